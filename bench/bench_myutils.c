@@ -0,0 +1,427 @@
+//
+// Microbenchmarks of the myutils validators and comparators.
+//
+// Every kernel runs over generated address sets that mimic production
+// data: skewed domains, mixed case, plus-tags, quoted local parts, IP
+// literals, labels at the length limits and a share of invalid input.
+// Each set is run with the scalar kernels and then with the ones
+// email_simd_init() selects. The email_validate library needs nothing
+// from the server; libpgcommon provides the hash. Results are printed as
+// one JSON object per line:
+//
+//   {"bench": "parse", "set": "common", "kernels": "avx2", "n": 100000, "ns_per_op": 41.2}
+//
+// Usage: bench_myutils [addresses per set [repetitions [output file]]]
+//
+
+#include "postgres_fe.h"
+
+#include <errno.h>
+#include <time.h>
+
+#include "common/hashfn.h"
+#include "myutils/common.h"
+#include "myutils/domain.h"
+#include "myutils/local.h"
+#include "myutils/parse.h"
+#include "myutils/simd.h"
+
+#define BENCH_MAX_ADDRESS 320
+
+/*
+ * Address set: n addresses packed into one buffer, with the parts as the
+ * parser splits them
+ */
+typedef struct {
+    const char *name;
+    int n;
+    char *data;
+    size_t *offset;
+    size_t *len;
+
+    /* parts of the valid addresses, and their canonical forms */
+    int nvalid;
+    const char **local;
+    size_t *local_len;
+    const char **domain;
+    size_t *domain_len;
+    char **canon;
+    size_t *canon_len;
+} AddressSet;
+
+typedef void (*SetGenerator)(uint64 *state, int i, char *buf);
+
+/* splitmix64, so that every run sees the same addresses */
+static uint64
+bench_random(uint64 *state) {
+    uint64 z = (*state += UINT64CONST(0x9e3779b97f4a7c15));
+
+    z = (z ^ (z >> 30)) * UINT64CONST(0xbf58476d1ce4e5b9);
+    z = (z ^ (z >> 27)) * UINT64CONST(0x94d049bb133111eb);
+    return z ^ (z >> 31);
+}
+
+static const char *const popular_domains[] = {
+    "gmail.com", "yahoo.com", "outlook.com", "hotmail.com", "icloud.com",
+    "qq.com", "163.com", "mail.ru", "gmx.de", "proton.me",
+};
+
+/*
+ * A domain with roughly Zipfian popularity: the ten popular ones take
+ * most addresses, then a long tail of company domains
+ */
+static int
+bench_domain(uint64 *state, char *buf) {
+    const double u = (double) (bench_random(state) >> 11) / (double) (UINT64CONST(1) << 53);
+    const int rank = (int) (1000.0 * u * u * u * u);
+
+    if (rank < (int) lengthof(popular_domains))
+        return sprintf(buf, "%s", popular_domains[rank]);
+
+    return sprintf(buf, "mail.corp%d.example.%s", rank, rank % 3 == 0 ? "org" : "com");
+}
+
+static void
+generate_common(uint64 *state, int i, char *buf) {
+    char domain[128];
+    const uint64 r = bench_random(state);
+
+    bench_domain(state, domain);
+
+    switch (r % 10) {
+        case 0:
+            /* mixed case */
+            sprintf(buf, "John.Smith%d@%s", i, domain);
+            buf[strlen(buf) - 1] &= ~0x20;
+            break;
+        case 1:
+        case 2:
+            sprintf(buf, "user%d+news%d@%s", i, (int) ((r >> 8) % 100), domain);
+            break;
+        default:
+            sprintf(buf, "first.last%d@%s", i, domain);
+            break;
+    }
+}
+
+static void
+generate_quoted(uint64 *state, int i, char *buf) {
+    char domain[128];
+
+    bench_domain(state, domain);
+
+    switch (bench_random(state) % 4) {
+        case 0:
+            /* content valid unquoted; the quotes are dropped */
+            sprintf(buf, "\"Alice.%d\"@%s", i, domain);
+            break;
+        case 1:
+            sprintf(buf, "\"john doe %d\"@%s", i, domain);
+            break;
+        case 2:
+            sprintf(buf, "\"john..doe%d\"@%s", i, domain);
+            break;
+        default:
+            sprintf(buf, "\"quote\\\"d\\\\%d\"@%s", i, domain);
+            break;
+    }
+}
+
+static void
+generate_ip(uint64 *state, int i, char *buf) {
+    const uint64 r = bench_random(state);
+
+    if (r % 3 == 0)
+        sprintf(buf, "postmaster%d@[IPv6:2001:db8:%x::%x]", i, (int) (r >> 8) & 0xffff, i & 0xffff);
+    else
+        sprintf(buf, "postmaster%d@[%d.%d.%d.%d]", i, (int) ((r >> 8) % 224) + 1, (int) (r >> 16) & 0xff,
+                (int) (r >> 24) & 0xff, (int) (r >> 32) & 0xff);
+}
+
+static void
+generate_long(uint64 *state, int i, char *buf) {
+    char *p = buf;
+
+    /* A 64-byte local part and a domain of 63-byte labels near 255 */
+    p += sprintf(p, "%0*d", 64, i);
+    *p++ = '@';
+    for (int label = 0; label < 3; label++) {
+        for (int j = 0; j < 63; j++)
+            *p++ = 'a' + (bench_random(state) % 26);
+        *p++ = '.';
+    }
+    sprintf(p, "example.com");
+}
+
+static void
+generate_invalid(uint64 *state, int i, char *buf) {
+    char domain[128];
+
+    bench_domain(state, domain);
+
+    switch (bench_random(state) % 6) {
+        case 0:
+            sprintf(buf, "user%d.%s", i, domain);
+            break;
+        case 1:
+            sprintf(buf, "user..%d@%s", i, domain);
+            break;
+        case 2:
+            sprintf(buf, "user%d@-%s", i, domain);
+            break;
+        case 3:
+            sprintf(buf, "user %d@%s", i, domain);
+            break;
+        case 4:
+            sprintf(buf, "user%d@%s.123", i, domain);
+            break;
+        default:
+            /* mostly valid addresses, as a real load has */
+            generate_common(state, i, buf);
+            break;
+    }
+}
+
+static void *
+bench_alloc(const size_t size) {
+    void *p = malloc(size);
+
+    if (p == NULL) {
+        fprintf(stderr, "out of memory\n");
+        exit(1);
+    }
+    return p;
+}
+
+static void
+build_set(AddressSet *set, const char *name, const int n, const SetGenerator generate) {
+    uint64 state = 42;
+    char buf[BENCH_MAX_ADDRESS * 2];
+    size_t used = 0;
+
+    set->name = name;
+    set->n = n;
+    set->data = bench_alloc((size_t) n * BENCH_MAX_ADDRESS);
+    set->offset = bench_alloc(sizeof(size_t) * (n + 1));
+    set->len = bench_alloc(sizeof(size_t) * n);
+    set->local = bench_alloc(sizeof(char *) * n);
+    set->local_len = bench_alloc(sizeof(size_t) * n);
+    set->domain = bench_alloc(sizeof(char *) * n);
+    set->domain_len = bench_alloc(sizeof(size_t) * n);
+    set->canon = bench_alloc(sizeof(char *) * n);
+    set->canon_len = bench_alloc(sizeof(size_t) * n);
+    set->nvalid = 0;
+
+    for (int i = 0; i < n; i++) {
+        EmailParseResult parse;
+
+        generate(&state, i, buf);
+
+        const size_t len = Min(strlen(buf), BENCH_MAX_ADDRESS);
+        memcpy(set->data + used, buf, len);
+        set->offset[i] = used;
+        set->len[i] = len;
+        used += len;
+
+        if (email_parse(set->data + set->offset[i], len, &parse)) {
+            const int v = set->nvalid++;
+            bool quoted;
+
+            set->local[v] = parse.local;
+            set->local_len[v] = parse.local_len;
+            set->domain[v] = parse.domain;
+            set->domain_len[v] = parse.domain_len;
+
+            /* canonical local '@' canonical domain, as email_addr stores it */
+            set->canon[v] = bench_alloc(len);
+            const size_t local_len = canonicalize_local_part(parse.local, parse.local_len, set->canon[v], &quoted);
+            set->canon[v][local_len] = '@';
+            email_lower(set->canon[v] + local_len + 1, parse.domain, parse.domain_len);
+            set->canon_len[v] = local_len + 1 + parse.domain_len;
+        }
+    }
+
+    /* The addresses are contiguous, as email_validate_batch takes them */
+    set->offset[n] = used;
+}
+
+/* Results are folded into this, so no call is optimised away */
+static volatile uint64 bench_sink;
+
+static uint64
+bench_parse(const AddressSet *set) {
+    uint64 acc = 0;
+
+    for (int i = 0; i < set->n; i++) {
+        EmailParseResult parse;
+
+        acc += email_parse(set->data + set->offset[i], set->len[i], &parse);
+    }
+    return acc;
+}
+
+static uint64
+bench_batch(const AddressSet *set) {
+    return email_validate_batch(set->data, set->offset, set->n, NULL);
+}
+
+static uint64
+bench_local(const AddressSet *set) {
+    uint64 acc = 0;
+
+    for (int i = 0; i < set->nvalid; i++) {
+        char *error_msg;
+
+        acc += validate_email_local_part(set->local[i], set->local_len[i], &error_msg);
+    }
+    return acc;
+}
+
+static uint64
+bench_domain_validate(const AddressSet *set) {
+    uint64 acc = 0;
+
+    for (int i = 0; i < set->nvalid; i++) {
+        char *error_msg;
+
+        acc += validate_email_domain(set->domain[i], set->domain_len[i], &error_msg);
+    }
+    return acc;
+}
+
+static uint64
+bench_canonicalize(const AddressSet *set) {
+    char buf[BENCH_MAX_ADDRESS];
+    uint64 acc = 0;
+
+    for (int i = 0; i < set->nvalid; i++) {
+        bool quoted;
+
+        acc += canonicalize_local_part(set->local[i], set->local_len[i], buf, &quoted);
+        acc += email_lower(buf, set->domain[i], set->domain_len[i]);
+    }
+    return acc;
+}
+
+/* The core of email_addr_domain_cmp on uncanonicalized values */
+static uint64
+bench_domain_casecmp(const AddressSet *set) {
+    uint64 acc = 0;
+
+    for (int i = 1; i < set->nvalid; i++)
+        acc += bounded_strcasecmp(set->domain[i - 1], set->domain_len[i - 1],
+                                  set->domain[i], set->domain_len[i]) < 0;
+    return acc;
+}
+
+/* The core of email_addr_cmp: bytewise on the canonical forms */
+static uint64
+bench_canon_memcmp(const AddressSet *set) {
+    uint64 acc = 0;
+
+    for (int i = 1; i < set->nvalid; i++)
+        acc += bounded_memcmp(set->canon[i - 1], set->canon_len[i - 1],
+                              set->canon[i], set->canon_len[i]) < 0;
+    return acc;
+}
+
+/* The core of email_hash */
+static uint64
+bench_hash(const AddressSet *set) {
+    uint64 acc = 0;
+
+    for (int i = 0; i < set->nvalid; i++)
+        acc += hash_bytes_extended((const unsigned char *) set->canon[i], set->canon_len[i], 0);
+    return acc;
+}
+
+typedef struct {
+    const char *name;
+    uint64 (*run)(const AddressSet *set);
+    bool valid_only;
+} Benchmark;
+
+static const Benchmark benchmarks[] = {
+    {"parse", bench_parse, false},
+    {"validate_batch", bench_batch, false},
+    {"validate_local", bench_local, true},
+    {"validate_domain", bench_domain_validate, true},
+    {"canonicalize", bench_canonicalize, true},
+    {"domain_casecmp", bench_domain_casecmp, true},
+    {"canon_memcmp", bench_canon_memcmp, true},
+    {"hash", bench_hash, true},
+};
+
+static double
+now_ns(void) {
+    struct timespec ts;
+
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (double) ts.tv_sec * 1e9 + (double) ts.tv_nsec;
+}
+
+/*
+ * Best of repeat runs, which filters out scheduling noise
+ */
+static void
+run_benchmark(FILE *out, const Benchmark *bench, const AddressSet *set, const int repeat) {
+    const int n = bench->valid_only ? set->nvalid : set->n;
+    double best = -1;
+
+    if (n == 0)
+        return;
+
+    for (int r = 0; r < repeat; r++) {
+        const double start = now_ns();
+
+        bench_sink += bench->run(set);
+
+        const double elapsed = now_ns() - start;
+        if (best < 0 || elapsed < best)
+            best = elapsed;
+    }
+
+    fprintf(out, "{\"bench\": \"%s\", \"set\": \"%s\", \"kernels\": \"%s\", \"n\": %d, \"ns_per_op\": %.2f}\n",
+           bench->name, set->name, email_simd_name(), n, best / n);
+}
+
+int
+main(int argc, char **argv) {
+    const int n = argc > 1 ? atoi(argv[1]) : 100000;
+    const int repeat = argc > 2 ? atoi(argv[2]) : 5;
+    FILE *out = argc > 3 ? fopen(argv[3], "w") : stdout;
+    AddressSet sets[5];
+
+    if (n <= 0 || repeat <= 0) {
+        fprintf(stderr, "usage: %s [addresses per set [repetitions [output file]]]\n", argv[0]);
+        return 1;
+    }
+    if (out == NULL) {
+        fprintf(stderr, "could not open \"%s\": %s\n", argv[3], strerror(errno));
+        return 1;
+    }
+
+    build_set(&sets[0], "common", n, generate_common);
+    build_set(&sets[1], "quoted", n, generate_quoted);
+    build_set(&sets[2], "ip_literal", n, generate_ip);
+    build_set(&sets[3], "long", n, generate_long);
+    build_set(&sets[4], "invalid", n, generate_invalid);
+
+    /* Scalar kernels first, then whatever the CPU supports */
+    for (int pass = 0; pass < 2; pass++) {
+        if (pass == 1) {
+            email_simd_init();
+            if (strcmp(email_simd_name(), "scalar") == 0)
+                break;
+        }
+
+        for (int s = 0; s < (int) lengthof(sets); s++)
+            for (int b = 0; b < (int) lengthof(benchmarks); b++)
+                run_benchmark(out, &benchmarks[b], &sets[s], repeat);
+    }
+
+    if (out != stdout)
+        fclose(out);
+
+    return 0;
+}
@@ -0,0 +1,3 @@
+-- Every address of one domain, popular ones most often
+\set rank random_zipfian(1, 1000, 1.5)
+SELECT count(*) FROM bench_emails WHERE email =# ('x@' || bench_domain(:rank))::email_addr;
@@ -0,0 +1,3 @@
+-- Hash aggregation on the address: email_hash
+SET enable_sort = off;
+SELECT count(*) FROM (SELECT email FROM bench_emails GROUP BY email) s;
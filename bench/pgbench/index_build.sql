@@ -0,0 +1,3 @@
+-- B-tree build: sorting with email_addr_sortsupport
+CREATE INDEX bench_emails_build_idx ON bench_emails (email);
+DROP INDEX bench_emails_build_idx;
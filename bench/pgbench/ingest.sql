@@ -0,0 +1,3 @@
+-- COPY ingest: email_addr_in for every row; run with -M simple -D datafile="'path'"
+TRUNCATE bench_ingest;
+COPY bench_ingest (email) FROM :datafile;
@@ -0,0 +1,3 @@
+-- Point lookups through the B-tree index
+\set id random(1, :rows)
+SELECT id FROM bench_emails WHERE email = bench_email(:id)::email_addr;
@@ -0,0 +1,2 @@
+-- Text output of every value: email_addr_out
+SELECT sum(length(email::text)) FROM bench_emails;
@@ -0,0 +1,60 @@
+#!/usr/bin/env bash
+#
+# Runs the pgbench workloads against the server in the PG* environment and
+# writes one JSON object per workload to <output dir>/pgbench.jsonl:
+#
+#   {"workload": "lookup", "clients": 4, "transactions": 81234, "tps": 2707.8, "latency_ms": 1.477}
+#
+# The server must be local: the ingest workload COPYs a file the script
+# writes, which needs superuser or pg_read_server_files.
+#
+# Usage: run.bash [output dir [rows [seconds [clients]]]]
+
+set -euo pipefail
+
+here="$(cd "$(dirname "$0")" && pwd)"
+out="$(mkdir -p "${1:-.}" && cd "${1:-.}" && pwd)"
+rows="${2:-1000000}"
+duration="${3:-30}"
+clients="${4:-4}"
+datafile="$out/bench-addresses.txt"
+results="$out/pgbench.jsonl"
+
+psql -X -q -v ON_ERROR_STOP=on -v rows="$rows" -f "$here/setup.sql" > /dev/null
+psql -X -q -v ON_ERROR_STOP=on \
+    -c "\\copy (SELECT bench_email(i) FROM generate_series(1, $rows) i) TO '$datafile'"
+
+: > "$results"
+
+# name, pgbench options
+workloads=(
+    "ingest|-M simple -t 3 -c 1"
+    "index_build|-t 3 -c 1"
+    "sort|-t 3 -c 1"
+    "output|-t 3 -c 1"
+    "hash_agg|-t 3 -c 1"
+    "lookup|-T $duration -c $clients -j $clients -M prepared"
+    "domain_scan|-T $duration -c $clients -j $clients -M prepared"
+)
+
+for entry in "${workloads[@]}"; do
+    name="${entry%%|*}"
+    # shellcheck disable=SC2206
+    options=(${entry#*|})
+
+    log="$out/pgbench-$name.log"
+    pgbench -n "${options[@]}" -D rows="$rows" -D datafile="'$datafile'" \
+        -f "$here/$name.sql" > "$log" 2>&1
+
+    awk -v name="$name" '
+        /^number of clients:/ { clients = $4 }
+        /^number of transactions actually processed:/ { split($NF, t, "/"); transactions = t[1] }
+        /^latency average/ { latency = $4 }
+        /^tps = / { tps = $3 }
+        END {
+            printf "{\"workload\": \"%s\", \"clients\": %d, \"transactions\": %d, \"tps\": %s, \"latency_ms\": %s}\n",
+                   name, clients, transactions, tps, latency
+        }' "$log" | tee -a "$results"
+done
+
+rm -f "$datafile"
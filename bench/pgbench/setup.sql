@@ -0,0 +1,54 @@
+-- ================================================
+-- Data for the pgbench workloads; run with -v rows=N
+-- ================================================
+
+CREATE EXTENSION IF NOT EXISTS pg_email_opt;
+
+-- Domain of popularity rank n: a few providers take most addresses
+CREATE OR REPLACE FUNCTION bench_domain(n integer) RETURNS text
+LANGUAGE sql IMMUTABLE PARALLEL SAFE AS $$
+    SELECT CASE
+        WHEN n <= 10 THEN (ARRAY['gmail.com', 'yahoo.com', 'outlook.com', 'hotmail.com', 'icloud.com',
+                                 'qq.com', '163.com', 'mail.ru', 'gmx.de', 'proton.me'])[n]
+        ELSE 'mail.corp' || n || '.example.' || CASE WHEN n % 3 = 0 THEN 'org' ELSE 'com' END
+    END
+$$;
+
+-- Rank of the domain of the id-th address, skewed like bench_myutils
+CREATE OR REPLACE FUNCTION bench_domain_rank(id bigint) RETURNS integer
+LANGUAGE sql IMMUTABLE PARALLEL SAFE AS $$
+    SELECT 1 + floor(1000 * power(((id * 2654435761) % 1000003) / 1000003.0, 4))::integer
+$$;
+
+-- The id-th address: mostly plain, with plus-tags, mixed case, quoted
+-- local parts, IP literals and labels at the length limits mixed in
+CREATE OR REPLACE FUNCTION bench_email(id bigint) RETURNS text
+LANGUAGE sql IMMUTABLE PARALLEL SAFE AS $$
+    SELECT CASE
+        WHEN id % 100 = 0 THEN '"john doe ' || id || '"@' || bench_domain(bench_domain_rank(id))
+        WHEN id % 100 = 1 THEN 'postmaster' || id || '@[10.' || (id / 65536) % 256 || '.'
+                               || (id / 256) % 256 || '.' || id % 256 || ']'
+        WHEN id % 100 = 2 THEN lpad(id::text, 64, '0') || '@' || repeat(chr(97 + (id % 26)::integer), 63)
+                               || '.' || repeat('b', 63) || '.example.com'
+        WHEN id % 10 = 3 THEN 'User' || id || '+news@' || upper(bench_domain(bench_domain_rank(id)))
+        ELSE 'first.last' || id || '@' || bench_domain(bench_domain_rank(id))
+    END
+$$;
+
+DROP TABLE IF EXISTS bench_emails;
+DROP TABLE IF EXISTS bench_ingest;
+
+CREATE TABLE bench_emails (
+    id bigint PRIMARY KEY,
+    email email_addr NOT NULL
+);
+
+INSERT INTO bench_emails
+SELECT i, bench_email(i)::email_addr FROM generate_series(1, :rows) i;
+
+CREATE INDEX bench_emails_email_idx ON bench_emails (email);
+CREATE INDEX bench_emails_domain_idx ON bench_emails (email email_addr_domain_ops);
+
+CREATE UNLOGGED TABLE bench_ingest (email email_addr);
+
+VACUUM ANALYZE bench_emails;
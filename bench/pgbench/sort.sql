@@ -0,0 +1,6 @@
+-- Full sorts without the indexes: email_addr_cmp, then the domain order
+SET enable_indexscan = off;
+SET enable_indexonlyscan = off;
+SET enable_bitmapscan = off;
+SELECT email FROM bench_emails ORDER BY email OFFSET :rows;
+SELECT email FROM bench_emails ORDER BY email USING <# OFFSET :rows;
@@ -0,0 +1,643 @@
+//
+// Domain statistics and selectivity estimation for the domain operators.
+//
+// ANALYZE collects the standard statistics of the whole address, which
+// say little about domains: a domain shared by half of the rows has no
+// address in the MCV list. email_addr_typanalyze adds two slots computed
+// over the canonical domains of the sample:
+//     STATISTIC_KIND_EMAIL_DOMAIN_MCV    the most common domains, with
+//         their frequencies; one extra number at the end holds the
+//         number of distinct domains (negative: a fraction of the rows)
+//     STATISTIC_KIND_EMAIL_DOMAIN_HIST   equi-depth histogram of the other
+//         domains, in email_addr_domain_ops order
+// Values are the canonical domains as text. The estimators of =#, <>#,
+// <#, <=#, ># and >=# read these slots.
+//
+
+#include "postgres.h"
+
+#include <math.h>
+
+#include "access/htup_details.h"
+#include "catalog/pg_statistic.h"
+#include "catalog/pg_type.h"
+#include "commands/vacuum.h"
+#include "nodes/pathnodes.h"
+#include "utils/builtins.h"
+#include "utils/lsyscache.h"
+#include "utils/selfuncs.h"
+
+#include "pg_email_opt.h"
+
+/* Statistics kinds, from the range reserved for private use */
+#define STATISTIC_KIND_EMAIL_DOMAIN_MCV   10001
+#define STATISTIC_KIND_EMAIL_DOMAIN_HIST  10002
+
+/* Standard statistics, computed before ours */
+typedef struct {
+    AnalyzeAttrComputeStatsFunc std_compute_stats;
+    void *std_extra_data;
+} EmailAnalyzeExtraData;
+
+/* A sampled domain */
+typedef struct {
+    const char *data;
+    int len;
+} SampleDomain;
+
+/* A run of equal domains in the sorted sample */
+typedef struct {
+    int first;
+    int count;
+    bool is_mcv;
+} DomainGroup;
+
+/* Domain statistics of a column, as read by the estimators */
+typedef struct {
+    AttStatsSlot mcv;
+    AttStatsSlot hist;
+    int nmcv;
+    bool have_hist;
+    double ndistinct;
+    double nullfrac;
+    double mcv_freq;
+} DomainStats;
+
+/*
+ * Domain order of email_addr_domain_ops: length first, then bytewise
+ */
+static int
+domain_cmp(const char *d1, const int len1, const char *d2, const int len2) {
+    if (len1 != len2)
+        return len1 < len2 ? -1 : 1;
+    return memcmp(d1, d2, len1);
+}
+
+static int
+sample_domain_cmp(const void *a, const void *b) {
+    const SampleDomain *da = a;
+    const SampleDomain *db = b;
+
+    return domain_cmp(da->data, da->len, db->data, db->len);
+}
+
+/* Most frequent first; ties in domain order */
+static int
+domain_group_count_cmp(const void *a, const void *b) {
+    const DomainGroup *ga = a;
+    const DomainGroup *gb = b;
+
+    if (ga->count != gb->count)
+        return ga->count > gb->count ? -1 : 1;
+    return ga->first - gb->first;
+}
+
+static int
+domain_group_first_cmp(const void *a, const void *b) {
+    return ((const DomainGroup *) a)->first - ((const DomainGroup *) b)->first;
+}
+
+/*
+ * Returns the first unused statistics slot, or -1
+ */
+static int
+free_stats_slot(const VacAttrStats *stats) {
+    for (int i = 0; i < STATISTIC_NUM_SLOTS; i++) {
+        if (stats->stakind[i] == 0)
+            return i;
+    }
+    return -1;
+}
+
+/*
+ * Haas-Stokes estimate of the number of distinct domains, as ANALYZE
+ * makes it for column values. Negative results are fractions of the rows.
+ */
+static double
+estimate_ndistinct(const int nonnull, const int d, const int f1, const double totalrows,
+                   const double nullfrac) {
+    const double N = totalrows * (1.0 - nullfrac);
+    double ndistinct;
+
+    if (f1 == d) {
+        /* Every sampled domain is unique: assume they all are */
+        return -(1.0 - nullfrac);
+    }
+
+    if (f1 == 0 || N <= 0) {
+        /* Every domain was seen more than once: assume we saw them all */
+        ndistinct = d;
+    } else {
+        ndistinct = (nonnull * (double) d) / ((nonnull - f1) + f1 * (double) nonnull / N);
+        ndistinct = Max(ndistinct, d);
+        ndistinct = Min(ndistinct, N);
+        ndistinct = floor(ndistinct + 0.5);
+    }
+
+    /* Scale with the table if more than 10% of the rows are distinct */
+    if (ndistinct > 0.1 * totalrows)
+        return -(ndistinct / totalrows);
+
+    return ndistinct;
+}
+
+static Datum
+domain_text_datum(const SampleDomain *domain) {
+    return PointerGetDatum(cstring_to_text_with_len(domain->data, domain->len));
+}
+
+/*
+ * Computes the standard statistics, then the domain slots
+ */
+static void
+compute_email_stats(VacAttrStats *stats, const AnalyzeAttrFetchFunc fetchfunc, const int samplerows,
+                    const double totalrows) {
+    EmailAnalyzeExtraData *extra = stats->extra_data;
+    const int num_mcv = stats->attr->attstattarget;
+    const int num_bins = stats->attr->attstattarget;
+    int nonnull = 0;
+
+    stats->extra_data = extra->std_extra_data;
+    extra->std_compute_stats(stats, fetchfunc, samplerows, totalrows);
+    stats->extra_data = extra;
+
+    const int mcv_slot = free_stats_slot(stats);
+    if (!stats->stats_valid || mcv_slot < 0)
+        return;
+
+    /* Canonical domains of the sample, sorted */
+    SampleDomain *domains = palloc(sizeof(SampleDomain) * samplerows);
+
+    for (int i = 0; i < samplerows; i++) {
+        bool isnull;
+        const Datum value = fetchfunc(stats, i, &isnull);
+        EmailAddrView view;
+
+        vacuum_delay_point();
+
+        if (isnull)
+            continue;
+
+        EMAIL_ADDR *addr = DatumGetEmailAddrP(value);
+
+        email_addr_unpack(addr, &view);
+        domains[nonnull].data = pnstrdup(view.canon_domain, view.canon_domain_len);
+        domains[nonnull].len = view.canon_domain_len;
+        nonnull++;
+
+        if (addr != (EMAIL_ADDR *) DatumGetPointer(value))
+            pfree(addr);
+    }
+
+    if (nonnull == 0)
+        return;
+
+    qsort(domains, nonnull, sizeof(SampleDomain), sample_domain_cmp);
+
+    /* Runs of equal domains */
+    DomainGroup *groups = palloc(sizeof(DomainGroup) * nonnull);
+    int ngroups = 0;
+    int f1 = 0;
+
+    for (int i = 0; i < nonnull; i++) {
+        if (i == 0 || sample_domain_cmp(&domains[i - 1], &domains[i]) != 0) {
+            groups[ngroups].first = i;
+            groups[ngroups].count = 0;
+            groups[ngroups].is_mcv = false;
+            ngroups++;
+        }
+        groups[ngroups - 1].count++;
+    }
+    for (int i = 0; i < ngroups; i++) {
+        if (groups[i].count == 1)
+            f1++;
+    }
+
+    /*
+     * Keep the domains that are clearly more common than average, or all
+     * of them if they fit and none is a singleton
+     */
+    qsort(groups, ngroups, sizeof(DomainGroup), domain_group_count_cmp);
+
+    int nmcv = Min(ngroups, num_mcv);
+    if (ngroups > num_mcv || f1 > 0) {
+        const double avgcount = (double) nonnull / ngroups;
+        const double mincount = Max(avgcount * 1.25, 2);
+
+        while (nmcv > 0 && groups[nmcv - 1].count < mincount)
+            nmcv--;
+    }
+
+    const double ndistinct = estimate_ndistinct(nonnull, ngroups, f1, totalrows, stats->stanullfrac);
+    const MemoryContext old_context = MemoryContextSwitchTo(stats->anl_context);
+
+    Datum *mcv_values = palloc(sizeof(Datum) * Max(nmcv, 1));
+    float4 *mcv_freqs = palloc(sizeof(float4) * (nmcv + 1));
+
+    for (int i = 0; i < nmcv; i++) {
+        mcv_values[i] = domain_text_datum(&domains[groups[i].first]);
+        mcv_freqs[i] = (double) groups[i].count / samplerows;
+        groups[i].is_mcv = true;
+    }
+    mcv_freqs[nmcv] = ndistinct;
+
+    stats->stakind[mcv_slot] = STATISTIC_KIND_EMAIL_DOMAIN_MCV;
+    stats->staop[mcv_slot] = InvalidOid;
+    stats->stacoll[mcv_slot] = InvalidOid;
+    stats->stanumbers[mcv_slot] = mcv_freqs;
+    stats->numnumbers[mcv_slot] = nmcv + 1;
+    stats->stavalues[mcv_slot] = mcv_values;
+    stats->numvalues[mcv_slot] = nmcv;
+    stats->statypid[mcv_slot] = TEXTOID;
+    stats->statyplen[mcv_slot] = -1;
+    stats->statypbyval[mcv_slot] = false;
+    stats->statypalign[mcv_slot] = TYPALIGN_INT;
+
+    MemoryContextSwitchTo(old_context);
+
+    /* Equi-depth histogram over the sampled domains not in the MCV list */
+    const int hist_slot = free_stats_slot(stats);
+    const int nother_groups = ngroups - nmcv;
+
+    if (hist_slot < 0 || nother_groups < 2)
+        return;
+
+    qsort(groups, ngroups, sizeof(DomainGroup), domain_group_first_cmp);
+
+    SampleDomain *others = palloc(sizeof(SampleDomain) * nonnull);
+    int nothers = 0;
+
+    for (int i = 0; i < ngroups; i++) {
+        if (groups[i].is_mcv)
+            continue;
+        for (int j = 0; j < groups[i].count; j++)
+            others[nothers++] = domains[groups[i].first + j];
+    }
+
+    const int num_hist = Min(nother_groups, num_bins + 1);
+
+    MemoryContextSwitchTo(stats->anl_context);
+
+    Datum *hist_values = palloc(sizeof(Datum) * num_hist);
+
+    for (int i = 0; i < num_hist; i++) {
+        const int pos = (int) ((int64) (nothers - 1) * i / (num_hist - 1));
+
+        hist_values[i] = domain_text_datum(&others[pos]);
+    }
+
+    stats->stakind[hist_slot] = STATISTIC_KIND_EMAIL_DOMAIN_HIST;
+    stats->staop[hist_slot] = InvalidOid;
+    stats->stacoll[hist_slot] = InvalidOid;
+    stats->stavalues[hist_slot] = hist_values;
+    stats->numvalues[hist_slot] = num_hist;
+    stats->statypid[hist_slot] = TEXTOID;
+    stats->statyplen[hist_slot] = -1;
+    stats->statypbyval[hist_slot] = false;
+    stats->statypalign[hist_slot] = TYPALIGN_INT;
+
+    MemoryContextSwitchTo(old_context);
+}
+
+/*
+ * typanalyze: standard statistics plus the domain slots
+ */
+PG_FUNCTION_INFO_V1(email_addr_typanalyze);
+
+Datum
+email_addr_typanalyze(PG_FUNCTION_ARGS) {
+    VacAttrStats *stats = (VacAttrStats *) PG_GETARG_POINTER(0);
+
+    if (!std_typanalyze(stats))
+        PG_RETURN_BOOL(false);
+
+    EmailAnalyzeExtraData *extra = palloc(sizeof(EmailAnalyzeExtraData));
+
+    extra->std_compute_stats = stats->compute_stats;
+    extra->std_extra_data = stats->extra_data;
+    stats->extra_data = extra;
+    stats->compute_stats = compute_email_stats;
+
+    PG_RETURN_BOOL(true);
+}
+
+/*
+ * Reads the domain statistics of a variable. Returns false if there are
+ * none; otherwise release them with release_domain_stats.
+ */
+static bool
+get_domain_stats(const VariableStatData *vardata, DomainStats *ds) {
+    if (!HeapTupleIsValid(vardata->statsTuple))
+        return false;
+
+    /* The MCV slot always has its ndistinct number, its values only if any */
+    if (!get_attstatsslot(&ds->mcv, vardata->statsTuple, STATISTIC_KIND_EMAIL_DOMAIN_MCV,
+                          InvalidOid, ATTSTATSSLOT_NUMBERS))
+        return false;
+
+    ds->nmcv = ds->mcv.nnumbers - 1;
+    if (ds->nmcv > 0) {
+        free_attstatsslot(&ds->mcv);
+        if (!get_attstatsslot(&ds->mcv, vardata->statsTuple, STATISTIC_KIND_EMAIL_DOMAIN_MCV,
+                              InvalidOid, ATTSTATSSLOT_VALUES | ATTSTATSSLOT_NUMBERS))
+            return false;
+    }
+
+    ds->have_hist = get_attstatsslot(&ds->hist, vardata->statsTuple, STATISTIC_KIND_EMAIL_DOMAIN_HIST,
+                                     InvalidOid, ATTSTATSSLOT_VALUES);
+
+    ds->nullfrac = ((Form_pg_statistic) GETSTRUCT(vardata->statsTuple))->stanullfrac;
+
+    ds->mcv_freq = 0;
+    for (int i = 0; i < ds->nmcv; i++)
+        ds->mcv_freq += ds->mcv.numbers[i];
+
+    ds->ndistinct = ds->mcv.numbers[ds->nmcv];
+    if (ds->ndistinct < 0)
+        ds->ndistinct = -ds->ndistinct * (vardata->rel ? vardata->rel->tuples : 0);
+    ds->ndistinct = Max(ds->ndistinct, ds->nmcv + 1);
+
+    return true;
+}
+
+static void
+release_domain_stats(DomainStats *ds) {
+    free_attstatsslot(&ds->mcv);
+    if (ds->have_hist)
+        free_attstatsslot(&ds->hist);
+}
+
+/*
+ * Compares a domain with a statistics value
+ */
+static int
+domain_cmp_text(const char *domain, const int len, const Datum value) {
+    const text *txt = DatumGetTextPP(value);
+
+    return domain_cmp(domain, len, VARDATA_ANY(txt), VARSIZE_ANY_EXHDR(txt));
+}
+
+/*
+ * Fraction of the rows whose domain equals the given one
+ */
+static double
+domain_eq_selectivity(const DomainStats *ds, const char *domain, const int len) {
+    for (int i = 0; i < ds->nmcv; i++) {
+        if (domain_cmp_text(domain, len, ds->mcv.values[i]) == 0)
+            return ds->mcv.numbers[i];
+    }
+
+    /* Not common: a share of the rest, but no more than the rarest MCV */
+    double selec = (1.0 - ds->nullfrac - ds->mcv_freq) / (ds->ndistinct - ds->nmcv);
+    if (ds->nmcv > 0)
+        selec = Min(selec, ds->mcv.numbers[ds->nmcv - 1]);
+
+    return selec;
+}
+
+/*
+ * Fraction of the rows whose domain is below the given one, or at most
+ * the given one if inclusive
+ */
+static double
+domain_lt_selectivity(const DomainStats *ds, const char *domain, const int len, const bool inclusive) {
+    double mcv_selec = 0;
+    double hist_frac = DEFAULT_INEQ_SEL;
+
+    for (int i = 0; i < ds->nmcv; i++) {
+        const int cmp = domain_cmp_text(domain, len, ds->mcv.values[i]);
+
+        if (cmp > 0 || (inclusive && cmp == 0))
+            mcv_selec += ds->mcv.numbers[i];
+    }
+
+    if (ds->have_hist && ds->hist.nvalues >= 2) {
+        /* Number of bounds below the domain */
+        int low = 0;
+        int high = ds->hist.nvalues;
+
+        while (low < high) {
+            const int mid = (low + high) / 2;
+            const int cmp = domain_cmp_text(domain, len, ds->hist.values[mid]);
+
+            if (cmp > 0 || (inclusive && cmp == 0))
+                low = mid + 1;
+            else
+                high = mid;
+        }
+
+        /* Half a bin for a domain inside a bin, as we cannot interpolate */
+        if (low == 0)
+            hist_frac = 0;
+        else if (low == ds->hist.nvalues)
+            hist_frac = 1;
+        else
+            hist_frac = (low - 0.5) / (ds->hist.nvalues - 1);
+    }
+
+    return mcv_selec + hist_frac * (1.0 - ds->nullfrac - ds->mcv_freq);
+}
+
+/*
+ * Restriction estimate for a domain operator. For comparisons, lt tells
+ * the direction with the variable on the left; ne negates equality.
+ */
+static double
+domain_restrict_selectivity(FunctionCallInfo fcinfo, const bool eq, const bool ne,
+                            const bool lt, const bool inclusive) {
+    PlannerInfo *root = (PlannerInfo *) PG_GETARG_POINTER(0);
+    List *args = (List *) PG_GETARG_POINTER(2);
+    const int varRelid = PG_GETARG_INT32(3);
+    const double default_selec = eq ? (ne ? 1.0 - DEFAULT_EQ_SEL : DEFAULT_EQ_SEL) : DEFAULT_INEQ_SEL;
+    VariableStatData vardata;
+    DomainStats ds;
+    Node *other;
+    bool varonleft;
+    double selec;
+
+    if (!get_restriction_variable(root, args, varRelid, &vardata, &other, &varonleft))
+        return default_selec;
+
+    if (!get_domain_stats(&vardata, &ds)) {
+        ReleaseVariableStats(vardata);
+        return default_selec;
+    }
+
+    if (IsA(other, Const) && ((Const *) other)->constisnull) {
+        selec = 0;
+    } else if (IsA(other, Const)) {
+        EMAIL_ADDR *addr = DatumGetEmailAddrP(((Const *) other)->constvalue);
+        EmailAddrView view;
+
+        email_addr_unpack(addr, &view);
+
+        if (eq) {
+            selec = domain_eq_selectivity(&ds, view.canon_domain, view.canon_domain_len);
+        } else {
+            /* "const < var" is "var > const" */
+            const bool var_lt = varonleft ? lt : !lt;
+            const double below = domain_lt_selectivity(&ds, view.canon_domain, view.canon_domain_len,
+                                                       var_lt == inclusive);
+
+            selec = var_lt ? below : 1.0 - ds.nullfrac - below;
+        }
+    } else if (eq) {
+        /* Unknown domain: the average one */
+        selec = (1.0 - ds.nullfrac) / ds.ndistinct;
+    } else {
+        selec = DEFAULT_INEQ_SEL;
+    }
+
+    if (ne)
+        selec = 1.0 - ds.nullfrac - selec;
+
+    release_domain_stats(&ds);
+    ReleaseVariableStats(vardata);
+
+    CLAMP_PROBABILITY(selec);
+    return selec;
+}
+
+PG_FUNCTION_INFO_V1(email_addr_domain_eqsel);
+
+Datum
+email_addr_domain_eqsel(PG_FUNCTION_ARGS) {
+    PG_RETURN_FLOAT8(domain_restrict_selectivity(fcinfo, true, false, false, false));
+}
+
+PG_FUNCTION_INFO_V1(email_addr_domain_neqsel);
+
+Datum
+email_addr_domain_neqsel(PG_FUNCTION_ARGS) {
+    PG_RETURN_FLOAT8(domain_restrict_selectivity(fcinfo, true, true, false, false));
+}
+
+PG_FUNCTION_INFO_V1(email_addr_domain_ltsel);
+
+Datum
+email_addr_domain_ltsel(PG_FUNCTION_ARGS) {
+    PG_RETURN_FLOAT8(domain_restrict_selectivity(fcinfo, false, false, true, false));
+}
+
+PG_FUNCTION_INFO_V1(email_addr_domain_lesel);
+
+Datum
+email_addr_domain_lesel(PG_FUNCTION_ARGS) {
+    PG_RETURN_FLOAT8(domain_restrict_selectivity(fcinfo, false, false, true, true));
+}
+
+PG_FUNCTION_INFO_V1(email_addr_domain_gtsel);
+
+Datum
+email_addr_domain_gtsel(PG_FUNCTION_ARGS) {
+    PG_RETURN_FLOAT8(domain_restrict_selectivity(fcinfo, false, false, false, false));
+}
+
+PG_FUNCTION_INFO_V1(email_addr_domain_gesel);
+
+Datum
+email_addr_domain_gesel(PG_FUNCTION_ARGS) {
+    PG_RETURN_FLOAT8(domain_restrict_selectivity(fcinfo, false, false, false, true));
+}
+
+/*
+ * Join estimate for =#, following eqjoinsel: matching MCVs contribute
+ * their frequency products, the rest is spread over the other domains
+ */
+static double
+domain_eqjoin_selectivity(FunctionCallInfo fcinfo) {
+    PlannerInfo *root = (PlannerInfo *) PG_GETARG_POINTER(0);
+    List *args = (List *) PG_GETARG_POINTER(2);
+    const JoinType jointype = (JoinType) PG_GETARG_INT16(3);
+    SpecialJoinInfo *sjinfo = (SpecialJoinInfo *) PG_GETARG_POINTER(4);
+    VariableStatData vardata1;
+    VariableStatData vardata2;
+    DomainStats ds1;
+    DomainStats ds2;
+    bool join_is_reversed;
+    double selec;
+
+    get_join_variables(root, args, sjinfo, &vardata1, &vardata2, &join_is_reversed);
+
+    const bool have1 = get_domain_stats(&vardata1, &ds1);
+    const bool have2 = get_domain_stats(&vardata2, &ds2);
+
+    if (!have1 || !have2) {
+        selec = DEFAULT_EQ_SEL;
+    } else if (jointype == JOIN_SEMI || jointype == JOIN_ANTI) {
+        /* Fraction of outer rows with a match */
+        const DomainStats *outer = join_is_reversed ? &ds2 : &ds1;
+        const DomainStats *inner = join_is_reversed ? &ds1 : &ds2;
+
+        selec = 1.0 - outer->nullfrac;
+        if (inner->ndistinct < outer->ndistinct)
+            selec *= inner->ndistinct / outer->ndistinct;
+    } else {
+        double match_prod = 0;
+        double match_freq1 = 0;
+        double match_freq2 = 0;
+        int nmatches = 0;
+
+        for (int i = 0; i < ds1.nmcv; i++) {
+            const text *d1 = DatumGetTextPP(ds1.mcv.values[i]);
+
+            for (int j = 0; j < ds2.nmcv; j++) {
+                if (domain_cmp_text(VARDATA_ANY(d1), VARSIZE_ANY_EXHDR(d1), ds2.mcv.values[j]) == 0) {
+                    match_prod += ds1.mcv.numbers[i] * ds2.mcv.numbers[j];
+                    match_freq1 += ds1.mcv.numbers[i];
+                    match_freq2 += ds2.mcv.numbers[j];
+                    nmatches++;
+                    break;
+                }
+            }
+        }
+
+        const double unmatch_freq1 = ds1.mcv_freq - match_freq1;
+        const double unmatch_freq2 = ds2.mcv_freq - match_freq2;
+        const double other_freq1 = Max(1.0 - ds1.nullfrac - ds1.mcv_freq, 0);
+        const double other_freq2 = Max(1.0 - ds2.nullfrac - ds2.mcv_freq, 0);
+        double total1 = match_prod;
+        double total2 = match_prod;
+
+        if (ds2.ndistinct > ds2.nmcv)
+            total1 += unmatch_freq1 * other_freq2 / (ds2.ndistinct - ds2.nmcv);
+        if (ds2.ndistinct > nmatches)
+            total1 += other_freq1 * (other_freq2 + unmatch_freq2) / (ds2.ndistinct - nmatches);
+        if (ds1.ndistinct > ds1.nmcv)
+            total2 += unmatch_freq2 * other_freq1 / (ds1.ndistinct - ds1.nmcv);
+        if (ds1.ndistinct > nmatches)
+            total2 += other_freq2 * (other_freq1 + unmatch_freq1) / (ds1.ndistinct - nmatches);
+
+        selec = Min(total1, total2);
+    }
+
+    if (have1)
+        release_domain_stats(&ds1);
+    if (have2)
+        release_domain_stats(&ds2);
+    ReleaseVariableStats(vardata1);
+    ReleaseVariableStats(vardata2);
+
+    CLAMP_PROBABILITY(selec);
+    return selec;
+}
+
+PG_FUNCTION_INFO_V1(email_addr_domain_eqjoinsel);
+
+Datum
+email_addr_domain_eqjoinsel(PG_FUNCTION_ARGS) {
+    PG_RETURN_FLOAT8(domain_eqjoin_selectivity(fcinfo));
+}
+
+PG_FUNCTION_INFO_V1(email_addr_domain_neqjoinsel);
+
+Datum
+email_addr_domain_neqjoinsel(PG_FUNCTION_ARGS) {
+    const JoinType jointype = (JoinType) PG_GETARG_INT16(3);
+
+    /* Nearly every outer row has some row with another domain */
+    if (jointype == JOIN_SEMI || jointype == JOIN_ANTI)
+        PG_RETURN_FLOAT8(1.0 - DEFAULT_EQ_SEL);
+
+    PG_RETURN_FLOAT8(1.0 - domain_eqjoin_selectivity(fcinfo));
+}
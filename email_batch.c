@@ -0,0 +1,154 @@
+//
+// Batch validation and parsing of text arrays.
+//
+// Each function makes a single call for the whole array and parses the
+// elements in place: there is no fmgr call, cstring copy or error per
+// element. Invalid elements never raise an error.
+//
+
+#include "postgres.h"
+
+#include "catalog/pg_type.h"
+#include "funcapi.h"
+#include "nodes/miscnodes.h"
+#include "utils/array.h"
+#include "utils/builtins.h"
+#include "utils/lsyscache.h"
+#include "utils/tuplestore.h"
+
+#include "pg_email_opt.h"
+#include "myutils/parse.h"
+
+/*
+ * Validates one element without building a datum.
+ * Returns NULL if it is valid, otherwise the reason it is not.
+ */
+static const char *
+email_batch_check(const text *txt) {
+    EmailParseResult parse;
+
+    if (email_parse_opt(VARDATA_ANY(txt), VARSIZE_ANY_EXHDR(txt), EMAIL_PARSE_OPTIONS, &parse))
+        return NULL;
+
+    /* The validators say which rule the part broke */
+    if (parse.error == EMAIL_PARSE_INVALID_LOCAL || parse.error == EMAIL_PARSE_INVALID_DOMAIN)
+        return psprintf("%s: %s", email_parse_error_string(parse.error), parse.error_msg);
+
+    return email_parse_error_string(parse.error);
+}
+
+/*
+ * Returns an array of the same shape with true for each valid element
+ * and false for each invalid one; NULL elements stay NULL
+ */
+PG_FUNCTION_INFO_V1(email_addr_validate);
+
+Datum
+email_addr_validate(PG_FUNCTION_ARGS) {
+    ArrayType *input = PG_GETARG_ARRAYTYPE_P(0);
+    Datum *elems;
+    bool *nulls;
+    int n;
+
+    deconstruct_array_builtin(input, TEXTOID, &elems, &nulls, &n);
+
+    /* Results overwrite the element array */
+    for (int i = 0; i < n; i++) {
+        if (!nulls[i])
+            elems[i] = BoolGetDatum(email_batch_check((text *) DatumGetPointer(elems[i])) == NULL);
+    }
+
+    ArrayType *result = construct_md_array(elems, nulls, ARR_NDIM(input), ARR_DIMS(input),
+                                           ARR_LBOUND(input), BOOLOID, 1, true, TYPALIGN_CHAR);
+
+    PG_RETURN_ARRAYTYPE_P(result);
+}
+
+/*
+ * Returns one row per element: its position, whether it is valid and
+ * why not. NULL elements have NULL validity and reason.
+ */
+PG_FUNCTION_INFO_V1(email_addr_validate_detail);
+
+Datum
+email_addr_validate_detail(PG_FUNCTION_ARGS) {
+    ReturnSetInfo *rsinfo = (ReturnSetInfo *) fcinfo->resultinfo;
+    ArrayType *input = PG_GETARG_ARRAYTYPE_P(0);
+    Datum *elems;
+    bool *elem_nulls;
+    int n;
+
+    InitMaterializedSRF(fcinfo, 0);
+
+    deconstruct_array_builtin(input, TEXTOID, &elems, &elem_nulls, &n);
+
+    for (int i = 0; i < n; i++) {
+        Datum values[3];
+        bool nulls[3] = {false, true, true};
+
+        values[0] = Int32GetDatum(i + 1);
+
+        if (!elem_nulls[i]) {
+            const char *reason = email_batch_check((text *) DatumGetPointer(elems[i]));
+
+            values[1] = BoolGetDatum(reason == NULL);
+            nulls[1] = false;
+            if (reason != NULL) {
+                values[2] = CStringGetTextDatum(reason);
+                nulls[2] = false;
+            }
+        }
+
+        tuplestore_putvalues(rsinfo->setResult, rsinfo->setDesc, values, nulls);
+    }
+
+    return (Datum) 0;
+}
+
+/*
+ * Converts a text array into an email_addr array of the same shape.
+ * Invalid elements become NULL.
+ */
+PG_FUNCTION_INFO_V1(email_addr_parse_array);
+
+Datum
+email_addr_parse_array(PG_FUNCTION_ARGS) {
+    ArrayType *input = PG_GETARG_ARRAYTYPE_P(0);
+    const Oid elemtype = get_element_type(get_fn_expr_rettype(fcinfo->flinfo));
+    ErrorSaveContext escontext = {T_ErrorSaveContext};
+    Datum *elems;
+    bool *nulls;
+    int n;
+    int16 typlen;
+    bool typbyval;
+    char typalign;
+
+    if (!OidIsValid(elemtype))
+        elog(ERROR, "could not determine element type of email_addr_parse_array result");
+
+    deconstruct_array_builtin(input, TEXTOID, &elems, &nulls, &n);
+
+    for (int i = 0; i < n; i++) {
+        if (nulls[i])
+            continue;
+
+        const text *txt = (text *) DatumGetPointer(elems[i]);
+        EMAIL_ADDR *addr = email_addr_from_string(VARDATA_ANY(txt), VARSIZE_ANY_EXHDR(txt), -1,
+                                                  (Node *) &escontext);
+
+        /* The context only records that an error happened, so reuse it */
+        escontext.error_occurred = false;
+
+        if (addr == NULL)
+            nulls[i] = true;
+        else
+            elems[i] = PointerGetDatum(addr);
+    }
+
+    get_typlenbyvalalign(elemtype, &typlen, &typbyval, &typalign);
+
+    ArrayType *result = construct_md_array(elems, nulls, ARR_NDIM(input), ARR_DIMS(input),
+                                           ARR_LBOUND(input), elemtype, typlen, typbyval, typalign);
+
+    PG_RETURN_ARRAYTYPE_P(result);
+}
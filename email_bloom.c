@@ -0,0 +1,533 @@
+//
+// Bloom filters over email addresses, for suppression-list checks.
+//
+// email_bloom is a plain bit array sized at build time from the expected
+// number of addresses and the wanted false positive rate. Positions come
+// from the two 64-bit halves of the fingerprint (email_fingerprint.c) by
+// double hashing, so addresses equal under ==# have the same positions
+// and filters are portable between platforms.
+//
+// Filters are stored out of line without compression (random bits do not
+// compress). A filter probed once per row usually comes from a stored
+// value or a subquery and is the same toasted datum on every call, so
+// the operators keep it detoasted in fn_extra.
+//
+
+#include "postgres.h"
+
+#include <math.h>
+
+#include "access/detoast.h"
+#include "fmgr.h"
+#include "libpq/pqformat.h"
+#include "nodes/miscnodes.h"
+#include "port/pg_bswap.h"
+#include "utils/builtins.h"
+#include "utils/memutils.h"
+#include "varatt.h"
+
+#include "pg_email_opt.h"
+
+#define EMAIL_BLOOM_VERSION 1
+
+#define EMAIL_BLOOM_DEFAULT_FALSE_POSITIVE_RATE 0.01
+#define EMAIL_BLOOM_MAX_HASHES 32
+
+/*
+ * A filter of nbits bits, a multiple of 8
+ */
+typedef struct {
+    /* varlena header for storing total struct length */
+    char vl_len_[4];
+
+    /* EMAIL_BLOOM_VERSION */
+    uint8 version;
+
+    /* number of positions set per address */
+    uint8 nhashes;
+
+    uint16 unused;
+
+    uint64 nbits;
+
+    uint8 bits[FLEXIBLE_ARRAY_MEMBER];
+} EmailBloom;
+
+#define EMAIL_BLOOM_HDRSZ offsetof(EmailBloom, bits)
+
+/* Header of the external form, see email_bloom_write */
+#define EMAIL_BLOOM_EXTERNAL_HDRSZ 12
+
+#define PG_GETARG_EMAIL_BLOOM_P(n) ((EmailBloom *) PG_DETOAST_DATUM(PG_GETARG_DATUM(n)))
+
+/*
+ * Detoasted filter kept across calls, with the toast pointer it came from
+ */
+typedef struct {
+    struct varatt_external pointer;
+    EmailBloom *filter;
+} EmailBloomCache;
+
+static EmailBloom *
+email_bloom_create(MemoryContext context, const uint64 nbits, const int nhashes) {
+    const Size size = EMAIL_BLOOM_HDRSZ + nbits / 8;
+    EmailBloom *filter = MemoryContextAllocZero(context, size);
+
+    SET_VARSIZE(filter, size);
+    filter->version = EMAIL_BLOOM_VERSION;
+    filter->nhashes = nhashes;
+    filter->nbits = nbits;
+
+    return filter;
+}
+
+/*
+ * Sizes a filter for the expected number of addresses and false
+ * positive rate: m = -n ln p / (ln 2)^2 bits and k = m / n ln 2 hashes
+ */
+static EmailBloom *
+email_bloom_create_for(MemoryContext context, const int64 expected, const double rate) {
+    if (expected <= 0)
+        ereport(ERROR,
+            (errcode(ERRCODE_INVALID_PARAMETER_VALUE),
+                errmsg("expected number of email addresses must be positive")));
+
+    if (!(rate > 0 && rate < 1))
+        ereport(ERROR,
+            (errcode(ERRCODE_INVALID_PARAMETER_VALUE),
+                errmsg("false positive rate must be between 0 and 1")));
+
+    const double ln2 = log(2.0);
+    const double bits = ceil(-(double) expected * log(rate) / (ln2 * ln2));
+
+    if (bits / 8 > MaxAllocSize - EMAIL_BLOOM_HDRSZ)
+        ereport(ERROR,
+            (errcode(ERRCODE_PROGRAM_LIMIT_EXCEEDED),
+                errmsg("email_bloom for %lld addresses at false positive rate %g is too large",
+                       (long long) expected, rate)));
+
+    /* Whole bytes, and at least a word */
+    const uint64 nbits = Max(((uint64) bits + 7) & ~UINT64CONST(7), 64);
+    const int nhashes = Max(1, Min(EMAIL_BLOOM_MAX_HASHES,
+                                   (int) rint((double) nbits / expected * ln2)));
+
+    return email_bloom_create(context, nbits, nhashes);
+}
+
+/*
+ * Checks a filter read from disk or from a client. Returns false if it is
+ * invalid and escontext is a soft error context.
+ */
+static bool
+email_bloom_validate(const EmailBloom *filter, Node *escontext) {
+    if (VARSIZE(filter) < EMAIL_BLOOM_HDRSZ ||
+        filter->version != EMAIL_BLOOM_VERSION ||
+        filter->nhashes < 1 || filter->nhashes > EMAIL_BLOOM_MAX_HASHES ||
+        filter->nbits == 0 || filter->nbits % 8 != 0 ||
+        VARSIZE(filter) - EMAIL_BLOOM_HDRSZ != filter->nbits / 8)
+        ereturn(escontext, false,
+            (errcode(ERRCODE_INVALID_BINARY_REPRESENTATION),
+                errmsg("invalid email_bloom value")));
+
+    return true;
+}
+
+/*
+ * The two halves of the fingerprint of an address
+ */
+static void
+email_bloom_hashes(const EMAIL_ADDR *email, uint64 *h1, uint64 *h2) {
+    EmailFingerprint fp;
+    EmailAddrView view;
+
+    email_addr_unpack(email, &view);
+    email_addr_view_fingerprint(&view, false, &fp);
+
+    memcpy(h1, fp.data, sizeof(uint64));
+    memcpy(h2, fp.data + sizeof(uint64), sizeof(uint64));
+    *h1 = pg_ntoh64(*h1);
+    *h2 = pg_ntoh64(*h2);
+}
+
+static void
+email_bloom_add(EmailBloom *filter, const EMAIL_ADDR *email) {
+    uint64 h1;
+    uint64 h2;
+
+    email_bloom_hashes(email, &h1, &h2);
+
+    for (int i = 0; i < filter->nhashes; i++) {
+        const uint64 pos = (h1 + i * h2) % filter->nbits;
+
+        filter->bits[pos / 8] |= 1 << (pos % 8);
+    }
+}
+
+static bool
+email_bloom_test(const EmailBloom *filter, const EMAIL_ADDR *email) {
+    uint64 h1;
+    uint64 h2;
+
+    email_bloom_hashes(email, &h1, &h2);
+
+    for (int i = 0; i < filter->nhashes; i++) {
+        const uint64 pos = (h1 + i * h2) % filter->nbits;
+
+        if (!(filter->bits[pos / 8] & (1 << (pos % 8))))
+            return false;
+    }
+
+    return true;
+}
+
+/*
+ * Bits of src into dst, which must have the same shape
+ */
+static void
+email_bloom_merge(EmailBloom *dst, const EmailBloom *src) {
+    if (dst->nbits != src->nbits || dst->nhashes != src->nhashes)
+        ereport(ERROR,
+            (errcode(ERRCODE_INVALID_PARAMETER_VALUE),
+                errmsg("cannot combine email_bloom filters of different sizes")));
+
+    for (uint64 i = 0; i < dst->nbits / 8; i++)
+        dst->bits[i] |= src->bits[i];
+}
+
+/*
+ * Returns the filter argument, detoasted once per toasted value
+ */
+static const EmailBloom *
+email_bloom_arg_cached(FunctionCallInfo fcinfo, const int argno) {
+    const struct varlena *arg = (struct varlena *) DatumGetPointer(PG_GETARG_DATUM(argno));
+
+    if (!VARATT_IS_EXTERNAL_ONDISK(arg))
+        return (EmailBloom *) PG_DETOAST_DATUM(PG_GETARG_DATUM(argno));
+
+    EmailBloomCache *cache = fcinfo->flinfo->fn_extra;
+    struct varatt_external pointer;
+
+    VARATT_EXTERNAL_GET_POINTER(pointer, arg);
+
+    if (cache == NULL) {
+        cache = MemoryContextAllocZero(fcinfo->flinfo->fn_mcxt, sizeof(EmailBloomCache));
+        fcinfo->flinfo->fn_extra = cache;
+    }
+
+    if (cache->filter == NULL ||
+        cache->pointer.va_valueid != pointer.va_valueid ||
+        cache->pointer.va_toastrelid != pointer.va_toastrelid) {
+        const MemoryContext old = MemoryContextSwitchTo(fcinfo->flinfo->fn_mcxt);
+
+        if (cache->filter != NULL)
+            pfree(cache->filter);
+        cache->filter = (EmailBloom *) detoast_attr((struct varlena *) arg);
+        cache->pointer = pointer;
+
+        MemoryContextSwitchTo(old);
+    }
+
+    return cache->filter;
+}
+
+/*
+ * Filter may contain the address: false means it certainly does not
+ */
+PG_FUNCTION_INFO_V1(email_bloom_contains);
+
+Datum
+email_bloom_contains(PG_FUNCTION_ARGS) {
+    const EmailBloom *filter = email_bloom_arg_cached(fcinfo, 0);
+    EMAIL_ADDR *email = PG_GETARG_EMAIL_ADDR_PP(1);
+
+    const bool result = email_bloom_test(filter, email);
+
+    PG_FREE_IF_COPY(email, 1);
+
+    PG_RETURN_BOOL(result);
+}
+
+/*
+ * Commutator of email_bloom_contains
+ */
+PG_FUNCTION_INFO_V1(email_bloom_contained);
+
+Datum
+email_bloom_contained(PG_FUNCTION_ARGS) {
+    EMAIL_ADDR *email = PG_GETARG_EMAIL_ADDR_PP(0);
+    const EmailBloom *filter = email_bloom_arg_cached(fcinfo, 1);
+
+    const bool result = email_bloom_test(filter, email);
+
+    PG_FREE_IF_COPY(email, 0);
+
+    PG_RETURN_BOOL(result);
+}
+
+/*
+ * Union of two filters of the same size
+ */
+PG_FUNCTION_INFO_V1(email_bloom_union2);
+
+Datum
+email_bloom_union2(PG_FUNCTION_ARGS) {
+    const EmailBloom *filter1 = PG_GETARG_EMAIL_BLOOM_P(0);
+    const EmailBloom *filter2 = PG_GETARG_EMAIL_BLOOM_P(1);
+    EmailBloom *result = palloc(VARSIZE(filter1));
+
+    memcpy(result, filter1, VARSIZE(filter1));
+    email_bloom_merge(result, filter2);
+
+    PG_RETURN_POINTER(result);
+}
+
+static MemoryContext
+email_bloom_context(FunctionCallInfo fcinfo) {
+    MemoryContext aggcontext;
+
+    if (!AggCheckCallContext(fcinfo, &aggcontext))
+        elog(ERROR, "email_bloom aggregate function called in non-aggregate context");
+
+    return aggcontext;
+}
+
+/*
+ * Transition function of email_bloom_agg(email, expected [, rate]).
+ * The filter is sized from the arguments of the first row.
+ */
+PG_FUNCTION_INFO_V1(email_bloom_transfn);
+
+Datum
+email_bloom_transfn(PG_FUNCTION_ARGS) {
+    const MemoryContext aggcontext = email_bloom_context(fcinfo);
+    EmailBloom *state = PG_ARGISNULL(0) ? NULL : (EmailBloom *) PG_GETARG_POINTER(0);
+
+    if (state == NULL) {
+        const double rate = PG_NARGS() > 3 && !PG_ARGISNULL(3)
+                                ? PG_GETARG_FLOAT8(3)
+                                : EMAIL_BLOOM_DEFAULT_FALSE_POSITIVE_RATE;
+
+        if (PG_ARGISNULL(2))
+            ereport(ERROR,
+                (errcode(ERRCODE_NULL_VALUE_NOT_ALLOWED),
+                    errmsg("expected number of email addresses must not be null")));
+
+        state = email_bloom_create_for(aggcontext, PG_GETARG_INT64(2), rate);
+    }
+
+    if (!PG_ARGISNULL(1)) {
+        EMAIL_ADDR *email = PG_GETARG_EMAIL_ADDR_PP(1);
+
+        email_bloom_add(state, email);
+
+        PG_FREE_IF_COPY(email, 1);
+    }
+
+    PG_RETURN_POINTER(state);
+}
+
+/*
+ * Transition function of email_bloom_union(email_bloom)
+ */
+PG_FUNCTION_INFO_V1(email_bloom_union_transfn);
+
+Datum
+email_bloom_union_transfn(PG_FUNCTION_ARGS) {
+    const MemoryContext aggcontext = email_bloom_context(fcinfo);
+    EmailBloom *state = PG_ARGISNULL(0) ? NULL : (EmailBloom *) PG_GETARG_POINTER(0);
+
+    if (PG_ARGISNULL(1))
+        PG_RETURN_POINTER(state);
+
+    const EmailBloom *filter = PG_GETARG_EMAIL_BLOOM_P(1);
+
+    if (state == NULL)
+        state = email_bloom_create(aggcontext, filter->nbits, filter->nhashes);
+
+    email_bloom_merge(state, filter);
+
+    PG_RETURN_POINTER(state);
+}
+
+PG_FUNCTION_INFO_V1(email_bloom_combinefn);
+
+Datum
+email_bloom_combinefn(PG_FUNCTION_ARGS) {
+    const MemoryContext aggcontext = email_bloom_context(fcinfo);
+    EmailBloom *state1 = PG_ARGISNULL(0) ? NULL : (EmailBloom *) PG_GETARG_POINTER(0);
+    const EmailBloom *state2 = PG_ARGISNULL(1) ? NULL : (EmailBloom *) PG_GETARG_POINTER(1);
+
+    if (state2 == NULL)
+        PG_RETURN_POINTER(state1);
+
+    if (state1 == NULL)
+        state1 = email_bloom_create(aggcontext, state2->nbits, state2->nhashes);
+
+    email_bloom_merge(state1, state2);
+
+    PG_RETURN_POINTER(state1);
+}
+
+/*
+ * The state is a varlena already; the serialized form is its bytes
+ */
+PG_FUNCTION_INFO_V1(email_bloom_serialize);
+
+Datum
+email_bloom_serialize(PG_FUNCTION_ARGS) {
+    const EmailBloom *state = (EmailBloom *) PG_GETARG_POINTER(0);
+    bytea *result = palloc(VARSIZE(state));
+
+    memcpy(result, state, VARSIZE(state));
+
+    PG_RETURN_BYTEA_P(result);
+}
+
+PG_FUNCTION_INFO_V1(email_bloom_deserialize);
+
+Datum
+email_bloom_deserialize(PG_FUNCTION_ARGS) {
+    const MemoryContext aggcontext = email_bloom_context(fcinfo);
+    const EmailBloom *serialized = (EmailBloom *) PG_GETARG_BYTEA_P(0);
+    EmailBloom *state = MemoryContextAlloc(aggcontext, VARSIZE(serialized));
+
+    memcpy(state, serialized, VARSIZE(serialized));
+
+    PG_RETURN_POINTER(state);
+}
+
+PG_FUNCTION_INFO_V1(email_bloom_finalfn);
+
+Datum
+email_bloom_finalfn(PG_FUNCTION_ARGS) {
+    if (PG_ARGISNULL(0))
+        PG_RETURN_NULL();
+
+    const EmailBloom *state = (EmailBloom *) PG_GETARG_POINTER(0);
+    EmailBloom *result = palloc(VARSIZE(state));
+
+    memcpy(result, state, VARSIZE(state));
+
+    PG_RETURN_POINTER(result);
+}
+
+/*
+ * External form, the same for text and binary: [version byte]
+ * [nhashes byte][two zero bytes][nbits, 8 bytes][bits], integers in
+ * network byte order
+ */
+static void
+email_bloom_write(StringInfo buf, const EmailBloom *filter) {
+    pq_sendbyte(buf, filter->version);
+    pq_sendbyte(buf, filter->nhashes);
+    pq_sendint16(buf, 0);
+    pq_sendint64(buf, filter->nbits);
+    pq_sendbytes(buf, (const char *) filter->bits, filter->nbits / 8);
+}
+
+/*
+ * Reads the external form. Returns NULL if it is invalid and escontext
+ * is a soft error context.
+ */
+static EmailBloom *
+email_bloom_read(StringInfo buf, Node *escontext) {
+    if (buf->len - buf->cursor < EMAIL_BLOOM_EXTERNAL_HDRSZ)
+        ereturn(escontext, NULL,
+            (errcode(ERRCODE_INVALID_BINARY_REPRESENTATION),
+                errmsg("invalid email_bloom value")));
+
+    const int version = pq_getmsgbyte(buf);
+    const int nhashes = pq_getmsgbyte(buf);
+
+    (void) pq_getmsgint(buf, 2);
+
+    const uint64 nbits = pq_getmsgint64(buf);
+
+    /* Checked before allocating anything of that size */
+    if (version != EMAIL_BLOOM_VERSION || nbits == 0 || nbits % 8 != 0 ||
+        nbits / 8 != (uint64) (buf->len - buf->cursor))
+        ereturn(escontext, NULL,
+            (errcode(ERRCODE_INVALID_BINARY_REPRESENTATION),
+                errmsg("invalid email_bloom value")));
+
+    EmailBloom *result = email_bloom_create(CurrentMemoryContext, nbits, nhashes);
+
+    pq_copymsgbytes(buf, (char *) result->bits, nbits / 8);
+    if (!email_bloom_validate(result, escontext))
+        return NULL;
+
+    return result;
+}
+
+/*
+ * Text form: as bytea, a hex dump of the external form
+ */
+PG_FUNCTION_INFO_V1(email_bloom_in);
+
+Datum
+email_bloom_in(PG_FUNCTION_ARGS) {
+    const char *input = PG_GETARG_CSTRING(0);
+    const size_t len = strlen(input);
+
+    if (len < 2 || input[0] != '\\' || input[1] != 'x' || (len - 2) % 2 != 0)
+        ereturn(fcinfo->context, (Datum) 0,
+            (errcode(ERRCODE_INVALID_TEXT_REPRESENTATION),
+                errmsg("invalid input syntax for type %s", "email_bloom"),
+                errhint("An email_bloom value is written as \\x followed by hexadecimal digits.")));
+
+    StringInfoData buf;
+
+    initStringInfo(&buf);
+    enlargeStringInfo(&buf, (len - 2) / 2);
+    buf.len = hex_decode_safe(input + 2, len - 2, buf.data, fcinfo->context);
+    if (SOFT_ERROR_OCCURRED(fcinfo->context))
+        return (Datum) 0;
+
+    EmailBloom *result = email_bloom_read(&buf, fcinfo->context);
+    if (result == NULL)
+        return (Datum) 0;
+
+    PG_RETURN_POINTER(result);
+}
+
+PG_FUNCTION_INFO_V1(email_bloom_out);
+
+Datum
+email_bloom_out(PG_FUNCTION_ARGS) {
+    const EmailBloom *filter = PG_GETARG_EMAIL_BLOOM_P(0);
+    StringInfoData buf;
+
+    initStringInfo(&buf);
+    email_bloom_write(&buf, filter);
+
+    char *result = palloc(2 + 2 * buf.len + 1);
+
+    result[0] = '\\';
+    result[1] = 'x';
+    hex_encode(buf.data, buf.len, result + 2);
+    result[2 + 2 * buf.len] = '\0';
+
+    PG_RETURN_CSTRING(result);
+}
+
+PG_FUNCTION_INFO_V1(email_bloom_recv);
+
+Datum
+email_bloom_recv(PG_FUNCTION_ARGS) {
+    StringInfo buf = (StringInfo) PG_GETARG_POINTER(0);
+
+    PG_RETURN_POINTER(email_bloom_read(buf, NULL));
+}
+
+PG_FUNCTION_INFO_V1(email_bloom_send);
+
+Datum
+email_bloom_send(PG_FUNCTION_ARGS) {
+    const EmailBloom *filter = PG_GETARG_EMAIL_BLOOM_P(0);
+    StringInfoData buf;
+
+    pq_begintypsend(&buf);
+    email_bloom_write(&buf, filter);
+
+    PG_RETURN_BYTEA_P(pq_endtypsend(&buf));
+}
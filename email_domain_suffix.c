@@ -0,0 +1,509 @@
+//
+// Reverse-label domain ordering and subdomain matching.
+//
+// email_addr_domain_rev_ops orders domains by their labels from right to
+// left, each label compared by length and then bytewise. All domains
+// under a suffix are then adjacent in the index, so email <@# 'example.com'
+// can be answered with a range scan: its support function rewrites it to
+//     email >=~# '*@example.com' AND email <~# '*@examplf.com'
+// where the upper bound has the last byte of the leftmost label bumped.
+//
+// Domain equality also takes a bare domain in text form: with a constant
+// operand, email =# 'example.com'::text becomes email =# '*@example.com',
+// which every operator class with =# can answer.
+//
+
+#include "postgres.h"
+
+#include "access/stratnum.h"
+#include "catalog/pg_am.h"
+#include "catalog/pg_type.h"
+#include "nodes/makefuncs.h"
+#include "nodes/miscnodes.h"
+#include "nodes/nodeFuncs.h"
+#include "nodes/supportnodes.h"
+#include "utils/builtins.h"
+#include "utils/lsyscache.h"
+
+#include "pg_email_opt.h"
+#include "myutils/idn.h"
+#include "myutils/simd.h"
+
+/*
+ * Compare two canonical domains label by label from the right.
+ * Labels compare by length, then bytewise; a domain that runs out of
+ * labels first sorts first.
+ */
+static int
+domain_rev_label_cmp(const char *d1, const size_t len1, const char *d2, const size_t len2) {
+    size_t end1 = len1;
+    size_t end2 = len2;
+
+    for (;;) {
+        size_t start1 = end1;
+        size_t start2 = end2;
+
+        while (start1 > 0 && d1[start1 - 1] != '.')
+            start1--;
+        while (start2 > 0 && d2[start2 - 1] != '.')
+            start2--;
+
+        const size_t label_len1 = end1 - start1;
+        const size_t label_len2 = end2 - start2;
+        if (label_len1 != label_len2)
+            return label_len1 < label_len2 ? -1 : 1;
+
+        const int cmp = memcmp(d1 + start1, d2 + start2, label_len1);
+        if (cmp != 0)
+            return cmp;
+
+        /* Reached the leftmost label of either domain */
+        if (start1 == 0 || start2 == 0)
+            return (start1 == 0 ? 0 : 1) - (start2 == 0 ? 0 : 1);
+
+        /* Skip the dot */
+        end1 = start1 - 1;
+        end2 = start2 - 1;
+    }
+}
+
+/*
+ * Core comparison for email_addr_domain_rev_ops
+ */
+static int
+email_addr_domain_rev_cmp_internal(const EMAIL_ADDR *addr1, const EMAIL_ADDR *addr2) {
+    EmailAddrView view1;
+    EmailAddrView view2;
+    int cmp;
+
+    email_addr_unpack(addr1, &view1);
+    email_addr_unpack(addr2, &view2);
+
+    /* Interned domains with the same id are equal */
+    if ((view1.flags & view2.flags & EMAIL_FLAG_INTERNED) && view1.domain_id == view2.domain_id)
+        cmp = 0;
+    else
+        cmp = domain_rev_label_cmp(view1.canon_domain, view1.canon_domain_len,
+                                   view2.canon_domain, view2.canon_domain_len);
+
+    return cmp;
+}
+
+/*
+ * Compare email addresses by reversed domain labels
+ */
+PG_FUNCTION_INFO_V1(email_addr_domain_rev_cmp);
+
+Datum
+email_addr_domain_rev_cmp(PG_FUNCTION_ARGS) {
+    EMAIL_ADDR *addr1 = PG_GETARG_EMAIL_ADDR_PP(0);
+    EMAIL_ADDR *addr2 = PG_GETARG_EMAIL_ADDR_PP(1);
+
+    const int cmp = email_addr_domain_rev_cmp_internal(addr1, addr2);
+
+    PG_FREE_IF_COPY(addr1, 0);
+    PG_FREE_IF_COPY(addr2, 1);
+
+    PG_RETURN_INT32(cmp);
+}
+
+/*
+ * Reversed domain less than operator
+ */
+PG_FUNCTION_INFO_V1(email_addr_domain_rev_lt);
+
+Datum
+email_addr_domain_rev_lt(PG_FUNCTION_ARGS) {
+    EMAIL_ADDR *addr1 = PG_GETARG_EMAIL_ADDR_PP(0);
+    EMAIL_ADDR *addr2 = PG_GETARG_EMAIL_ADDR_PP(1);
+    int cmp;
+
+    EMAIL_STATS_COMPARISON(cmp, email_addr_domain_rev_cmp_internal(addr1, addr2));
+
+    PG_FREE_IF_COPY(addr1, 0);
+    PG_FREE_IF_COPY(addr2, 1);
+
+    PG_RETURN_BOOL(cmp < 0);
+}
+
+/*
+ * Reversed domain less than or equal operator
+ */
+PG_FUNCTION_INFO_V1(email_addr_domain_rev_le);
+
+Datum
+email_addr_domain_rev_le(PG_FUNCTION_ARGS) {
+    EMAIL_ADDR *addr1 = PG_GETARG_EMAIL_ADDR_PP(0);
+    EMAIL_ADDR *addr2 = PG_GETARG_EMAIL_ADDR_PP(1);
+    int cmp;
+
+    EMAIL_STATS_COMPARISON(cmp, email_addr_domain_rev_cmp_internal(addr1, addr2));
+
+    PG_FREE_IF_COPY(addr1, 0);
+    PG_FREE_IF_COPY(addr2, 1);
+
+    PG_RETURN_BOOL(cmp <= 0);
+}
+
+/*
+ * Reversed domain greater than operator
+ */
+PG_FUNCTION_INFO_V1(email_addr_domain_rev_gt);
+
+Datum
+email_addr_domain_rev_gt(PG_FUNCTION_ARGS) {
+    EMAIL_ADDR *addr1 = PG_GETARG_EMAIL_ADDR_PP(0);
+    EMAIL_ADDR *addr2 = PG_GETARG_EMAIL_ADDR_PP(1);
+    int cmp;
+
+    EMAIL_STATS_COMPARISON(cmp, email_addr_domain_rev_cmp_internal(addr1, addr2));
+
+    PG_FREE_IF_COPY(addr1, 0);
+    PG_FREE_IF_COPY(addr2, 1);
+
+    PG_RETURN_BOOL(cmp > 0);
+}
+
+/*
+ * Reversed domain greater than or equal operator
+ */
+PG_FUNCTION_INFO_V1(email_addr_domain_rev_ge);
+
+Datum
+email_addr_domain_rev_ge(PG_FUNCTION_ARGS) {
+    EMAIL_ADDR *addr1 = PG_GETARG_EMAIL_ADDR_PP(0);
+    EMAIL_ADDR *addr2 = PG_GETARG_EMAIL_ADDR_PP(1);
+    int cmp;
+
+    EMAIL_STATS_COMPARISON(cmp, email_addr_domain_rev_cmp_internal(addr1, addr2));
+
+    PG_FREE_IF_COPY(addr1, 0);
+    PG_FREE_IF_COPY(addr2, 1);
+
+    PG_RETURN_BOOL(cmp >= 0);
+}
+
+/*
+ * Canonical form of a domain given as text, as addresses store it
+ */
+bool
+email_domain_operand_to_ascii(char *dest, const char *domain, const size_t len, size_t *dest_len) {
+    char *error_msg;
+
+    if (len == 0 || len > EMAIL_MAX_DOMAIN_LENGTH)
+        return false;
+
+    /* U-labels are matched in the A-label form addresses store */
+    if (has_non_ascii(domain, len))
+        return email_domain_to_ascii(domain, len, dest, dest_len, &error_msg);
+
+    email_lower(dest, domain, len);
+    *dest_len = len;
+    return true;
+}
+
+/*
+ * Canonicalizes a suffix into dest and checks that it is a plain domain
+ * name: LDH labels separated by single dots. Such a suffix can only
+ * match standard domains, never IP literals.
+ */
+bool
+email_domain_suffix_canonicalize(char *dest, const char *suffix, const size_t len,
+                                 size_t *dest_len) {
+    if (!email_domain_operand_to_ascii(dest, suffix, len, dest_len))
+        return false;
+
+    const size_t n = *dest_len;
+
+    if (email_span(dest, n, EMAIL_SET_LDH) != n || dest[0] == '.' || dest[n - 1] == '.')
+        return false;
+    for (size_t i = 1; i < n; i++) {
+        if (dest[i] == '.' && dest[i - 1] == '.')
+            return false;
+    }
+
+    return true;
+}
+
+/*
+ * Subdomain match: true if the domain is the given one or a subdomain
+ * of it. The suffix is compared case-insensitively, and U-labels in
+ * their A-label form.
+ */
+PG_FUNCTION_INFO_V1(email_addr_domain_suffix);
+
+Datum
+email_addr_domain_suffix(PG_FUNCTION_ARGS) {
+    EMAIL_ADDR *email = PG_GETARG_EMAIL_ADDR_PP(0);
+    const text *suffix = PG_GETARG_TEXT_PP(1);
+    char canon_suffix[EMAIL_MAX_DOMAIN_LENGTH];
+    size_t suffix_len;
+    EmailAddrView view;
+    bool result = false;
+
+    email_addr_unpack(email, &view);
+
+    if (email_domain_operand_to_ascii(canon_suffix, VARDATA_ANY(suffix), VARSIZE_ANY_EXHDR(suffix),
+                                      &suffix_len) &&
+        suffix_len <= view.canon_domain_len) {
+        const char *tail = view.canon_domain + view.canon_domain_len - suffix_len;
+
+        /* Matches whole labels only */
+        result = memcmp(tail, canon_suffix, suffix_len) == 0 &&
+                 (suffix_len == view.canon_domain_len || tail[-1] == '.');
+    }
+
+    PG_FREE_IF_COPY(email, 0);
+
+    PG_RETURN_BOOL(result);
+}
+
+/*
+ * Domain of the text operand of =#: a bare domain, or the domain of the
+ * address when it has an @, which keeps the meaning =# had through the
+ * implicit cast to email_addr. buf must hold EMAIL_MAX_DOMAIN_LENGTH bytes.
+ * Returns false for a domain no address can have.
+ */
+static bool
+domain_operand(const text *txt, char *buf, EmailAddrView *view, const char **domain, size_t *len) {
+    const char *data = VARDATA_ANY(txt);
+    const size_t data_len = VARSIZE_ANY_EXHDR(txt);
+
+    if (memchr(data, '@', data_len) != NULL) {
+        email_addr_view_from_string(data, data_len, view);
+        *domain = view->canon_domain;
+        *len = view->canon_domain_len;
+        return true;
+    }
+
+    *domain = buf;
+    return email_domain_operand_to_ascii(buf, data, data_len, len);
+}
+
+static bool
+email_addr_domain_eq_text_internal(const EMAIL_ADDR *email, const text *txt) {
+    char buf[EMAIL_MAX_DOMAIN_LENGTH];
+    EmailAddrView operand;
+    EmailAddrView view;
+    const char *domain;
+    size_t len;
+
+    if (!domain_operand(txt, buf, &operand, &domain, &len))
+        return false;
+
+    email_addr_unpack(email, &view);
+
+    return view.canon_domain_len == len && memcmp(view.canon_domain, domain, len) == 0;
+}
+
+/*
+ * Domain equality with a domain, or an address, in text form
+ */
+PG_FUNCTION_INFO_V1(email_addr_domain_eq_text);
+
+Datum
+email_addr_domain_eq_text(PG_FUNCTION_ARGS) {
+    EMAIL_ADDR *email = PG_GETARG_EMAIL_ADDR_PP(0);
+    const text *txt = PG_GETARG_TEXT_PP(1);
+
+    const bool result = email_addr_domain_eq_text_internal(email, txt);
+
+    PG_FREE_IF_COPY(email, 0);
+
+    PG_RETURN_BOOL(result);
+}
+
+PG_FUNCTION_INFO_V1(email_addr_domain_ne_text);
+
+Datum
+email_addr_domain_ne_text(PG_FUNCTION_ARGS) {
+    EMAIL_ADDR *email = PG_GETARG_EMAIL_ADDR_PP(0);
+    const text *txt = PG_GETARG_TEXT_PP(1);
+
+    const bool result = email_addr_domain_eq_text_internal(email, txt);
+
+    PG_FREE_IF_COPY(email, 0);
+
+    PG_RETURN_BOOL(!result);
+}
+
+PG_FUNCTION_INFO_V1(text_domain_eq_email_addr);
+
+Datum
+text_domain_eq_email_addr(PG_FUNCTION_ARGS) {
+    const text *txt = PG_GETARG_TEXT_PP(0);
+    EMAIL_ADDR *email = PG_GETARG_EMAIL_ADDR_PP(1);
+
+    const bool result = email_addr_domain_eq_text_internal(email, txt);
+
+    PG_FREE_IF_COPY(email, 1);
+
+    PG_RETURN_BOOL(result);
+}
+
+PG_FUNCTION_INFO_V1(text_domain_ne_email_addr);
+
+Datum
+text_domain_ne_email_addr(PG_FUNCTION_ARGS) {
+    const text *txt = PG_GETARG_TEXT_PP(0);
+    EMAIL_ADDR *email = PG_GETARG_EMAIL_ADDR_PP(1);
+
+    const bool result = email_addr_domain_eq_text_internal(email, txt);
+
+    PG_FREE_IF_COPY(email, 1);
+
+    PG_RETURN_BOOL(!result);
+}
+
+/* Text forms of =# and <>#, by the side of their text operand */
+static const struct {
+    const char *name;
+    bool negate;
+    int text_arg;
+} email_domain_text_funcs[] = {
+    {"email_addr_domain_eq_text", false, 1},
+    {"email_addr_domain_ne_text", true, 1},
+    {"text_domain_eq_email_addr", false, 0},
+    {"text_domain_ne_email_addr", true, 0},
+};
+
+/*
+ * Planner support for the text forms of =# and <>#: with a constant text
+ * operand, the call becomes the email_addr operator against a constant
+ * address, "*@domain" for a bare domain. Operands that would fail or
+ * never match are left to execution.
+ */
+PG_FUNCTION_INFO_V1(email_addr_domain_text_support);
+
+Datum
+email_addr_domain_text_support(PG_FUNCTION_ARGS) {
+    Node *rawreq = (Node *) PG_GETARG_POINTER(0);
+
+    if (!IsA(rawreq, SupportRequestSimplify))
+        PG_RETURN_POINTER(NULL);
+
+    const FuncExpr *expr = ((SupportRequestSimplify *) rawreq)->fcall;
+    const char *name = get_func_name(expr->funcid);
+    int i;
+
+    if (name == NULL || list_length(expr->args) != 2)
+        PG_RETURN_POINTER(NULL);
+
+    for (i = 0; i < lengthof(email_domain_text_funcs); i++) {
+        if (strcmp(name, email_domain_text_funcs[i].name) == 0)
+            break;
+    }
+    if (i == lengthof(email_domain_text_funcs) ||
+        !email_support_is_function(fcinfo, expr, email_domain_text_funcs[i].name))
+        PG_RETURN_POINTER(NULL);
+
+    const int text_arg = email_domain_text_funcs[i].text_arg;
+    const bool negate = email_domain_text_funcs[i].negate;
+    Node *email_arg = list_nth(expr->args, 1 - text_arg);
+    const Node *text_node = list_nth(expr->args, text_arg);
+
+    if (!IsA(text_node, Const) || ((const Const *) text_node)->constisnull)
+        PG_RETURN_POINTER(NULL);
+
+    const text *txt = DatumGetTextPP(((const Const *) text_node)->constvalue);
+    const char *data = VARDATA_ANY(txt);
+    const size_t len = VARSIZE_ANY_EXHDR(txt);
+    char domain[EMAIL_MAX_DOMAIN_LENGTH];
+    size_t domain_len;
+    EMAIL_ADDR *addr;
+
+    if (memchr(data, '@', len) != NULL) {
+        ErrorSaveContext escontext = {T_ErrorSaveContext};
+
+        addr = email_addr_from_string(data, len, -1, (Node *) &escontext);
+    } else if (email_domain_suffix_canonicalize(domain, data, len, &domain_len))
+        addr = make_email_addr("*", 1, domain, domain_len);
+    else
+        addr = NULL;
+
+    if (addr == NULL)
+        PG_RETURN_POINTER(NULL);
+
+    /* =# is the equality of email_addr_domain_ops, next to this function */
+    const Oid typid = exprType(email_arg);
+    const Oid opfamily = email_support_opfamily(fcinfo, BTREE_AM_OID, "email_addr_domain_ops");
+
+    if (!OidIsValid(opfamily))
+        PG_RETURN_POINTER(NULL);
+
+    Oid opno = get_opfamily_member(opfamily, typid, typid, BTEqualStrategyNumber);
+
+    if (OidIsValid(opno) && negate)
+        opno = get_negator(opno);
+    if (!OidIsValid(opno))
+        PG_RETURN_POINTER(NULL);
+
+    Const *value = makeConst(typid, -1, InvalidOid, -1, PointerGetDatum(addr), false, false);
+    Expr *left = text_arg == 0 ? (Expr *) value : (Expr *) email_arg;
+    Expr *right = text_arg == 0 ? (Expr *) email_arg : (Expr *) value;
+
+    PG_RETURN_POINTER(make_opclause(opno, BOOLOID, false, left, right, InvalidOid, InvalidOid));
+}
+
+/*
+ * Planner support for email_addr_domain_suffix: turns "email <@# const"
+ * into an exact range on email_addr_domain_rev_ops
+ */
+PG_FUNCTION_INFO_V1(email_addr_domain_suffix_support);
+
+Datum
+email_addr_domain_suffix_support(PG_FUNCTION_ARGS) {
+    Node *rawreq = (Node *) PG_GETARG_POINTER(0);
+
+    if (!IsA(rawreq, SupportRequestIndexCondition))
+        PG_RETURN_POINTER(NULL);
+
+    SupportRequestIndexCondition *req = (SupportRequestIndexCondition *) rawreq;
+
+    if (!is_opclause(req->node) || req->indexarg != 0 ||
+        req->opfamily != email_support_opfamily(fcinfo, BTREE_AM_OID, "email_addr_domain_rev_ops"))
+        PG_RETURN_POINTER(NULL);
+
+    const OpExpr *clause = (OpExpr *) req->node;
+    Expr *indexkey = linitial(clause->args);
+    const Node *pattern = lsecond(clause->args);
+
+    if (!IsA(pattern, Const) || ((const Const *) pattern)->constisnull)
+        PG_RETURN_POINTER(NULL);
+
+    const text *suffix = DatumGetTextPP(((const Const *) pattern)->constvalue);
+    char domain[EMAIL_MAX_DOMAIN_LENGTH];
+    size_t len;
+
+    /* Only names made of non-empty LDH labels have labels to range over */
+    if (!email_domain_suffix_canonicalize(domain, VARDATA_ANY(suffix), VARSIZE_ANY_EXHDR(suffix),
+                                          &len))
+        PG_RETURN_POINTER(NULL);
+
+    /* Last byte of the leftmost label, bumped for the upper bound below */
+    const char *dot = memchr(domain, '.', len);
+    const size_t last = (dot ? dot - domain : len) - 1;
+    if (domain[last] == '-')
+        PG_RETURN_POINTER(NULL);
+
+    const Oid typid = exprType((Node *) indexkey);
+    const Oid ge_op = get_opfamily_member(req->opfamily, typid, typid, BTGreaterEqualStrategyNumber);
+    const Oid lt_op = get_opfamily_member(req->opfamily, typid, typid, BTLessStrategyNumber);
+
+    if (!OidIsValid(ge_op) || !OidIsValid(lt_op))
+        PG_RETURN_POINTER(NULL);
+
+    Expr *lower = email_make_bound_clause(ge_op, indexkey, typid, "*", 1, domain, len);
+
+    /*
+     * The upper bound is the smallest label of the same length after the
+     * leftmost one, so only that exact label qualifies
+     */
+    domain[last]++;
+
+    Expr *upper = email_make_bound_clause(lt_op, indexkey, typid, "*", 1, domain, len);
+
+    req->lossy = false;
+
+    PG_RETURN_POINTER(list_make2(lower, upper));
+}
@@ -0,0 +1,499 @@
+//
+// email_fingerprint: a fixed-width key for the normalized identity of an
+// address.
+//
+// The fingerprint is the 128-bit MurmurHash3 (x64 variant) of
+//     [canonical local part] '@' [canonical domain]
+// so that addresses equal under ==# have equal fingerprints. It is
+// computed with explicit little-endian loads and stored big-endian, so
+// it does not depend on the platform and can be kept in tables.
+//
+// Provider rules, read from email_fingerprint_rules, can additionally fold
+// dots and plus-tags out of unquoted local parts for the domains listed
+// there. The rules are cached per transaction.
+//
+
+#include "postgres.h"
+
+#include "access/xact.h"
+#include "commands/extension.h"
+#include "common/hashfn.h"
+#include "executor/spi.h"
+#include "libpq/pqformat.h"
+#include "port/pg_bswap.h"
+#include "utils/builtins.h"
+#include "utils/hsearch.h"
+#include "utils/lsyscache.h"
+#include "utils/memutils.h"
+#include "utils/snapmgr.h"
+#include "utils/sortsupport.h"
+
+#include "pg_email_opt.h"
+
+/*
+ * Cached provider rule, keyed by canonical domain
+ */
+typedef struct {
+    /* hash key, NUL-terminated domain */
+    char domain[EMAIL_MAX_DOMAIN_LENGTH + 1];
+
+    bool fold_dots;
+    bool fold_plus_tag;
+} FingerprintRule;
+
+/* Rules of the current transaction, NULL until loaded */
+static MemoryContext rules_context = NULL;
+static HTAB *rules = NULL;
+static SPIPlanPtr rules_plan = NULL;
+static bool rules_callback_registered = false;
+
+static inline uint64
+rotl64(const uint64 x, const int r) {
+    return (x << r) | (x >> (64 - r));
+}
+
+static inline uint64
+fmix64(uint64 k) {
+    k ^= k >> 33;
+    k *= UINT64CONST(0xff51afd7ed558ccd);
+    k ^= k >> 33;
+    k *= UINT64CONST(0xc4ceb9fe1a85ec53);
+    k ^= k >> 33;
+
+    return k;
+}
+
+static inline uint64
+load_le64(const uint8 *p) {
+    uint64 v;
+
+    memcpy(&v, p, sizeof(v));
+#ifdef WORDS_BIGENDIAN
+    v = pg_bswap64(v);
+#endif
+
+    return v;
+}
+
+/*
+ * MurmurHash3_x64_128 with seed 0
+ */
+static void
+murmur3_128(const uint8 *data, const size_t len, EmailFingerprint *result) {
+    const uint64 c1 = UINT64CONST(0x87c37b91114253d5);
+    const uint64 c2 = UINT64CONST(0x4cf5ad432745937f);
+    const size_t nblocks = len / 16;
+    uint64 h1 = 0;
+    uint64 h2 = 0;
+    uint64 k1;
+    uint64 k2;
+
+    for (size_t i = 0; i < nblocks; i++) {
+        k1 = load_le64(data + i * 16);
+        k2 = load_le64(data + i * 16 + 8);
+
+        k1 *= c1;
+        k1 = rotl64(k1, 31);
+        k1 *= c2;
+        h1 ^= k1;
+        h1 = rotl64(h1, 27);
+        h1 += h2;
+        h1 = h1 * 5 + 0x52dce729;
+
+        k2 *= c2;
+        k2 = rotl64(k2, 33);
+        k2 *= c1;
+        h2 ^= k2;
+        h2 = rotl64(h2, 31);
+        h2 += h1;
+        h2 = h2 * 5 + 0x38495ab5;
+    }
+
+    const uint8 *tail = data + nblocks * 16;
+    const size_t rem = len & 15;
+
+    k1 = 0;
+    k2 = 0;
+    for (size_t i = rem; i > 8; i--)
+        k2 ^= (uint64) tail[i - 1] << ((i - 9) * 8);
+    for (size_t i = Min(rem, 8); i > 0; i--)
+        k1 ^= (uint64) tail[i - 1] << ((i - 1) * 8);
+
+    if (rem > 8) {
+        k2 *= c2;
+        k2 = rotl64(k2, 33);
+        k2 *= c1;
+        h2 ^= k2;
+    }
+    if (rem > 0) {
+        k1 *= c1;
+        k1 = rotl64(k1, 31);
+        k1 *= c2;
+        h1 ^= k1;
+    }
+
+    h1 ^= len;
+    h2 ^= len;
+    h1 += h2;
+    h2 += h1;
+    h1 = fmix64(h1);
+    h2 = fmix64(h2);
+    h1 += h2;
+    h2 += h1;
+
+    /* Big-endian, so that the text form reads as two 64-bit numbers */
+    h1 = pg_hton64(h1);
+    h2 = pg_hton64(h2);
+    memcpy(result->data, &h1, sizeof(h1));
+    memcpy(result->data + sizeof(h1), &h2, sizeof(h2));
+}
+
+/*
+ * Rules are only valid for the transaction that read them
+ */
+static void
+fingerprint_rules_xact_callback(XactEvent event, void *arg) {
+    switch (event) {
+        case XACT_EVENT_ABORT:
+        case XACT_EVENT_PARALLEL_ABORT:
+        case XACT_EVENT_COMMIT:
+        case XACT_EVENT_PARALLEL_COMMIT:
+        case XACT_EVENT_PREPARE:
+            if (rules_context != NULL)
+                MemoryContextReset(rules_context);
+            rules = NULL;
+            break;
+        default:
+            break;
+    }
+}
+
+/*
+ * Reads email_fingerprint_rules into the cache
+ */
+static void
+fingerprint_rules_load(void) {
+    HASHCTL ctl;
+
+    if (!rules_callback_registered) {
+        RegisterXactCallback(fingerprint_rules_xact_callback, NULL);
+        rules_callback_registered = true;
+    }
+
+    if (rules_context == NULL)
+        rules_context = AllocSetContextCreate(TopMemoryContext,
+                                              "email_fingerprint rules",
+                                              ALLOCSET_SMALL_SIZES);
+
+    ctl.keysize = EMAIL_MAX_DOMAIN_LENGTH + 1;
+    ctl.entrysize = sizeof(FingerprintRule);
+    ctl.hcxt = rules_context;
+    HTAB *loaded = hash_create("email_fingerprint rules", 16, &ctl,
+                               HASH_ELEM | HASH_STRINGS | HASH_CONTEXT);
+
+    if (SPI_connect() != SPI_OK_CONNECT)
+        elog(ERROR, "SPI_connect failed");
+
+    if (rules_plan == NULL) {
+        const Oid ext_oid = get_extension_oid("pg_email_opt", false);
+        const char *relname = quote_qualified_identifier(get_namespace_name(get_extension_schema(ext_oid)),
+                                                         "email_fingerprint_rules");
+        char *query = psprintf("SELECT domain, fold_dots, fold_plus_tag FROM %s", relname);
+
+        rules_plan = SPI_prepare(query, 0, NULL);
+        if (rules_plan == NULL)
+            elog(ERROR, "SPI_prepare failed for \"%s\": %s", query, SPI_result_code_string(SPI_result));
+
+        SPI_keepplan(rules_plan);
+        pfree(query);
+    }
+
+    /* Read-only queries run with the active snapshot */
+    const bool pushed = !ActiveSnapshotSet();
+    if (pushed)
+        PushActiveSnapshot(GetTransactionSnapshot());
+
+    if (SPI_execute_plan(rules_plan, NULL, NULL, true, 0) != SPI_OK_SELECT)
+        elog(ERROR, "could not read email_fingerprint_rules");
+
+    if (pushed)
+        PopActiveSnapshot();
+
+    for (uint64 i = 0; i < SPI_processed; i++) {
+        const HeapTuple tuple = SPI_tuptable->vals[i];
+        const TupleDesc tupdesc = SPI_tuptable->tupdesc;
+        char key[EMAIL_MAX_DOMAIN_LENGTH + 1];
+        bool isnull;
+        bool found;
+
+        const text *domain = DatumGetTextPP(SPI_getbinval(tuple, tupdesc, 1, &isnull));
+        const size_t len = VARSIZE_ANY_EXHDR(domain);
+
+        /* Longer names are no domain of any address */
+        if (len > EMAIL_MAX_DOMAIN_LENGTH)
+            continue;
+
+        memcpy(key, VARDATA_ANY(domain), len);
+        key[len] = '\0';
+
+        FingerprintRule *rule = hash_search(loaded, key, HASH_ENTER, &found);
+        rule->fold_dots = DatumGetBool(SPI_getbinval(tuple, tupdesc, 2, &isnull));
+        rule->fold_plus_tag = DatumGetBool(SPI_getbinval(tuple, tupdesc, 3, &isnull));
+    }
+
+    SPI_finish();
+
+    rules = loaded;
+}
+
+/*
+ * Returns the provider rule for a canonical domain, or NULL
+ */
+static const FingerprintRule *
+fingerprint_rule_lookup(const char *domain, const size_t len) {
+    char key[EMAIL_MAX_DOMAIN_LENGTH + 1];
+    bool found;
+
+    if (rules == NULL)
+        fingerprint_rules_load();
+
+    memcpy(key, domain, len);
+    key[len] = '\0';
+
+    return hash_search(rules, key, HASH_FIND, &found);
+}
+
+/*
+ * Computes the fingerprint of a decoded address, applying the provider
+ * rules of its domain if asked to
+ */
+void
+email_addr_view_fingerprint(const EmailAddrView *view, const bool provider_rules,
+                            EmailFingerprint *result) {
+    char buf[EMAIL_MAX_LOCAL_LENGTH + 1 + EMAIL_MAX_DOMAIN_LENGTH];
+    const char *local = view->canon_local;
+    size_t local_len = view->canon_local_len;
+    size_t len = 0;
+
+    /* Quoted local parts are taken literally */
+    const FingerprintRule *rule = NULL;
+    if (provider_rules && !(view->flags & EMAIL_FLAG_QUOTED_LOCAL))
+        rule = fingerprint_rule_lookup(view->canon_domain, view->canon_domain_len);
+
+    if (rule != NULL && rule->fold_plus_tag) {
+        const char *plus = memchr(local, '+', local_len);
+
+        /* A local part that is all tag is kept */
+        if (plus != NULL && plus != local)
+            local_len = plus - local;
+    }
+
+    if (rule != NULL && rule->fold_dots) {
+        for (size_t i = 0; i < local_len; i++) {
+            if (local[i] != '.')
+                buf[len++] = local[i];
+        }
+    } else {
+        memcpy(buf, local, local_len);
+        len = local_len;
+    }
+
+    buf[len++] = '@';
+    memcpy(buf + len, view->canon_domain, view->canon_domain_len);
+    len += view->canon_domain_len;
+
+    murmur3_128((const uint8 *) buf, len, result);
+}
+
+/*
+ * Fingerprint of the normalized form of an address
+ */
+PG_FUNCTION_INFO_V1(email_addr_fingerprint);
+
+Datum
+email_addr_fingerprint(PG_FUNCTION_ARGS) {
+    EMAIL_ADDR *email = PG_GETARG_EMAIL_ADDR_PP(0);
+    const bool provider_rules = PG_NARGS() > 1 && PG_GETARG_BOOL(1);
+    EmailFingerprint *result = palloc(sizeof(EmailFingerprint));
+    EmailAddrView view;
+
+    email_addr_unpack(email, &view);
+    email_addr_view_fingerprint(&view, provider_rules, result);
+
+    PG_FREE_IF_COPY(email, 0);
+
+    PG_RETURN_POINTER(result);
+}
+
+/*
+ * Input function: 32 hexadecimal digits
+ */
+PG_FUNCTION_INFO_V1(email_fingerprint_in);
+
+Datum
+email_fingerprint_in(PG_FUNCTION_ARGS) {
+    const char *input = PG_GETARG_CSTRING(0);
+    EmailFingerprint *result = palloc(sizeof(EmailFingerprint));
+
+    if (strlen(input) != 2 * EMAIL_FINGERPRINT_LEN ||
+        strspn(input, "0123456789abcdefABCDEF") != 2 * EMAIL_FINGERPRINT_LEN)
+        ereturn(fcinfo->context, (Datum) 0,
+            (errcode(ERRCODE_INVALID_TEXT_REPRESENTATION),
+                errmsg("invalid input syntax for type %s: \"%s\"", "email_fingerprint", input),
+                errhint("A fingerprint is written as %d hexadecimal digits.",
+                        2 * EMAIL_FINGERPRINT_LEN)));
+
+    hex_decode(input, 2 * EMAIL_FINGERPRINT_LEN, (char *) result->data);
+
+    PG_RETURN_POINTER(result);
+}
+
+/*
+ * Output function: 32 lowercase hexadecimal digits
+ */
+PG_FUNCTION_INFO_V1(email_fingerprint_out);
+
+Datum
+email_fingerprint_out(PG_FUNCTION_ARGS) {
+    const EmailFingerprint *fp = PG_GETARG_EMAIL_FINGERPRINT_P(0);
+    char *result = palloc(2 * EMAIL_FINGERPRINT_LEN + 1);
+
+    hex_encode((const char *) fp->data, EMAIL_FINGERPRINT_LEN, result);
+    result[2 * EMAIL_FINGERPRINT_LEN] = '\0';
+
+    PG_RETURN_CSTRING(result);
+}
+
+/*
+ * Binary input function: the 16 bytes as they are
+ */
+PG_FUNCTION_INFO_V1(email_fingerprint_recv);
+
+Datum
+email_fingerprint_recv(PG_FUNCTION_ARGS) {
+    StringInfo buf = (StringInfo) PG_GETARG_POINTER(0);
+    EmailFingerprint *result = palloc(sizeof(EmailFingerprint));
+
+    memcpy(result->data, pq_getmsgbytes(buf, EMAIL_FINGERPRINT_LEN), EMAIL_FINGERPRINT_LEN);
+
+    PG_RETURN_POINTER(result);
+}
+
+/*
+ * Binary output function
+ */
+PG_FUNCTION_INFO_V1(email_fingerprint_send);
+
+Datum
+email_fingerprint_send(PG_FUNCTION_ARGS) {
+    const EmailFingerprint *fp = PG_GETARG_EMAIL_FINGERPRINT_P(0);
+    StringInfoData buf;
+
+    pq_begintypsend(&buf);
+    pq_sendbytes(&buf, (const char *) fp->data, EMAIL_FINGERPRINT_LEN);
+
+    PG_RETURN_BYTEA_P(pq_endtypsend(&buf));
+}
+
+static inline int
+email_fingerprint_cmp_internal(const EmailFingerprint *fp1, const EmailFingerprint *fp2) {
+    return memcmp(fp1->data, fp2->data, EMAIL_FINGERPRINT_LEN);
+}
+
+PG_FUNCTION_INFO_V1(email_fingerprint_cmp);
+
+Datum
+email_fingerprint_cmp(PG_FUNCTION_ARGS) {
+    PG_RETURN_INT32(email_fingerprint_cmp_internal(PG_GETARG_EMAIL_FINGERPRINT_P(0),
+                                                   PG_GETARG_EMAIL_FINGERPRINT_P(1)));
+}
+
+PG_FUNCTION_INFO_V1(email_fingerprint_eq);
+
+Datum
+email_fingerprint_eq(PG_FUNCTION_ARGS) {
+    PG_RETURN_BOOL(email_fingerprint_cmp_internal(PG_GETARG_EMAIL_FINGERPRINT_P(0),
+                                                  PG_GETARG_EMAIL_FINGERPRINT_P(1)) == 0);
+}
+
+PG_FUNCTION_INFO_V1(email_fingerprint_ne);
+
+Datum
+email_fingerprint_ne(PG_FUNCTION_ARGS) {
+    PG_RETURN_BOOL(email_fingerprint_cmp_internal(PG_GETARG_EMAIL_FINGERPRINT_P(0),
+                                                  PG_GETARG_EMAIL_FINGERPRINT_P(1)) != 0);
+}
+
+PG_FUNCTION_INFO_V1(email_fingerprint_lt);
+
+Datum
+email_fingerprint_lt(PG_FUNCTION_ARGS) {
+    PG_RETURN_BOOL(email_fingerprint_cmp_internal(PG_GETARG_EMAIL_FINGERPRINT_P(0),
+                                                  PG_GETARG_EMAIL_FINGERPRINT_P(1)) < 0);
+}
+
+PG_FUNCTION_INFO_V1(email_fingerprint_le);
+
+Datum
+email_fingerprint_le(PG_FUNCTION_ARGS) {
+    PG_RETURN_BOOL(email_fingerprint_cmp_internal(PG_GETARG_EMAIL_FINGERPRINT_P(0),
+                                                  PG_GETARG_EMAIL_FINGERPRINT_P(1)) <= 0);
+}
+
+PG_FUNCTION_INFO_V1(email_fingerprint_gt);
+
+Datum
+email_fingerprint_gt(PG_FUNCTION_ARGS) {
+    PG_RETURN_BOOL(email_fingerprint_cmp_internal(PG_GETARG_EMAIL_FINGERPRINT_P(0),
+                                                  PG_GETARG_EMAIL_FINGERPRINT_P(1)) > 0);
+}
+
+PG_FUNCTION_INFO_V1(email_fingerprint_ge);
+
+Datum
+email_fingerprint_ge(PG_FUNCTION_ARGS) {
+    PG_RETURN_BOOL(email_fingerprint_cmp_internal(PG_GETARG_EMAIL_FINGERPRINT_P(0),
+                                                  PG_GETARG_EMAIL_FINGERPRINT_P(1)) >= 0);
+}
+
+static int
+email_fingerprint_fast_cmp(Datum x, Datum y, SortSupport ssup) {
+    return email_fingerprint_cmp_internal((const EmailFingerprint *) DatumGetPointer(x),
+                                          (const EmailFingerprint *) DatumGetPointer(y));
+}
+
+/*
+ * Sort support: fingerprints are fixed-width and never toasted
+ */
+PG_FUNCTION_INFO_V1(email_fingerprint_sortsupport);
+
+Datum
+email_fingerprint_sortsupport(PG_FUNCTION_ARGS) {
+    SortSupport ssup = (SortSupport) PG_GETARG_POINTER(0);
+
+    ssup->comparator = email_fingerprint_fast_cmp;
+
+    PG_RETURN_VOID();
+}
+
+/*
+ * Hash functions. The fingerprint is already a hash, but the hash opclass
+ * needs a seeded variant, and the generic kernels hash 16 bytes quickly.
+ */
+PG_FUNCTION_INFO_V1(email_fingerprint_hash);
+
+Datum
+email_fingerprint_hash(PG_FUNCTION_ARGS) {
+    const EmailFingerprint *fp = PG_GETARG_EMAIL_FINGERPRINT_P(0);
+
+    return hash_any(fp->data, EMAIL_FINGERPRINT_LEN);
+}
+
+PG_FUNCTION_INFO_V1(email_fingerprint_hash_extended);
+
+Datum
+email_fingerprint_hash_extended(PG_FUNCTION_ARGS) {
+    const EmailFingerprint *fp = PG_GETARG_EMAIL_FINGERPRINT_P(0);
+
+    return hash_any_extended(fp->data, EMAIL_FINGERPRINT_LEN, PG_GETARG_INT64(1));
+}
@@ -0,0 +1,267 @@
+//
+// GIN support over the tokens of an email address.
+//
+// An address is indexed under one entry per token:
+//     domain labels          John.Smith+promo@Mail.Example.com: mail, example, com
+//     local-part segments    split on '.', '+' and '-': john, smith, promo
+//     the plus-tag           everything after the first '+': promo
+// Tokens are lowercased and tagged with their kind, so that the label
+// "promo" and the tag "promo" are different entries. Each of the operators
+// ?#, ?@ and ?+ looks up a single entry and needs no recheck.
+//
+
+#include "postgres.h"
+
+#include "access/gin.h"
+#include "access/stratnum.h"
+#include "utils/builtins.h"
+
+#include "pg_email_opt.h"
+#include "myutils/domain.h"
+#include "myutils/local.h"
+#include "myutils/simd.h"
+
+/* Operator strategies of email_addr_gin_ops, also used as token kinds */
+#define EMAIL_GIN_LABEL_STRATEGY    1
+#define EMAIL_GIN_SEGMENT_STRATEGY  2
+#define EMAIL_GIN_TAG_STRATEGY      3
+
+/* Leading byte of an entry, telling its kind */
+static const char token_kind[] = {
+    [EMAIL_GIN_LABEL_STRATEGY] = 'd',
+    [EMAIL_GIN_SEGMENT_STRATEGY] = 'l',
+    [EMAIL_GIN_TAG_STRATEGY] = 't',
+};
+
+/*
+ * Builds an entry: kind byte, then the lowercased token
+ */
+static Datum
+make_token_entry(const StrategyNumber kind, const char *token, const size_t len) {
+    text *entry = palloc(VARHDRSZ + 1 + len);
+
+    SET_VARSIZE(entry, VARHDRSZ + 1 + len);
+    VARDATA(entry)[0] = token_kind[kind];
+    email_lower(VARDATA(entry) + 1, token, len);
+
+    return PointerGetDatum(entry);
+}
+
+/*
+ * Canonical form of a query into dest, which must hold
+ * EMAIL_MAX_DOMAIN_LENGTH bytes: lowercased, and a label with non-ASCII
+ * characters in the A-label form domains are indexed in. Returns false
+ * if no token can be equal to it.
+ */
+static bool
+canonicalize_query(const StrategyNumber kind, const char *query, const size_t len,
+                   char *dest, size_t *dest_len) {
+    if (len == 0 || len > EMAIL_MAX_DOMAIN_LENGTH)
+        return false;
+
+    if (kind == EMAIL_GIN_LABEL_STRATEGY)
+        return memchr(query, '.', len) == NULL &&
+               email_domain_operand_to_ascii(dest, query, len, dest_len);
+
+    email_lower(dest, query, len);
+    *dest_len = len;
+    return true;
+}
+
+/*
+ * Looks for a token of the given kind equal to the canonical query
+ */
+static bool
+email_addr_has_token(const EmailAddrView *view, const StrategyNumber kind,
+                     const char *query, const size_t query_len) {
+    char token_buf[EMAIL_MAX_DOMAIN_LENGTH];
+    const char *token;
+    size_t len;
+    size_t pos = 0;
+
+    switch (kind) {
+        case EMAIL_GIN_LABEL_STRATEGY:
+            while (next_domain_label(view->canon_domain, view->canon_domain_len, &pos, &token, &len)) {
+                if (len == query_len && memcmp(token, query, len) == 0)
+                    return true;
+            }
+            return false;
+
+        case EMAIL_GIN_SEGMENT_STRATEGY:
+            /* Quoted local parts keep their case */
+            while (next_local_segment(view->canon_local, view->canon_local_len, &pos, &token, &len)) {
+                if (len == query_len) {
+                    email_lower(token_buf, token, len);
+                    if (memcmp(token_buf, query, len) == 0)
+                        return true;
+                }
+            }
+            return false;
+
+        case EMAIL_GIN_TAG_STRATEGY:
+            if (!local_part_plus_tag(view->canon_local, view->canon_local_len, &token, &len) ||
+                len != query_len)
+                return false;
+            email_lower(token_buf, token, len);
+            return memcmp(token_buf, query, len) == 0;
+
+        default:
+            elog(ERROR, "unrecognized strategy number: %d", kind);
+    }
+
+    return false;
+}
+
+/*
+ * Common body of the token operators
+ */
+static bool
+email_addr_token_match(FunctionCallInfo fcinfo, const StrategyNumber kind) {
+    EMAIL_ADDR *email = PG_GETARG_EMAIL_ADDR_PP(0);
+    const text *query = PG_GETARG_TEXT_PP(1);
+    char canon_query[EMAIL_MAX_DOMAIN_LENGTH];
+    size_t query_len;
+    EmailAddrView view;
+    bool result = false;
+
+    if (canonicalize_query(kind, VARDATA_ANY(query), VARSIZE_ANY_EXHDR(query),
+                           canon_query, &query_len)) {
+        email_addr_unpack(email, &view);
+        result = email_addr_has_token(&view, kind, canon_query, query_len);
+    }
+
+    PG_FREE_IF_COPY(email, 0);
+
+    return result;
+}
+
+/*
+ * Domain has the given label
+ */
+PG_FUNCTION_INFO_V1(email_addr_has_label);
+
+Datum
+email_addr_has_label(PG_FUNCTION_ARGS) {
+    PG_RETURN_BOOL(email_addr_token_match(fcinfo, EMAIL_GIN_LABEL_STRATEGY));
+}
+
+/*
+ * Local part has the given segment
+ */
+PG_FUNCTION_INFO_V1(email_addr_has_segment);
+
+Datum
+email_addr_has_segment(PG_FUNCTION_ARGS) {
+    PG_RETURN_BOOL(email_addr_token_match(fcinfo, EMAIL_GIN_SEGMENT_STRATEGY));
+}
+
+/*
+ * Local part has the given plus-tag
+ */
+PG_FUNCTION_INFO_V1(email_addr_has_tag);
+
+Datum
+email_addr_has_tag(PG_FUNCTION_ARGS) {
+    PG_RETURN_BOOL(email_addr_token_match(fcinfo, EMAIL_GIN_TAG_STRATEGY));
+}
+
+/*
+ * Extracts the entries of an indexed address. GIN removes duplicates.
+ */
+PG_FUNCTION_INFO_V1(email_addr_gin_extract_value);
+
+Datum
+email_addr_gin_extract_value(PG_FUNCTION_ARGS) {
+    EMAIL_ADDR *email = PG_GETARG_EMAIL_ADDR_PP(0);
+    int32 *nentries = (int32 *) PG_GETARG_POINTER(1);
+    EmailAddrView view;
+    const char *token;
+    size_t len;
+    size_t pos;
+    int n = 0;
+
+    email_addr_unpack(email, &view);
+
+    /*
+     * A domain has at most (len + 1) / 2 labels and a local part as many
+     * segments; one more for the tag
+     */
+    Datum *entries = palloc(sizeof(Datum) * ((view.canon_domain_len + 1) / 2 +
+                                             (view.canon_local_len + 1) / 2 + 1));
+
+    pos = 0;
+    while (next_domain_label(view.canon_domain, view.canon_domain_len, &pos, &token, &len))
+        entries[n++] = make_token_entry(EMAIL_GIN_LABEL_STRATEGY, token, len);
+
+    pos = 0;
+    while (next_local_segment(view.canon_local, view.canon_local_len, &pos, &token, &len))
+        entries[n++] = make_token_entry(EMAIL_GIN_SEGMENT_STRATEGY, token, len);
+
+    if (local_part_plus_tag(view.canon_local, view.canon_local_len, &token, &len))
+        entries[n++] = make_token_entry(EMAIL_GIN_TAG_STRATEGY, token, len);
+
+    *nentries = n;
+
+    PG_RETURN_POINTER(entries);
+}
+
+/*
+ * A query is the single entry it looks for, if such an entry can exist
+ */
+PG_FUNCTION_INFO_V1(email_addr_gin_extract_query);
+
+Datum
+email_addr_gin_extract_query(PG_FUNCTION_ARGS) {
+    const text *query = PG_GETARG_TEXT_PP(0);
+    int32 *nentries = (int32 *) PG_GETARG_POINTER(1);
+    const StrategyNumber strategy = PG_GETARG_UINT16(2);
+    char str[EMAIL_MAX_DOMAIN_LENGTH];
+    size_t len;
+
+    if (strategy != EMAIL_GIN_LABEL_STRATEGY && strategy != EMAIL_GIN_SEGMENT_STRATEGY &&
+        strategy != EMAIL_GIN_TAG_STRATEGY)
+        elog(ERROR, "unrecognized strategy number: %d", strategy);
+
+    bool possible = canonicalize_query(strategy, VARDATA_ANY(query), VARSIZE_ANY_EXHDR(query),
+                                       str, &len);
+
+    /* No segment contains its separators */
+    if (strategy == EMAIL_GIN_SEGMENT_STRATEGY)
+        for (size_t i = 0; possible && i < len; i++)
+            possible = str[i] != '.' && str[i] != '+' && str[i] != '-';
+
+    /* No entries means no match */
+    if (!possible) {
+        *nentries = 0;
+        PG_RETURN_POINTER(NULL);
+    }
+
+    Datum *entries = palloc(sizeof(Datum));
+
+    entries[0] = make_token_entry(strategy, str, len);
+    *nentries = 1;
+
+    PG_RETURN_POINTER(entries);
+}
+
+PG_FUNCTION_INFO_V1(email_addr_gin_consistent);
+
+Datum
+email_addr_gin_consistent(PG_FUNCTION_ARGS) {
+    const bool *check = (bool *) PG_GETARG_POINTER(0);
+    bool *recheck = (bool *) PG_GETARG_POINTER(5);
+
+    /* The entry is the token itself */
+    *recheck = false;
+
+    PG_RETURN_BOOL(check[0]);
+}
+
+PG_FUNCTION_INFO_V1(email_addr_gin_tri_consistent);
+
+Datum
+email_addr_gin_tri_consistent(PG_FUNCTION_ARGS) {
+    const GinTernaryValue *check = (GinTernaryValue *) PG_GETARG_POINTER(0);
+
+    PG_RETURN_GIN_TERNARY_VALUE(check[0]);
+}
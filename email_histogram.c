@@ -0,0 +1,297 @@
+//
+// domain_histogram(email, topn): the topn most frequent domains and their
+// counts.
+//
+// The transition state is a hash table keyed on the canonical domain
+// bytes of each value, decoded in place, so no text is built per row.
+// The state can be serialized and combined, which lets the aggregate run
+// in parallel workers.
+//
+
+#include "postgres.h"
+
+#include "access/htup_details.h"
+#include "common/hashfn.h"
+#include "funcapi.h"
+#include "libpq/pqformat.h"
+#include "utils/array.h"
+#include "utils/builtins.h"
+#include "utils/hsearch.h"
+#include "utils/lsyscache.h"
+#include "utils/typcache.h"
+
+#include "pg_email_opt.h"
+#include "myutils/common.h"
+
+/*
+ * Hash key: a canonical domain, owned by the state once entered
+ */
+typedef struct {
+    const char *domain;
+    uint16 len;
+} DomainKey;
+
+typedef struct {
+    DomainKey key;
+    int64 count;
+} DomainCount;
+
+/*
+ * Transition state
+ */
+typedef struct {
+    /* aggregate context; holds the table and the domain copies */
+    MemoryContext context;
+    HTAB *counts;
+
+    /* number of domains to return, from the first row */
+    int32 topn;
+} DomainHistogramState;
+
+static uint32
+domain_key_hash(const void *key, Size keysize) {
+    const DomainKey *k = key;
+
+    return hash_bytes((const unsigned char *) k->domain, k->len);
+}
+
+static int
+domain_key_match(const void *key1, const void *key2, Size keysize) {
+    const DomainKey *k1 = key1;
+    const DomainKey *k2 = key2;
+
+    return k1->len == k2->len ? memcmp(k1->domain, k2->domain, k1->len) : 1;
+}
+
+static DomainHistogramState *
+domain_histogram_create(MemoryContext context, const int32 topn) {
+    DomainHistogramState *state = MemoryContextAlloc(context, sizeof(DomainHistogramState));
+    HASHCTL ctl;
+
+    ctl.keysize = sizeof(DomainKey);
+    ctl.entrysize = sizeof(DomainCount);
+    ctl.hash = domain_key_hash;
+    ctl.match = domain_key_match;
+    ctl.hcxt = context;
+
+    state->context = context;
+    state->counts = hash_create("domain_histogram", 256, &ctl,
+                                HASH_ELEM | HASH_FUNCTION | HASH_COMPARE | HASH_CONTEXT);
+    state->topn = topn;
+
+    return state;
+}
+
+/*
+ * Adds count occurrences of a domain
+ */
+static void
+domain_histogram_add(DomainHistogramState *state, const char *domain, const size_t len,
+                     const int64 count) {
+    const DomainKey key = {domain, len};
+    bool found;
+
+    DomainCount *entry = hash_search(state->counts, &key, HASH_ENTER, &found);
+
+    if (!found) {
+        /* The key still points at the caller's bytes */
+        char *copy = MemoryContextAlloc(state->context, len);
+
+        memcpy(copy, domain, len);
+        entry->key.domain = copy;
+        entry->count = 0;
+    }
+
+    entry->count += count;
+}
+
+static void
+check_topn(const int32 topn) {
+    if (topn <= 0)
+        ereport(ERROR,
+            (errcode(ERRCODE_INVALID_PARAMETER_VALUE),
+                errmsg("number of domains must be positive")));
+}
+
+static MemoryContext
+domain_histogram_context(FunctionCallInfo fcinfo) {
+    MemoryContext aggcontext;
+
+    if (!AggCheckCallContext(fcinfo, &aggcontext))
+        elog(ERROR, "domain_histogram called in non-aggregate context");
+
+    return aggcontext;
+}
+
+PG_FUNCTION_INFO_V1(domain_histogram_transfn);
+
+Datum
+domain_histogram_transfn(PG_FUNCTION_ARGS) {
+    const MemoryContext aggcontext = domain_histogram_context(fcinfo);
+    DomainHistogramState *state = PG_ARGISNULL(0) ? NULL : (DomainHistogramState *) PG_GETARG_POINTER(0);
+
+    if (state == NULL) {
+        if (PG_ARGISNULL(2))
+            ereport(ERROR,
+                (errcode(ERRCODE_NULL_VALUE_NOT_ALLOWED),
+                    errmsg("number of domains must not be null")));
+        check_topn(PG_GETARG_INT32(2));
+
+        state = domain_histogram_create(aggcontext, PG_GETARG_INT32(2));
+    }
+
+    if (!PG_ARGISNULL(1)) {
+        EMAIL_ADDR *email = PG_GETARG_EMAIL_ADDR_PP(1);
+        EmailAddrView view;
+
+        email_addr_unpack(email, &view);
+        domain_histogram_add(state, view.canon_domain, view.canon_domain_len, 1);
+
+        PG_FREE_IF_COPY(email, 1);
+    }
+
+    PG_RETURN_POINTER(state);
+}
+
+PG_FUNCTION_INFO_V1(domain_histogram_combinefn);
+
+Datum
+domain_histogram_combinefn(PG_FUNCTION_ARGS) {
+    const MemoryContext aggcontext = domain_histogram_context(fcinfo);
+    DomainHistogramState *state1 = PG_ARGISNULL(0) ? NULL : (DomainHistogramState *) PG_GETARG_POINTER(0);
+    const DomainHistogramState *state2 = PG_ARGISNULL(1) ? NULL : (DomainHistogramState *) PG_GETARG_POINTER(1);
+    HASH_SEQ_STATUS status;
+    const DomainCount *entry;
+
+    if (state2 == NULL)
+        PG_RETURN_POINTER(state1);
+
+    /* state2 may live in another context; never hand it back as is */
+    if (state1 == NULL)
+        state1 = domain_histogram_create(aggcontext, state2->topn);
+
+    hash_seq_init(&status, state2->counts);
+    while ((entry = hash_seq_search(&status)) != NULL)
+        domain_histogram_add(state1, entry->key.domain, entry->key.len, entry->count);
+
+    PG_RETURN_POINTER(state1);
+}
+
+/*
+ * Serialized form: topn, number of domains, then for each domain its
+ * length byte, its bytes and its count
+ */
+PG_FUNCTION_INFO_V1(domain_histogram_serialize);
+
+Datum
+domain_histogram_serialize(PG_FUNCTION_ARGS) {
+    const DomainHistogramState *state = (DomainHistogramState *) PG_GETARG_POINTER(0);
+    HASH_SEQ_STATUS status;
+    const DomainCount *entry;
+    StringInfoData buf;
+
+    pq_begintypsend(&buf);
+    pq_sendint32(&buf, state->topn);
+    pq_sendint64(&buf, hash_get_num_entries(state->counts));
+
+    hash_seq_init(&status, state->counts);
+    while ((entry = hash_seq_search(&status)) != NULL) {
+        pq_sendbyte(&buf, entry->key.len);
+        pq_sendbytes(&buf, entry->key.domain, entry->key.len);
+        pq_sendint64(&buf, entry->count);
+    }
+
+    PG_RETURN_BYTEA_P(pq_endtypsend(&buf));
+}
+
+PG_FUNCTION_INFO_V1(domain_histogram_deserialize);
+
+Datum
+domain_histogram_deserialize(PG_FUNCTION_ARGS) {
+    const MemoryContext aggcontext = domain_histogram_context(fcinfo);
+    const bytea *serialized = PG_GETARG_BYTEA_PP(0);
+    StringInfoData buf;
+
+    initStringInfo(&buf);
+    appendBinaryStringInfo(&buf, VARDATA_ANY(serialized), VARSIZE_ANY_EXHDR(serialized));
+
+    const int32 topn = pq_getmsgint(&buf, 4);
+    const int64 n = pq_getmsgint64(&buf);
+    DomainHistogramState *state = domain_histogram_create(aggcontext, topn);
+
+    for (int64 i = 0; i < n; i++) {
+        const int len = pq_getmsgbyte(&buf);
+        const char *domain = pq_getmsgbytes(&buf, len);
+
+        domain_histogram_add(state, domain, len, pq_getmsgint64(&buf));
+    }
+
+    pq_getmsgend(&buf);
+    pfree(buf.data);
+
+    PG_RETURN_POINTER(state);
+}
+
+/*
+ * Most frequent first; ties in domain order, so the result is stable
+ */
+static int
+domain_count_cmp(const void *a, const void *b) {
+    const DomainCount *ca = *(const DomainCount *const *) a;
+    const DomainCount *cb = *(const DomainCount *const *) b;
+
+    if (ca->count != cb->count)
+        return ca->count > cb->count ? -1 : 1;
+
+    return bounded_memcmp(ca->key.domain, ca->key.len, cb->key.domain, cb->key.len);
+}
+
+/*
+ * Returns the topn most frequent domains as an array of
+ * email_domain_count (domain, count)
+ */
+PG_FUNCTION_INFO_V1(domain_histogram_finalfn);
+
+Datum
+domain_histogram_finalfn(PG_FUNCTION_ARGS) {
+    if (PG_ARGISNULL(0))
+        PG_RETURN_NULL();
+
+    const DomainHistogramState *state = (DomainHistogramState *) PG_GETARG_POINTER(0);
+    const long ndomains = hash_get_num_entries(state->counts);
+    HASH_SEQ_STATUS status;
+    DomainCount *entry;
+    int n = 0;
+
+    DomainCount **sorted = palloc(sizeof(DomainCount *) * Max(ndomains, 1));
+
+    hash_seq_init(&status, state->counts);
+    while ((entry = hash_seq_search(&status)) != NULL)
+        sorted[n++] = entry;
+
+    qsort(sorted, n, sizeof(DomainCount *), domain_count_cmp);
+    n = Min(n, state->topn);
+
+    /* The element type is email_domain_count, wherever it is installed */
+    const Oid array_type = get_fn_expr_rettype(fcinfo->flinfo);
+    const Oid elem_type = get_element_type(array_type);
+    if (!OidIsValid(elem_type))
+        elog(ERROR, "could not determine the result type of domain_histogram");
+
+    const TupleDesc tupdesc = lookup_rowtype_tupdesc(elem_type, -1);
+    Datum *elems = palloc(sizeof(Datum) * Max(n, 1));
+
+    for (int i = 0; i < n; i++) {
+        Datum values[2];
+        bool nulls[2] = {false, false};
+
+        values[0] = PointerGetDatum(cstring_to_text_with_len(sorted[i]->key.domain, sorted[i]->key.len));
+        values[1] = Int64GetDatum(sorted[i]->count);
+
+        elems[i] = HeapTupleGetDatum(heap_form_tuple(tupdesc, values, nulls));
+    }
+
+    ReleaseTupleDesc(tupdesc);
+
+    PG_RETURN_ARRAYTYPE_P(construct_array(elems, n, elem_type, -1, false, TYPALIGN_DOUBLE));
+}
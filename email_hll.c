@@ -0,0 +1,450 @@
+//
+// HyperLogLog sketches of email addresses.
+//
+// email_hll is a dense HyperLogLog sketch: one byte per register, 2^p
+// registers. An address is added under the first 64 bits of its
+// fingerprint (email_fingerprint.c), so addresses equal under ==# count
+// once and sketches built on different platforms can be united. With
+// provider rules, the fingerprint also folds dots and plus-tags for the
+// domains listed in email_fingerprint_rules.
+//
+// The aggregates keep the sketch itself as their state, so serializing
+// and combining them for parallel aggregation is a copy and a register
+// maximum.
+//
+
+#include "postgres.h"
+
+#include <math.h>
+
+#include "fmgr.h"
+#include "libpq/pqformat.h"
+#include "nodes/miscnodes.h"
+#include "port/pg_bitutils.h"
+#include "port/pg_bswap.h"
+#include "utils/builtins.h"
+
+#include "pg_email_opt.h"
+
+#define EMAIL_HLL_VERSION 1
+
+/* Precision bounds and default: 2^14 registers, about 0.8% error */
+#define EMAIL_HLL_MIN_PRECISION 4
+#define EMAIL_HLL_MAX_PRECISION 18
+#define EMAIL_HLL_DEFAULT_PRECISION 14
+
+/*
+ * A sketch. STORAGE is EXTENDED: sparse sketches compress well.
+ */
+typedef struct {
+    /* varlena header for storing total struct length */
+    char vl_len_[4];
+
+    /* EMAIL_HLL_VERSION */
+    uint8 version;
+
+    /* log2 of the number of registers */
+    uint8 precision;
+
+    /* rank of the longest run of zeros seen in each register */
+    uint8 registers[FLEXIBLE_ARRAY_MEMBER];
+} EmailHll;
+
+#define EMAIL_HLL_SIZE(precision) (offsetof(EmailHll, registers) + ((Size) 1 << (precision)))
+
+#define PG_GETARG_EMAIL_HLL_P(n) ((EmailHll *) PG_DETOAST_DATUM(PG_GETARG_DATUM(n)))
+
+static void
+check_precision(const int32 precision) {
+    if (precision < EMAIL_HLL_MIN_PRECISION || precision > EMAIL_HLL_MAX_PRECISION)
+        ereport(ERROR,
+            (errcode(ERRCODE_INVALID_PARAMETER_VALUE),
+                errmsg("email_hll precision must be between %d and %d",
+                       EMAIL_HLL_MIN_PRECISION, EMAIL_HLL_MAX_PRECISION)));
+}
+
+static EmailHll *
+email_hll_create(MemoryContext context, const int precision) {
+    const Size size = EMAIL_HLL_SIZE(precision);
+    EmailHll *hll = MemoryContextAllocZero(context, size);
+
+    SET_VARSIZE(hll, size);
+    hll->version = EMAIL_HLL_VERSION;
+    hll->precision = precision;
+
+    return hll;
+}
+
+/*
+ * Checks a sketch read from disk or from a client. Returns false if it is
+ * invalid and escontext is a soft error context.
+ */
+static bool
+email_hll_validate(const EmailHll *hll, Node *escontext) {
+    if (VARSIZE(hll) < offsetof(EmailHll, registers) ||
+        hll->version != EMAIL_HLL_VERSION ||
+        hll->precision < EMAIL_HLL_MIN_PRECISION || hll->precision > EMAIL_HLL_MAX_PRECISION ||
+        VARSIZE(hll) != EMAIL_HLL_SIZE(hll->precision))
+        ereturn(escontext, false,
+            (errcode(ERRCODE_INVALID_BINARY_REPRESENTATION),
+                errmsg("invalid email_hll value")));
+
+    return true;
+}
+
+/*
+ * Adds a 64-bit hash: the top bits pick the register, the rank of the
+ * rest is the position of its first set bit
+ */
+static inline void
+email_hll_add_hash(EmailHll *hll, const uint64 hash) {
+    const int p = hll->precision;
+    const uint64 rest = hash << p;
+    const uint8 rho = rest == 0 ? 64 - p + 1 : 64 - pg_leftmost_one_pos64(rest);
+    uint8 *reg = &hll->registers[hash >> (64 - p)];
+
+    if (rho > *reg)
+        *reg = rho;
+}
+
+static void
+email_hll_add_email(EmailHll *hll, const EMAIL_ADDR *email, const bool provider_rules) {
+    EmailFingerprint fp;
+    EmailAddrView view;
+    uint64 hash;
+
+    email_addr_unpack(email, &view);
+    email_addr_view_fingerprint(&view, provider_rules, &fp);
+
+    /* The fingerprint is big-endian */
+    memcpy(&hash, fp.data, sizeof(hash));
+    email_hll_add_hash(hll, pg_ntoh64(hash));
+}
+
+/*
+ * Registers of src into dst, which must have the same precision
+ */
+static void
+email_hll_merge(EmailHll *dst, const EmailHll *src) {
+    if (dst->precision != src->precision)
+        ereport(ERROR,
+            (errcode(ERRCODE_INVALID_PARAMETER_VALUE),
+                errmsg("cannot combine email_hll sketches of precision %d and %d",
+                       dst->precision, src->precision)));
+
+    const Size m = (Size) 1 << dst->precision;
+
+    for (Size i = 0; i < m; i++) {
+        if (src->registers[i] > dst->registers[i])
+            dst->registers[i] = src->registers[i];
+    }
+}
+
+/*
+ * HyperLogLog estimate, with linear counting for small cardinalities.
+ * 64-bit hashes need no large range correction.
+ */
+static int64
+email_hll_estimate(const EmailHll *hll) {
+    const Size m = (Size) 1 << hll->precision;
+    double sum = 0;
+    Size zeros = 0;
+    double alpha;
+
+    for (Size i = 0; i < m; i++) {
+        sum += ldexp(1.0, -hll->registers[i]);
+        if (hll->registers[i] == 0)
+            zeros++;
+    }
+
+    switch (m) {
+        case 16:
+            alpha = 0.673;
+            break;
+        case 32:
+            alpha = 0.697;
+            break;
+        case 64:
+            alpha = 0.709;
+            break;
+        default:
+            alpha = 0.7213 / (1.0 + 1.079 / m);
+            break;
+    }
+
+    double estimate = alpha * m * m / sum;
+
+    if (estimate <= 2.5 * m && zeros > 0)
+        estimate = m * log((double) m / zeros);
+
+    return (int64) rint(estimate);
+}
+
+static MemoryContext
+email_hll_context(FunctionCallInfo fcinfo) {
+    MemoryContext aggcontext;
+
+    if (!AggCheckCallContext(fcinfo, &aggcontext))
+        elog(ERROR, "email_hll aggregate function called in non-aggregate context");
+
+    return aggcontext;
+}
+
+/*
+ * Transition function of email_hll_agg and email_approx_count_distinct;
+ * the optional third argument is the precision
+ */
+PG_FUNCTION_INFO_V1(email_hll_transfn);
+
+Datum
+email_hll_transfn(PG_FUNCTION_ARGS) {
+    const MemoryContext aggcontext = email_hll_context(fcinfo);
+    EmailHll *state = PG_ARGISNULL(0) ? NULL : (EmailHll *) PG_GETARG_POINTER(0);
+
+    if (state == NULL) {
+        int32 precision = EMAIL_HLL_DEFAULT_PRECISION;
+
+        if (PG_NARGS() > 2 && !PG_ARGISNULL(2)) {
+            precision = PG_GETARG_INT32(2);
+            check_precision(precision);
+        }
+
+        state = email_hll_create(aggcontext, precision);
+    }
+
+    if (!PG_ARGISNULL(1)) {
+        EMAIL_ADDR *email = PG_GETARG_EMAIL_ADDR_PP(1);
+
+        email_hll_add_email(state, email, false);
+
+        PG_FREE_IF_COPY(email, 1);
+    }
+
+    PG_RETURN_POINTER(state);
+}
+
+/*
+ * Transition function of the variants that take provider_rules
+ */
+PG_FUNCTION_INFO_V1(email_hll_rules_transfn);
+
+Datum
+email_hll_rules_transfn(PG_FUNCTION_ARGS) {
+    const MemoryContext aggcontext = email_hll_context(fcinfo);
+    EmailHll *state = PG_ARGISNULL(0) ? NULL : (EmailHll *) PG_GETARG_POINTER(0);
+
+    if (state == NULL)
+        state = email_hll_create(aggcontext, EMAIL_HLL_DEFAULT_PRECISION);
+
+    if (!PG_ARGISNULL(1)) {
+        EMAIL_ADDR *email = PG_GETARG_EMAIL_ADDR_PP(1);
+        const bool provider_rules = !PG_ARGISNULL(2) && PG_GETARG_BOOL(2);
+
+        email_hll_add_email(state, email, provider_rules);
+
+        PG_FREE_IF_COPY(email, 1);
+    }
+
+    PG_RETURN_POINTER(state);
+}
+
+/*
+ * Transition function of email_hll_union(email_hll)
+ */
+PG_FUNCTION_INFO_V1(email_hll_union_transfn);
+
+Datum
+email_hll_union_transfn(PG_FUNCTION_ARGS) {
+    const MemoryContext aggcontext = email_hll_context(fcinfo);
+    EmailHll *state = PG_ARGISNULL(0) ? NULL : (EmailHll *) PG_GETARG_POINTER(0);
+
+    if (PG_ARGISNULL(1))
+        PG_RETURN_POINTER(state);
+
+    const EmailHll *hll = PG_GETARG_EMAIL_HLL_P(1);
+
+    if (state == NULL)
+        state = email_hll_create(aggcontext, hll->precision);
+
+    email_hll_merge(state, hll);
+
+    PG_RETURN_POINTER(state);
+}
+
+PG_FUNCTION_INFO_V1(email_hll_combinefn);
+
+Datum
+email_hll_combinefn(PG_FUNCTION_ARGS) {
+    const MemoryContext aggcontext = email_hll_context(fcinfo);
+    EmailHll *state1 = PG_ARGISNULL(0) ? NULL : (EmailHll *) PG_GETARG_POINTER(0);
+    const EmailHll *state2 = PG_ARGISNULL(1) ? NULL : (EmailHll *) PG_GETARG_POINTER(1);
+
+    if (state2 == NULL)
+        PG_RETURN_POINTER(state1);
+
+    if (state1 == NULL)
+        state1 = email_hll_create(aggcontext, state2->precision);
+
+    email_hll_merge(state1, state2);
+
+    PG_RETURN_POINTER(state1);
+}
+
+/*
+ * The state is a varlena already; the serialized form is its bytes
+ */
+PG_FUNCTION_INFO_V1(email_hll_serialize);
+
+Datum
+email_hll_serialize(PG_FUNCTION_ARGS) {
+    const EmailHll *state = (EmailHll *) PG_GETARG_POINTER(0);
+    bytea *result = palloc(VARSIZE(state));
+
+    memcpy(result, state, VARSIZE(state));
+
+    PG_RETURN_BYTEA_P(result);
+}
+
+PG_FUNCTION_INFO_V1(email_hll_deserialize);
+
+Datum
+email_hll_deserialize(PG_FUNCTION_ARGS) {
+    const MemoryContext aggcontext = email_hll_context(fcinfo);
+    const EmailHll *serialized = (EmailHll *) PG_GETARG_BYTEA_P(0);
+    EmailHll *state = MemoryContextAlloc(aggcontext, VARSIZE(serialized));
+
+    memcpy(state, serialized, VARSIZE(serialized));
+
+    PG_RETURN_POINTER(state);
+}
+
+/*
+ * Final function returning the sketch
+ */
+PG_FUNCTION_INFO_V1(email_hll_finalfn);
+
+Datum
+email_hll_finalfn(PG_FUNCTION_ARGS) {
+    if (PG_ARGISNULL(0))
+        PG_RETURN_NULL();
+
+    const EmailHll *state = (EmailHll *) PG_GETARG_POINTER(0);
+    EmailHll *result = palloc(VARSIZE(state));
+
+    memcpy(result, state, VARSIZE(state));
+
+    PG_RETURN_POINTER(result);
+}
+
+/*
+ * Final function returning the estimate; 0 for no rows, like count
+ */
+PG_FUNCTION_INFO_V1(email_hll_count_finalfn);
+
+Datum
+email_hll_count_finalfn(PG_FUNCTION_ARGS) {
+    if (PG_ARGISNULL(0))
+        PG_RETURN_INT64(0);
+
+    PG_RETURN_INT64(email_hll_estimate((EmailHll *) PG_GETARG_POINTER(0)));
+}
+
+/*
+ * Estimated number of distinct addresses in a sketch
+ */
+PG_FUNCTION_INFO_V1(email_hll_cardinality);
+
+Datum
+email_hll_cardinality(PG_FUNCTION_ARGS) {
+    const EmailHll *hll = PG_GETARG_EMAIL_HLL_P(0);
+
+    PG_RETURN_INT64(email_hll_estimate(hll));
+}
+
+/*
+ * Union of two sketches
+ */
+PG_FUNCTION_INFO_V1(email_hll_union2);
+
+Datum
+email_hll_union2(PG_FUNCTION_ARGS) {
+    const EmailHll *hll1 = PG_GETARG_EMAIL_HLL_P(0);
+    const EmailHll *hll2 = PG_GETARG_EMAIL_HLL_P(1);
+    EmailHll *result = palloc(VARSIZE(hll1));
+
+    memcpy(result, hll1, VARSIZE(hll1));
+    email_hll_merge(result, hll2);
+
+    PG_RETURN_POINTER(result);
+}
+
+/*
+ * Text form: as bytea, a hex dump of the sketch after the header
+ */
+PG_FUNCTION_INFO_V1(email_hll_in);
+
+Datum
+email_hll_in(PG_FUNCTION_ARGS) {
+    const char *input = PG_GETARG_CSTRING(0);
+    const size_t len = strlen(input);
+
+    if (len < 2 || input[0] != '\\' || input[1] != 'x' || (len - 2) % 2 != 0)
+        ereturn(fcinfo->context, (Datum) 0,
+            (errcode(ERRCODE_INVALID_TEXT_REPRESENTATION),
+                errmsg("invalid input syntax for type %s", "email_hll"),
+                errhint("An email_hll value is written as \\x followed by hexadecimal digits.")));
+
+    const Size size = VARHDRSZ + (len - 2) / 2;
+    EmailHll *result = palloc(size);
+
+    SET_VARSIZE(result, size);
+    hex_decode_safe(input + 2, len - 2, VARDATA(result), fcinfo->context);
+    if (SOFT_ERROR_OCCURRED(fcinfo->context) || !email_hll_validate(result, fcinfo->context))
+        return (Datum) 0;
+
+    PG_RETURN_POINTER(result);
+}
+
+PG_FUNCTION_INFO_V1(email_hll_out);
+
+Datum
+email_hll_out(PG_FUNCTION_ARGS) {
+    const EmailHll *hll = PG_GETARG_EMAIL_HLL_P(0);
+    const Size len = VARSIZE(hll) - VARHDRSZ;
+    char *result = palloc(2 + 2 * len + 1);
+
+    result[0] = '\\';
+    result[1] = 'x';
+    hex_encode(VARDATA(hll), len, result + 2);
+    result[2 + 2 * len] = '\0';
+
+    PG_RETURN_CSTRING(result);
+}
+
+PG_FUNCTION_INFO_V1(email_hll_recv);
+
+Datum
+email_hll_recv(PG_FUNCTION_ARGS) {
+    StringInfo buf = (StringInfo) PG_GETARG_POINTER(0);
+    const int len = buf->len - buf->cursor;
+    EmailHll *result = palloc(VARHDRSZ + len);
+
+    SET_VARSIZE(result, VARHDRSZ + len);
+    pq_copymsgbytes(buf, VARDATA(result), len);
+    email_hll_validate(result, NULL);
+
+    PG_RETURN_POINTER(result);
+}
+
+PG_FUNCTION_INFO_V1(email_hll_send);
+
+Datum
+email_hll_send(PG_FUNCTION_ARGS) {
+    const EmailHll *hll = PG_GETARG_EMAIL_HLL_P(0);
+    StringInfoData buf;
+
+    pq_begintypsend(&buf);
+    pq_sendbytes(&buf, VARDATA(hll), VARSIZE(hll) - VARHDRSZ);
+
+    PG_RETURN_BYTEA_P(pq_endtypsend(&buf));
+}
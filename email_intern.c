@@ -0,0 +1,346 @@
+//
+// Domain dictionary for email_addr(interned) columns.
+//
+// Interned datums store a 4-byte id instead of the domain. Ids come from
+// the extension table email_addr_domain_dict, which is append-only and
+// only written by email_addr_domain_dict_add(), and are resolved through
+// a backend-local cache: an array indexed by id for decoding and a hash
+// table keyed on the domain for interning.
+//
+// Decoding runs inside comparators, hash and sort support, so a cache
+// miss reads the table directly rather than through SPI, with the latest
+// snapshot: every id above the highest one read so far comes along, as
+// pg_enum is loaded for enum_cmp. Only interning runs queries, and only
+// in transactions that may write; others store the domain inline.
+//
+
+#include "postgres.h"
+
+#include "access/genam.h"
+#include "access/htup_details.h"
+#include "access/stratnum.h"
+#include "access/table.h"
+#include "access/xact.h"
+#include "catalog/pg_type.h"
+#include "commands/extension.h"
+#include "executor/spi.h"
+#include "utils/builtins.h"
+#include "utils/fmgroids.h"
+#include "utils/hsearch.h"
+#include "utils/lsyscache.h"
+#include "utils/memutils.h"
+#include "utils/snapmgr.h"
+
+#include "pg_email_opt.h"
+
+/*
+ * Hash table entry mapping a domain to its id
+ */
+typedef struct {
+    /* hash key, NUL-terminated domain */
+    char domain[EMAIL_MAX_DOMAIN_LENGTH + 1];
+
+    uint32 id;
+} DomainDictEntry;
+
+/* Memory for everything below; reset when it may hold uncommitted ids */
+static MemoryContext dict_context = NULL;
+
+/* domain -> id */
+static HTAB *dict_ids = NULL;
+
+/* id -> domain, NULL for ids not loaded yet */
+static const char **dict_domains = NULL;
+static uint32 dict_domains_size = 0;
+
+/* Highest id read from the table */
+static uint32 dict_loaded_max = 0;
+
+/* Saved plans for dictionary queries */
+static SPIPlanPtr insert_plan = NULL;
+static SPIPlanPtr find_plan = NULL;
+
+/* True if this transaction added ids to the cache by inserting them */
+static bool dict_inserted_in_xact = false;
+static bool dict_callbacks_registered = false;
+
+/*
+ * Drop all cached entries
+ */
+static void
+domain_dict_reset(void) {
+    if (dict_context != NULL)
+        MemoryContextReset(dict_context);
+    dict_ids = NULL;
+    dict_domains = NULL;
+    dict_domains_size = 0;
+    dict_loaded_max = 0;
+}
+
+/*
+ * An aborted insert leaves ids in the cache that no other backend can
+ * resolve, so forget the cache when a transaction that inserted aborts
+ */
+static void
+domain_dict_xact_callback(XactEvent event, void *arg) {
+    switch (event) {
+        case XACT_EVENT_ABORT:
+        case XACT_EVENT_PARALLEL_ABORT:
+            if (dict_inserted_in_xact)
+                domain_dict_reset();
+            dict_inserted_in_xact = false;
+            break;
+        case XACT_EVENT_COMMIT:
+        case XACT_EVENT_PARALLEL_COMMIT:
+        case XACT_EVENT_PREPARE:
+            dict_inserted_in_xact = false;
+            break;
+        default:
+            break;
+    }
+}
+
+static void
+domain_dict_subxact_callback(SubXactEvent event, SubTransactionId mySubid,
+                             SubTransactionId parentSubid, void *arg) {
+    if (event == SUBXACT_EVENT_ABORT_SUB && dict_inserted_in_xact)
+        domain_dict_reset();
+}
+
+/*
+ * Set up the cache on first use
+ */
+static void
+domain_dict_init(void) {
+    if (!dict_callbacks_registered) {
+        RegisterXactCallback(domain_dict_xact_callback, NULL);
+        RegisterSubXactCallback(domain_dict_subxact_callback, NULL);
+        dict_callbacks_registered = true;
+    }
+
+    if (dict_context == NULL)
+        dict_context = AllocSetContextCreate(TopMemoryContext,
+                                             "email_addr domain dictionary",
+                                             ALLOCSET_DEFAULT_SIZES);
+
+    if (dict_ids == NULL) {
+        HASHCTL ctl;
+
+        ctl.keysize = EMAIL_MAX_DOMAIN_LENGTH + 1;
+        ctl.entrysize = sizeof(DomainDictEntry);
+        ctl.hcxt = dict_context;
+        dict_ids = hash_create("email_addr domain ids", 64, &ctl,
+                               HASH_ELEM | HASH_STRINGS | HASH_CONTEXT);
+    }
+}
+
+/*
+ * Remember a mapping in both directions
+ */
+static const char *
+domain_dict_store(const uint32 id, const char *domain, const size_t len) {
+    char key[EMAIL_MAX_DOMAIN_LENGTH + 1];
+    bool found;
+
+    if (id >= dict_domains_size) {
+        uint32 new_size = Max(dict_domains_size * 2, 64);
+        while (new_size <= id)
+            new_size *= 2;
+
+        if (dict_domains == NULL)
+            dict_domains = MemoryContextAllocZero(dict_context, new_size * sizeof(char *));
+        else {
+            dict_domains = repalloc(dict_domains, new_size * sizeof(char *));
+            memset(dict_domains + dict_domains_size, 0,
+                   (new_size - dict_domains_size) * sizeof(char *));
+        }
+        dict_domains_size = new_size;
+    }
+
+    if (dict_domains[id] == NULL) {
+        char *copy = MemoryContextAlloc(dict_context, len + 1);
+        memcpy(copy, domain, len);
+        copy[len] = '\0';
+        dict_domains[id] = copy;
+    }
+
+    memcpy(key, domain, len);
+    key[len] = '\0';
+    DomainDictEntry *entry = hash_search(dict_ids, key, HASH_ENTER, &found);
+    entry->id = id;
+
+    return dict_domains[id];
+}
+
+/*
+ * Prepares and saves a dictionary query on the named object of the
+ * extension. Must be called inside SPI.
+ */
+static SPIPlanPtr
+domain_dict_prepare(const char *query_format, const char *name, const Oid argtype) {
+    const Oid ext_oid = get_extension_oid("pg_email_opt", false);
+    const char *qualified = quote_qualified_identifier(get_namespace_name(get_extension_schema(ext_oid)),
+                                                       name);
+    char *query = psprintf(query_format, qualified);
+
+    SPIPlanPtr plan = SPI_prepare(query, 1, (Oid *) &argtype);
+    if (plan == NULL)
+        elog(ERROR, "SPI_prepare failed for \"%s\": %s", query, SPI_result_code_string(SPI_result));
+
+    SPI_keepplan(plan);
+    pfree(query);
+
+    return plan;
+}
+
+/*
+ * Reads the first column of the first result row as an id
+ */
+static uint32
+domain_dict_result_id(void) {
+    bool isnull;
+    const Datum id = SPI_getbinval(SPI_tuptable->vals[0], SPI_tuptable->tupdesc, 1, &isnull);
+
+    Assert(!isnull);
+    return DatumGetInt32(id);
+}
+
+/*
+ * Reads entries from the table into the cache, with the latest snapshot:
+ * id alone if it is not above the highest id read, a gap left by an
+ * insert that had not committed yet; otherwise every id above that.
+ */
+static void
+domain_dict_load(const uint32 id) {
+    const Oid nspid = get_extension_schema(get_extension_oid("pg_email_opt", false));
+    const Oid relid = get_relname_relid("email_addr_domain_dict", nspid);
+    const Oid indexid = get_relname_relid("email_addr_domain_dict_pkey", nspid);
+    const bool gap = id != 0 && id <= dict_loaded_max;
+    ScanKeyData key;
+    HeapTuple tuple;
+
+    if (!OidIsValid(relid) || !OidIsValid(indexid))
+        elog(ERROR, "could not find email_addr_domain_dict");
+
+    ScanKeyInit(&key, 1,
+                gap ? BTEqualStrategyNumber : BTGreaterStrategyNumber,
+                gap ? F_INT4EQ : F_INT4GT,
+                Int32GetDatum((int32) (gap ? id : dict_loaded_max)));
+
+    Relation rel = table_open(relid, AccessShareLock);
+    Snapshot snapshot = RegisterSnapshot(GetLatestSnapshot());
+    SysScanDesc scan = systable_beginscan(rel, indexid, true, snapshot, 1, &key);
+
+    while (HeapTupleIsValid(tuple = systable_getnext(scan))) {
+        bool isnull;
+        const uint32 entry_id = DatumGetInt32(heap_getattr(tuple, 1, RelationGetDescr(rel), &isnull));
+        const text *domain = DatumGetTextPP(heap_getattr(tuple, 2, RelationGetDescr(rel), &isnull));
+        const size_t len = VARSIZE_ANY_EXHDR(domain);
+
+        if (len > EMAIL_MAX_DOMAIN_LENGTH)
+            ereport(ERROR,
+                (errcode(ERRCODE_DATA_CORRUPTED),
+                    errmsg("email domain id %u is too long in email_addr_domain_dict", entry_id)));
+
+        domain_dict_store(entry_id, VARDATA_ANY(domain), len);
+        dict_loaded_max = Max(dict_loaded_max, entry_id);
+    }
+
+    systable_endscan(scan);
+    UnregisterSnapshot(snapshot);
+    table_close(rel, AccessShareLock);
+}
+
+/*
+ * Returns the domain for a dictionary id
+ */
+const char *
+email_domain_dict_lookup(const uint32 id, const uint16 len) {
+    if (id < dict_domains_size && dict_domains[id] != NULL)
+        return dict_domains[id];
+
+    domain_dict_init();
+    domain_dict_load(id);
+
+    if (id >= dict_domains_size || dict_domains[id] == NULL)
+        ereport(ERROR,
+            (errcode(ERRCODE_DATA_CORRUPTED),
+                errmsg("email domain id %u not found in email_addr_domain_dict", id)));
+
+    if (strlen(dict_domains[id]) != len)
+        ereport(ERROR,
+            (errcode(ERRCODE_DATA_CORRUPTED),
+                errmsg("email domain id %u does not match its stored length", id)));
+
+    return dict_domains[id];
+}
+
+/*
+ * Returns the dictionary id of a canonical domain, adding it if needed,
+ * or 0 if it is not there and the transaction cannot add it
+ */
+uint32
+email_domain_dict_intern(const char *domain, const size_t len) {
+    char key[EMAIL_MAX_DOMAIN_LENGTH + 1];
+    bool found;
+
+    Assert(len <= EMAIL_MAX_DOMAIN_LENGTH);
+
+    domain_dict_init();
+
+    memcpy(key, domain, len);
+    key[len] = '\0';
+    const DomainDictEntry *entry = hash_search(dict_ids, key, HASH_FIND, &found);
+    if (found)
+        return entry->id;
+
+    /* Added by another backend since the cache was loaded? */
+    domain_dict_load(0);
+    entry = hash_search(dict_ids, key, HASH_FIND, &found);
+    if (found)
+        return entry->id;
+
+    /* Read-only transactions, standbys included, store the domain inline */
+    if (XactReadOnly || IsInParallelMode())
+        return 0;
+
+    if (SPI_connect() != SPI_OK_CONNECT)
+        elog(ERROR, "SPI_connect failed");
+
+    if (insert_plan == NULL)
+        insert_plan = domain_dict_prepare("SELECT %s($1)", "email_addr_domain_dict_add", TEXTOID);
+    if (find_plan == NULL)
+        find_plan = domain_dict_prepare("SELECT id FROM %s WHERE domain = $1", "email_addr_domain_dict", TEXTOID);
+
+    Datum values[1] = {PointerGetDatum(cstring_to_text_with_len(domain, len))};
+    uint32 id;
+
+    if (SPI_execute_plan(insert_plan, values, NULL, false, 1) != SPI_OK_SELECT || SPI_processed != 1)
+        elog(ERROR, "could not insert into email_addr_domain_dict");
+
+    bool isnull;
+    const Datum added = SPI_getbinval(SPI_tuptable->vals[0], SPI_tuptable->tupdesc, 1, &isnull);
+
+    if (!isnull) {
+        id = DatumGetInt32(added);
+        /* Not visible to others until commit */
+        dict_inserted_in_xact = true;
+    } else {
+        /*
+         * Added concurrently: ON CONFLICT waited for that insert to commit,
+         * which a snapshot taken before it would not see
+         */
+        PushActiveSnapshot(GetLatestSnapshot());
+        if (SPI_execute_plan(find_plan, values, NULL, true, 1) != SPI_OK_SELECT ||
+            SPI_processed == 0)
+            elog(ERROR, "could not find domain \"%s\" in email_addr_domain_dict", key);
+        PopActiveSnapshot();
+        id = domain_dict_result_id();
+    }
+
+    domain_dict_store(id, domain, len);
+
+    SPI_finish();
+
+    return id;
+}
@@ -0,0 +1,210 @@
+//
+// Local-part-first ordering for address autocomplete.
+//
+// email_addr_local_ops orders addresses by their canonical local part,
+// then by domain, with the same case and quoting rules as email_addr_ops.
+// All local parts with a given prefix are then adjacent in the index, so
+// email ^@ 'jo' can be answered with a range scan: its support function
+// rewrites it to
+//     email >=^ 'jo@' AND email <^ 'jp@'
+// where the bounds have an empty domain, which sorts before any other.
+//
+
+#include "postgres.h"
+
+#include "access/stratnum.h"
+#include "catalog/pg_am.h"
+#include "nodes/nodeFuncs.h"
+#include "nodes/supportnodes.h"
+#include "utils/builtins.h"
+#include "utils/lsyscache.h"
+
+#include "pg_email_opt.h"
+#include "myutils/common.h"
+#include "myutils/simd.h"
+
+/*
+ * Core comparison for email_addr_local_ops: canonical local part, then
+ * quoting, then canonical domain. Equal exactly when email_addr_ops
+ * says so.
+ */
+static int
+email_addr_local_cmp_internal(const EMAIL_ADDR *addr1, const EMAIL_ADDR *addr2) {
+    EmailAddrView view1;
+    EmailAddrView view2;
+    int cmp;
+
+    email_addr_unpack(addr1, &view1);
+    email_addr_unpack(addr2, &view2);
+
+    cmp = bounded_memcmp(view1.canon_local, view1.canon_local_len,
+                         view2.canon_local, view2.canon_local_len);
+
+    if (cmp == 0) {
+        const bool quoted1 = (view1.flags & EMAIL_FLAG_QUOTED_LOCAL) != 0;
+        const bool quoted2 = (view2.flags & EMAIL_FLAG_QUOTED_LOCAL) != 0;
+
+        if (quoted1 != quoted2)
+            cmp = quoted1 ? 1 : -1;
+        else if (view1.domain_id == 0 || view1.domain_id != view2.domain_id)
+            cmp = bounded_memcmp(view1.canon_domain, view1.canon_domain_len,
+                                 view2.canon_domain, view2.canon_domain_len);
+    }
+
+    return cmp;
+}
+
+/*
+ * Compare email addresses local part first
+ */
+PG_FUNCTION_INFO_V1(email_addr_local_cmp);
+
+Datum
+email_addr_local_cmp(PG_FUNCTION_ARGS) {
+    EMAIL_ADDR *addr1 = PG_GETARG_EMAIL_ADDR_PP(0);
+    EMAIL_ADDR *addr2 = PG_GETARG_EMAIL_ADDR_PP(1);
+
+    const int cmp = email_addr_local_cmp_internal(addr1, addr2);
+
+    PG_FREE_IF_COPY(addr1, 0);
+    PG_FREE_IF_COPY(addr2, 1);
+
+    PG_RETURN_INT32(cmp);
+}
+
+/*
+ * Local-first less than operator
+ */
+PG_FUNCTION_INFO_V1(email_addr_local_lt);
+
+Datum
+email_addr_local_lt(PG_FUNCTION_ARGS) {
+    EMAIL_ADDR *addr1 = PG_GETARG_EMAIL_ADDR_PP(0);
+    EMAIL_ADDR *addr2 = PG_GETARG_EMAIL_ADDR_PP(1);
+    int cmp;
+
+    EMAIL_STATS_COMPARISON(cmp, email_addr_local_cmp_internal(addr1, addr2));
+
+    PG_FREE_IF_COPY(addr1, 0);
+    PG_FREE_IF_COPY(addr2, 1);
+
+    PG_RETURN_BOOL(cmp < 0);
+}
+
+/*
+ * Local-first less than or equal operator
+ */
+PG_FUNCTION_INFO_V1(email_addr_local_le);
+
+Datum
+email_addr_local_le(PG_FUNCTION_ARGS) {
+    EMAIL_ADDR *addr1 = PG_GETARG_EMAIL_ADDR_PP(0);
+    EMAIL_ADDR *addr2 = PG_GETARG_EMAIL_ADDR_PP(1);
+    int cmp;
+
+    EMAIL_STATS_COMPARISON(cmp, email_addr_local_cmp_internal(addr1, addr2));
+
+    PG_FREE_IF_COPY(addr1, 0);
+    PG_FREE_IF_COPY(addr2, 1);
+
+    PG_RETURN_BOOL(cmp <= 0);
+}
+
+/*
+ * Local-first greater than operator
+ */
+PG_FUNCTION_INFO_V1(email_addr_local_gt);
+
+Datum
+email_addr_local_gt(PG_FUNCTION_ARGS) {
+    EMAIL_ADDR *addr1 = PG_GETARG_EMAIL_ADDR_PP(0);
+    EMAIL_ADDR *addr2 = PG_GETARG_EMAIL_ADDR_PP(1);
+    int cmp;
+
+    EMAIL_STATS_COMPARISON(cmp, email_addr_local_cmp_internal(addr1, addr2));
+
+    PG_FREE_IF_COPY(addr1, 0);
+    PG_FREE_IF_COPY(addr2, 1);
+
+    PG_RETURN_BOOL(cmp > 0);
+}
+
+/*
+ * Local-first greater than or equal operator
+ */
+PG_FUNCTION_INFO_V1(email_addr_local_ge);
+
+Datum
+email_addr_local_ge(PG_FUNCTION_ARGS) {
+    EMAIL_ADDR *addr1 = PG_GETARG_EMAIL_ADDR_PP(0);
+    EMAIL_ADDR *addr2 = PG_GETARG_EMAIL_ADDR_PP(1);
+    int cmp;
+
+    EMAIL_STATS_COMPARISON(cmp, email_addr_local_cmp_internal(addr1, addr2));
+
+    PG_FREE_IF_COPY(addr1, 0);
+    PG_FREE_IF_COPY(addr2, 1);
+
+    PG_RETURN_BOOL(cmp >= 0);
+}
+
+/*
+ * Planner support for email_addr_local_prefix: turns "email ^@ const"
+ * into an exact range on email_addr_local_ops
+ */
+PG_FUNCTION_INFO_V1(email_addr_local_prefix_support);
+
+Datum
+email_addr_local_prefix_support(PG_FUNCTION_ARGS) {
+    Node *rawreq = (Node *) PG_GETARG_POINTER(0);
+
+    if (!IsA(rawreq, SupportRequestIndexCondition))
+        PG_RETURN_POINTER(NULL);
+
+    SupportRequestIndexCondition *req = (SupportRequestIndexCondition *) rawreq;
+
+    if (!is_opclause(req->node) || req->indexarg != 0 ||
+        req->opfamily != email_support_opfamily(fcinfo, BTREE_AM_OID, "email_addr_local_ops"))
+        PG_RETURN_POINTER(NULL);
+
+    const OpExpr *clause = (OpExpr *) req->node;
+    Expr *indexkey = linitial(clause->args);
+    const Node *pattern = lsecond(clause->args);
+
+    if (!IsA(pattern, Const) || ((const Const *) pattern)->constisnull)
+        PG_RETURN_POINTER(NULL);
+
+    const text *prefix = DatumGetTextPP(((const Const *) pattern)->constvalue);
+    const size_t len = VARSIZE_ANY_EXHDR(prefix);
+    char local[EMAIL_MAX_LOCAL_LENGTH];
+
+    if (len == 0 || len > EMAIL_MAX_LOCAL_LENGTH)
+        PG_RETURN_POINTER(NULL);
+
+    /*
+     * Only unquoted prefixes: their bytes are their own canonical form,
+     * and so are the bounds built from them. The successor of an atext
+     * byte is never an uppercase letter.
+     */
+    email_lower(local, VARDATA_ANY(prefix), len);
+    if (email_span(local, len, EMAIL_SET_ATEXT) != len)
+        PG_RETURN_POINTER(NULL);
+
+    const Oid typid = exprType((Node *) indexkey);
+    const Oid ge_op = get_opfamily_member(req->opfamily, typid, typid, BTGreaterEqualStrategyNumber);
+    const Oid lt_op = get_opfamily_member(req->opfamily, typid, typid, BTLessStrategyNumber);
+
+    if (!OidIsValid(ge_op) || !OidIsValid(lt_op))
+        PG_RETURN_POINTER(NULL);
+
+    Expr *lower = email_make_bound_clause(ge_op, indexkey, typid, local, len, "", 0);
+
+    /* The smallest local part after every one with the prefix */
+    local[len - 1]++;
+
+    Expr *upper = email_make_bound_clause(lt_op, indexkey, typid, local, len, "", 0);
+
+    req->lossy = false;
+
+    PG_RETURN_POINTER(list_make2(lower, upper));
+}
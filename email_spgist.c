@@ -0,0 +1,557 @@
+//
+// SP-GiST radix tree over email addresses.
+//
+// Each address is indexed under the key
+//     <domain labels, right to left>@<canonical local part>
+// e.g. "com.example.mail@john" for John@Mail.Example.com. The tree shares
+// common prefixes between keys, so a domain is stored once per subtree
+// rather than once per address, and the supported queries all become
+// prefix searches:
+//     =    the whole key
+//     =#   "com.example.mail@"
+//     <@#  "com.example" followed by '.' or '@'
+//     ^@   anything, then '@' and the local-part prefix
+//
+// The tree itself follows the text radix tree of spgtextproc.c: inner
+// tuples carry a prefix and one node per next byte, -1 labels the node of
+// keys that end there and -2 the dummy node of an allTheSame tuple.
+//
+
+#include "postgres.h"
+
+#include "access/spgist.h"
+#include "catalog/pg_type.h"
+#include "utils/builtins.h"
+#include "utils/datum.h"
+
+#include "pg_email_opt.h"
+#include "myutils/simd.h"
+
+/* Operator strategies of email_addr_spgist_ops */
+#define EMAIL_SPG_EQUAL_STRATEGY        1
+#define EMAIL_SPG_DOMAIN_EQUAL_STRATEGY 2
+#define EMAIL_SPG_SUBDOMAIN_STRATEGY    3
+#define EMAIL_SPG_LOCAL_PREFIX_STRATEGY 4
+
+/*
+ * A scan key turned into the key bytes it constrains
+ */
+typedef struct {
+    StrategyNumber strategy;
+
+    /* bytes to match, see email_spg_match */
+    char *key;
+    int len;
+
+    /* false if the index cannot decide the query; leaves are rechecked */
+    bool exact;
+} EmailSpgQuery;
+
+/* Node of a picksplit, sorted by label */
+typedef struct {
+    Datum d;
+    int i;
+    int16 c;
+} EmailSpgNode;
+
+/*
+ * Writes the labels of a canonical domain from right to left. IP literals
+ * have no labels and are copied as they are. Writes exactly len bytes.
+ */
+static void
+reverse_domain_labels(char *dest, const char *domain, const size_t len) {
+    size_t end = len;
+
+    if (len > 0 && domain[0] == '[') {
+        memcpy(dest, domain, len);
+        return;
+    }
+
+    while (end > 0) {
+        size_t start = end;
+
+        while (start > 0 && domain[start - 1] != '.')
+            start--;
+
+        memcpy(dest, domain + start, end - start);
+        dest += end - start;
+
+        if (start == 0)
+            break;
+
+        *dest++ = '.';
+        end = start - 1;
+    }
+}
+
+/*
+ * Builds the index key of an address. If domain_only, stops after the '@'.
+ * Returns the key length.
+ */
+static int
+email_spg_make_key(const EMAIL_ADDR *addr, const bool domain_only, char **key) {
+    EmailAddrView view;
+
+    email_addr_unpack(addr, &view);
+
+    const int len = view.canon_domain_len + 1 + (domain_only ? 0 : view.canon_local_len);
+    char *p = palloc(len);
+
+    reverse_domain_labels(p, view.canon_domain, view.canon_domain_len);
+    p[view.canon_domain_len] = '@';
+    if (!domain_only)
+        memcpy(p + view.canon_domain_len + 1, view.canon_local, view.canon_local_len);
+
+    *key = p;
+    return len;
+}
+
+/*
+ * Forms a text datum, with a short header where possible to keep the
+ * index small
+ */
+static Datum
+form_text_datum(const char *data, const int len) {
+    char *p = palloc(len + VARHDRSZ);
+
+    if (len + VARHDRSZ_SHORT <= VARATT_SHORT_MAX) {
+        SET_VARSIZE_SHORT(p, len + VARHDRSZ_SHORT);
+        if (len > 0)
+            memcpy(p + VARHDRSZ_SHORT, data, len);
+    } else {
+        SET_VARSIZE(p, len + VARHDRSZ);
+        memcpy(p + VARHDRSZ, data, len);
+    }
+
+    return PointerGetDatum(p);
+}
+
+/*
+ * Length of the common prefix of two strings
+ */
+static int
+common_prefix(const char *a, const char *b, const int lena, const int lenb) {
+    int i = 0;
+
+    while (i < lena && i < lenb && a[i] == b[i])
+        i++;
+
+    return i;
+}
+
+/*
+ * Binary search for a label in a sorted label array. Returns true if
+ * found, and in *i the position it is or should be at.
+ */
+static bool
+search_label(const Datum *labels, const int nlabels, const int16 c, int *i) {
+    int low = 0;
+    int high = nlabels;
+
+    while (low < high) {
+        const int mid = (low + high) / 2;
+        const int16 label = DatumGetInt16(labels[mid]);
+
+        if (c == label) {
+            *i = mid;
+            return true;
+        }
+        if (c > label)
+            low = mid + 1;
+        else
+            high = mid;
+    }
+
+    *i = high;
+    return false;
+}
+
+static int
+email_spg_node_cmp(const void *a, const void *b) {
+    const EmailSpgNode *na = a;
+    const EmailSpgNode *nb = b;
+
+    return (int) na->c - (int) nb->c;
+}
+
+/*
+ * Decodes the scan keys of a scan
+ */
+static EmailSpgQuery *
+email_spg_make_queries(const ScanKey scankeys, const int nkeys) {
+    EmailSpgQuery *queries = palloc(sizeof(EmailSpgQuery) * nkeys);
+
+    for (int i = 0; i < nkeys; i++) {
+        EmailSpgQuery *q = &queries[i];
+        const Datum arg = scankeys[i].sk_argument;
+
+        q->strategy = scankeys[i].sk_strategy;
+        q->exact = true;
+
+        switch (q->strategy) {
+            case EMAIL_SPG_EQUAL_STRATEGY:
+            case EMAIL_SPG_DOMAIN_EQUAL_STRATEGY:
+                q->len = email_spg_make_key(DatumGetEmailAddrP(arg),
+                                            q->strategy == EMAIL_SPG_DOMAIN_EQUAL_STRATEGY, &q->key);
+                break;
+
+            case EMAIL_SPG_SUBDOMAIN_STRATEGY: {
+                const text *suffix = DatumGetTextPP(arg);
+                char domain[EMAIL_MAX_DOMAIN_LENGTH];
+                size_t len;
+
+                /* Anything but a plain name is left to the recheck */
+                if (!email_domain_suffix_canonicalize(domain, VARDATA_ANY(suffix),
+                                                      VARSIZE_ANY_EXHDR(suffix), &len)) {
+                    q->exact = false;
+                    break;
+                }
+
+                q->key = palloc(len);
+                q->len = len;
+                reverse_domain_labels(q->key, domain, len);
+                break;
+            }
+
+            case EMAIL_SPG_LOCAL_PREFIX_STRATEGY: {
+                const text *prefix = DatumGetTextPP(arg);
+
+                q->len = VARSIZE_ANY_EXHDR(prefix);
+                q->key = palloc(q->len + 1);
+                email_lower(q->key, VARDATA_ANY(prefix), q->len);
+                break;
+            }
+
+            default:
+                elog(ERROR, "unrecognized strategy number: %d", q->strategy);
+        }
+    }
+
+    return queries;
+}
+
+/*
+ * Checks a key against a query. value is the whole key if complete is
+ * set, otherwise only its first len bytes are known and the result says
+ * whether some key starting with them could match.
+ */
+static bool
+email_spg_match(const EmailSpgQuery *q, const char *value, const int len, const bool complete) {
+    if (!q->exact)
+        return true;
+
+    switch (q->strategy) {
+        case EMAIL_SPG_EQUAL_STRATEGY:
+            if (complete ? len != q->len : len > q->len)
+                return false;
+            return memcmp(value, q->key, len) == 0;
+
+        case EMAIL_SPG_DOMAIN_EQUAL_STRATEGY:
+            if (complete && len < q->len)
+                return false;
+            return memcmp(value, q->key, Min(len, q->len)) == 0;
+
+        case EMAIL_SPG_SUBDOMAIN_STRATEGY:
+            /* Complete keys always have the '@' after the domain */
+            if (memcmp(value, q->key, Min(len, q->len)) != 0)
+                return false;
+            return len <= q->len ? !complete : value[q->len] == '.' || value[q->len] == '@';
+
+        case EMAIL_SPG_LOCAL_PREFIX_STRATEGY: {
+            const char *at = memchr(value, '@', len);
+
+            if (at == NULL)
+                return !complete;
+
+            const int local_len = value + len - (at + 1);
+
+            if (complete && local_len < q->len)
+                return false;
+            return memcmp(at + 1, q->key, Min(local_len, q->len)) == 0;
+        }
+    }
+
+    return false;
+}
+
+PG_FUNCTION_INFO_V1(email_addr_spg_config);
+
+Datum
+email_addr_spg_config(PG_FUNCTION_ARGS) {
+    spgConfigOut *cfg = (spgConfigOut *) PG_GETARG_POINTER(1);
+
+    cfg->prefixType = TEXTOID;
+    cfg->labelType = INT2OID;
+    cfg->leafType = TEXTOID;
+    cfg->canReturnData = false;
+    cfg->longValuesOK = false;
+
+    PG_RETURN_VOID();
+}
+
+/*
+ * Converts an address into its index key
+ */
+PG_FUNCTION_INFO_V1(email_addr_spg_compress);
+
+Datum
+email_addr_spg_compress(PG_FUNCTION_ARGS) {
+    EMAIL_ADDR *addr = PG_GETARG_EMAIL_ADDR_PP(0);
+    char *key;
+
+    const int len = email_spg_make_key(addr, false, &key);
+
+    PG_RETURN_DATUM(form_text_datum(key, len));
+}
+
+PG_FUNCTION_INFO_V1(email_addr_spg_choose);
+
+Datum
+email_addr_spg_choose(PG_FUNCTION_ARGS) {
+    const spgChooseIn *in = (spgChooseIn *) PG_GETARG_POINTER(0);
+    spgChooseOut *out = (spgChooseOut *) PG_GETARG_POINTER(1);
+
+    /* The leaf datum is what is left of the key below this tuple */
+    const text *in_text = DatumGetTextPP(in->leafDatum);
+    const char *in_str = VARDATA_ANY(in_text);
+    const int in_len = VARSIZE_ANY_EXHDR(in_text);
+    int common_len = 0;
+    int16 node_char;
+    int i;
+
+    if (in->hasPrefix) {
+        const text *prefix_text = DatumGetTextPP(in->prefixDatum);
+        const char *prefix = VARDATA_ANY(prefix_text);
+        const int prefix_len = VARSIZE_ANY_EXHDR(prefix_text);
+
+        common_len = common_prefix(in_str, prefix, in_len, prefix_len);
+
+        if (common_len < prefix_len) {
+            /* Split the tuple where the key leaves the prefix */
+            out->resultType = spgSplitTuple;
+            out->result.splitTuple.prefixHasPrefix = common_len > 0;
+            if (common_len > 0)
+                out->result.splitTuple.prefixPrefixDatum = form_text_datum(prefix, common_len);
+            out->result.splitTuple.prefixNNodes = 1;
+            out->result.splitTuple.prefixNodeLabels = palloc(sizeof(Datum));
+            out->result.splitTuple.prefixNodeLabels[0] =
+                    Int16GetDatum(*(const unsigned char *) (prefix + common_len));
+            out->result.splitTuple.childNodeN = 0;
+            out->result.splitTuple.postfixHasPrefix = prefix_len - common_len > 1;
+            if (prefix_len - common_len > 1)
+                out->result.splitTuple.postfixPrefixDatum =
+                        form_text_datum(prefix + common_len + 1, prefix_len - common_len - 1);
+
+            PG_RETURN_VOID();
+        }
+    }
+
+    node_char = in_len > common_len ? *(const unsigned char *) (in_str + common_len) : -1;
+
+    if (search_label(in->nodeLabels, in->nNodes, node_char, &i)) {
+        /*
+         * Descend; for allTheSame tuples the core picks the node itself,
+         * but levelAdd and restDatum are the same for all of them
+         */
+        const int level_add = common_len + (node_char >= 0 ? 1 : 0);
+
+        out->resultType = spgMatchNode;
+        out->result.matchNode.nodeN = i;
+        out->result.matchNode.levelAdd = level_add;
+        out->result.matchNode.restDatum = form_text_datum(in_str + level_add, in_len - level_add);
+    } else if (in->allTheSame) {
+        /* Nodes cannot be added to allTheSame tuples: push it down */
+        out->resultType = spgSplitTuple;
+        out->result.splitTuple.prefixHasPrefix = in->hasPrefix;
+        out->result.splitTuple.prefixPrefixDatum = in->prefixDatum;
+        out->result.splitTuple.prefixNNodes = 1;
+        out->result.splitTuple.prefixNodeLabels = palloc(sizeof(Datum));
+        out->result.splitTuple.prefixNodeLabels[0] = Int16GetDatum(-2);
+        out->result.splitTuple.childNodeN = 0;
+        out->result.splitTuple.postfixHasPrefix = false;
+    } else {
+        out->resultType = spgAddNode;
+        out->result.addNode.nodeLabel = Int16GetDatum(node_char);
+        out->result.addNode.nodeN = i;
+    }
+
+    PG_RETURN_VOID();
+}
+
+PG_FUNCTION_INFO_V1(email_addr_spg_picksplit);
+
+Datum
+email_addr_spg_picksplit(PG_FUNCTION_ARGS) {
+    const spgPickSplitIn *in = (spgPickSplitIn *) PG_GETARG_POINTER(0);
+    spgPickSplitOut *out = (spgPickSplitOut *) PG_GETARG_POINTER(1);
+    const text *text0 = DatumGetTextPP(in->datums[0]);
+    int common_len = VARSIZE_ANY_EXHDR(text0);
+
+    /* Longest prefix common to all keys becomes the tuple prefix */
+    for (int i = 1; i < in->nTuples && common_len > 0; i++) {
+        const text *texti = DatumGetTextPP(in->datums[i]);
+        const int len = common_prefix(VARDATA_ANY(text0), VARDATA_ANY(texti),
+                                      common_len, VARSIZE_ANY_EXHDR(texti));
+
+        common_len = Min(common_len, len);
+    }
+
+    out->hasPrefix = common_len > 0;
+    if (common_len > 0)
+        out->prefixDatum = form_text_datum(VARDATA_ANY(text0), common_len);
+
+    /* Label each key with its first byte after the prefix */
+    EmailSpgNode *nodes = palloc(sizeof(EmailSpgNode) * in->nTuples);
+
+    for (int i = 0; i < in->nTuples; i++) {
+        const text *texti = DatumGetTextPP(in->datums[i]);
+
+        nodes[i].c = VARSIZE_ANY_EXHDR(texti) > common_len
+                         ? *(const unsigned char *) (VARDATA_ANY(texti) + common_len)
+                         : -1;
+        nodes[i].i = i;
+        nodes[i].d = in->datums[i];
+    }
+
+    qsort(nodes, in->nTuples, sizeof(EmailSpgNode), email_spg_node_cmp);
+
+    out->nNodes = 0;
+    out->nodeLabels = palloc(sizeof(Datum) * in->nTuples);
+    out->mapTuplesToNodes = palloc(sizeof(int) * in->nTuples);
+    out->leafTupleDatums = palloc(sizeof(Datum) * in->nTuples);
+
+    for (int i = 0; i < in->nTuples; i++) {
+        const text *texti = DatumGetTextPP(nodes[i].d);
+        const int len = VARSIZE_ANY_EXHDR(texti);
+
+        if (i == 0 || nodes[i].c != nodes[i - 1].c)
+            out->nodeLabels[out->nNodes++] = Int16GetDatum(nodes[i].c);
+
+        out->leafTupleDatums[nodes[i].i] = len > common_len
+                                               ? form_text_datum(VARDATA_ANY(texti) + common_len + 1,
+                                                                 len - common_len - 1)
+                                               : form_text_datum(NULL, 0);
+        out->mapTuplesToNodes[nodes[i].i] = out->nNodes - 1;
+    }
+
+    PG_RETURN_VOID();
+}
+
+PG_FUNCTION_INFO_V1(email_addr_spg_inner_consistent);
+
+Datum
+email_addr_spg_inner_consistent(PG_FUNCTION_ARGS) {
+    const spgInnerConsistentIn *in = (spgInnerConsistentIn *) PG_GETARG_POINTER(0);
+    spgInnerConsistentOut *out = (spgInnerConsistentOut *) PG_GETARG_POINTER(1);
+    EmailSpgQuery *queries = email_spg_make_queries(in->scankeys, in->nkeys);
+
+    /*
+     * Reconstruct the key bytes down to this tuple: the parent's, our
+     * prefix and the node label. Reconstructed values always have a
+     * 4-byte header, as we make them below.
+     */
+    const text *parent = (text *) DatumGetPointer(in->reconstructedValue);
+    const text *prefix_text = in->hasPrefix ? DatumGetTextPP(in->prefixDatum) : NULL;
+    const int prefix_len = prefix_text ? VARSIZE_ANY_EXHDR(prefix_text) : 0;
+    const int max_len = in->level + prefix_len + 1;
+    text *reconstr = palloc(VARHDRSZ + max_len);
+    char *value = VARDATA(reconstr);
+
+    Assert(parent == NULL ? in->level == 0 : VARSIZE(parent) - VARHDRSZ == in->level);
+
+    if (in->level > 0)
+        memcpy(value, VARDATA(parent), in->level);
+    if (prefix_len > 0)
+        memcpy(value + in->level, VARDATA_ANY(prefix_text), prefix_len);
+
+    out->nodeNumbers = palloc(sizeof(int) * in->nNodes);
+    out->levelAdds = palloc(sizeof(int) * in->nNodes);
+    out->reconstructedValues = palloc(sizeof(Datum) * in->nNodes);
+    out->nNodes = 0;
+
+    for (int i = 0; i < in->nNodes; i++) {
+        const int16 node_char = DatumGetInt16(in->nodeLabels[i]);
+        int len = max_len - 1;
+        bool match = true;
+
+        /* End-of-key and dummy labels add no byte */
+        if (node_char > 0)
+            value[len++] = (char) node_char;
+
+        for (int j = 0; j < in->nkeys && match; j++)
+            match = email_spg_match(&queries[j], value, len, false);
+
+        if (match) {
+            SET_VARSIZE(reconstr, VARHDRSZ + len);
+
+            out->nodeNumbers[out->nNodes] = i;
+            out->levelAdds[out->nNodes] = len - in->level;
+            out->reconstructedValues[out->nNodes] = datumCopy(PointerGetDatum(reconstr), false, -1);
+            out->nNodes++;
+        }
+    }
+
+    PG_RETURN_VOID();
+}
+
+PG_FUNCTION_INFO_V1(email_addr_spg_leaf_consistent);
+
+Datum
+email_addr_spg_leaf_consistent(PG_FUNCTION_ARGS) {
+    const spgLeafConsistentIn *in = (spgLeafConsistentIn *) PG_GETARG_POINTER(0);
+    spgLeafConsistentOut *out = (spgLeafConsistentOut *) PG_GETARG_POINTER(1);
+    EmailSpgQuery *queries = email_spg_make_queries(in->scankeys, in->nkeys);
+    const text *reconstr = (text *) DatumGetPointer(in->reconstructedValue);
+    const text *leaf = DatumGetTextPP(in->leafDatum);
+    const int leaf_len = VARSIZE_ANY_EXHDR(leaf);
+    const int len = in->level + leaf_len;
+    char *value = palloc(len + 1);
+    bool match = true;
+
+    Assert(reconstr == NULL ? in->level == 0 : VARSIZE(reconstr) - VARHDRSZ == in->level);
+
+    /* The whole key: bytes above the leaf, then the leaf's own */
+    if (in->level > 0)
+        memcpy(value, VARDATA(reconstr), in->level);
+    if (leaf_len > 0)
+        memcpy(value + in->level, VARDATA_ANY(leaf), leaf_len);
+
+    out->recheck = false;
+
+    for (int j = 0; j < in->nkeys && match; j++) {
+        match = email_spg_match(&queries[j], value, len, true);
+        if (!queries[j].exact)
+            out->recheck = true;
+    }
+
+    PG_RETURN_BOOL(match);
+}
+
+/*
+ * Local-part prefix match: true if the canonical local part starts with
+ * the given prefix, compared case-insensitively
+ */
+PG_FUNCTION_INFO_V1(email_addr_local_prefix);
+
+Datum
+email_addr_local_prefix(PG_FUNCTION_ARGS) {
+    EMAIL_ADDR *email = PG_GETARG_EMAIL_ADDR_PP(0);
+    const text *prefix = PG_GETARG_TEXT_PP(1);
+    const size_t prefix_len = VARSIZE_ANY_EXHDR(prefix);
+    EmailAddrView view;
+    bool result = false;
+
+    email_addr_unpack(email, &view);
+
+    if (prefix_len <= view.canon_local_len) {
+        char *canon_prefix = palloc(prefix_len + 1);
+
+        email_lower(canon_prefix, VARDATA_ANY(prefix), prefix_len);
+        result = memcmp(view.canon_local, canon_prefix, prefix_len) == 0;
+        pfree(canon_prefix);
+    }
+
+    PG_FREE_IF_COPY(email, 0);
+
+    PG_RETURN_BOOL(result);
+}
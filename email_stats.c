@@ -0,0 +1,97 @@
+//
+// Per-backend instrumentation for the email_addr type.
+//
+// Call, byte and failure counters are always maintained, they are plain
+// increments. Timing needs a clock read per call and is only collected
+// when pg_email_opt.track_timing is on. Comparisons are counted at the
+// SQL operators only, never in the btree, sort or hash support functions.
+//
+
+#include "postgres.h"
+
+#include "funcapi.h"
+#include "utils/builtins.h"
+#include "utils/guc.h"
+#include "utils/tuplestore.h"
+
+#include "pg_email_opt.h"
+
+/* GUC variables */
+bool email_trace = false;
+bool email_track_timing = false;
+
+/* Counters, indexed by EmailStatsKind */
+EmailStatsCounter email_stats[EMAIL_STATS_NUM_KINDS];
+
+static const char *const email_stats_names[EMAIL_STATS_NUM_KINDS] = {
+    "input",
+    "output",
+    "receive",
+    "send",
+    "compare",
+};
+
+/*
+ * Define the instrumentation GUCs
+ */
+void
+email_stats_init(void) {
+    DefineCustomBoolVariable("pg_email_opt.trace",
+                             "Emits a NOTICE describing each email_addr value read or printed.",
+                             "Meant for debugging the storage format; very verbose.",
+                             &email_trace,
+                             false,
+                             PGC_USERSET,
+                             0,
+                             NULL, NULL, NULL);
+
+    DefineCustomBoolVariable("pg_email_opt.track_timing",
+                             "Collects time spent in email_addr input, output and comparison.",
+                             "Adds a clock read to every call; see pg_email_opt_stats().",
+                             &email_track_timing,
+                             false,
+                             PGC_USERSET,
+                             0,
+                             NULL, NULL, NULL);
+
+    MarkGUCPrefixReserved("pg_email_opt");
+}
+
+/*
+ * Show the counters of the current backend, one row per operation
+ */
+PG_FUNCTION_INFO_V1(pg_email_opt_stats);
+
+Datum
+pg_email_opt_stats(PG_FUNCTION_ARGS) {
+    ReturnSetInfo *rsinfo = (ReturnSetInfo *) fcinfo->resultinfo;
+
+    InitMaterializedSRF(fcinfo, 0);
+
+    for (int i = 0; i < EMAIL_STATS_NUM_KINDS; i++) {
+        Datum values[5];
+        bool nulls[5] = {false};
+
+        values[0] = CStringGetTextDatum(email_stats_names[i]);
+        values[1] = Int64GetDatum(email_stats[i].calls);
+        values[2] = Int64GetDatum(email_stats[i].bytes);
+        values[3] = Int64GetDatum(email_stats[i].failures);
+        values[4] = Float8GetDatum(INSTR_TIME_GET_MILLISEC(email_stats[i].time));
+
+        tuplestore_putvalues(rsinfo->setResult, rsinfo->setDesc, values, nulls);
+    }
+
+    return (Datum) 0;
+}
+
+/*
+ * Reset the counters of the current backend
+ */
+PG_FUNCTION_INFO_V1(pg_email_opt_stats_reset);
+
+Datum
+pg_email_opt_stats_reset(PG_FUNCTION_ARGS) {
+    memset(email_stats, 0, sizeof(email_stats));
+
+    PG_RETURN_VOID();
+}
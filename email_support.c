@@ -0,0 +1,69 @@
+//
+// Helpers shared by the planner support functions.
+//
+// Support functions only act on the operator families and functions of
+// the extension. Those are told apart by OID, resolved by name in the
+// namespace of the support function being called, which is the schema
+// the extension was created in; a same-named object elsewhere does not
+// match.
+//
+
+#include "postgres.h"
+
+#include "catalog/pg_type.h"
+#include "commands/defrem.h"
+#include "nodes/makefuncs.h"
+#include "nodes/nodeFuncs.h"
+#include "parser/parse_func.h"
+#include "utils/lsyscache.h"
+
+#include "pg_email_opt.h"
+
+/*
+ * "schema.name" of the extension, as a qualified name list
+ */
+static List *
+email_support_qualified_name(FunctionCallInfo fcinfo, const char *name) {
+    const char *nspname = get_namespace_name(get_func_namespace(fcinfo->flinfo->fn_oid));
+
+    if (nspname == NULL)
+        return NIL;
+
+    return list_make2(makeString((char *) nspname), makeString(pstrdup(name)));
+}
+
+Oid
+email_support_opfamily(FunctionCallInfo fcinfo, const Oid amoid, const char *name) {
+    List *qualified = email_support_qualified_name(fcinfo, name);
+
+    if (qualified == NIL)
+        return InvalidOid;
+
+    return get_opfamily_oid(amoid, qualified, true);
+}
+
+bool
+email_support_is_function(FunctionCallInfo fcinfo, const FuncExpr *expr, const char *name) {
+    List *qualified = email_support_qualified_name(fcinfo, name);
+    Oid argtypes[FUNC_MAX_ARGS];
+    int nargs = 0;
+    ListCell *lc;
+
+    if (qualified == NIL || list_length(expr->args) > FUNC_MAX_ARGS)
+        return false;
+
+    foreach(lc, expr->args)
+        argtypes[nargs++] = exprType(lfirst(lc));
+
+    return LookupFuncName(qualified, nargs, argtypes, true) == expr->funcid;
+}
+
+Expr *
+email_make_bound_clause(const Oid opno, Expr *indexkey, const Oid typid,
+                        const char *local, const size_t local_len,
+                        const char *domain, const size_t domain_len) {
+    EMAIL_ADDR *bound = make_email_addr(local, local_len, domain, domain_len);
+    Const *value = makeConst(typid, -1, InvalidOid, -1, PointerGetDatum(bound), false, false);
+
+    return make_opclause(opno, BOOLOID, false, indexkey, (Expr *) value, InvalidOid, InvalidOid);
+}
@@ -0,0 +1,788 @@
+//
+// Shared-memory suppression cache.
+//
+// When the library is in shared_preload_libraries, the addresses of the
+// tables registered in email_suppression_sources are kept in a dshash
+// table in a DSA area shared by all backends, and email_is_suppressed()
+// answers from there without touching the buffer manager. Each database
+// has its own sources, and so its own table, generation and builder; the
+// state of a dropped database stays until the server restarts.
+//
+// The table is keyed on the fingerprint of the address and keeps its
+// canonical bytes, which lookups compare, so answers are exact. It is
+// rebuilt from the sources when a lookup finds it stale:
+//   - a statement trigger on each source marks the transaction, and its
+//     commit bumps the generation of its database;
+//   - a lookup that sees a generation other than the loaded one rebuilds
+//     the table off-lock from the latest snapshot, swaps it in and frees
+//     the old one. Lookups that find another backend rebuilding query the
+//     sources directly meanwhile: a builder may need a lock they hold,
+//     and a wait on each other would be invisible to deadlock detection.
+// The generation is read before the rebuild takes its snapshot, so a
+// commit that the rebuild misses leaves the table stale again. A builder
+// that fails or exits gives the role up, and the next one frees the table
+// it left half built.
+//
+// A transaction that changed a source itself is answered by querying the
+// sources directly, with its own snapshot: a table built from its
+// uncommitted rows must never be shared.
+//
+// The table is shared, the privileges are not: every lookup checks that
+// its role may read the email column of each source the table was built
+// from, once per statement and table. Row-level security cannot be shared
+// either, so sources must be tables without it; a lookup whose role is
+// subject to policies added since the rebuild queries the sources.
+//
+
+#include "postgres.h"
+
+#include "access/xact.h"
+#include "commands/extension.h"
+#include "commands/trigger.h"
+#include "executor/spi.h"
+#include "lib/dshash.h"
+#include "miscadmin.h"
+#include "port/atomics.h"
+#include "storage/ipc.h"
+#include "storage/lwlock.h"
+#include "storage/shmem.h"
+#include "utils/acl.h"
+#include "utils/builtins.h"
+#include "utils/dsa.h"
+#include "utils/lsyscache.h"
+#include "utils/memutils.h"
+#include "utils/rls.h"
+#include "utils/snapmgr.h"
+
+#include "pg_email_opt.h"
+
+/* Rows fetched per batch while rebuilding */
+#define SUPPRESSION_FETCH_SIZE 10000
+
+/*
+ * Fixed shared state
+ */
+typedef struct {
+    /* protects everything below, and the SuppressionDatabase fields but generation */
+    LWLock *lock;
+
+    /* tranche of the DSA area and of the dshash partition locks */
+    int tranche_id;
+
+    dsa_handle area;
+
+    /* list of SuppressionDatabase in the area */
+    dsa_pointer databases;
+} SuppressionShared;
+
+/*
+ * State of one database: each has its own sources, and so its own table
+ */
+typedef struct {
+    Oid dboid;
+    dsa_pointer next;
+
+    dshash_table_handle table;
+
+    /* SuppressionSourceId of each source the table was built from */
+    dsa_pointer source_ids;
+    int nsources;
+
+    /* generation the table was built for */
+    uint64 loaded_generation;
+
+    /* a backend is rebuilding the table */
+    bool building;
+
+    /* table being built, left behind if its builder failed */
+    dshash_table_handle building_table;
+
+    /* bumped by commits that changed a source */
+    pg_atomic_uint64 generation;
+} SuppressionDatabase;
+
+/*
+ * Entry: fingerprint, and the canonical "local@domain" it was made of
+ */
+typedef struct {
+    EmailFingerprint key;
+    uint16 len;
+    dsa_pointer canon;
+} SuppressionEntry;
+
+/*
+ * Column a lookup needs SELECT privilege on
+ */
+typedef struct {
+    Oid relid;
+    AttrNumber attnum;
+} SuppressionSourceId;
+
+/*
+ * Kept in fn_extra: the table whose sources the role was checked for
+ */
+typedef struct {
+    uint64 generation;
+    Oid userid;
+
+    /* row-level security applies to the role: query the sources */
+    bool direct;
+} SuppressionChecked;
+
+static uint32
+suppression_hash(const void *key, size_t size, void *arg) {
+    uint32 hash;
+
+    /* The fingerprint is a hash already */
+    memcpy(&hash, key, sizeof(hash));
+
+    return hash;
+}
+
+static int
+suppression_compare(const void *a, const void *b, size_t size, void *arg) {
+    return memcmp(a, b, sizeof(EmailFingerprint));
+}
+
+static dshash_parameters suppression_params = {
+    sizeof(EmailFingerprint),
+    sizeof(SuppressionEntry),
+    suppression_compare,
+    suppression_hash,
+    0 /* set from shared state */
+};
+
+static SuppressionShared *shared = NULL;
+
+/* Backend-local attachments; db is the state of MyDatabaseId */
+static dsa_area *area = NULL;
+static SuppressionDatabase *db = NULL;
+static dshash_table *table = NULL;
+static dshash_table_handle table_handle = DSHASH_HANDLE_INVALID;
+
+/* This backend set db->building */
+static bool building_here = false;
+static bool exit_callback_registered = false;
+
+/* This transaction changed a source */
+static bool changed_in_xact = false;
+static bool xact_callback_registered = false;
+
+static shmem_request_hook_type prev_shmem_request_hook = NULL;
+static shmem_startup_hook_type prev_shmem_startup_hook = NULL;
+
+static void
+suppression_shmem_request(void) {
+    if (prev_shmem_request_hook)
+        prev_shmem_request_hook();
+
+    RequestAddinShmemSpace(MAXALIGN(sizeof(SuppressionShared)));
+    RequestNamedLWLockTranche("pg_email_opt_suppression", 1);
+}
+
+static void
+suppression_shmem_startup(void) {
+    bool found;
+
+    if (prev_shmem_startup_hook)
+        prev_shmem_startup_hook();
+
+    LWLockAcquire(AddinShmemInitLock, LW_EXCLUSIVE);
+
+    shared = ShmemInitStruct("pg_email_opt suppression cache", sizeof(SuppressionShared), &found);
+    if (!found) {
+        shared->lock = &(GetNamedLWLockTranche("pg_email_opt_suppression"))->lock;
+        shared->tranche_id = LWLockNewTrancheId();
+        shared->area = DSA_HANDLE_INVALID;
+        shared->databases = InvalidDsaPointer;
+    }
+
+    LWLockRelease(AddinShmemInitLock);
+}
+
+/*
+ * Installs the shared memory hooks; only when preloaded
+ */
+void
+email_suppression_init(void) {
+    if (!process_shared_preload_libraries_in_progress)
+        return;
+
+    prev_shmem_request_hook = shmem_request_hook;
+    shmem_request_hook = suppression_shmem_request;
+    prev_shmem_startup_hook = shmem_startup_hook;
+    shmem_startup_hook = suppression_shmem_startup;
+}
+
+/*
+ * Attaches to the DSA area and finds the state of this database, creating
+ * either on first use
+ */
+static void
+suppression_attach(void) {
+    if (db != NULL)
+        return;
+
+    if (shared == NULL)
+        ereport(ERROR,
+            (errcode(ERRCODE_OBJECT_NOT_IN_PREREQUISITE_STATE),
+                errmsg("email suppression cache is not available"),
+                errhint("Add pg_email_opt to shared_preload_libraries.")));
+
+    LWLockRegisterTranche(shared->tranche_id, "pg_email_opt_suppression_area");
+    suppression_params.tranche_id = shared->tranche_id;
+
+    LWLockAcquire(shared->lock, LW_EXCLUSIVE);
+
+    if (area == NULL) {
+        /* Attachments live as long as the backend */
+        const MemoryContext oldcontext = MemoryContextSwitchTo(TopMemoryContext);
+
+        if (shared->area == DSA_HANDLE_INVALID) {
+            area = dsa_create(shared->tranche_id);
+            dsa_pin(area);
+            shared->area = dsa_get_handle(area);
+        } else {
+            area = dsa_attach(shared->area);
+        }
+        dsa_pin_mapping(area);
+
+        MemoryContextSwitchTo(oldcontext);
+    }
+
+    dsa_pointer p = shared->databases;
+    while (DsaPointerIsValid(p)) {
+        SuppressionDatabase *candidate = dsa_get_address(area, p);
+
+        if (candidate->dboid == MyDatabaseId) {
+            db = candidate;
+            break;
+        }
+        p = candidate->next;
+    }
+
+    if (db == NULL) {
+        p = dsa_allocate(area, sizeof(SuppressionDatabase));
+        db = dsa_get_address(area, p);
+        db->dboid = MyDatabaseId;
+        db->next = shared->databases;
+        db->table = DSHASH_HANDLE_INVALID;
+        db->source_ids = InvalidDsaPointer;
+        db->nsources = 0;
+        db->loaded_generation = 0;
+        db->building = false;
+        db->building_table = DSHASH_HANDLE_INVALID;
+        pg_atomic_init_u64(&db->generation, 1);
+        shared->databases = p;
+    }
+
+    LWLockRelease(shared->lock);
+}
+
+/*
+ * Frees the canonical bytes of every entry, then the table
+ */
+static void
+suppression_destroy_table(dshash_table *t) {
+    dshash_seq_status status;
+    SuppressionEntry *entry;
+
+    dshash_seq_init(&status, t, true);
+    while ((entry = dshash_seq_next(&status)) != NULL)
+        dsa_free(area, entry->canon);
+    dshash_seq_term(&status);
+
+    dshash_destroy(t);
+}
+
+/*
+ * Canonical "local@domain" of a decoded address; returns its length
+ */
+static size_t
+suppression_canonical(const EmailAddrView *view, char *buf) {
+    memcpy(buf, view->canon_local, view->canon_local_len);
+    buf[view->canon_local_len] = '@';
+    memcpy(buf + view->canon_local_len + 1, view->canon_domain, view->canon_domain_len);
+
+    return view->canon_local_len + 1 + view->canon_domain_len;
+}
+
+static void
+suppression_insert(dshash_table *t, const EMAIL_ADDR *email) {
+    char canon[EMAIL_MAX_LOCAL_LENGTH + 1 + EMAIL_MAX_DOMAIN_LENGTH];
+    EmailFingerprint fp;
+    EmailAddrView view;
+    bool found;
+
+    email_addr_unpack(email, &view);
+    email_addr_view_fingerprint(&view, false, &fp);
+    const size_t len = suppression_canonical(&view, canon);
+
+    /* Allocated before taking the partition lock, which an error would leave held */
+    const dsa_pointer copy = dsa_allocate(area, len);
+    memcpy(dsa_get_address(area, copy), canon, len);
+
+    SuppressionEntry *entry = dshash_find_or_insert(t, &fp, &found);
+    const bool duplicate = found;
+
+    if (!found) {
+        entry->len = len;
+        entry->canon = copy;
+    } else if (entry->len != len || memcmp(dsa_get_address(area, entry->canon), canon, len) != 0) {
+        /* Two addresses with one 128-bit fingerprint: keep the first */
+        elog(WARNING, "email address \"%.*s\" not cached: fingerprint collision", (int) len, canon);
+    }
+
+    dshash_release_lock(t, entry);
+
+    if (duplicate)
+        dsa_free(area, copy);
+}
+
+/*
+ * A registered source: the relation, its column and their quoted names
+ */
+typedef struct {
+    SuppressionSourceId id;
+    char *relname;
+    char *column;
+    bool rowsecurity;
+} SuppressionSource;
+
+/*
+ * Reads email_suppression_sources through SPI, which must be connected.
+ * Returns the number of sources, *nspname is the extension's schema.
+ */
+static int
+suppression_read_sources(SuppressionSource **sources, const char **nspname) {
+    const Oid ext_oid = get_extension_oid("pg_email_opt", false);
+
+    *nspname = get_namespace_name(get_extension_schema(ext_oid));
+
+    /* A dropped source takes its trigger along; skip its row */
+    char *query = psprintf("SELECT s.source::pg_catalog.oid, s.source::pg_catalog.text, s.email_column, "
+                           "c.relrowsecurity "
+                           "FROM %s s JOIN pg_catalog.pg_class c ON c.oid = s.source",
+                           quote_qualified_identifier(*nspname, "email_suppression_sources"));
+
+    if (SPI_execute(query, true, 0) != SPI_OK_SELECT)
+        elog(ERROR, "could not read email_suppression_sources");
+
+    const int nsources = (int) SPI_processed;
+
+    *sources = palloc(Max(nsources, 1) * sizeof(SuppressionSource));
+    for (int i = 0; i < nsources; i++) {
+        const HeapTuple tuple = SPI_tuptable->vals[i];
+        const TupleDesc tupdesc = SPI_tuptable->tupdesc;
+        bool isnull;
+
+        const char *column = SPI_getvalue(tuple, tupdesc, 3);
+
+        (*sources)[i].id.relid = DatumGetObjectId(SPI_getbinval(tuple, tupdesc, 1, &isnull));
+        (*sources)[i].id.attnum = get_attnum((*sources)[i].id.relid, column);
+        (*sources)[i].relname = SPI_getvalue(tuple, tupdesc, 2);
+        (*sources)[i].column = pstrdup(quote_identifier(column));
+        (*sources)[i].rowsecurity = DatumGetBool(SPI_getbinval(tuple, tupdesc, 4, &isnull));
+    }
+
+    return nsources;
+}
+
+static void
+suppression_check_type(const TupleDesc tupdesc, const Oid email_type, const char *source_query) {
+    if (SPI_gettypeid(tupdesc, 1) != email_type)
+        ereport(ERROR,
+            (errcode(ERRCODE_DATATYPE_MISMATCH),
+                errmsg("suppression source column is not of type email_addr"),
+                errdetail("Source query was: %s", source_query)));
+}
+
+/*
+ * Loads every registered source into a new table. *source_ids gets the
+ * SuppressionSourceId of each, allocated in the area.
+ */
+static dshash_table *
+suppression_build(const Oid email_type, dsa_pointer *source_ids, int *nsources_out) {
+    const MemoryContext oldcontext = MemoryContextSwitchTo(TopMemoryContext);
+    dshash_table *t = dshash_create(area, &suppression_params, NULL);
+    SuppressionSource *sources;
+    const char *nspname;
+
+    MemoryContextSwitchTo(oldcontext);
+
+    /*
+     * Freed by the next builder if this one fails: an error can leave
+     * partition locks held until the transaction aborts
+     */
+    db->building_table = dshash_get_hash_table_handle(t);
+
+    if (SPI_connect() != SPI_OK_CONNECT)
+        elog(ERROR, "SPI_connect failed");
+
+    /* The latest committed state, whatever the isolation level */
+    PushActiveSnapshot(GetLatestSnapshot());
+
+    const int nsources = suppression_read_sources(&sources, &nspname);
+
+    for (int i = 0; i < nsources; i++) {
+        char *source_query = psprintf("SELECT %s FROM %s", sources[i].column, sources[i].relname);
+
+        /* The rows its builder may see are not the rows everyone may see */
+        if (sources[i].rowsecurity)
+            ereport(ERROR,
+                (errcode(ERRCODE_OBJECT_NOT_IN_PREREQUISITE_STATE),
+                    errmsg("suppression source %s has row-level security enabled", sources[i].relname),
+                    errhint("Disable row-level security on the table or unregister it.")));
+
+        Portal portal = SPI_cursor_open_with_args(NULL, source_query, 0, NULL, NULL, NULL, true, 0);
+
+        for (;;) {
+            SPI_cursor_fetch(portal, true, SUPPRESSION_FETCH_SIZE);
+            if (SPI_processed == 0)
+                break;
+
+            suppression_check_type(SPI_tuptable->tupdesc, email_type, source_query);
+
+            for (uint64 j = 0; j < SPI_processed; j++) {
+                bool isnull;
+                const Datum value = SPI_getbinval(SPI_tuptable->vals[j], SPI_tuptable->tupdesc, 1, &isnull);
+
+                if (isnull)
+                    continue;
+
+                EMAIL_ADDR *email = DatumGetEmailAddrP(value);
+                suppression_insert(t, email);
+                if (email != (EMAIL_ADDR *) DatumGetPointer(value))
+                    pfree(email);
+
+                CHECK_FOR_INTERRUPTS();
+            }
+
+            SPI_freetuptable(SPI_tuptable);
+        }
+
+        SPI_cursor_close(portal);
+    }
+
+    *source_ids = dsa_allocate(area, Max(nsources, 1) * sizeof(SuppressionSourceId));
+    *nsources_out = nsources;
+    for (int i = 0; i < nsources; i++)
+        ((SuppressionSourceId *) dsa_get_address(area, *source_ids))[i] = sources[i].id;
+
+    PopActiveSnapshot();
+    SPI_finish();
+
+    return t;
+}
+
+/*
+ * Looks the address up in the sources themselves, as the current
+ * transaction sees them
+ */
+static bool
+suppression_lookup_direct(const Datum email, const Oid email_type) {
+    SuppressionSource *sources;
+    const char *nspname;
+    bool result = false;
+
+    if (SPI_connect() != SPI_OK_CONNECT)
+        elog(ERROR, "SPI_connect failed");
+
+    const int nsources = suppression_read_sources(&sources, &nspname);
+
+    for (int i = 0; i < nsources && !result; i++) {
+        char *source_query = psprintf("SELECT %s FROM %s WHERE %s OPERATOR(%s.=) $1 LIMIT 1",
+                                      sources[i].column, sources[i].relname, sources[i].column,
+                                      quote_identifier(nspname));
+        Oid argtype = email_type;
+        Datum value = email;
+
+        if (SPI_execute_with_args(source_query, 1, &argtype, &value, NULL, true, 1) != SPI_OK_SELECT)
+            elog(ERROR, "could not query suppression source %s", sources[i].relname);
+
+        suppression_check_type(SPI_tuptable->tupdesc, email_type, source_query);
+        result = SPI_processed > 0;
+    }
+
+    SPI_finish();
+
+    return result;
+}
+
+/*
+ * Gives up the builder role
+ */
+static void
+suppression_end_build(void) {
+    LWLockAcquire(shared->lock, LW_EXCLUSIVE);
+    db->building = false;
+    LWLockRelease(shared->lock);
+    building_here = false;
+}
+
+/*
+ * A builder that exits, FATAL included, must leave the role to others
+ */
+static void
+suppression_shmem_exit(int code, Datum arg) {
+    if (building_here)
+        suppression_end_build();
+}
+
+/*
+ * Rebuilds the table for the current generation, as the only builder
+ */
+static void
+suppression_rebuild(const Oid email_type) {
+    const uint64 generation = pg_atomic_read_u64(&db->generation);
+    dsa_pointer source_ids;
+    int nsources;
+    dshash_table *t;
+
+    if (db->building_table != DSHASH_HANDLE_INVALID) {
+        suppression_destroy_table(dshash_attach(area, &suppression_params, db->building_table, NULL));
+        db->building_table = DSHASH_HANDLE_INVALID;
+    }
+
+    PG_TRY();
+    {
+        t = suppression_build(email_type, &source_ids, &nsources);
+    }
+    PG_CATCH();
+    {
+        suppression_end_build();
+        PG_RE_THROW();
+    }
+    PG_END_TRY();
+
+    LWLockAcquire(shared->lock, LW_EXCLUSIVE);
+    const dshash_table_handle old = db->table;
+    const dsa_pointer old_source_ids = db->source_ids;
+    db->table = dshash_get_hash_table_handle(t);
+    db->source_ids = source_ids;
+    db->nsources = nsources;
+    db->loaded_generation = generation;
+    db->building_table = DSHASH_HANDLE_INVALID;
+    db->building = false;
+    LWLockRelease(shared->lock);
+    building_here = false;
+
+    /* Lookups take the lock, so nobody reads the old table any more */
+    if (table != NULL)
+        dshash_detach(table);
+    table = t;
+    table_handle = db->table;
+
+    if (old != DSHASH_HANDLE_INVALID)
+        suppression_destroy_table(dshash_attach(area, &suppression_params, old, NULL));
+    if (DsaPointerIsValid(old_source_ids))
+        dsa_free(area, old_source_ids);
+}
+
+/*
+ * Errors out unless the current role may read every source column, like
+ * a query on the sources would. Returns true if row-level security, only
+ * enabled since the table was built, applies to the role on a source.
+ */
+static bool
+suppression_check_privileges(const SuppressionSourceId *ids, const int nsources) {
+    const Oid userid = GetUserId();
+    bool rowsecurity = false;
+
+    for (int i = 0; i < nsources; i++) {
+        bool is_missing = false;
+
+        if (check_enable_rls(ids[i].relid, InvalidOid, true) == RLS_ENABLED)
+            rowsecurity = true;
+
+        /* A source dropped since the table was built has nothing to protect */
+        if (pg_class_aclcheck_ext(ids[i].relid, userid, ACL_SELECT, &is_missing) == ACLCHECK_OK || is_missing)
+            continue;
+        if (pg_attribute_aclcheck_ext(ids[i].relid, ids[i].attnum, userid, ACL_SELECT, &is_missing) ==
+            ACLCHECK_OK || is_missing)
+            continue;
+
+        aclcheck_error(ACLCHECK_NO_PRIV, OBJECT_TABLE, get_rel_name(ids[i].relid));
+    }
+
+    return rowsecurity;
+}
+
+/*
+ * Is the address in one of the registered sources?
+ */
+PG_FUNCTION_INFO_V1(email_is_suppressed);
+
+Datum
+email_is_suppressed(PG_FUNCTION_ARGS) {
+    EMAIL_ADDR *email = PG_GETARG_EMAIL_ADDR_PP(0);
+    char canon[EMAIL_MAX_LOCAL_LENGTH + 1 + EMAIL_MAX_DOMAIN_LENGTH];
+    EmailFingerprint fp;
+    EmailAddrView view;
+    SuppressionSourceId *unchecked = NULL;
+    int nunchecked = 0;
+    uint64 unchecked_generation = 0;
+    bool cached = false;
+    bool result = false;
+
+    if (fcinfo->flinfo->fn_extra == NULL)
+        fcinfo->flinfo->fn_extra = MemoryContextAllocZero(fcinfo->flinfo->fn_mcxt, sizeof(SuppressionChecked));
+
+    SuppressionChecked *checked = fcinfo->flinfo->fn_extra;
+
+    suppression_attach();
+
+    /* The cache has none of this transaction's changes, and must not get them */
+    if (changed_in_xact) {
+        result = suppression_lookup_direct(PointerGetDatum(email), get_fn_expr_argtype(fcinfo->flinfo, 0));
+        PG_FREE_IF_COPY(email, 0);
+        PG_RETURN_BOOL(result);
+    }
+
+    email_addr_unpack(email, &view);
+    email_addr_view_fingerprint(&view, false, &fp);
+    const size_t len = suppression_canonical(&view, canon);
+
+    for (;;) {
+        const uint64 generation = pg_atomic_read_u64(&db->generation);
+        bool build = false;
+
+        LWLockAcquire(shared->lock, LW_SHARED);
+
+        if (db->table != DSHASH_HANDLE_INVALID && db->loaded_generation == generation) {
+            if (table_handle != db->table) {
+                if (table != NULL)
+                    dshash_detach(table);
+                const MemoryContext oldcontext = MemoryContextSwitchTo(TopMemoryContext);
+
+                table = dshash_attach(area, &suppression_params, db->table, NULL);
+                MemoryContextSwitchTo(oldcontext);
+                table_handle = db->table;
+            }
+
+            SuppressionEntry *entry = dshash_find(table, &fp, false);
+            if (entry != NULL) {
+                result = entry->len == len &&
+                         memcmp(dsa_get_address(area, entry->canon), canon, len) == 0;
+                dshash_release_lock(table, entry);
+            }
+            cached = true;
+
+            /* Copied out: the checks read the catalogs, not under the lock */
+            if (checked->generation != db->loaded_generation || checked->userid != GetUserId()) {
+                nunchecked = db->nsources;
+                unchecked = palloc(Max(nunchecked, 1) * sizeof(SuppressionSourceId));
+                memcpy(unchecked, dsa_get_address(area, db->source_ids),
+                       nunchecked * sizeof(SuppressionSourceId));
+                unchecked_generation = db->loaded_generation;
+            }
+
+            LWLockRelease(shared->lock);
+            break;
+        }
+
+        LWLockRelease(shared->lock);
+
+        /* Stale or never loaded: rebuild, unless another backend does */
+        if (!exit_callback_registered) {
+            before_shmem_exit(suppression_shmem_exit, 0);
+            exit_callback_registered = true;
+        }
+
+        LWLockAcquire(shared->lock, LW_EXCLUSIVE);
+        if (!db->building) {
+            db->building = true;
+            building_here = true;
+            build = true;
+        }
+        LWLockRelease(shared->lock);
+
+        if (build) {
+            suppression_rebuild(get_fn_expr_argtype(fcinfo->flinfo, 0));
+            continue;
+        }
+
+        result = suppression_lookup_direct(PointerGetDatum(email), get_fn_expr_argtype(fcinfo->flinfo, 0));
+        break;
+    }
+
+    if (unchecked != NULL) {
+        checked->direct = suppression_check_privileges(unchecked, nunchecked);
+        checked->generation = unchecked_generation;
+        checked->userid = GetUserId();
+        pfree(unchecked);
+    }
+
+    if (cached && checked->direct)
+        result = suppression_lookup_direct(PointerGetDatum(email), get_fn_expr_argtype(fcinfo->flinfo, 0));
+
+    PG_FREE_IF_COPY(email, 0);
+
+    PG_RETURN_BOOL(result);
+}
+
+/*
+ * Bumps the generation once a transaction that changed a source commits,
+ * when its changes are visible
+ */
+static void
+suppression_xact_callback(XactEvent event, void *arg) {
+    switch (event) {
+        case XACT_EVENT_COMMIT:
+        case XACT_EVENT_PARALLEL_COMMIT:
+            if (changed_in_xact && db != NULL)
+                pg_atomic_fetch_add_u64(&db->generation, 1);
+            changed_in_xact = false;
+            break;
+        case XACT_EVENT_ABORT:
+        case XACT_EVENT_PARALLEL_ABORT:
+        case XACT_EVENT_PREPARE:
+            changed_in_xact = false;
+            break;
+        default:
+            break;
+    }
+}
+
+static void
+suppression_mark_changed(void) {
+    /* Without the preload there is no cache to invalidate */
+    if (shared != NULL)
+        suppression_attach();
+
+    if (!xact_callback_registered) {
+        RegisterXactCallback(suppression_xact_callback, NULL);
+        xact_callback_registered = true;
+    }
+
+    changed_in_xact = true;
+}
+
+/*
+ * Statement trigger on every registered source
+ */
+PG_FUNCTION_INFO_V1(email_suppression_invalidate);
+
+Datum
+email_suppression_invalidate(PG_FUNCTION_ARGS) {
+    if (!CALLED_AS_TRIGGER(fcinfo))
+        ereport(ERROR,
+            (errcode(ERRCODE_E_R_I_E_TRIGGER_PROTOCOL_VIOLATED),
+                errmsg("email_suppression_invalidate: not called by trigger manager")));
+
+    suppression_mark_changed();
+
+    PG_RETURN_POINTER(NULL);
+}
+
+/*
+ * Marks the cache stale at commit; used when sources are (un)registered
+ */
+PG_FUNCTION_INFO_V1(email_suppression_changed);
+
+Datum
+email_suppression_changed(PG_FUNCTION_ARGS) {
+    suppression_mark_changed();
+
+    PG_RETURN_VOID();
+}
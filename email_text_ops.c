@@ -0,0 +1,437 @@
+//
+// Comparison of email_addr with addresses in text form.
+//
+// The text operand is parsed in place and compared through a view, so
+// nothing is allocated per comparison. When the text operand is a
+// constant, the planner support function replaces the call with the
+// email_addr operator and a constant email_addr. The text is then
+// parsed once, and the email_addr operator classes (SP-GiST, BRIN) apply
+// as well.
+//
+
+#include "postgres.h"
+
+#include "access/stratnum.h"
+#include "catalog/pg_am.h"
+#include "catalog/pg_type.h"
+#include "commands/defrem.h"
+#include "nodes/makefuncs.h"
+#include "nodes/miscnodes.h"
+#include "nodes/nodeFuncs.h"
+#include "nodes/supportnodes.h"
+#include "utils/builtins.h"
+#include "utils/lsyscache.h"
+
+#include "pg_email_opt.h"
+
+/*
+ * Compares an address with the text form of another
+ */
+static int
+email_addr_text_cmp_internal(const EMAIL_ADDR *addr, const text *txt) {
+    EmailAddrView view1;
+    EmailAddrView view2;
+
+    email_addr_unpack(addr, &view1);
+    email_addr_view_from_string(VARDATA_ANY(txt), VARSIZE_ANY_EXHDR(txt), &view2);
+
+    const int result = email_addr_view_cmp(&view1, &view2);
+
+    return result;
+}
+
+/*
+ * Comparison of email_addr and text
+ */
+PG_FUNCTION_INFO_V1(email_addr_text_cmp);
+
+Datum
+email_addr_text_cmp(PG_FUNCTION_ARGS) {
+    EMAIL_ADDR *addr = PG_GETARG_EMAIL_ADDR_PP(0);
+    text *txt = PG_GETARG_TEXT_PP(1);
+
+    const int cmp = email_addr_text_cmp_internal(addr, txt);
+
+    PG_FREE_IF_COPY(addr, 0);
+    PG_FREE_IF_COPY(txt, 1);
+
+    PG_RETURN_INT32(cmp);
+}
+
+/*
+ * Equality of email_addr and text
+ */
+PG_FUNCTION_INFO_V1(email_addr_text_eq);
+
+Datum
+email_addr_text_eq(PG_FUNCTION_ARGS) {
+    EMAIL_ADDR *addr = PG_GETARG_EMAIL_ADDR_PP(0);
+    text *txt = PG_GETARG_TEXT_PP(1);
+    int cmp;
+
+    EMAIL_STATS_COMPARISON(cmp, email_addr_text_cmp_internal(addr, txt));
+
+    PG_FREE_IF_COPY(addr, 0);
+    PG_FREE_IF_COPY(txt, 1);
+
+    PG_RETURN_BOOL(cmp == 0);
+}
+
+/*
+ * Inequality of email_addr and text
+ */
+PG_FUNCTION_INFO_V1(email_addr_text_ne);
+
+Datum
+email_addr_text_ne(PG_FUNCTION_ARGS) {
+    EMAIL_ADDR *addr = PG_GETARG_EMAIL_ADDR_PP(0);
+    text *txt = PG_GETARG_TEXT_PP(1);
+    int cmp;
+
+    EMAIL_STATS_COMPARISON(cmp, email_addr_text_cmp_internal(addr, txt));
+
+    PG_FREE_IF_COPY(addr, 0);
+    PG_FREE_IF_COPY(txt, 1);
+
+    PG_RETURN_BOOL(cmp != 0);
+}
+
+/*
+ * Less than of email_addr and text
+ */
+PG_FUNCTION_INFO_V1(email_addr_text_lt);
+
+Datum
+email_addr_text_lt(PG_FUNCTION_ARGS) {
+    EMAIL_ADDR *addr = PG_GETARG_EMAIL_ADDR_PP(0);
+    text *txt = PG_GETARG_TEXT_PP(1);
+    int cmp;
+
+    EMAIL_STATS_COMPARISON(cmp, email_addr_text_cmp_internal(addr, txt));
+
+    PG_FREE_IF_COPY(addr, 0);
+    PG_FREE_IF_COPY(txt, 1);
+
+    PG_RETURN_BOOL(cmp < 0);
+}
+
+/*
+ * Less than or equal of email_addr and text
+ */
+PG_FUNCTION_INFO_V1(email_addr_text_le);
+
+Datum
+email_addr_text_le(PG_FUNCTION_ARGS) {
+    EMAIL_ADDR *addr = PG_GETARG_EMAIL_ADDR_PP(0);
+    text *txt = PG_GETARG_TEXT_PP(1);
+    int cmp;
+
+    EMAIL_STATS_COMPARISON(cmp, email_addr_text_cmp_internal(addr, txt));
+
+    PG_FREE_IF_COPY(addr, 0);
+    PG_FREE_IF_COPY(txt, 1);
+
+    PG_RETURN_BOOL(cmp <= 0);
+}
+
+/*
+ * Greater than of email_addr and text
+ */
+PG_FUNCTION_INFO_V1(email_addr_text_gt);
+
+Datum
+email_addr_text_gt(PG_FUNCTION_ARGS) {
+    EMAIL_ADDR *addr = PG_GETARG_EMAIL_ADDR_PP(0);
+    text *txt = PG_GETARG_TEXT_PP(1);
+    int cmp;
+
+    EMAIL_STATS_COMPARISON(cmp, email_addr_text_cmp_internal(addr, txt));
+
+    PG_FREE_IF_COPY(addr, 0);
+    PG_FREE_IF_COPY(txt, 1);
+
+    PG_RETURN_BOOL(cmp > 0);
+}
+
+/*
+ * Greater than or equal of email_addr and text
+ */
+PG_FUNCTION_INFO_V1(email_addr_text_ge);
+
+Datum
+email_addr_text_ge(PG_FUNCTION_ARGS) {
+    EMAIL_ADDR *addr = PG_GETARG_EMAIL_ADDR_PP(0);
+    text *txt = PG_GETARG_TEXT_PP(1);
+    int cmp;
+
+    EMAIL_STATS_COMPARISON(cmp, email_addr_text_cmp_internal(addr, txt));
+
+    PG_FREE_IF_COPY(addr, 0);
+    PG_FREE_IF_COPY(txt, 1);
+
+    PG_RETURN_BOOL(cmp >= 0);
+}
+
+/*
+ * Comparison of text and email_addr
+ */
+PG_FUNCTION_INFO_V1(text_email_addr_cmp);
+
+Datum
+text_email_addr_cmp(PG_FUNCTION_ARGS) {
+    text *txt = PG_GETARG_TEXT_PP(0);
+    EMAIL_ADDR *addr = PG_GETARG_EMAIL_ADDR_PP(1);
+
+    const int cmp = email_addr_text_cmp_internal(addr, txt);
+
+    PG_FREE_IF_COPY(txt, 0);
+    PG_FREE_IF_COPY(addr, 1);
+
+    PG_RETURN_INT32(cmp > 0 ? -1 : (cmp < 0 ? 1 : 0));
+}
+
+/*
+ * Equality of text and email_addr
+ */
+PG_FUNCTION_INFO_V1(text_email_addr_eq);
+
+Datum
+text_email_addr_eq(PG_FUNCTION_ARGS) {
+    text *txt = PG_GETARG_TEXT_PP(0);
+    EMAIL_ADDR *addr = PG_GETARG_EMAIL_ADDR_PP(1);
+    int cmp;
+
+    EMAIL_STATS_COMPARISON(cmp, email_addr_text_cmp_internal(addr, txt));
+
+    PG_FREE_IF_COPY(txt, 0);
+    PG_FREE_IF_COPY(addr, 1);
+
+    PG_RETURN_BOOL(cmp == 0);
+}
+
+/*
+ * Inequality of text and email_addr
+ */
+PG_FUNCTION_INFO_V1(text_email_addr_ne);
+
+Datum
+text_email_addr_ne(PG_FUNCTION_ARGS) {
+    text *txt = PG_GETARG_TEXT_PP(0);
+    EMAIL_ADDR *addr = PG_GETARG_EMAIL_ADDR_PP(1);
+    int cmp;
+
+    EMAIL_STATS_COMPARISON(cmp, email_addr_text_cmp_internal(addr, txt));
+
+    PG_FREE_IF_COPY(txt, 0);
+    PG_FREE_IF_COPY(addr, 1);
+
+    PG_RETURN_BOOL(cmp != 0);
+}
+
+/*
+ * Less than of text and email_addr
+ */
+PG_FUNCTION_INFO_V1(text_email_addr_lt);
+
+Datum
+text_email_addr_lt(PG_FUNCTION_ARGS) {
+    text *txt = PG_GETARG_TEXT_PP(0);
+    EMAIL_ADDR *addr = PG_GETARG_EMAIL_ADDR_PP(1);
+    int cmp;
+
+    EMAIL_STATS_COMPARISON(cmp, email_addr_text_cmp_internal(addr, txt));
+
+    PG_FREE_IF_COPY(txt, 0);
+    PG_FREE_IF_COPY(addr, 1);
+
+    PG_RETURN_BOOL(cmp > 0);
+}
+
+/*
+ * Less than or equal of text and email_addr
+ */
+PG_FUNCTION_INFO_V1(text_email_addr_le);
+
+Datum
+text_email_addr_le(PG_FUNCTION_ARGS) {
+    text *txt = PG_GETARG_TEXT_PP(0);
+    EMAIL_ADDR *addr = PG_GETARG_EMAIL_ADDR_PP(1);
+    int cmp;
+
+    EMAIL_STATS_COMPARISON(cmp, email_addr_text_cmp_internal(addr, txt));
+
+    PG_FREE_IF_COPY(txt, 0);
+    PG_FREE_IF_COPY(addr, 1);
+
+    PG_RETURN_BOOL(cmp >= 0);
+}
+
+/*
+ * Greater than of text and email_addr
+ */
+PG_FUNCTION_INFO_V1(text_email_addr_gt);
+
+Datum
+text_email_addr_gt(PG_FUNCTION_ARGS) {
+    text *txt = PG_GETARG_TEXT_PP(0);
+    EMAIL_ADDR *addr = PG_GETARG_EMAIL_ADDR_PP(1);
+    int cmp;
+
+    EMAIL_STATS_COMPARISON(cmp, email_addr_text_cmp_internal(addr, txt));
+
+    PG_FREE_IF_COPY(txt, 0);
+    PG_FREE_IF_COPY(addr, 1);
+
+    PG_RETURN_BOOL(cmp < 0);
+}
+
+/*
+ * Greater than or equal of text and email_addr
+ */
+PG_FUNCTION_INFO_V1(text_email_addr_ge);
+
+Datum
+text_email_addr_ge(PG_FUNCTION_ARGS) {
+    text *txt = PG_GETARG_TEXT_PP(0);
+    EMAIL_ADDR *addr = PG_GETARG_EMAIL_ADDR_PP(1);
+    int cmp;
+
+    EMAIL_STATS_COMPARISON(cmp, email_addr_text_cmp_internal(addr, txt));
+
+    PG_FREE_IF_COPY(txt, 0);
+    PG_FREE_IF_COPY(addr, 1);
+
+    PG_RETURN_BOOL(cmp <= 0);
+}
+
+/*
+ * Hash of the text form of an address, equal to email_hash of the same
+ * address, for hash joins between email_addr and text
+ */
+PG_FUNCTION_INFO_V1(email_text_hash);
+
+Datum
+email_text_hash(PG_FUNCTION_ARGS) {
+    text *txt = PG_GETARG_TEXT_PP(0);
+    EmailAddrView view;
+
+    email_addr_view_from_string(VARDATA_ANY(txt), VARSIZE_ANY_EXHDR(txt), &view);
+
+    const uint32 hash = email_addr_view_hash(&view);
+
+    PG_FREE_IF_COPY(txt, 0);
+
+    PG_RETURN_UINT32(hash);
+}
+
+/*
+ * Seeded 64-bit variant of email_text_hash
+ */
+PG_FUNCTION_INFO_V1(email_text_hash_extended);
+
+Datum
+email_text_hash_extended(PG_FUNCTION_ARGS) {
+    text *txt = PG_GETARG_TEXT_PP(0);
+    const uint64 seed = PG_GETARG_INT64(1);
+    EmailAddrView view;
+
+    email_addr_view_from_string(VARDATA_ANY(txt), VARSIZE_ANY_EXHDR(txt), &view);
+
+    const uint64 hash = email_addr_view_hash_extended(&view, seed);
+
+    PG_FREE_IF_COPY(txt, 0);
+
+    PG_RETURN_INT64(hash);
+}
+
+/* Cross-type functions and the email_addr operator each one becomes */
+static const struct {
+    const char *name;
+    StrategyNumber strategy;    /* InvalidStrategy for <> */
+    int text_arg;
+} email_text_funcs[] = {
+    {"email_addr_text_eq", BTEqualStrategyNumber, 1},
+    {"email_addr_text_ne", InvalidStrategy, 1},
+    {"email_addr_text_lt", BTLessStrategyNumber, 1},
+    {"email_addr_text_le", BTLessEqualStrategyNumber, 1},
+    {"email_addr_text_gt", BTGreaterStrategyNumber, 1},
+    {"email_addr_text_ge", BTGreaterEqualStrategyNumber, 1},
+    {"text_email_addr_eq", BTEqualStrategyNumber, 0},
+    {"text_email_addr_ne", InvalidStrategy, 0},
+    {"text_email_addr_lt", BTLessStrategyNumber, 0},
+    {"text_email_addr_le", BTLessEqualStrategyNumber, 0},
+    {"text_email_addr_gt", BTGreaterStrategyNumber, 0},
+    {"text_email_addr_ge", BTGreaterEqualStrategyNumber, 0},
+};
+
+/*
+ * Planner support for the cross-type operators: with a constant text
+ * operand that is a valid address, "email op 'text'" becomes
+ * "email op 'text'::email_addr" with the email_addr operator.
+ * Invalid constants are left alone to fail at execution, as before.
+ */
+PG_FUNCTION_INFO_V1(email_addr_text_support);
+
+Datum
+email_addr_text_support(PG_FUNCTION_ARGS) {
+    Node *rawreq = (Node *) PG_GETARG_POINTER(0);
+
+    if (!IsA(rawreq, SupportRequestSimplify))
+        PG_RETURN_POINTER(NULL);
+
+    const FuncExpr *expr = ((SupportRequestSimplify *) rawreq)->fcall;
+    const char *name = get_func_name(expr->funcid);
+    int i;
+
+    if (name == NULL || list_length(expr->args) != 2)
+        PG_RETURN_POINTER(NULL);
+
+    for (i = 0; i < lengthof(email_text_funcs); i++) {
+        if (strcmp(name, email_text_funcs[i].name) == 0)
+            break;
+    }
+
+    /* The name only picks the entry; the OID must be the extension's */
+    if (i == lengthof(email_text_funcs) ||
+        !email_support_is_function(fcinfo, expr, email_text_funcs[i].name))
+        PG_RETURN_POINTER(NULL);
+
+    const int text_arg = email_text_funcs[i].text_arg;
+    Node *email_arg = list_nth(expr->args, 1 - text_arg);
+    const Node *text_node = list_nth(expr->args, text_arg);
+
+    if (!IsA(text_node, Const) || ((const Const *) text_node)->constisnull)
+        PG_RETURN_POINTER(NULL);
+
+    /* Parse the constant once; keep the call if it is invalid */
+    const text *txt = DatumGetTextPP(((const Const *) text_node)->constvalue);
+    ErrorSaveContext escontext = {T_ErrorSaveContext};
+    EMAIL_ADDR *addr = email_addr_from_string(VARDATA_ANY(txt), VARSIZE_ANY_EXHDR(txt), -1,
+                                              (Node *) &escontext);
+
+    if (addr == NULL)
+        PG_RETURN_POINTER(NULL);
+
+    /* The operator of the default btree class, or the negator of its = */
+    const Oid typid = exprType(email_arg);
+    const Oid opclass = GetDefaultOpClass(typid, BTREE_AM_OID);
+
+    if (!OidIsValid(opclass))
+        PG_RETURN_POINTER(NULL);
+
+    const Oid opfamily = get_opclass_family(opclass);
+    const StrategyNumber strategy = email_text_funcs[i].strategy;
+    Oid opno = get_opfamily_member(opfamily, typid, typid,
+                                   strategy == InvalidStrategy ? BTEqualStrategyNumber : strategy);
+
+    if (OidIsValid(opno) && strategy == InvalidStrategy)
+        opno = get_negator(opno);
+    if (!OidIsValid(opno))
+        PG_RETURN_POINTER(NULL);
+
+    Const *value = makeConst(typid, -1, InvalidOid, -1, PointerGetDatum(addr), false, false);
+    Expr *left = text_arg == 0 ? (Expr *) value : (Expr *) email_arg;
+    Expr *right = text_arg == 0 ? (Expr *) email_arg : (Expr *) value;
+
+    PG_RETURN_POINTER(make_opclause(opno, BOOLOID, false, left, right, InvalidOid, InvalidOid));
+}
@@ -4,17 +4,70 @@
 
 #include "common.h"
 
+/*
+ * Character class table, see the EMAIL_CHAR_* bits
+ */
+const uint8_t email_char_class[256] = {
+    /* 0x00 */ 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
+    /* 0x10 */ 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
+    /* 0x20 */ 0x06, 0x07, 0x04, 0x07, 0x07, 0x07, 0x07, 0x07, 0x06, 0x06, 0x07, 0x07, 0x06, 0x0f, 0x06, 0x07,
+    /* 0x30 */ 0x3f, 0x3f, 0x3f, 0x3f, 0x3f, 0x3f, 0x3f, 0x3f, 0x3f, 0x3f, 0x06, 0x06, 0x06, 0x07, 0x06, 0x07,
+    /* 0x40 */ 0x06, 0x6f, 0x6f, 0x6f, 0x6f, 0x6f, 0x6f, 0x4f, 0x4f, 0x4f, 0x4f, 0x4f, 0x4f, 0x4f, 0x4f, 0x4f,
+    /* 0x50 */ 0x4f, 0x4f, 0x4f, 0x4f, 0x4f, 0x4f, 0x4f, 0x4f, 0x4f, 0x4f, 0x4f, 0x06, 0x04, 0x06, 0x07, 0x07,
+    /* 0x60 */ 0x07, 0x2f, 0x2f, 0x2f, 0x2f, 0x2f, 0x2f, 0x0f, 0x0f, 0x0f, 0x0f, 0x0f, 0x0f, 0x0f, 0x0f, 0x0f,
+    /* 0x70 */ 0x0f, 0x0f, 0x0f, 0x0f, 0x0f, 0x0f, 0x0f, 0x0f, 0x0f, 0x0f, 0x0f, 0x07, 0x07, 0x07, 0x07, 0x00,
+    /* 0x80 */ 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
+    /* 0x90 */ 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
+    /* 0xa0 */ 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
+    /* 0xb0 */ 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
+    /* 0xc0 */ 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
+    /* 0xd0 */ 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
+    /* 0xe0 */ 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
+    /* 0xf0 */ 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
+};
+
 /*
  * Helper function to compare two strings case-insensitively,
- * with length limits for each string
+ * with length limits for each string. Only ASCII letters are folded,
+ * which is all a valid domain can hold.
  */
 int
 bounded_strcasecmp(const char *s1, const size_t len1,
                    const char *s2, const size_t len2) {
-    const size_t min_len = Min(len1, len2);
-    const int cmp = pg_strncasecmp(s1, s2, min_len);
+    const size_t min_len = len1 < len2 ? len1 : len2;
+
+    for (size_t i = 0; i < min_len; i++) {
+        unsigned char c1 = s1[i];
+        unsigned char c2 = s2[i];
+
+        /* Fold only bytes that differ */
+        if (c1 == c2)
+            continue;
+        if (EMAIL_CHAR_IS(c1, EMAIL_CHAR_UPPER))
+            c1 += 'a' - 'A';
+        if (EMAIL_CHAR_IS(c2, EMAIL_CHAR_UPPER))
+            c2 += 'a' - 'A';
+        if (c1 != c2)
+            return c1 - c2;
+    }
+
+    /* If common prefix matches, longer string is greater */
+    if (len1 < len2)
+        return -1;
+    if (len1 > len2)
+        return 1;
+    return 0;
+}
+
+/*
+ * Helper function to compare two byte strings, with length limits
+ * for each string. A proper prefix sorts first.
+ */
+int
+bounded_memcmp(const char *s1, const size_t len1,
+               const char *s2, const size_t len2) {
+    const int cmp = memcmp(s1, s2, len1 < len2 ? len1 : len2);
     if (cmp == 0) {
-        /* If common prefix matches, longer string is greater */
         if (len1 < len2)
             return -1;
         if (len1 > len2)
@@ -5,8 +5,10 @@
 #ifndef COMMON_H
 #define COMMON_H
 
-#include <c.h>
-#include <port.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <string.h>
 
 /*
  * Helper function to compare two strings case-insensitively,
@@ -15,4 +17,26 @@
 int bounded_strcasecmp(const char *s1, const size_t len1,
                        const char *s2, const size_t len2);
 
+/*
+ * Helper function to compare two byte strings, with length limits
+ * for each string
+ */
+int bounded_memcmp(const char *s1, const size_t len1,
+                   const char *s2, const size_t len2);
+
+/*
+ * Character classes used by the validators, one byte per character
+ */
+#define EMAIL_CHAR_ATEXT  0x01  /* unquoted local-part character, except dot */
+#define EMAIL_CHAR_QTEXT  0x02  /* quoted local-part character */
+#define EMAIL_CHAR_PRINT  0x04  /* printable ASCII */
+#define EMAIL_CHAR_LDH    0x08  /* letter, digit or hyphen */
+#define EMAIL_CHAR_DIGIT  0x10  /* decimal digit */
+#define EMAIL_CHAR_HEX    0x20  /* hexadecimal digit */
+#define EMAIL_CHAR_UPPER  0x40  /* uppercase letter */
+
+extern const uint8_t email_char_class[256];
+
+#define EMAIL_CHAR_IS(c, class) ((email_char_class[(unsigned char) (c)] & (class)) != 0)
+
 #endif //COMMON_H
@@ -3,29 +3,41 @@
 //
 
 #include "domain.h"
+#include "simd.h"
+#include <string.h>
 
 /*
- * Check if character is valid in a domain name (LDH rule)
+ * Check if string is all numeric
  */
 static bool
-is_valid_domain_char(const unsigned char c) {
-    return (c >= 'A' && c <= 'Z') || /* uppercase letters */
-           (c >= 'a' && c <= 'z') || /* lowercase letters */
-           (c >= '0' && c <= '9') || /* digits */
-           c == '-' || /* hyphen */
-           c == '.'; /* dot separator */
+is_all_numeric(const char *str, const size_t len) {
+    for (size_t i = 0; i < len; i++) {
+        if (!EMAIL_CHAR_IS(str[i], EMAIL_CHAR_DIGIT))
+            return false;
+    }
+    return true;
 }
 
 /*
- * Check if string is all numeric
+ * Check a single label of a domain name
  */
 static bool
-is_all_numeric(const char *str) {
-    while (*str) {
-        if (!(*str >= '0' && *str <= '9'))
-            return false;
-        str++;
+validate_label(const char *label, const size_t len, char **error_msg) {
+    if (len == 0) {
+        *error_msg = "empty label in domain name";
+        return false;
     }
+    if (len > MAX_LABEL_LENGTH) {
+        *error_msg = "domain label exceeds maximum length";
+        return false;
+    }
+
+    /* Check if label starts or ends with hyphen */
+    if (label[0] == '-' || label[len - 1] == '-') {
+        *error_msg = "domain label cannot start or end with hyphen";
+        return false;
+    }
+
     return true;
 }
 
@@ -33,75 +45,43 @@ is_all_numeric(const char *str) {
  * Validate a standard domain name
  */
 static bool
-validate_standard_domain(const char *domain, char **error_msg) {
-    const char *p;
-    bool had_dot = false;
-
+validate_standard_domain(const char *domain, const size_t len, char **error_msg) {
     /* Check total length */
-    if (strlen(domain) > MAX_DOMAIN_LENGTH) {
+    if (len > MAX_DOMAIN_LENGTH) {
         *error_msg = "domain name exceeds maximum length";
         return false;
     }
 
-    /* Validate each label */
+    /* Characters up to the first invalid one (LDH rule) */
+    const size_t valid_len = email_span(domain, len, EMAIL_SET_LDH);
+
+    /* Validate each label before it, jumping from dot to dot */
     const char *label_start = domain;
-    size_t label_len = 0;
-    for (p = domain; *p; p++) {
-        if (*p == '.') {
-            /* Check label length */
-            if (label_len == 0) {
-                *error_msg = "empty label in domain name";
-                return false;
-            }
-            if (label_len > MAX_LABEL_LENGTH) {
-                *error_msg = "domain label exceeds maximum length";
-                return false;
-            }
-
-            /* Check if label starts or ends with hyphen */
-            if (label_start[0] == '-' || *(p - 1) == '-') {
-                *error_msg = "domain label cannot start or end with hyphen";
-                return false;
-            }
-
-            /* Reset for next label */
-            label_start = p + 1;
-            label_len = 0;
-            had_dot = true;
-            continue;
-        }
-
-        /* Validate character */
-        if (!is_valid_domain_char(*p)) {
-            *error_msg = "invalid character in domain name";
+    const char *dot;
+    while ((dot = memchr(label_start, '.', domain + valid_len - label_start)) != NULL) {
+        if (!validate_label(label_start, dot - label_start, error_msg))
             return false;
-        }
-
-        label_len++;
+        label_start = dot + 1;
     }
 
-    /* Check final label */
-    if (label_len == 0) {
-        *error_msg = "empty label in domain name";
+    if (valid_len < len) {
+        *error_msg = "invalid character in domain name";
         return false;
     }
-    if (label_len > MAX_LABEL_LENGTH) {
-        *error_msg = "domain label exceeds maximum length";
-        return false;
-    }
-    if (label_start[0] == '-' || *(p - 1) == '-') {
-        *error_msg = "domain label cannot start or end with hyphen";
+
+    /* Check final label */
+    const size_t label_len = domain + len - label_start;
+    if (!validate_label(label_start, label_len, error_msg))
         return false;
-    }
 
     /* Must have at least one dot for a full domain */
-    if (!had_dot) {
+    if (label_start == domain) {
         *error_msg = "domain must contain at least two parts";
         return false;
     }
 
     /* Check if top-level domain is all numeric */
-    if (is_all_numeric(label_start)) {
+    if (is_all_numeric(label_start, label_len)) {
         *error_msg = "top-level domain cannot be all numeric";
         return false;
     }
@@ -113,38 +93,42 @@ validate_standard_domain(const char *domain, char **error_msg) {
  * Main domain validation function
  */
 bool
-validate_email_domain(const char *domain, char **error_msg) {
+validate_email_domain(const char *domain, const size_t len, char **error_msg) {
     if (domain == NULL) {
         *error_msg = "domain cannot be NULL";
         return false;
     }
 
-    if (strlen(domain) == 0) {
+    if (len == 0) {
         *error_msg = "domain cannot be empty";
         return false;
     }
 
     /* Check if it's an IP literal */
     if (domain[0] == '[') {
-        return validate_ip_literal(domain, error_msg);
+        return validate_ip_literal(domain, len, error_msg);
     }
 
     /* Standard domain name validation */
-    return validate_standard_domain(domain, error_msg);
+    return validate_standard_domain(domain, len, error_msg);
 }
 
 /*
- * Helper function to report domain validation errors using ereport
+ * Returns the next label of a valid domain, starting the search at *pos.
+ * IP literals have no labels. Returns false when there are no more.
  */
-void
-check_domain(const char *domain) {
-    char *error_msg = NULL;
-
-    if (!validate_email_domain(domain, &error_msg)) {
-        ereport(ERROR,
-                (errcode(ERRCODE_INVALID_TEXT_REPRESENTATION),
-                    errmsg("invalid domain part of email address: %s", error_msg),
-                    errdetail("Domain was: \"%s\"", domain),
-                    errhint("Domain must follow DNS naming rules or be a valid IP address literal")));
-    }
+bool
+next_domain_label(const char *domain, const size_t len, size_t *pos,
+                  const char **label, size_t *label_len) {
+    if (*pos >= len || domain[0] == '[')
+        return false;
+
+    const char *start = domain + *pos;
+    const char *dot = memchr(start, '.', domain + len - start);
+    const char *end = dot ? dot : domain + len;
+
+    *label = start;
+    *label_len = end - start;
+    *pos = end - domain + 1;
+    return true;
 }
@@ -5,7 +5,7 @@
 #ifndef DOMAIN_H
 #define DOMAIN_H
 
-#include "postgres.h"
+#include "common.h"
 #include "ip.h"
 
 /* Maximum length for a DNS label */
@@ -15,11 +15,13 @@
 /*
  * Main domain validation function
  */
-bool validate_email_domain(const char *domain, char **error_msg);
+bool validate_email_domain(const char *domain, size_t len, char **error_msg);
 
 /*
- * Helper function to report domain validation errors using ereport
+ * Iterate over the labels of a valid domain, left to right. Start with
+ * *pos = 0; returns false when there are no more.
  */
-void check_domain(const char *domain);
+bool next_domain_label(const char *domain, size_t len, size_t *pos,
+                       const char **label, size_t *label_len);
 
 #endif //DOMAIN_H
@@ -0,0 +1,275 @@
+//
+// Internationalized addresses: UTF-8 decoding and the IDNA A-label form
+// of U-label domains.
+//
+
+#include "idn.h"
+#include "domain.h"
+#include "simd.h"
+
+/* Punycode parameters, RFC 3492 section 5 */
+#define PUNY_BASE         36
+#define PUNY_TMIN         1
+#define PUNY_TMAX         26
+#define PUNY_SKEW         38
+#define PUNY_DAMP         700
+#define PUNY_INITIAL_BIAS 72
+#define PUNY_INITIAL_N    0x80
+
+#define ACE_PREFIX     "xn--"
+#define ACE_PREFIX_LEN 4
+
+size_t
+utf8_decode(const char *s, const size_t len, uint32_t *cp) {
+    const unsigned char *p = (const unsigned char *) s;
+    size_t n;
+    uint32_t c;
+    uint32_t min;
+
+    if (len == 0)
+        return 0;
+
+    if (p[0] < 0x80) {
+        *cp = p[0];
+        return 1;
+    }
+
+    if (p[0] >= 0xc2 && p[0] <= 0xdf) {
+        n = 2;
+        c = p[0] & 0x1f;
+        min = 0x80;
+    } else if (p[0] >= 0xe0 && p[0] <= 0xef) {
+        n = 3;
+        c = p[0] & 0x0f;
+        min = 0x800;
+    } else if (p[0] >= 0xf0 && p[0] <= 0xf4) {
+        n = 4;
+        c = p[0] & 0x07;
+        min = 0x10000;
+    } else
+        return 0;
+
+    if (len < n)
+        return 0;
+
+    for (size_t i = 1; i < n; i++) {
+        if ((p[i] & 0xc0) != 0x80)
+            return 0;
+        c = (c << 6) | (p[i] & 0x3f);
+    }
+
+    /* Overlong, surrogate, out of range or C1 control */
+    if (c < min || (c >= 0xd800 && c <= 0xdfff) || c > 0x10ffff || c < 0xa0)
+        return 0;
+
+    *cp = c;
+    return n;
+}
+
+bool
+has_non_ascii(const char *s, const size_t len) {
+    for (size_t i = 0; i < len; i++) {
+        if ((unsigned char) s[i] >= 0x80)
+            return true;
+    }
+    return false;
+}
+
+static uint32_t
+puny_adapt(uint32_t delta, const uint32_t numpoints, const bool first) {
+    uint32_t k = 0;
+
+    delta = first ? delta / PUNY_DAMP : delta / 2;
+    delta += delta / numpoints;
+
+    while (delta > ((PUNY_BASE - PUNY_TMIN) * PUNY_TMAX) / 2) {
+        delta /= PUNY_BASE - PUNY_TMIN;
+        k += PUNY_BASE;
+    }
+
+    return k + (PUNY_BASE - PUNY_TMIN + 1) * delta / (delta + PUNY_SKEW);
+}
+
+static char
+puny_digit(const uint32_t d) {
+    return (char) (d < 26 ? 'a' + d : '0' + d - 26);
+}
+
+/*
+ * Punycode-encodes n code points into dest, at most max bytes.
+ * Returns the number of bytes written, or 0 if they do not fit.
+ */
+static size_t
+puny_encode(const uint32_t *cps, const size_t n, char *dest, const size_t max) {
+    size_t out = 0;
+
+    /* Basic code points first, then the delimiter if there were any */
+    for (size_t i = 0; i < n; i++) {
+        if (cps[i] < PUNY_INITIAL_N) {
+            if (out == max)
+                return 0;
+            dest[out++] = (char) cps[i];
+        }
+    }
+
+    const size_t basic = out;
+    if (basic > 0) {
+        if (out == max)
+            return 0;
+        dest[out++] = '-';
+    }
+
+    uint32_t code = PUNY_INITIAL_N;
+    uint32_t delta = 0;
+    uint32_t bias = PUNY_INITIAL_BIAS;
+
+    for (size_t handled = basic; handled < n;) {
+        uint32_t m = UINT32_MAX;
+
+        for (size_t i = 0; i < n; i++) {
+            if (cps[i] >= code && cps[i] < m)
+                m = cps[i];
+        }
+
+        /* A label has at most 63 code points below U+110000: no overflow */
+        delta += (m - code) * (uint32_t) (handled + 1);
+        code = m;
+
+        for (size_t i = 0; i < n; i++) {
+            if (cps[i] < code)
+                delta++;
+
+            if (cps[i] == code) {
+                uint32_t q = delta;
+
+                for (uint32_t k = PUNY_BASE;; k += PUNY_BASE) {
+                    const uint32_t t = k <= bias ? PUNY_TMIN
+                                       : k >= bias + PUNY_TMAX ? PUNY_TMAX
+                                       : k - bias;
+                    if (q < t)
+                        break;
+
+                    if (out == max)
+                        return 0;
+                    dest[out++] = puny_digit(t + (q - t) % (PUNY_BASE - t));
+                    q = (q - t) / (PUNY_BASE - t);
+                }
+
+                if (out == max)
+                    return 0;
+                dest[out++] = puny_digit(q);
+
+                bias = puny_adapt(delta, (uint32_t) (handled + 1), handled == basic);
+                delta = 0;
+                handled++;
+            }
+        }
+
+        delta++;
+        code++;
+    }
+
+    return out;
+}
+
+/*
+ * Converts one label with non-ASCII characters into dest, at most max
+ * bytes. Returns the length written, or 0 on error.
+ */
+static size_t
+label_to_ascii(const char *label, const size_t len, char *dest, const size_t max,
+               char **error_msg) {
+    uint32_t cps[MAX_LABEL_LENGTH];
+    size_t n = 0;
+
+    for (size_t i = 0; i < len;) {
+        /* Every code point takes at least a byte of the encoded label */
+        if (n == MAX_LABEL_LENGTH) {
+            *error_msg = "domain label exceeds maximum length";
+            return 0;
+        }
+
+        const size_t seq = utf8_decode(label + i, len - i, &cps[n]);
+
+        if (seq == 0) {
+            *error_msg = "invalid UTF-8 in domain name";
+            return 0;
+        }
+
+        /* Basic code points are folded like ASCII labels */
+        if (seq == 1 && EMAIL_CHAR_IS(cps[n], EMAIL_CHAR_UPPER))
+            cps[n] += 'a' - 'A';
+
+        i += seq;
+        n++;
+    }
+
+    /* Whichever is tighter: the label limit or the room left in the domain */
+    const bool label_limit = max >= MAX_LABEL_LENGTH;
+    const size_t limit = label_limit ? MAX_LABEL_LENGTH : max;
+
+    if (limit <= ACE_PREFIX_LEN) {
+        *error_msg = "domain name exceeds maximum length";
+        return 0;
+    }
+    memcpy(dest, ACE_PREFIX, ACE_PREFIX_LEN);
+
+    const size_t encoded = puny_encode(cps, n, dest + ACE_PREFIX_LEN, limit - ACE_PREFIX_LEN);
+    if (encoded == 0) {
+        *error_msg = label_limit ? "domain label exceeds maximum length"
+                                 : "domain name exceeds maximum length";
+        return 0;
+    }
+
+    return ACE_PREFIX_LEN + encoded;
+}
+
+bool
+email_domain_to_ascii(const char *domain, const size_t len, char *dest, size_t *dest_len,
+                      char **error_msg) {
+    size_t out = 0;
+    size_t start = 0;
+
+    if (len == 0) {
+        *error_msg = "domain cannot be empty";
+        return false;
+    }
+    if (len > MAX_DOMAIN_LENGTH) {
+        *error_msg = "domain name exceeds maximum length";
+        return false;
+    }
+
+    while (start <= len) {
+        const char *dot = memchr(domain + start, '.', len - start);
+        const size_t end = dot ? (size_t) (dot - domain) : len;
+        const size_t label_len = end - start;
+
+        if (start > 0) {
+            if (out == MAX_DOMAIN_LENGTH) {
+                *error_msg = "domain name exceeds maximum length";
+                return false;
+            }
+            dest[out++] = '.';
+        }
+
+        if (has_non_ascii(domain + start, label_len)) {
+            const size_t written = label_to_ascii(domain + start, label_len, dest + out,
+                                                  MAX_DOMAIN_LENGTH - out, error_msg);
+            if (written == 0)
+                return false;
+            out += written;
+        } else {
+            if (label_len > MAX_DOMAIN_LENGTH - out) {
+                *error_msg = "domain name exceeds maximum length";
+                return false;
+            }
+            email_lower(dest + out, domain + start, label_len);
+            out += label_len;
+        }
+
+        start = end + 1;
+    }
+
+    *dest_len = out;
+    return true;
+}
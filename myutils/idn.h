@@ -0,0 +1,35 @@
+//
+// Internationalized addresses: UTF-8 decoding and the IDNA A-label form
+// of U-label domains (RFC 5890, Punycode per RFC 3492).
+//
+
+#ifndef IDN_H
+#define IDN_H
+
+#include "common.h"
+
+/*
+ * Decodes the UTF-8 sequence at s[0..len) into *cp. Overlong forms,
+ * surrogates, code points above U+10FFFF and C1 controls are rejected.
+ * Returns the length of the sequence, or 0 if it is invalid.
+ */
+size_t utf8_decode(const char *s, size_t len, uint32_t *cp);
+
+/*
+ * True if any byte of s[0..len) has the high bit set
+ */
+bool has_non_ascii(const char *s, size_t len);
+
+/*
+ * Writes the A-label form of a domain to dest, which must have room for
+ * MAX_DOMAIN_LENGTH bytes: labels with non-ASCII characters become
+ * "xn--" and their Punycode encoding, ASCII letters are lowercased.
+ * Only ASCII is case folded; U-labels are expected in their IDNA2008
+ * form already. The result still has to pass validate_email_domain.
+ * Domains longer than MAX_DOMAIN_LENGTH bytes are rejected as they are.
+ * Returns false with error details if the domain cannot be converted.
+ */
+bool email_domain_to_ascii(const char *domain, size_t len, char *dest, size_t *dest_len,
+                           char **error_msg);
+
+#endif //IDN_H
@@ -6,17 +6,18 @@
 #include <string.h>
 
 static bool
-is_valid_ipv4(const char *ipv4_str) {
+is_valid_ipv4(const char *ipv4_str, const int len) {
+    const char *end = ipv4_str + len;
     int curr_num = 0;
     int dots = 0;
     const char *p;
 
     /* Empty string is invalid */
-    if (!ipv4_str || *ipv4_str == '\0')
+    if (len == 0)
         return false;
 
     /* Parse each character */
-    for (p = ipv4_str; *p; p++) {
+    for (p = ipv4_str; p < end; p++) {
         if (*p == '.') {
             /* Check for consecutive dots or dot at start */
             if (p == ipv4_str || *(p - 1) == '.')
@@ -28,7 +29,7 @@ is_valid_ipv4(const char *ipv4_str) {
         }
 
         /* Only digits are allowed */
-        if (*p < '0' || *p > '9')
+        if (!EMAIL_CHAR_IS(*p, EMAIL_CHAR_DIGIT))
             return false;
 
         curr_num = curr_num * 10 + (*p - '0');
@@ -48,10 +49,7 @@ is_valid_ipv6_segment(const char *seg, int len) {
 
     /* Check each character is valid hex */
     for (int i = 0; i < len; i++) {
-        const char c = seg[i];
-        if (!((c >= '0' && c <= '9') ||
-              (c >= 'a' && c <= 'f') ||
-              (c >= 'A' && c <= 'F')))
+        if (!EMAIL_CHAR_IS(seg[i], EMAIL_CHAR_HEX))
             return false;
     }
 
@@ -60,7 +58,8 @@ is_valid_ipv6_segment(const char *seg, int len) {
 
 
 static bool
-is_valid_ipv6(const char *ipv6_str) {
+is_valid_ipv6(const char *ipv6_str, const int len) {
+    const char *end = ipv6_str + len;
     int seg_len;
     int segments = 0;
     bool has_double_colon = false;
@@ -68,23 +67,23 @@ is_valid_ipv6(const char *ipv6_str) {
     const char *seg_start;
 
     /* Empty string is invalid */
-    if (!ipv6_str || *ipv6_str == '\0')
+    if (len == 0)
         return false;
 
     /* Skip "IPv6:" prefix if present */
-    if (strncmp(p, "IPv6:", 5) == 0)
+    if (len >= 5 && strncmp(p, "IPv6:", 5) == 0)
         p += 5;
     seg_start = p;
 
     /* Handle first character being : (for ::) */
-    if (*p == ':' && *(p + 1) == ':') {
+    if (end - p >= 2 && *p == ':' && *(p + 1) == ':') {
         has_double_colon = true;
         p += 2;
         seg_start = p;
     }
 
     /* Process each character */
-    while (*p) {
+    while (p < end) {
         if (*p == ':') {
             /* Check segment before colon */
             seg_len = p - seg_start;
@@ -96,7 +95,7 @@ is_valid_ipv6(const char *ipv6_str) {
                 return false; /* Empty segment not part of :: */
 
             /* Handle double colon */
-            if (*(p + 1) == ':') {
+            if (p + 1 < end && *(p + 1) == ':') {
                 if (has_double_colon) /* Only one :: allowed */
                     return false;
                 has_double_colon = true;
@@ -131,31 +130,29 @@ is_valid_ipv6(const char *ipv6_str) {
 }
 
 bool
-validate_ip_literal(const char *ip_str, char **error_msg) {
-    /* Remove brackets */
-    const int len = strlen(ip_str);
+validate_ip_literal(const char *ip_str, const size_t len, char **error_msg) {
     if (len < 2 || ip_str[0] != '[' || ip_str[len - 1] != ']') {
         *error_msg = "IP literal must be enclosed in square brackets";
         return false;
     }
 
-    /* Extract IP address */
-    char *ip = pnstrdup(ip_str + 1, len - 2);
+    /* Address between the brackets, validated in place */
+    const char *ip = ip_str + 1;
+    const int ip_len = len - 2;
     bool result;
 
     /* Check for IPv6 prefix */
-    if (strncmp(ip, "IPv6:", 5) == 0) {
+    if (ip_len >= 5 && strncmp(ip, "IPv6:", 5) == 0) {
         /* Validate IPv6 address */
-        result = is_valid_ipv6(ip);
+        result = is_valid_ipv6(ip, ip_len);
         if (!result)
             *error_msg = "invalid IPv6 address";
     } else {
         /* Validate IPv4 address */
-        result = is_valid_ipv4(ip);
+        result = is_valid_ipv4(ip, ip_len);
         if (!result)
             *error_msg = "invalid IPv4 address";
     }
 
-    pfree(ip);
     return result;
 }
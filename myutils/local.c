@@ -3,48 +3,98 @@
 //
 
 #include "local.h"
+#include "idn.h"
+#include "simd.h"
 #include <string.h>
 
 /*
- * Check if the character is a valid unquoted local-part character
- * according to RFC 5321/5322
+ * Check a dot-atom: valid characters, no leading, trailing or consecutive
+ * dots. Sets *error_msg, if given, to the first problem found.
  */
 static bool
-is_valid_unquoted_char(unsigned char c) {
-    return (c >= 'A' && c <= 'Z') || /* uppercase letters */
-           (c >= 'a' && c <= 'z') || /* lowercase letters */
-           (c >= '0' && c <= '9') || /* digits */
-           c == '!' || c == '#' || c == '$' ||
-           c == '%' || c == '&' || c == '\'' ||
-           c == '*' || c == '+' || c == '-' ||
-           c == '/' || c == '=' || c == '?' ||
-           c == '^' || c == '_' || c == '`' ||
-           c == '{' || c == '|' || c == '}' ||
-           c == '~' || c == '.'; /* allowed special chars */
+validate_dot_atom(const char *s, const size_t len, char **error_msg) {
+    /* Check first and last character aren't dots */
+    if (s[0] == '.' || s[len - 1] == '.') {
+        if (error_msg)
+            *error_msg = "unquoted local part cannot begin or end with a dot";
+        return false;
+    }
+
+    /* Characters up to the first invalid one, then look for ".." before it */
+    const size_t valid_len = email_span(s, len, EMAIL_SET_ATEXT);
+    const char *end = s + valid_len;
+
+    for (const char *dot = memchr(s, '.', valid_len); dot != NULL && dot + 1 < end;
+         dot = memchr(dot + 1, '.', end - dot - 1)) {
+        if (dot[1] == '.') {
+            if (error_msg)
+                *error_msg = "unquoted local part cannot contain consecutive dots";
+            return false;
+        }
+    }
+
+    if (valid_len < len) {
+        if (error_msg)
+            *error_msg = "invalid character in unquoted local part";
+        return false;
+    }
+
+    return true;
 }
 
 /*
- * Check if the character is a valid quoted local-part character
- * according to RFC 5321/5322
+ * validate_dot_atom for SMTPUTF8 (RFC 6531): UTF-8 characters are allowed
+ * besides atext. Only reached once the ASCII form has been rejected.
  */
 static bool
-is_valid_quoted_char(unsigned char c) {
-    /* Any ASCII printable character except \ and " */
-    return c >= 32 && c <= 126 && c != '\\' && c != '"';
+validate_dot_atom_utf8(const char *s, const size_t len, char **error_msg) {
+    if (s[0] == '.' || s[len - 1] == '.') {
+        if (error_msg)
+            *error_msg = "unquoted local part cannot begin or end with a dot";
+        return false;
+    }
+
+    for (size_t i = 0; i < len;) {
+        uint32_t cp;
+
+        if ((unsigned char) s[i] >= 0x80) {
+            const size_t seq = utf8_decode(s + i, len - i, &cp);
+            if (seq == 0) {
+                if (error_msg)
+                    *error_msg = "invalid UTF-8 in local part";
+                return false;
+            }
+            i += seq;
+            continue;
+        }
+
+        if (s[i] == '.' && s[i + 1] == '.') {
+            if (error_msg)
+                *error_msg = "unquoted local part cannot contain consecutive dots";
+            return false;
+        }
+        if (s[i] != '.' && !EMAIL_CHAR_IS(s[i], EMAIL_CHAR_ATEXT)) {
+            if (error_msg)
+                *error_msg = "invalid character in unquoted local part";
+            return false;
+        }
+        i++;
+    }
+
+    return true;
 }
 
 /*
  * Validate email local part according to RFC 5321/5322
  * Returns true if valid, false otherwise with error details
  */
-static bool
-validate_email_local_part(const char *local_part, char **error_msg) {
+bool
+validate_email_local_part(const char *local_part, const size_t len, char **error_msg) {
     if (local_part == NULL) {
         *error_msg = "local part cannot be NULL";
         return false;
     }
 
-    const size_t len = strlen(local_part);
     if (len == 0) {
         *error_msg = "local part cannot be empty";
         return false;
@@ -60,198 +110,179 @@ validate_email_local_part(const char *local_part, char **error_msg) {
 
     /* Handle quoted string */
     if (is_quoted) {
-        bool prev_was_backslash = false;
         /* Remove quotes from length check */
         if (len <= 2) {
             *error_msg = "quoted local part cannot be empty";
             return false;
         }
 
-        /* Check each character in quoted string */
-        for (size_t i = 1; i < len - 1; i++) {
-            const unsigned char c = local_part[i];
-
-            if (prev_was_backslash) {
-                /* After backslash, only certain characters are allowed */
-                if (c != ' ' && c != '\t' && (c < 32 || c > 126)) {
-                    *error_msg = "invalid character after backslash in quoted local part";
-                    return false;
-                }
-                prev_was_backslash = false;
-                continue;
-            }
-
-            if (c == '\\') {
-                prev_was_backslash = true;
-                continue;
-            }
-
-            if (!is_valid_quoted_char(c)) {
+        /* Skip over runs of plain quoted characters, stop at escapes */
+        const size_t end = len - 1;
+        size_t i = 1;
+        while ((i += email_span(local_part + i, end - i, EMAIL_SET_QTEXT)) < end) {
+            if (local_part[i] != '\\') {
                 *error_msg = "invalid character in quoted local part";
                 return false;
             }
-        }
-    }
-    /* Handle unquoted string */
-    else {
-        bool prev_was_dot = false;
-        /* Check first and last character aren't dots */
-        if (local_part[0] == '.' || local_part[len - 1] == '.') {
-            *error_msg = "unquoted local part cannot begin or end with a dot";
-            return false;
-        }
 
-        /* Check each character */
-        for (size_t i = 0; i < len; i++) {
-            const unsigned char c = local_part[i];
-
-            /* Check for consecutive dots */
-            if (c == '.') {
-                if (prev_was_dot) {
-                    *error_msg = "unquoted local part cannot contain consecutive dots";
-                    return false;
-                }
-                prev_was_dot = true;
-                continue;
-            }
-            prev_was_dot = false;
+            /* A backslash right before the closing quote escapes nothing */
+            if (i + 1 == end)
+                break;
 
-            /* Check if character is valid */
-            if (!is_valid_unquoted_char(c)) {
-                *error_msg = "invalid character in unquoted local part";
+            /* After backslash, any printable character or tab */
+            const unsigned char c = local_part[i + 1];
+            if (c != '\t' && !EMAIL_CHAR_IS(c, EMAIL_CHAR_PRINT)) {
+                *error_msg = "invalid character after backslash in quoted local part";
                 return false;
             }
+            i += 2;
         }
     }
+    /* Handle unquoted string */
+    else if (!validate_dot_atom(local_part, len, error_msg))
+        return false;
 
     return true;
 }
 
-/*
- * Helper function to report local part validation errors using ereport
- */
-void
-check_local_part(const char *local_part) {
-    char *error_msg = NULL;
-
-    if (!validate_email_local_part(local_part, &error_msg)) {
-        ereport(ERROR,
-                (errcode(ERRCODE_INVALID_TEXT_REPRESENTATION),
-                    errmsg("invalid local-part of email address: %s", error_msg),
-                    errdetail("Local-part was: \"%s\"", local_part),
-                    errhint("The local-part of an email address must follow RFC 5321/5322 rules")));
-    }
-}
-
 /*
  * Helper function to check if the content of a quoted local part
  * would be valid as an unquoted local part
  */
 bool
 quoted_content_valid_as_unquoted(const char *quoted_part, size_t len) {
-    bool prev_was_dot = false;
+    /* Remove surrounding quotes; UTF-8 content only gets here under SMTPUTF8 */
+    return validate_dot_atom(quoted_part + 1, len - 2, NULL) ||
+           (has_non_ascii(quoted_part + 1, len - 2) &&
+            validate_dot_atom_utf8(quoted_part + 1, len - 2, NULL));
+}
 
-    /* Remove surrounding quotes */
-    const char *content = quoted_part + 1;
-    const size_t content_len = len - 2;
+bool
+validate_email_local_part_utf8(const char *local_part, const size_t len, char **error_msg) {
+    if (!has_non_ascii(local_part, len))
+        return validate_email_local_part(local_part, len, error_msg);
 
-    /* Check if content would be valid unquoted */
-    if (content[0] == '.' || content[content_len - 1] == '.')
+    if (len > 64) {
+        *error_msg = "local part exceeds maximum length of 64 characters";
         return false;
+    }
 
-    for (size_t i = 0; i < content_len; i++) {
-        const unsigned char c = content[i];
+    if (len < 2 || local_part[0] != '"' || local_part[len - 1] != '"')
+        return validate_dot_atom_utf8(local_part, len, error_msg);
 
-        /* Check for consecutive dots */
-        if (c == '.') {
-            if (prev_was_dot)
-                return false;
-            prev_was_dot = true;
-            continue;
-        }
-        prev_was_dot = false;
+    /* Quoted: qtext, quoted pairs or UTF-8 characters */
+    const size_t end = len - 1;
+    for (size_t i = 1; i < end;) {
+        const unsigned char c = local_part[i];
+        uint32_t cp;
 
-        /* Check if character would be valid in unquoted form */
-        if (!is_valid_unquoted_char(c))
+        if (c >= 0x80) {
+            const size_t seq = utf8_decode(local_part + i, end - i, &cp);
+            if (seq == 0) {
+                *error_msg = "invalid UTF-8 in local part";
+                return false;
+            }
+            i += seq;
+        } else if (c == '\\' && i + 1 < end) {
+            const unsigned char escaped = local_part[i + 1];
+            if (escaped != '\t' && !EMAIL_CHAR_IS(escaped, EMAIL_CHAR_PRINT)) {
+                *error_msg = "invalid character after backslash in quoted local part";
+                return false;
+            }
+            i += 2;
+        } else if (c == '\\' || EMAIL_CHAR_IS(c, EMAIL_CHAR_QTEXT)) {
+            i++;
+        } else {
+            *error_msg = "invalid character in quoted local part";
             return false;
+        }
     }
 
     return true;
 }
 
 /*
- * Helper function to hash a local part consistently
- * whether it's quoted or unquoted
+ * Write the canonical form of a local part into dest, which must have
+ * room for len bytes. Unquoted parts, and quoted parts whose content is
+ * valid unquoted, are unquoted and lowercased. Quoted parts that must stay
+ * quoted are copied unchanged and *quoted is set.
+ * Returns the length of the canonical form.
  */
-uint32
-hash_local_part(const char *local, size_t len) {
-    /* DJB2 */
-    uint32 hash = 5381;
-    const bool is_quoted = local[0] == '"' && local[len - 1] == '"';
-    size_t i;
-
-    if (is_quoted && quoted_content_valid_as_unquoted(local, len)) {
-        /* If quoted content is valid as unquoted, hash the unquoted form */
-        for (i = 1; i < len - 1; i++)
-            hash = (hash << 5) + hash + pg_tolower(local[i]);
-    } else if (is_quoted) {
-        /* For quoted parts that must remain quoted, include quotes in hash */
-        for (i = 0; i < len; i++)
-            hash = (hash << 5) + hash + local[i];
-    } else {
-        /* For unquoted parts, use case-insensitive hash */
-        for (i = 0; i < len; i++)
-            hash = (hash << 5) + hash + pg_tolower(local[i]);
+size_t
+canonicalize_local_part(const char *local, size_t len, char *dest, bool *quoted) {
+    const bool is_quoted = len >= 2 && local[0] == '"' && local[len - 1] == '"';
+
+    if (is_quoted && !quoted_content_valid_as_unquoted(local, len)) {
+        /* Quoted content is case-sensitive */
+        memcpy(dest, local, len);
+        *quoted = true;
+        return len;
+    }
+
+    if (is_quoted) {
+        /* Drop the quotes */
+        local++;
+        len -= 2;
     }
 
-    return hash;
+    email_lower(dest, local, len);
+
+    *quoted = false;
+    return len;
 }
 
 /*
- * Compare local parts considering quoting rules
- * Returns -1 if local1 < local2, 0 if equal, 1 if local1 > local2
+ * Content of a canonical local part without the quotes, if it kept them
  */
-int
-compare_local_parts(const char *local1, size_t len1,
-                    const char *local2, size_t len2) {
-    /* Check if parts are quoted */
-    const bool is_quoted1 = len1 >= 2 && local1[0] == '"' && local1[len1 - 1] == '"';
-    const bool is_quoted2 = len2 >= 2 && local2[0] == '"' && local2[len2 - 1] == '"';
-
-    if (!is_quoted1 && !is_quoted2) {
-        /* Both unquoted - do case-insensitive comparison */
-        return bounded_strcasecmp(local1, len1, local2, len2);
-    }
-    if (is_quoted1 && is_quoted2) {
-        /* Both quoted - compare content exactly */
-        const size_t min_len = Min(len1, len2);
-        const int cmp = memcmp(local1, local2, min_len);
-        if (cmp == 0) {
-            if (len1 < len2)
-                return -1;
-            if (len1 > len2)
-                return 1;
-            return 0;
-        }
-        return cmp;
+static void
+local_part_content(const char **local, size_t *len) {
+    if (*len >= 2 && (*local)[0] == '"') {
+        (*local)++;
+        *len -= 2;
     }
-    /* One quoted, one unquoted */
-    const char *quoted = is_quoted1 ? local1 : local2;
-    const char *unquoted = is_quoted1 ? local2 : local1;
-    const size_t quoted_len = is_quoted1 ? len1 : len2;
-    const size_t unquoted_len = is_quoted1 ? len2 : len1;
-
-    /* Check if quoted content would be valid as unquoted */
-    if (quoted_content_valid_as_unquoted(quoted, quoted_len)) {
-        /* Compare unquoted form with quoted content */
-        const int cmp = bounded_strcasecmp(quoted + 1, quoted_len - 2,
-                                           unquoted, unquoted_len);
-        /* Reverse comparison if second string was quoted */
-        return is_quoted1 ? -cmp : cmp;
+}
+
+/*
+ * Returns the next segment of a canonical local part, starting the search
+ * at *pos. Segments are separated by '.', '+' and '-'; empty ones are
+ * skipped. Returns false when there are no more.
+ */
+bool
+next_local_segment(const char *local, size_t len, size_t *pos,
+                   const char **segment, size_t *segment_len) {
+    local_part_content(&local, &len);
+
+    size_t i = *pos;
+    while (i < len && (local[i] == '.' || local[i] == '+' || local[i] == '-'))
+        i++;
+    if (i >= len) {
+        *pos = len;
+        return false;
     }
-    /*
-     * If quoted content can't be unquoted, treat quoted form
-     * as greater (comes after) unquoted form
-     */
-    return is_quoted1 ? 1 : -1;
+
+    const size_t start = i;
+    while (i < len && local[i] != '.' && local[i] != '+' && local[i] != '-')
+        i++;
+
+    *segment = local + start;
+    *segment_len = i - start;
+    *pos = i;
+    return true;
+}
+
+/*
+ * Returns the plus-tag of a canonical local part: everything after the
+ * first '+'. Returns false if there is none or it is empty.
+ */
+bool
+local_part_plus_tag(const char *local, size_t len, const char **tag, size_t *tag_len) {
+    local_part_content(&local, &len);
+
+    const char *plus = memchr(local, '+', len);
+    if (plus == NULL || plus + 1 == local + len)
+        return false;
+
+    *tag = plus + 1;
+    *tag_len = local + len - (plus + 1);
+    return true;
 }
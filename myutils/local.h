@@ -5,7 +5,6 @@
 #ifndef LOCAL_H
 #define LOCAL_H
 
-#include "postgres.h"
 #include "common.h"
 
 /* Function declarations */
@@ -14,12 +13,13 @@
  * Validate email local part according to RFC 5321/5322
  * Returns true if valid, false otherwise with error details
  */
-static bool validate_email_local_part(const char *local_part, char **error_msg);
+bool validate_email_local_part(const char *local_part, size_t len, char **error_msg);
 
 /*
- * Helper function to report local part validation errors using ereport
+ * Validate a local part under SMTPUTF8 (RFC 6531), which also allows
+ * UTF-8 characters wherever atext or qtext is allowed
  */
-void check_local_part(const char *local_part);
+bool validate_email_local_part_utf8(const char *local_part, size_t len, char **error_msg);
 
 /*
  * Helper function to check if the content of a quoted local part
@@ -28,16 +28,23 @@ void check_local_part(const char *local_part);
 bool quoted_content_valid_as_unquoted(const char *quoted_part, size_t len);
 
 /*
- * Helper function to hash a local part consistently
- * whether it's quoted or unquoted
+ * Write the canonical form of a local part into dest, which must have
+ * room for len bytes. Returns the length of the canonical form and sets
+ * *quoted when the canonical form keeps its quotes.
  */
-uint32 hash_local_part(const char *local, size_t len);
+size_t canonicalize_local_part(const char *local, size_t len, char *dest, bool *quoted);
 
 /*
- * Compare local parts considering quoting rules
- * Returns -1 if local1 < local2, 0 if equal, 1 if local1 > local2
+ * Iterate over the segments of a canonical local part, split on '.', '+'
+ * and '-'. Start with *pos = 0; returns false when there are no more.
  */
-int compare_local_parts(const char *local1, size_t len1,
-                        const char *local2, size_t len2);
+bool next_local_segment(const char *local, size_t len, size_t *pos,
+                        const char **segment, size_t *segment_len);
+
+/*
+ * Find the plus-tag of a canonical local part, the text after its first
+ * '+'. Returns false if it has none.
+ */
+bool local_part_plus_tag(const char *local, size_t len, const char **tag, size_t *tag_len);
 
 #endif //LOCAL_H
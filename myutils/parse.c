@@ -0,0 +1,192 @@
+//
+// Single-pass parser for the text form of an email address.
+//
+
+#include "parse.h"
+#include "local.h"
+#include "domain.h"
+#include "idn.h"
+#include "simd.h"
+
+/*
+ * Find the @ separating local part and domain: the last one that is
+ * neither quoted nor escaped. Returns NULL if there is none.
+ */
+static const char *
+find_at(const char *input, const size_t len, EmailParseResult *result) {
+    const char *end = input + len;
+    const char *at_pos = NULL;
+    bool in_quotes = false;
+    bool escaped = false;
+
+    for (const char *p = input; p < end; p++) {
+        /* Skip runs of characters that are none of the three specials */
+        if (!escaped) {
+            p += email_span(p, end - p, EMAIL_SET_PLAIN);
+            if (p == end)
+                break;
+        }
+
+        if (escaped)
+            escaped = false;
+        else if (*p == '\\')
+            escaped = true;
+        else if (*p == '"')
+            in_quotes = !in_quotes;
+        else if (*p == '@' && !in_quotes)
+            at_pos = p;
+    }
+
+    if (in_quotes)
+        result->error = EMAIL_PARSE_UNTERMINATED_QUOTES;
+    else if (escaped)
+        result->error = EMAIL_PARSE_TRAILING_BACKSLASH;
+    else if (at_pos == NULL)
+        result->error = EMAIL_PARSE_MISSING_AT;
+
+    return at_pos;
+}
+
+/*
+ * The domain under SMTPUTF8, once the ASCII rules have rejected it:
+ * valid if it has non-ASCII labels and its A-label form is valid
+ */
+static bool
+validate_idn_domain(EmailParseResult *result) {
+    char ascii[MAX_DOMAIN_LENGTH];
+    size_t ascii_len;
+
+    if (!has_non_ascii(result->domain, result->domain_len) || result->domain[0] == '[')
+        return false;
+
+    if (!email_domain_to_ascii(result->domain, result->domain_len, ascii, &ascii_len,
+                               &result->error_msg) ||
+        !validate_email_domain(ascii, ascii_len, &result->error_msg))
+        return false;
+
+    result->idn_domain = true;
+    return true;
+}
+
+bool
+email_parse(const char *input, const size_t len, EmailParseResult *result) {
+    return email_parse_opt(input, len, 0, result);
+}
+
+bool
+email_parse_opt(const char *input, const size_t len, const int options, EmailParseResult *result) {
+    result->local = NULL;
+    result->local_len = 0;
+    result->domain = NULL;
+    result->domain_len = 0;
+    result->idn_domain = false;
+    result->error = EMAIL_PARSE_OK;
+    result->error_msg = NULL;
+
+    const char *at_pos = find_at(input, len, result);
+    if (result->error != EMAIL_PARSE_OK)
+        return false;
+
+    return email_parse_parts(input, at_pos - input, at_pos + 1, input + len - (at_pos + 1),
+                             options, result);
+}
+
+bool
+email_parse_parts(const char *local, const size_t local_len, const char *domain,
+                  const size_t domain_len, const int options, EmailParseResult *result) {
+    result->local = local;
+    result->local_len = local_len;
+    result->domain = domain;
+    result->domain_len = domain_len;
+    result->idn_domain = false;
+    result->error = EMAIL_PARSE_OK;
+    result->error_msg = NULL;
+
+    if (!validate_email_local_part(result->local, result->local_len, &result->error_msg) &&
+        (!(options & EMAIL_PARSE_SMTPUTF8) ||
+         !validate_email_local_part_utf8(result->local, result->local_len, &result->error_msg))) {
+        result->error = EMAIL_PARSE_INVALID_LOCAL;
+        return false;
+    }
+
+    if (!validate_email_domain(result->domain, result->domain_len, &result->error_msg) &&
+        (!(options & EMAIL_PARSE_SMTPUTF8) || !validate_idn_domain(result))) {
+        result->error = EMAIL_PARSE_INVALID_DOMAIN;
+        return false;
+    }
+
+    /* IP literals are not limited by the domain name rules */
+    if (result->domain_len > MAX_DOMAIN_LENGTH) {
+        result->error = EMAIL_PARSE_DOMAIN_TOO_LONG;
+        return false;
+    }
+
+    return true;
+}
+
+const char *
+email_parse_error_string(const EmailParseError error) {
+    switch (error) {
+        case EMAIL_PARSE_OK:
+            break;
+        case EMAIL_PARSE_UNTERMINATED_QUOTES:
+            return "unterminated quotes in email address";
+        case EMAIL_PARSE_TRAILING_BACKSLASH:
+            return "invalid trailing backslash in email address";
+        case EMAIL_PARSE_MISSING_AT:
+            return "missing @ in email address";
+        case EMAIL_PARSE_INVALID_LOCAL:
+            return "invalid local-part of email address";
+        case EMAIL_PARSE_INVALID_DOMAIN:
+            return "invalid domain part of email address";
+        case EMAIL_PARSE_DOMAIN_TOO_LONG:
+            return "email domain too long";
+    }
+    return "valid email address";
+}
+
+EmailParseError
+email_canonical_form(const char *input, const size_t len, char *dest, size_t *dest_len) {
+    EmailParseResult result;
+    bool quoted;
+    size_t domain_len = 0;
+
+    if (!email_parse_opt(input, len, EMAIL_PARSE_SMTPUTF8, &result))
+        return result.error;
+
+    const size_t local_len = canonicalize_local_part(result.local, result.local_len, dest, &quoted);
+
+    dest[local_len] = '@';
+    if (result.idn_domain) {
+        char *error_msg;
+
+        /* The parser converted it already, so this succeeds */
+        if (!email_domain_to_ascii(result.domain, result.domain_len, dest + local_len + 1,
+                                   &domain_len, &error_msg))
+            return EMAIL_PARSE_INVALID_DOMAIN;
+    } else {
+        email_lower(dest + local_len + 1, result.domain, result.domain_len);
+        domain_len = result.domain_len;
+    }
+    *dest_len = local_len + 1 + domain_len;
+
+    return EMAIL_PARSE_OK;
+}
+
+size_t
+email_validate_batch(const char *buf, const size_t *offsets, const size_t n,
+                     EmailParseError *errors) {
+    size_t valid = 0;
+
+    for (size_t i = 0; i < n; i++) {
+        EmailParseResult result;
+
+        if (email_parse_opt(buf + offsets[i], offsets[i + 1] - offsets[i], EMAIL_PARSE_SMTPUTF8,
+                            &result))
+            valid++;
+        if (errors != NULL)
+            errors[i] = result.error;
+    }
+
+    return valid;
+}
@@ -0,0 +1,106 @@
+//
+// Single-pass parser for the text form of an email address.
+//
+// Together with the validators this is the whole of the address rules,
+// and none of it depends on the server: it works on caller-provided
+// buffers, allocates nothing and reports errors as codes. The extension
+// wraps it, and client programs can link the email_validate library to
+// reject bad input before it is sent. Call email_simd_init() once to use
+// the vectorised kernels.
+//
+
+#ifndef PARSE_H
+#define PARSE_H
+
+#include "common.h"
+#include "domain.h"
+
+/*
+ * Reasons for rejecting an input string
+ */
+typedef enum {
+    EMAIL_PARSE_OK = 0,
+    EMAIL_PARSE_UNTERMINATED_QUOTES,
+    EMAIL_PARSE_TRAILING_BACKSLASH,
+    EMAIL_PARSE_MISSING_AT,
+    EMAIL_PARSE_INVALID_LOCAL,
+    EMAIL_PARSE_INVALID_DOMAIN,
+    EMAIL_PARSE_DOMAIN_TOO_LONG
+} EmailParseError;
+
+/*
+ * Options of email_parse_opt
+ */
+/* Accept UTF-8 local parts and U-label domains (RFC 6531, IDNA2008) */
+#define EMAIL_PARSE_SMTPUTF8 0x01
+
+/*
+ * Result of parsing. The parts point into the input and are only set
+ * once the @ has been found; error_msg details the INVALID_* errors.
+ * idn_domain is set for domains with non-ASCII labels, whose A-label
+ * form email_domain_to_ascii computes.
+ */
+typedef struct {
+    const char *local;
+    size_t local_len;
+    const char *domain;
+    size_t domain_len;
+
+    bool idn_domain;
+
+    EmailParseError error;
+    char *error_msg;
+} EmailParseResult;
+
+/*
+ * Splits input of length len at the last @ outside of quotes and
+ * validates both parts. Allocates nothing.
+ * Returns true if the address is valid.
+ */
+bool email_parse(const char *input, size_t len, EmailParseResult *result);
+
+/*
+ * email_parse with EMAIL_PARSE_* options. ASCII input takes the same
+ * path whatever the options; the others only matter once it fails.
+ */
+bool email_parse_opt(const char *input, size_t len, int options, EmailParseResult *result);
+
+/*
+ * email_parse_opt for an address already split into its parts, such as
+ * one received in binary form: the same rules without looking for the @.
+ */
+bool email_parse_parts(const char *local, size_t local_len, const char *domain,
+                       size_t domain_len, int options, EmailParseResult *result);
+
+/*
+ * Short description of an error code, without the details of error_msg
+ */
+const char *email_parse_error_string(EmailParseError error);
+
+/*
+ * Room email_canonical_form needs for input of length len: an A-label
+ * domain can be longer than the U-labels it is written in
+ */
+#define EMAIL_CANONICAL_SIZE(len) ((len) + MAX_DOMAIN_LENGTH)
+
+/*
+ * Validates input with the rules of the extension's input, SMTPUTF8
+ * included, and writes its canonical form, the canonical local part, '@'
+ * and the lowercased domain in A-label form, to dest, which must have
+ * room for EMAIL_CANONICAL_SIZE(len) bytes. Equal addresses have equal
+ * canonical forms.
+ * Returns EMAIL_PARSE_OK and sets *dest_len if the address is valid.
+ */
+EmailParseError email_canonical_form(const char *input, size_t len, char *dest, size_t *dest_len);
+
+/*
+ * Validates the n addresses packed into buf, the i-th being the bytes
+ * from offsets[i] up to offsets[i + 1]; offsets has n + 1 entries, with
+ * the rules of email_canonical_form. The code of each is stored in
+ * errors, unless it is NULL.
+ * Returns the number of valid addresses.
+ */
+size_t email_validate_batch(const char *buf, const size_t *offsets, size_t n,
+                            EmailParseError *errors);
+
+#endif //PARSE_H
@@ -0,0 +1,238 @@
+//
+// Vectorised character-class kernels for the validators.
+//
+// Set membership uses the nibble lookup technique: for a byte c, bit
+// (c >> 4) of set_bitmap[set][c & 15] tells whether c is in the set.
+// Vector kernels do both lookups with a byte shuffle, 16 or 32 bytes
+// at a time. x86 kernels are compiled with target attributes and picked
+// at load time; NEON is always present on AArch64.
+//
+
+#include "simd.h"
+
+#if defined(__x86_64__) && (defined(__GNUC__) || defined(__clang__))
+#define EMAIL_SIMD_X86
+#include <immintrin.h>
+#elif defined(__aarch64__) && defined(__ARM_NEON)
+#define EMAIL_SIMD_NEON
+#include <arm_neon.h>
+#endif
+
+/* Bitmaps of the ASCII characters in each set, indexed by low nibble */
+static const uint8_t set_bitmap[EMAIL_NUM_SETS][16] = {
+    [EMAIL_SET_ATEXT] = {0xe8, 0xfc, 0xf8, 0xfc, 0xfc, 0xfc, 0xfc, 0xfc, 0xf8, 0xf8, 0xf4, 0xd4, 0xd0, 0xdc, 0xf4, 0x7c},
+    [EMAIL_SET_QTEXT] = {0xfc, 0xfc, 0xf8, 0xfc, 0xfc, 0xfc, 0xfc, 0xfc, 0xfc, 0xfc, 0xfc, 0xfc, 0xdc, 0xfc, 0xfc, 0x7c},
+    [EMAIL_SET_LDH] = {0xa8, 0xf8, 0xf8, 0xf8, 0xf8, 0xf8, 0xf8, 0xf8, 0xf8, 0xf8, 0xf0, 0x50, 0x50, 0x54, 0x54, 0x50},
+    [EMAIL_SET_PLAIN] = {0xec, 0xfc, 0xf8, 0xfc, 0xfc, 0xfc, 0xfc, 0xfc, 0xfc, 0xfc, 0xfc, 0xfc, 0xdc, 0xfc, 0xfc, 0x7c},
+};
+
+/* Bit selected by the high nibble; none for bytes outside ASCII */
+static const uint8_t high_nibble_bit[16] = {
+    0x01, 0x02, 0x04, 0x08, 0x10, 0x20, 0x40, 0x80,
+    0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
+};
+
+/*
+ * Scalar kernels, also used for the tails of the vector kernels
+ */
+static size_t
+email_span_scalar(const char *s, const size_t len, const EmailCharSet set) {
+    const uint8_t *bitmap = set_bitmap[set];
+
+    for (size_t i = 0; i < len; i++) {
+        const unsigned char c = s[i];
+
+        if ((bitmap[c & 0x0f] & high_nibble_bit[c >> 4]) == 0)
+            return i;
+    }
+    return len;
+}
+
+static bool
+email_lower_scalar(char *dest, const char *src, const size_t len) {
+    bool changed = false;
+
+    for (size_t i = 0; i < len; i++) {
+        const unsigned char c = src[i];
+
+        if (EMAIL_CHAR_IS(c, EMAIL_CHAR_UPPER)) {
+            dest[i] = c + ('a' - 'A');
+            changed = true;
+        } else
+            dest[i] = c;
+    }
+    return changed;
+}
+
+size_t (*email_span)(const char *s, size_t len, EmailCharSet set) = email_span_scalar;
+bool (*email_lower)(char *dest, const char *src, size_t len) = email_lower_scalar;
+
+static const char *email_simd_impl = "scalar";
+
+#ifdef EMAIL_SIMD_X86
+
+__attribute__((target("ssse3")))
+static size_t
+email_span_ssse3(const char *s, const size_t len, const EmailCharSet set) {
+    const __m128i bitmap = _mm_loadu_si128((const __m128i *) set_bitmap[set]);
+    const __m128i high_bits = _mm_loadu_si128((const __m128i *) high_nibble_bit);
+    const __m128i nibble = _mm_set1_epi8(0x0f);
+    size_t i = 0;
+
+    for (; i + 16 <= len; i += 16) {
+        const __m128i v = _mm_loadu_si128((const __m128i *) (s + i));
+        const __m128i lo = _mm_shuffle_epi8(bitmap, _mm_and_si128(v, nibble));
+        const __m128i hi = _mm_shuffle_epi8(high_bits, _mm_and_si128(_mm_srli_epi16(v, 4), nibble));
+        const __m128i outside = _mm_cmpeq_epi8(_mm_and_si128(lo, hi), _mm_setzero_si128());
+        const int mask = _mm_movemask_epi8(outside);
+
+        if (mask != 0)
+            return i + __builtin_ctz(mask);
+    }
+    return i + email_span_scalar(s + i, len - i, set);
+}
+
+__attribute__((target("avx2")))
+static size_t
+email_span_avx2(const char *s, const size_t len, const EmailCharSet set) {
+    const __m256i bitmap = _mm256_broadcastsi128_si256(_mm_loadu_si128((const __m128i *) set_bitmap[set]));
+    const __m256i high_bits = _mm256_broadcastsi128_si256(_mm_loadu_si128((const __m128i *) high_nibble_bit));
+    const __m256i nibble = _mm256_set1_epi8(0x0f);
+    size_t i = 0;
+
+    for (; i + 32 <= len; i += 32) {
+        const __m256i v = _mm256_loadu_si256((const __m256i *) (s + i));
+        const __m256i lo = _mm256_shuffle_epi8(bitmap, _mm256_and_si256(v, nibble));
+        const __m256i hi = _mm256_shuffle_epi8(high_bits, _mm256_and_si256(_mm256_srli_epi16(v, 4), nibble));
+        const __m256i outside = _mm256_cmpeq_epi8(_mm256_and_si256(lo, hi), _mm256_setzero_si256());
+        const unsigned int mask = _mm256_movemask_epi8(outside);
+
+        if (mask != 0)
+            return i + __builtin_ctz(mask);
+    }
+
+    /*
+     * The tail kernel is legacy-SSE encoded; entering it with the upper
+     * halves dirty costs a state transition per call
+     */
+    _mm256_zeroupper();
+    return i + email_span_ssse3(s + i, len - i, set);
+}
+
+/* SSE2 is part of x86-64, so no target attribute is needed */
+static bool
+email_lower_sse2(char *dest, const char *src, const size_t len) {
+    const __m128i before_a = _mm_set1_epi8('A' - 1);
+    const __m128i after_z = _mm_set1_epi8('Z' + 1);
+    const __m128i case_bit = _mm_set1_epi8(0x20);
+    __m128i any = _mm_setzero_si128();
+    size_t i = 0;
+
+    for (; i + 16 <= len; i += 16) {
+        const __m128i v = _mm_loadu_si128((const __m128i *) (src + i));
+        /* Signed compares: bytes >= 0x80 are negative and never uppercase */
+        const __m128i upper = _mm_and_si128(_mm_cmpgt_epi8(v, before_a), _mm_cmplt_epi8(v, after_z));
+
+        _mm_storeu_si128((__m128i *) (dest + i), _mm_or_si128(v, _mm_and_si128(upper, case_bit)));
+        any = _mm_or_si128(any, upper);
+    }
+
+    const bool changed = _mm_movemask_epi8(any) != 0;
+    return email_lower_scalar(dest + i, src + i, len - i) || changed;
+}
+
+__attribute__((target("avx2")))
+static bool
+email_lower_avx2(char *dest, const char *src, const size_t len) {
+    const __m256i before_a = _mm256_set1_epi8('A' - 1);
+    const __m256i after_z = _mm256_set1_epi8('Z' + 1);
+    const __m256i case_bit = _mm256_set1_epi8(0x20);
+    __m256i any = _mm256_setzero_si256();
+    size_t i = 0;
+
+    for (; i + 32 <= len; i += 32) {
+        const __m256i v = _mm256_loadu_si256((const __m256i *) (src + i));
+        const __m256i upper = _mm256_and_si256(_mm256_cmpgt_epi8(v, before_a), _mm256_cmpgt_epi8(after_z, v));
+
+        _mm256_storeu_si256((__m256i *) (dest + i), _mm256_or_si256(v, _mm256_and_si256(upper, case_bit)));
+        any = _mm256_or_si256(any, upper);
+    }
+
+    const bool changed = _mm256_movemask_epi8(any) != 0;
+
+    /* As in email_span_avx2 */
+    _mm256_zeroupper();
+    return email_lower_sse2(dest + i, src + i, len - i) || changed;
+}
+
+#endif /* EMAIL_SIMD_X86 */
+
+#ifdef EMAIL_SIMD_NEON
+
+static size_t
+email_span_neon(const char *s, const size_t len, const EmailCharSet set) {
+    const uint8x16_t bitmap = vld1q_u8(set_bitmap[set]);
+    const uint8x16_t high_bits = vld1q_u8(high_nibble_bit);
+    const uint8x16_t nibble = vdupq_n_u8(0x0f);
+    size_t i = 0;
+
+    for (; i + 16 <= len; i += 16) {
+        const uint8x16_t v = vld1q_u8((const uint8_t *) (s + i));
+        const uint8x16_t lo = vqtbl1q_u8(bitmap, vandq_u8(v, nibble));
+        const uint8x16_t hi = vqtbl1q_u8(high_bits, vshrq_n_u8(v, 4));
+
+        /* 0xff for bytes in the set; locate the first miss in scalar code */
+        if (vminvq_u8(vtstq_u8(lo, hi)) == 0)
+            return i + email_span_scalar(s + i, 16, set);
+    }
+    return i + email_span_scalar(s + i, len - i, set);
+}
+
+static bool
+email_lower_neon(char *dest, const char *src, const size_t len) {
+    const uint8x16_t a = vdupq_n_u8('A');
+    const uint8x16_t z = vdupq_n_u8('Z');
+    const uint8x16_t case_bit = vdupq_n_u8(0x20);
+    uint8x16_t any = vdupq_n_u8(0);
+    size_t i = 0;
+
+    for (; i + 16 <= len; i += 16) {
+        const uint8x16_t v = vld1q_u8((const uint8_t *) (src + i));
+        const uint8x16_t upper = vandq_u8(vcgeq_u8(v, a), vcleq_u8(v, z));
+
+        vst1q_u8((uint8_t *) (dest + i), vorrq_u8(v, vandq_u8(upper, case_bit)));
+        any = vorrq_u8(any, upper);
+    }
+
+    const bool changed = vmaxvq_u8(any) != 0;
+    return email_lower_scalar(dest + i, src + i, len - i) || changed;
+}
+
+#endif /* EMAIL_SIMD_NEON */
+
+void
+email_simd_init(void) {
+#if defined(EMAIL_SIMD_X86)
+    __builtin_cpu_init();
+    if (__builtin_cpu_supports("avx2")) {
+        email_span = email_span_avx2;
+        email_lower = email_lower_avx2;
+        email_simd_impl = "avx2";
+    } else if (__builtin_cpu_supports("ssse3")) {
+        email_span = email_span_ssse3;
+        email_lower = email_lower_sse2;
+        email_simd_impl = "ssse3";
+    } else {
+        email_lower = email_lower_sse2;
+    }
+#elif defined(EMAIL_SIMD_NEON)
+    email_span = email_span_neon;
+    email_lower = email_lower_neon;
+    email_simd_impl = "neon";
+#endif
+}
+
+const char *
+email_simd_name(void) {
+    return email_simd_impl;
+}
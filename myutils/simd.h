@@ -0,0 +1,45 @@
+//
+// Vectorised character-class kernels for the validators.
+//
+
+#ifndef SIMD_H
+#define SIMD_H
+
+#include "common.h"
+
+/*
+ * Character sets the kernels can scan for. All of them are subsets of
+ * ASCII; bytes with the high bit set never belong to a set.
+ */
+typedef enum {
+    EMAIL_SET_ATEXT,        /* unquoted local-part characters and dot */
+    EMAIL_SET_QTEXT,        /* quoted local-part characters */
+    EMAIL_SET_LDH,          /* letters, digits, hyphen and dot */
+    EMAIL_SET_PLAIN,        /* printable ASCII except quote, backslash and @ */
+    EMAIL_NUM_SETS
+} EmailCharSet;
+
+/*
+ * Returns the length of the longest prefix of s[0..len) whose bytes all
+ * belong to set
+ */
+extern size_t (*email_span)(const char *s, size_t len, EmailCharSet set);
+
+/*
+ * ASCII-lowercase src[0..len) into dest, which may be the same buffer.
+ * Returns true if any byte changed.
+ */
+extern bool (*email_lower)(char *dest, const char *src, size_t len);
+
+/*
+ * Selects the fastest kernels the CPU supports. Until this is called the
+ * scalar kernels are used.
+ */
+void email_simd_init(void);
+
+/*
+ * Name of the selected kernels: "avx2", "ssse3", "neon" or "scalar"
+ */
+const char *email_simd_name(void);
+
+#endif //SIMD_H
@@ -0,0 +1,1591 @@
+-- complain if script is sourced in psql, rather than via ALTER EXTENSION
+\echo Use "ALTER EXTENSION pg_email_opt UPDATE TO '1.1'" to load this file. \quit
+
+-- Input with the interned modifier reads email_addr_domain_dict and adds
+-- new domains to it. Input functions are always called with the type
+-- oid and modifier, so the one-argument declaration of 1.0 is kept.
+ALTER FUNCTION email_addr_in(cstring) STABLE PARALLEL UNSAFE;
+
+-- The 1.0 functions are all parallel safe
+ALTER FUNCTION email_addr_out(email_addr) PARALLEL SAFE;
+ALTER FUNCTION email_addr_lt(email_addr, email_addr) PARALLEL SAFE;
+ALTER FUNCTION email_addr_le(email_addr, email_addr) PARALLEL SAFE;
+ALTER FUNCTION email_addr_eq(email_addr, email_addr) PARALLEL SAFE;
+ALTER FUNCTION email_addr_ne(email_addr, email_addr) PARALLEL SAFE;
+ALTER FUNCTION email_addr_ge(email_addr, email_addr) PARALLEL SAFE;
+ALTER FUNCTION email_addr_gt(email_addr, email_addr) PARALLEL SAFE;
+ALTER FUNCTION email_hash(email_addr) PARALLEL SAFE;
+ALTER FUNCTION email_addr_cmp(email_addr, email_addr) PARALLEL SAFE;
+ALTER FUNCTION email_addr_domain_lt(email_addr, email_addr) PARALLEL SAFE;
+ALTER FUNCTION email_addr_domain_le(email_addr, email_addr) PARALLEL SAFE;
+ALTER FUNCTION email_addr_domain_eq(email_addr, email_addr) PARALLEL SAFE;
+ALTER FUNCTION email_addr_domain_ne(email_addr, email_addr) PARALLEL SAFE;
+ALTER FUNCTION email_addr_domain_ge(email_addr, email_addr) PARALLEL SAFE;
+ALTER FUNCTION email_addr_domain_gt(email_addr, email_addr) PARALLEL SAFE;
+ALTER FUNCTION email_addr_domain_cmp(email_addr, email_addr) PARALLEL SAFE;
+ALTER FUNCTION email_addr_get_local_part(email_addr) PARALLEL SAFE;
+ALTER FUNCTION email_addr_get_domain(email_addr) PARALLEL SAFE;
+ALTER FUNCTION email_addr_normalized_local_part(email_addr) PARALLEL SAFE;
+ALTER FUNCTION email_addr_normalized_domain(email_addr) PARALLEL SAFE;
+ALTER FUNCTION email_addr_normalize(email_addr) PARALLEL SAFE;
+ALTER FUNCTION email_addr_normalize_text(email_addr) PARALLEL SAFE;
+ALTER FUNCTION email_addr_normalize_eq(email_addr, email_addr) PARALLEL SAFE;
+ALTER FUNCTION email_addr_cast_to_text(email_addr) PARALLEL SAFE;
+ALTER FUNCTION text_cast_to_email_addr(text) PARALLEL SAFE;
+ALTER FUNCTION email_addr_cast_to_varchar(email_addr) PARALLEL SAFE;
+ALTER FUNCTION varchar_cast_to_email_addr(varchar) PARALLEL SAFE;
+ALTER FUNCTION email_addr_cast_to_name(email_addr) PARALLEL SAFE;
+ALTER FUNCTION name_cast_to_email_addr(name) PARALLEL SAFE;
+
+-- Binary I/O functions
+CREATE FUNCTION email_addr_recv(internal, oid, integer)
+    RETURNS email_addr
+AS 'MODULE_PATHNAME'
+LANGUAGE C STABLE STRICT PARALLEL UNSAFE;
+
+CREATE FUNCTION email_addr_send(email_addr)
+    RETURNS bytea
+AS 'MODULE_PATHNAME'
+LANGUAGE C IMMUTABLE STRICT PARALLEL SAFE;
+
+-- Type modifier functions: email_addr(interned)
+CREATE FUNCTION email_addr_typmod_in(cstring[])
+    RETURNS integer
+AS 'MODULE_PATHNAME'
+LANGUAGE C IMMUTABLE STRICT PARALLEL SAFE;
+
+CREATE FUNCTION email_addr_typmod_out(integer)
+    RETURNS cstring
+AS 'MODULE_PATHNAME'
+LANGUAGE C IMMUTABLE STRICT PARALLEL SAFE;
+
+-- Statistics: standard ones plus domain MCVs, histogram and ndistinct
+CREATE FUNCTION email_addr_typanalyze(internal)
+    RETURNS boolean
+AS 'MODULE_PATHNAME'
+LANGUAGE C STRICT PARALLEL SAFE;
+
+-- Version 0 datums stay readable and are rewritten in the version 1
+-- layout when they are next written. The storage applies to new
+-- columns; existing ones keep theirs until ALTER TABLE ... SET STORAGE.
+ALTER TYPE email_addr SET (
+    RECEIVE = email_addr_recv,
+    SEND = email_addr_send,
+    TYPMOD_IN = email_addr_typmod_in,
+    TYPMOD_OUT = email_addr_typmod_out,
+    ANALYZE = email_addr_typanalyze,
+    STORAGE = MAIN
+);
+
+-- Dictionary of interned domains, used by email_addr(interned) columns.
+-- Append-only: ids are stored in column data and must never change.
+-- Anyone can add domains, so only canonical ones are accepted: lowercase
+-- host names or IP literals that fit in an address. Not dumped: the
+-- addresses are dumped as text, and restoring them interns their domains.
+CREATE TABLE email_addr_domain_dict (
+    id serial PRIMARY KEY,
+    domain text NOT NULL UNIQUE
+        CHECK (octet_length(domain) <= 255)
+        CHECK (domain ~ '^(([a-z0-9]([a-z0-9-]{0,61}[a-z0-9])?\.)+[a-z0-9]([a-z0-9-]{0,61}[a-z0-9])?|\[[0-9a-z.:]+\])$')
+);
+
+GRANT SELECT ON email_addr_domain_dict TO PUBLIC;
+
+-- The only way domains are added: ids come from the sequence, as the
+-- extension owner. Returns NULL if the domain was there already.
+CREATE FUNCTION email_addr_domain_dict_add(text)
+    RETURNS integer
+AS $$
+    INSERT INTO @extschema@.email_addr_domain_dict (domain) VALUES ($1)
+    ON CONFLICT (domain) DO NOTHING
+    RETURNING id
+$$ LANGUAGE sql VOLATILE STRICT PARALLEL UNSAFE SECURITY DEFINER
+SET search_path = pg_catalog, pg_temp;
+
+-- Length coercion: applies the interned modifier on assignment, which
+-- may insert into email_addr_domain_dict
+CREATE FUNCTION email_addr(email_addr, integer, boolean)
+    RETURNS email_addr
+AS 'MODULE_PATHNAME', 'email_addr_apply_typmod'
+LANGUAGE C VOLATILE STRICT PARALLEL UNSAFE;
+
+CREATE CAST (email_addr AS email_addr)
+    WITH FUNCTION email_addr(email_addr, integer, boolean)
+AS IMPLICIT;
+
+-- Seeded 64-bit hash function for hash partitioning
+CREATE FUNCTION email_hash_extended(email_addr, int8)
+    RETURNS int8
+AS 'MODULE_PATHNAME'
+LANGUAGE C IMMUTABLE STRICT PARALLEL SAFE;
+
+-- B-tree sort support (direct comparator and abbreviated keys)
+CREATE FUNCTION email_addr_sortsupport(internal)
+    RETURNS void
+AS 'MODULE_PATHNAME'
+    LANGUAGE C IMMUTABLE STRICT PARALLEL SAFE;
+
+ALTER OPERATOR FAMILY email_addr_ops USING btree ADD
+    FUNCTION    2   (email_addr, email_addr) email_addr_sortsupport(internal);
+
+ALTER OPERATOR FAMILY email_addr_hash_ops USING hash ADD
+    FUNCTION    2   (email_addr, email_addr) email_hash_extended(email_addr, int8);
+
+-- Comparison with addresses in text form, parsed in place
+CREATE FUNCTION email_addr_text_support(internal)
+    RETURNS internal
+AS 'MODULE_PATHNAME'
+LANGUAGE C IMMUTABLE STRICT PARALLEL SAFE;
+
+CREATE FUNCTION email_addr_text_cmp(email_addr, text)
+    RETURNS integer
+AS 'MODULE_PATHNAME'
+LANGUAGE C IMMUTABLE STRICT PARALLEL SAFE;
+
+CREATE FUNCTION email_addr_text_eq(email_addr, text)
+    RETURNS boolean
+AS 'MODULE_PATHNAME'
+LANGUAGE C IMMUTABLE STRICT PARALLEL SAFE
+SUPPORT email_addr_text_support;
+
+CREATE FUNCTION email_addr_text_ne(email_addr, text)
+    RETURNS boolean
+AS 'MODULE_PATHNAME'
+LANGUAGE C IMMUTABLE STRICT PARALLEL SAFE
+SUPPORT email_addr_text_support;
+
+CREATE FUNCTION email_addr_text_lt(email_addr, text)
+    RETURNS boolean
+AS 'MODULE_PATHNAME'
+LANGUAGE C IMMUTABLE STRICT PARALLEL SAFE
+SUPPORT email_addr_text_support;
+
+CREATE FUNCTION email_addr_text_le(email_addr, text)
+    RETURNS boolean
+AS 'MODULE_PATHNAME'
+LANGUAGE C IMMUTABLE STRICT PARALLEL SAFE
+SUPPORT email_addr_text_support;
+
+CREATE FUNCTION email_addr_text_gt(email_addr, text)
+    RETURNS boolean
+AS 'MODULE_PATHNAME'
+LANGUAGE C IMMUTABLE STRICT PARALLEL SAFE
+SUPPORT email_addr_text_support;
+
+CREATE FUNCTION email_addr_text_ge(email_addr, text)
+    RETURNS boolean
+AS 'MODULE_PATHNAME'
+LANGUAGE C IMMUTABLE STRICT PARALLEL SAFE
+SUPPORT email_addr_text_support;
+
+CREATE FUNCTION text_email_addr_cmp(text, email_addr)
+    RETURNS integer
+AS 'MODULE_PATHNAME'
+LANGUAGE C IMMUTABLE STRICT PARALLEL SAFE;
+
+CREATE FUNCTION text_email_addr_eq(text, email_addr)
+    RETURNS boolean
+AS 'MODULE_PATHNAME'
+LANGUAGE C IMMUTABLE STRICT PARALLEL SAFE
+SUPPORT email_addr_text_support;
+
+CREATE FUNCTION text_email_addr_ne(text, email_addr)
+    RETURNS boolean
+AS 'MODULE_PATHNAME'
+LANGUAGE C IMMUTABLE STRICT PARALLEL SAFE
+SUPPORT email_addr_text_support;
+
+CREATE FUNCTION text_email_addr_lt(text, email_addr)
+    RETURNS boolean
+AS 'MODULE_PATHNAME'
+LANGUAGE C IMMUTABLE STRICT PARALLEL SAFE
+SUPPORT email_addr_text_support;
+
+CREATE FUNCTION text_email_addr_le(text, email_addr)
+    RETURNS boolean
+AS 'MODULE_PATHNAME'
+LANGUAGE C IMMUTABLE STRICT PARALLEL SAFE
+SUPPORT email_addr_text_support;
+
+CREATE FUNCTION text_email_addr_gt(text, email_addr)
+    RETURNS boolean
+AS 'MODULE_PATHNAME'
+LANGUAGE C IMMUTABLE STRICT PARALLEL SAFE
+SUPPORT email_addr_text_support;
+
+CREATE FUNCTION text_email_addr_ge(text, email_addr)
+    RETURNS boolean
+AS 'MODULE_PATHNAME'
+LANGUAGE C IMMUTABLE STRICT PARALLEL SAFE
+SUPPORT email_addr_text_support;
+
+CREATE FUNCTION email_text_hash(text)
+    RETURNS integer
+AS 'MODULE_PATHNAME'
+LANGUAGE C IMMUTABLE STRICT PARALLEL SAFE;
+
+CREATE FUNCTION email_text_hash_extended(text, int8)
+    RETURNS int8
+AS 'MODULE_PATHNAME'
+LANGUAGE C IMMUTABLE STRICT PARALLEL SAFE;
+
+CREATE OPERATOR = (
+    LEFTARG = email_addr,
+    RIGHTARG = text,
+    PROCEDURE = email_addr_text_eq,
+    COMMUTATOR = =,
+    NEGATOR = <>,
+    RESTRICT = eqsel,
+    JOIN = eqjoinsel,
+    HASHES
+);
+
+CREATE OPERATOR <> (
+    LEFTARG = email_addr,
+    RIGHTARG = text,
+    PROCEDURE = email_addr_text_ne,
+    COMMUTATOR = <>,
+    NEGATOR = =,
+    RESTRICT = neqsel,
+    JOIN = neqjoinsel
+);
+
+CREATE OPERATOR < (
+    LEFTARG = email_addr,
+    RIGHTARG = text,
+    PROCEDURE = email_addr_text_lt,
+    COMMUTATOR = >,
+    NEGATOR = >=,
+    RESTRICT = scalarltsel,
+    JOIN = scalarltjoinsel
+);
+
+CREATE OPERATOR <= (
+    LEFTARG = email_addr,
+    RIGHTARG = text,
+    PROCEDURE = email_addr_text_le,
+    COMMUTATOR = >=,
+    NEGATOR = >,
+    RESTRICT = scalarlesel,
+    JOIN = scalarlejoinsel
+);
+
+CREATE OPERATOR > (
+    LEFTARG = email_addr,
+    RIGHTARG = text,
+    PROCEDURE = email_addr_text_gt,
+    COMMUTATOR = <,
+    NEGATOR = <=,
+    RESTRICT = scalargtsel,
+    JOIN = scalargtjoinsel
+);
+
+CREATE OPERATOR >= (
+    LEFTARG = email_addr,
+    RIGHTARG = text,
+    PROCEDURE = email_addr_text_ge,
+    COMMUTATOR = <=,
+    NEGATOR = <,
+    RESTRICT = scalargesel,
+    JOIN = scalargejoinsel
+);
+
+CREATE OPERATOR = (
+    LEFTARG = text,
+    RIGHTARG = email_addr,
+    PROCEDURE = text_email_addr_eq,
+    COMMUTATOR = =,
+    NEGATOR = <>,
+    RESTRICT = eqsel,
+    JOIN = eqjoinsel,
+    HASHES
+);
+
+CREATE OPERATOR <> (
+    LEFTARG = text,
+    RIGHTARG = email_addr,
+    PROCEDURE = text_email_addr_ne,
+    COMMUTATOR = <>,
+    NEGATOR = =,
+    RESTRICT = neqsel,
+    JOIN = neqjoinsel
+);
+
+CREATE OPERATOR < (
+    LEFTARG = text,
+    RIGHTARG = email_addr,
+    PROCEDURE = text_email_addr_lt,
+    COMMUTATOR = >,
+    NEGATOR = >=,
+    RESTRICT = scalarltsel,
+    JOIN = scalarltjoinsel
+);
+
+CREATE OPERATOR <= (
+    LEFTARG = text,
+    RIGHTARG = email_addr,
+    PROCEDURE = text_email_addr_le,
+    COMMUTATOR = >=,
+    NEGATOR = >,
+    RESTRICT = scalarlesel,
+    JOIN = scalarlejoinsel
+);
+
+CREATE OPERATOR > (
+    LEFTARG = text,
+    RIGHTARG = email_addr,
+    PROCEDURE = text_email_addr_gt,
+    COMMUTATOR = <,
+    NEGATOR = <=,
+    RESTRICT = scalargtsel,
+    JOIN = scalargtjoinsel
+);
+
+CREATE OPERATOR >= (
+    LEFTARG = text,
+    RIGHTARG = email_addr,
+    PROCEDURE = text_email_addr_ge,
+    COMMUTATOR = <=,
+    NEGATOR = <,
+    RESTRICT = scalargesel,
+    JOIN = scalargejoinsel
+);
+
+ALTER OPERATOR FAMILY email_addr_ops USING btree ADD
+    OPERATOR    1   < (email_addr, text),
+    OPERATOR    2   <= (email_addr, text),
+    OPERATOR    3   = (email_addr, text),
+    OPERATOR    4   >= (email_addr, text),
+    OPERATOR    5   > (email_addr, text),
+    FUNCTION    1   (email_addr, text) email_addr_text_cmp(email_addr, text),
+    OPERATOR    1   < (text, email_addr),
+    OPERATOR    2   <= (text, email_addr),
+    OPERATOR    3   = (text, email_addr),
+    OPERATOR    4   >= (text, email_addr),
+    OPERATOR    5   > (text, email_addr),
+    FUNCTION    1   (text, email_addr) text_email_addr_cmp(text, email_addr);
+
+ALTER OPERATOR FAMILY email_addr_hash_ops USING hash ADD
+    OPERATOR    1   = (email_addr, text),
+    OPERATOR    1   = (text, email_addr),
+    FUNCTION    1   (text, text) email_text_hash(text),
+    FUNCTION    2   (text, text) email_text_hash_extended(text, int8);
+
+-- Selectivity estimation from the domain statistics
+CREATE FUNCTION email_addr_domain_eqsel(internal, oid, internal, integer)
+    RETURNS float8
+AS 'MODULE_PATHNAME'
+LANGUAGE C STABLE STRICT PARALLEL SAFE;
+
+CREATE FUNCTION email_addr_domain_neqsel(internal, oid, internal, integer)
+    RETURNS float8
+AS 'MODULE_PATHNAME'
+LANGUAGE C STABLE STRICT PARALLEL SAFE;
+
+CREATE FUNCTION email_addr_domain_ltsel(internal, oid, internal, integer)
+    RETURNS float8
+AS 'MODULE_PATHNAME'
+LANGUAGE C STABLE STRICT PARALLEL SAFE;
+
+CREATE FUNCTION email_addr_domain_lesel(internal, oid, internal, integer)
+    RETURNS float8
+AS 'MODULE_PATHNAME'
+LANGUAGE C STABLE STRICT PARALLEL SAFE;
+
+CREATE FUNCTION email_addr_domain_gtsel(internal, oid, internal, integer)
+    RETURNS float8
+AS 'MODULE_PATHNAME'
+LANGUAGE C STABLE STRICT PARALLEL SAFE;
+
+CREATE FUNCTION email_addr_domain_gesel(internal, oid, internal, integer)
+    RETURNS float8
+AS 'MODULE_PATHNAME'
+LANGUAGE C STABLE STRICT PARALLEL SAFE;
+
+CREATE FUNCTION email_addr_domain_eqjoinsel(internal, oid, internal, smallint, internal)
+    RETURNS float8
+AS 'MODULE_PATHNAME'
+LANGUAGE C STABLE STRICT PARALLEL SAFE;
+
+CREATE FUNCTION email_addr_domain_neqjoinsel(internal, oid, internal, smallint, internal)
+    RETURNS float8
+AS 'MODULE_PATHNAME'
+LANGUAGE C STABLE STRICT PARALLEL SAFE;
+
+ALTER OPERATOR <# (email_addr, email_addr)
+    SET (RESTRICT = email_addr_domain_ltsel);
+ALTER OPERATOR <=# (email_addr, email_addr)
+    SET (RESTRICT = email_addr_domain_lesel, JOIN = scalarlejoinsel);
+ALTER OPERATOR =# (email_addr, email_addr)
+    SET (RESTRICT = email_addr_domain_eqsel, JOIN = email_addr_domain_eqjoinsel);
+ALTER OPERATOR >=# (email_addr, email_addr)
+    SET (RESTRICT = email_addr_domain_gesel, JOIN = scalargejoinsel);
+ALTER OPERATOR ># (email_addr, email_addr)
+    SET (RESTRICT = email_addr_domain_gtsel);
+
+-- 1.0 created domain inequality as <>##, leaving <># a shell: this
+-- fills in the shell, and <>## is dropped below
+CREATE OPERATOR <># (
+    LEFTARG = email_addr,
+    RIGHTARG = email_addr,
+    PROCEDURE = email_addr_domain_ne,
+    COMMUTATOR = <>#,
+    NEGATOR = =#,
+    RESTRICT = email_addr_domain_neqsel,
+    JOIN = email_addr_domain_neqjoinsel
+);
+
+CREATE FUNCTION email_addr_domain_sortsupport(internal)
+    RETURNS void
+AS 'MODULE_PATHNAME'
+LANGUAGE C IMMUTABLE STRICT PARALLEL SAFE;
+
+ALTER OPERATOR FAMILY email_addr_domain_ops USING btree ADD
+    FUNCTION    2   (email_addr, email_addr) email_addr_domain_sortsupport(internal);
+
+-- Hash of the domain alone, consistent with =#
+CREATE FUNCTION email_addr_domain_hash(email_addr)
+    RETURNS integer
+AS 'MODULE_PATHNAME'
+LANGUAGE C IMMUTABLE STRICT PARALLEL SAFE;
+
+-- BRIN operator classes: block range minimum and maximum in address or
+-- domain order, and bloom filters of address or domain hashes
+CREATE OPERATOR CLASS email_addr_minmax_ops
+DEFAULT FOR TYPE email_addr USING brin AS
+    OPERATOR    1   <,
+    OPERATOR    2   <=,
+    OPERATOR    3   =,
+    OPERATOR    4   >=,
+    OPERATOR    5   >,
+    FUNCTION    1   brin_minmax_opcinfo(internal),
+    FUNCTION    2   brin_minmax_add_value(internal, internal, internal, internal),
+    FUNCTION    3   brin_minmax_consistent(internal, internal, internal),
+    FUNCTION    4   brin_minmax_union(internal, internal, internal);
+
+CREATE OPERATOR CLASS email_addr_domain_minmax_ops
+FOR TYPE email_addr USING brin AS
+    OPERATOR    1   <#,
+    OPERATOR    2   <=#,
+    OPERATOR    3   =#,
+    OPERATOR    4   >=#,
+    OPERATOR    5   >#,
+    FUNCTION    1   brin_minmax_opcinfo(internal),
+    FUNCTION    2   brin_minmax_add_value(internal, internal, internal, internal),
+    FUNCTION    3   brin_minmax_consistent(internal, internal, internal),
+    FUNCTION    4   brin_minmax_union(internal, internal, internal);
+
+CREATE OPERATOR CLASS email_addr_bloom_ops
+FOR TYPE email_addr USING brin AS
+    OPERATOR    1   =,
+    FUNCTION    1   brin_bloom_opcinfo(internal),
+    FUNCTION    2   brin_bloom_add_value(internal, internal, internal, internal),
+    FUNCTION    3   brin_bloom_consistent(internal, internal, internal, int4),
+    FUNCTION    4   brin_bloom_union(internal, internal, internal),
+    FUNCTION    5   brin_bloom_options(internal),
+    FUNCTION    11  email_hash(email_addr);
+
+CREATE OPERATOR CLASS email_addr_domain_bloom_ops
+FOR TYPE email_addr USING brin AS
+    OPERATOR    1   =#,
+    FUNCTION    1   brin_bloom_opcinfo(internal),
+    FUNCTION    2   brin_bloom_add_value(internal, internal, internal, internal),
+    FUNCTION    3   brin_bloom_consistent(internal, internal, internal, int4),
+    FUNCTION    4   brin_bloom_union(internal, internal, internal),
+    FUNCTION    5   brin_bloom_options(internal),
+    FUNCTION    11  email_addr_domain_hash(email_addr);
+
+-- Reverse-label domain order: labels compared right to left, each by
+-- length and then bytewise, so that subdomains of a domain are adjacent
+CREATE FUNCTION email_addr_domain_rev_cmp(email_addr, email_addr)
+    RETURNS integer
+AS 'MODULE_PATHNAME'
+LANGUAGE C IMMUTABLE STRICT PARALLEL SAFE;
+
+CREATE FUNCTION email_addr_domain_rev_lt(email_addr, email_addr)
+    RETURNS boolean
+AS 'MODULE_PATHNAME'
+LANGUAGE C IMMUTABLE STRICT PARALLEL SAFE;
+
+CREATE FUNCTION email_addr_domain_rev_le(email_addr, email_addr)
+    RETURNS boolean
+AS 'MODULE_PATHNAME'
+LANGUAGE C IMMUTABLE STRICT PARALLEL SAFE;
+
+CREATE FUNCTION email_addr_domain_rev_ge(email_addr, email_addr)
+    RETURNS boolean
+AS 'MODULE_PATHNAME'
+LANGUAGE C IMMUTABLE STRICT PARALLEL SAFE;
+
+CREATE FUNCTION email_addr_domain_rev_gt(email_addr, email_addr)
+    RETURNS boolean
+AS 'MODULE_PATHNAME'
+LANGUAGE C IMMUTABLE STRICT PARALLEL SAFE;
+
+CREATE OPERATOR <~# (
+    LEFTARG = email_addr,
+    RIGHTARG = email_addr,
+    PROCEDURE = email_addr_domain_rev_lt,
+    COMMUTATOR = >~#,
+    NEGATOR = >=~#,
+    RESTRICT = scalarltsel,
+    JOIN = scalarltjoinsel
+);
+
+CREATE OPERATOR <=~# (
+    LEFTARG = email_addr,
+    RIGHTARG = email_addr,
+    PROCEDURE = email_addr_domain_rev_le,
+    COMMUTATOR = >=~#,
+    NEGATOR = >~#,
+    RESTRICT = scalarlesel,
+    JOIN = scalarlejoinsel
+);
+
+CREATE OPERATOR >=~# (
+    LEFTARG = email_addr,
+    RIGHTARG = email_addr,
+    PROCEDURE = email_addr_domain_rev_ge,
+    COMMUTATOR = <=~#,
+    NEGATOR = <~#,
+    RESTRICT = scalargesel,
+    JOIN = scalargejoinsel
+);
+
+CREATE OPERATOR >~# (
+    LEFTARG = email_addr,
+    RIGHTARG = email_addr,
+    PROCEDURE = email_addr_domain_rev_gt,
+    COMMUTATOR = <~#,
+    NEGATOR = <=~#,
+    RESTRICT = scalargtsel,
+    JOIN = scalargtjoinsel
+);
+
+CREATE OPERATOR CLASS email_addr_domain_rev_ops
+FOR TYPE email_addr USING btree AS
+    OPERATOR    1   <~#,
+    OPERATOR    2   <=~#,
+    OPERATOR    3   =#,
+    OPERATOR    4   >=~#,
+    OPERATOR    5   >~#,
+    FUNCTION    1   email_addr_domain_rev_cmp(email_addr, email_addr);
+
+-- Subdomain match, indexable through email_addr_domain_rev_ops
+CREATE FUNCTION email_addr_domain_suffix_support(internal)
+    RETURNS internal
+AS 'MODULE_PATHNAME'
+LANGUAGE C IMMUTABLE STRICT PARALLEL SAFE;
+
+CREATE FUNCTION email_addr_domain_suffix(email_addr, text)
+    RETURNS boolean
+AS 'MODULE_PATHNAME'
+LANGUAGE C IMMUTABLE STRICT PARALLEL SAFE
+SUPPORT email_addr_domain_suffix_support;
+
+CREATE OPERATOR <@# (
+    LEFTARG = email_addr,
+    RIGHTARG = text,
+    PROCEDURE = email_addr_domain_suffix,
+    RESTRICT = matchingsel,
+    JOIN = matchingjoinsel
+);
+
+-- Domain equality with a domain in text form; a constant operand is
+-- rewritten to =# (email_addr, email_addr), so its indexes apply
+CREATE FUNCTION email_addr_domain_text_support(internal)
+    RETURNS internal
+AS 'MODULE_PATHNAME'
+LANGUAGE C IMMUTABLE STRICT PARALLEL SAFE;
+
+CREATE FUNCTION email_addr_domain_eq_text(email_addr, text)
+    RETURNS boolean
+AS 'MODULE_PATHNAME'
+LANGUAGE C IMMUTABLE STRICT PARALLEL SAFE
+SUPPORT email_addr_domain_text_support;
+
+CREATE FUNCTION email_addr_domain_ne_text(email_addr, text)
+    RETURNS boolean
+AS 'MODULE_PATHNAME'
+LANGUAGE C IMMUTABLE STRICT PARALLEL SAFE
+SUPPORT email_addr_domain_text_support;
+
+CREATE FUNCTION text_domain_eq_email_addr(text, email_addr)
+    RETURNS boolean
+AS 'MODULE_PATHNAME'
+LANGUAGE C IMMUTABLE STRICT PARALLEL SAFE
+SUPPORT email_addr_domain_text_support;
+
+CREATE FUNCTION text_domain_ne_email_addr(text, email_addr)
+    RETURNS boolean
+AS 'MODULE_PATHNAME'
+LANGUAGE C IMMUTABLE STRICT PARALLEL SAFE
+SUPPORT email_addr_domain_text_support;
+
+CREATE OPERATOR =# (
+    LEFTARG = email_addr,
+    RIGHTARG = text,
+    PROCEDURE = email_addr_domain_eq_text,
+    COMMUTATOR = =#,
+    NEGATOR = <>#,
+    RESTRICT = eqsel,
+    JOIN = eqjoinsel
+);
+
+CREATE OPERATOR =# (
+    LEFTARG = text,
+    RIGHTARG = email_addr,
+    PROCEDURE = text_domain_eq_email_addr,
+    COMMUTATOR = =#,
+    NEGATOR = <>#,
+    RESTRICT = eqsel,
+    JOIN = eqjoinsel
+);
+
+CREATE OPERATOR <># (
+    LEFTARG = email_addr,
+    RIGHTARG = text,
+    PROCEDURE = email_addr_domain_ne_text,
+    COMMUTATOR = <>#,
+    NEGATOR = =#,
+    RESTRICT = neqsel,
+    JOIN = neqjoinsel
+);
+
+CREATE OPERATOR <># (
+    LEFTARG = text,
+    RIGHTARG = email_addr,
+    PROCEDURE = text_domain_ne_email_addr,
+    COMMUTATOR = <>#,
+    NEGATOR = =#,
+    RESTRICT = neqsel,
+    JOIN = neqjoinsel
+);
+
+-- Local-part-first order, for prefix searches on the local part
+CREATE FUNCTION email_addr_local_cmp(email_addr, email_addr)
+    RETURNS integer
+AS 'MODULE_PATHNAME'
+LANGUAGE C IMMUTABLE STRICT PARALLEL SAFE;
+
+CREATE FUNCTION email_addr_local_lt(email_addr, email_addr)
+    RETURNS boolean
+AS 'MODULE_PATHNAME'
+LANGUAGE C IMMUTABLE STRICT PARALLEL SAFE;
+
+CREATE FUNCTION email_addr_local_le(email_addr, email_addr)
+    RETURNS boolean
+AS 'MODULE_PATHNAME'
+LANGUAGE C IMMUTABLE STRICT PARALLEL SAFE;
+
+CREATE FUNCTION email_addr_local_ge(email_addr, email_addr)
+    RETURNS boolean
+AS 'MODULE_PATHNAME'
+LANGUAGE C IMMUTABLE STRICT PARALLEL SAFE;
+
+CREATE FUNCTION email_addr_local_gt(email_addr, email_addr)
+    RETURNS boolean
+AS 'MODULE_PATHNAME'
+LANGUAGE C IMMUTABLE STRICT PARALLEL SAFE;
+
+CREATE OPERATOR <^ (
+    LEFTARG = email_addr,
+    RIGHTARG = email_addr,
+    PROCEDURE = email_addr_local_lt,
+    COMMUTATOR = >^,
+    NEGATOR = >=^,
+    RESTRICT = scalarltsel,
+    JOIN = scalarltjoinsel
+);
+
+CREATE OPERATOR <=^ (
+    LEFTARG = email_addr,
+    RIGHTARG = email_addr,
+    PROCEDURE = email_addr_local_le,
+    COMMUTATOR = >=^,
+    NEGATOR = >^,
+    RESTRICT = scalarlesel,
+    JOIN = scalarlejoinsel
+);
+
+CREATE OPERATOR >=^ (
+    LEFTARG = email_addr,
+    RIGHTARG = email_addr,
+    PROCEDURE = email_addr_local_ge,
+    COMMUTATOR = <=^,
+    NEGATOR = <^,
+    RESTRICT = scalargesel,
+    JOIN = scalargejoinsel
+);
+
+CREATE OPERATOR >^ (
+    LEFTARG = email_addr,
+    RIGHTARG = email_addr,
+    PROCEDURE = email_addr_local_gt,
+    COMMUTATOR = <^,
+    NEGATOR = <=^,
+    RESTRICT = scalargtsel,
+    JOIN = scalargtjoinsel
+);
+
+CREATE OPERATOR CLASS email_addr_local_ops
+FOR TYPE email_addr USING btree AS
+    OPERATOR    1   <^,
+    OPERATOR    2   <=^,
+    OPERATOR    3   =,
+    OPERATOR    4   >=^,
+    OPERATOR    5   >^,
+    FUNCTION    1   email_addr_local_cmp(email_addr, email_addr);
+
+-- Local-part prefix match, indexable through email_addr_local_ops
+CREATE FUNCTION email_addr_local_prefix_support(internal)
+    RETURNS internal
+AS 'MODULE_PATHNAME'
+LANGUAGE C IMMUTABLE STRICT PARALLEL SAFE;
+
+CREATE FUNCTION email_addr_local_prefix(email_addr, text)
+    RETURNS boolean
+AS 'MODULE_PATHNAME'
+LANGUAGE C IMMUTABLE STRICT PARALLEL SAFE
+SUPPORT email_addr_local_prefix_support;
+
+CREATE OPERATOR ^@ (
+    LEFTARG = email_addr,
+    RIGHTARG = text,
+    PROCEDURE = email_addr_local_prefix,
+    RESTRICT = matchingsel,
+    JOIN = matchingjoinsel
+);
+
+-- SP-GiST radix tree keyed on reversed domain labels, then the local part
+CREATE FUNCTION email_addr_spg_config(internal, internal)
+    RETURNS void
+AS 'MODULE_PATHNAME'
+LANGUAGE C IMMUTABLE STRICT PARALLEL SAFE;
+
+CREATE FUNCTION email_addr_spg_choose(internal, internal)
+    RETURNS void
+AS 'MODULE_PATHNAME'
+LANGUAGE C IMMUTABLE STRICT PARALLEL SAFE;
+
+CREATE FUNCTION email_addr_spg_picksplit(internal, internal)
+    RETURNS void
+AS 'MODULE_PATHNAME'
+LANGUAGE C IMMUTABLE STRICT PARALLEL SAFE;
+
+CREATE FUNCTION email_addr_spg_inner_consistent(internal, internal)
+    RETURNS void
+AS 'MODULE_PATHNAME'
+LANGUAGE C IMMUTABLE STRICT PARALLEL SAFE;
+
+CREATE FUNCTION email_addr_spg_leaf_consistent(internal, internal)
+    RETURNS boolean
+AS 'MODULE_PATHNAME'
+LANGUAGE C IMMUTABLE STRICT PARALLEL SAFE;
+
+CREATE FUNCTION email_addr_spg_compress(email_addr)
+    RETURNS text
+AS 'MODULE_PATHNAME'
+LANGUAGE C IMMUTABLE STRICT PARALLEL SAFE;
+
+CREATE OPERATOR CLASS email_addr_spgist_ops
+FOR TYPE email_addr USING spgist AS
+    OPERATOR    1   = (email_addr, email_addr),
+    OPERATOR    2   =# (email_addr, email_addr),
+    OPERATOR    3   <@# (email_addr, text),
+    OPERATOR    4   ^@ (email_addr, text),
+    FUNCTION    1   email_addr_spg_config(internal, internal),
+    FUNCTION    2   email_addr_spg_choose(internal, internal),
+    FUNCTION    3   email_addr_spg_picksplit(internal, internal),
+    FUNCTION    4   email_addr_spg_inner_consistent(internal, internal),
+    FUNCTION    5   email_addr_spg_leaf_consistent(internal, internal),
+    FUNCTION    6   email_addr_spg_compress(email_addr),
+    STORAGE     text;
+
+-- Token containment: domain labels, local-part segments and the plus-tag
+CREATE FUNCTION email_addr_has_label(email_addr, text)
+    RETURNS boolean
+AS 'MODULE_PATHNAME'
+LANGUAGE C IMMUTABLE STRICT PARALLEL SAFE;
+
+CREATE FUNCTION email_addr_has_segment(email_addr, text)
+    RETURNS boolean
+AS 'MODULE_PATHNAME'
+LANGUAGE C IMMUTABLE STRICT PARALLEL SAFE;
+
+CREATE FUNCTION email_addr_has_tag(email_addr, text)
+    RETURNS boolean
+AS 'MODULE_PATHNAME'
+LANGUAGE C IMMUTABLE STRICT PARALLEL SAFE;
+
+CREATE OPERATOR ?# (
+    LEFTARG = email_addr,
+    RIGHTARG = text,
+    PROCEDURE = email_addr_has_label,
+    RESTRICT = matchingsel,
+    JOIN = matchingjoinsel
+);
+
+CREATE OPERATOR ?@ (
+    LEFTARG = email_addr,
+    RIGHTARG = text,
+    PROCEDURE = email_addr_has_segment,
+    RESTRICT = matchingsel,
+    JOIN = matchingjoinsel
+);
+
+CREATE OPERATOR ?+ (
+    LEFTARG = email_addr,
+    RIGHTARG = text,
+    PROCEDURE = email_addr_has_tag,
+    RESTRICT = matchingsel,
+    JOIN = matchingjoinsel
+);
+
+-- GIN operator class over the tokens
+CREATE FUNCTION email_addr_gin_extract_value(email_addr, internal, internal)
+    RETURNS internal
+AS 'MODULE_PATHNAME'
+LANGUAGE C IMMUTABLE STRICT PARALLEL SAFE;
+
+CREATE FUNCTION email_addr_gin_extract_query(text, internal, int2, internal, internal, internal, internal)
+    RETURNS internal
+AS 'MODULE_PATHNAME'
+LANGUAGE C IMMUTABLE STRICT PARALLEL SAFE;
+
+CREATE FUNCTION email_addr_gin_consistent(internal, int2, text, int4, internal, internal, internal, internal)
+    RETURNS boolean
+AS 'MODULE_PATHNAME'
+LANGUAGE C IMMUTABLE STRICT PARALLEL SAFE;
+
+CREATE FUNCTION email_addr_gin_tri_consistent(internal, int2, text, int4, internal, internal, internal)
+    RETURNS "char"
+AS 'MODULE_PATHNAME'
+LANGUAGE C IMMUTABLE STRICT PARALLEL SAFE;
+
+CREATE OPERATOR CLASS email_addr_gin_ops
+FOR TYPE email_addr USING gin AS
+    OPERATOR    1   ?# (email_addr, text),
+    OPERATOR    2   ?@ (email_addr, text),
+    OPERATOR    3   ?+ (email_addr, text),
+    FUNCTION    1   bttext_pattern_cmp(text, text),
+    FUNCTION    2   email_addr_gin_extract_value(email_addr, internal, internal),
+    FUNCTION    3   email_addr_gin_extract_query(text, internal, int2, internal, internal, internal, internal),
+    FUNCTION    4   email_addr_gin_consistent(internal, int2, text, int4, internal, internal, internal, internal),
+    FUNCTION    6   email_addr_gin_tri_consistent(internal, int2, text, int4, internal, internal, internal),
+    STORAGE     text;
+
+-- All of the above in one call
+CREATE FUNCTION email_addr_split(email email_addr,
+                                 OUT local text, OUT domain text,
+                                 OUT norm_local text, OUT norm_domain text)
+    RETURNS record
+AS 'MODULE_PATHNAME'
+LANGUAGE C IMMUTABLE STRICT PARALLEL SAFE;
+
+-- Normalization comparison. Normalized identity is the equality of
+-- email_addr_ops, so the planner turns ==# into = and its indexes, hash
+-- joins and merge joins apply
+CREATE FUNCTION email_addr_normalize_eq_support(internal)
+    RETURNS internal
+AS 'MODULE_PATHNAME'
+LANGUAGE C IMMUTABLE STRICT PARALLEL SAFE;
+
+ALTER FUNCTION email_addr_normalize_eq(email_addr, email_addr)
+    SUPPORT email_addr_normalize_eq_support;
+
+-- ==# had <>## as its negator, which is domain inequality. Before 17
+-- there is no ALTER OPERATOR for negators, so clear it in the catalog.
+UPDATE pg_catalog.pg_operator SET oprnegate = 0
+WHERE oid = '@extschema@.==#(@extschema@.email_addr, @extschema@.email_addr)'::pg_catalog.regoperator;
+
+DROP OPERATOR <>## (email_addr, email_addr);
+
+-- Fixed-width fingerprint of the normalized form, for dedup joins
+CREATE TYPE email_fingerprint;
+
+CREATE FUNCTION email_fingerprint_in(cstring)
+    RETURNS email_fingerprint
+AS 'MODULE_PATHNAME'
+LANGUAGE C IMMUTABLE STRICT PARALLEL SAFE;
+
+CREATE FUNCTION email_fingerprint_out(email_fingerprint)
+    RETURNS cstring
+AS 'MODULE_PATHNAME'
+LANGUAGE C IMMUTABLE STRICT PARALLEL SAFE;
+
+CREATE FUNCTION email_fingerprint_recv(internal)
+    RETURNS email_fingerprint
+AS 'MODULE_PATHNAME'
+LANGUAGE C IMMUTABLE STRICT PARALLEL SAFE;
+
+CREATE FUNCTION email_fingerprint_send(email_fingerprint)
+    RETURNS bytea
+AS 'MODULE_PATHNAME'
+LANGUAGE C IMMUTABLE STRICT PARALLEL SAFE;
+
+CREATE TYPE email_fingerprint (
+    INTERNALLENGTH = 16,
+    INPUT = email_fingerprint_in,
+    OUTPUT = email_fingerprint_out,
+    RECEIVE = email_fingerprint_recv,
+    SEND = email_fingerprint_send,
+    ALIGNMENT = char,
+    STORAGE = PLAIN
+);
+
+-- Provider rules applied by email_addr_fingerprint(email, true)
+CREATE TABLE email_fingerprint_rules (
+    domain text PRIMARY KEY CHECK (domain = lower(domain)),
+    fold_dots boolean NOT NULL DEFAULT false,
+    fold_plus_tag boolean NOT NULL DEFAULT false
+);
+
+SELECT pg_catalog.pg_extension_config_dump('email_fingerprint_rules', '');
+
+GRANT SELECT ON email_fingerprint_rules TO PUBLIC;
+
+CREATE FUNCTION email_addr_fingerprint(email_addr)
+    RETURNS email_fingerprint
+AS 'MODULE_PATHNAME'
+LANGUAGE C IMMUTABLE STRICT PARALLEL SAFE;
+
+-- Reads email_fingerprint_rules, hence only stable
+CREATE FUNCTION email_addr_fingerprint(email_addr, boolean)
+    RETURNS email_fingerprint
+AS 'MODULE_PATHNAME'
+LANGUAGE C STABLE STRICT PARALLEL SAFE;
+
+CREATE FUNCTION email_fingerprint_eq(email_fingerprint, email_fingerprint)
+    RETURNS boolean
+AS 'MODULE_PATHNAME'
+LANGUAGE C IMMUTABLE STRICT PARALLEL SAFE;
+
+CREATE FUNCTION email_fingerprint_ne(email_fingerprint, email_fingerprint)
+    RETURNS boolean
+AS 'MODULE_PATHNAME'
+LANGUAGE C IMMUTABLE STRICT PARALLEL SAFE;
+
+CREATE FUNCTION email_fingerprint_lt(email_fingerprint, email_fingerprint)
+    RETURNS boolean
+AS 'MODULE_PATHNAME'
+LANGUAGE C IMMUTABLE STRICT PARALLEL SAFE;
+
+CREATE FUNCTION email_fingerprint_le(email_fingerprint, email_fingerprint)
+    RETURNS boolean
+AS 'MODULE_PATHNAME'
+LANGUAGE C IMMUTABLE STRICT PARALLEL SAFE;
+
+CREATE FUNCTION email_fingerprint_gt(email_fingerprint, email_fingerprint)
+    RETURNS boolean
+AS 'MODULE_PATHNAME'
+LANGUAGE C IMMUTABLE STRICT PARALLEL SAFE;
+
+CREATE FUNCTION email_fingerprint_ge(email_fingerprint, email_fingerprint)
+    RETURNS boolean
+AS 'MODULE_PATHNAME'
+LANGUAGE C IMMUTABLE STRICT PARALLEL SAFE;
+
+CREATE FUNCTION email_fingerprint_cmp(email_fingerprint, email_fingerprint)
+    RETURNS integer
+AS 'MODULE_PATHNAME'
+LANGUAGE C IMMUTABLE STRICT PARALLEL SAFE;
+
+CREATE FUNCTION email_fingerprint_sortsupport(internal)
+    RETURNS void
+AS 'MODULE_PATHNAME'
+LANGUAGE C IMMUTABLE STRICT PARALLEL SAFE;
+
+CREATE FUNCTION email_fingerprint_hash(email_fingerprint)
+    RETURNS integer
+AS 'MODULE_PATHNAME'
+LANGUAGE C IMMUTABLE STRICT PARALLEL SAFE;
+
+CREATE FUNCTION email_fingerprint_hash_extended(email_fingerprint, int8)
+    RETURNS int8
+AS 'MODULE_PATHNAME'
+LANGUAGE C IMMUTABLE STRICT PARALLEL SAFE;
+
+CREATE OPERATOR = (
+    LEFTARG = email_fingerprint,
+    RIGHTARG = email_fingerprint,
+    PROCEDURE = email_fingerprint_eq,
+    COMMUTATOR = =,
+    NEGATOR = <>,
+    RESTRICT = eqsel,
+    JOIN = eqjoinsel,
+    HASHES,
+    MERGES
+);
+
+CREATE OPERATOR <> (
+    LEFTARG = email_fingerprint,
+    RIGHTARG = email_fingerprint,
+    PROCEDURE = email_fingerprint_ne,
+    COMMUTATOR = <>,
+    NEGATOR = =,
+    RESTRICT = neqsel,
+    JOIN = neqjoinsel
+);
+
+CREATE OPERATOR < (
+    LEFTARG = email_fingerprint,
+    RIGHTARG = email_fingerprint,
+    PROCEDURE = email_fingerprint_lt,
+    COMMUTATOR = >,
+    NEGATOR = >=,
+    RESTRICT = scalarltsel,
+    JOIN = scalarltjoinsel
+);
+
+CREATE OPERATOR <= (
+    LEFTARG = email_fingerprint,
+    RIGHTARG = email_fingerprint,
+    PROCEDURE = email_fingerprint_le,
+    COMMUTATOR = >=,
+    NEGATOR = >,
+    RESTRICT = scalarlesel,
+    JOIN = scalarlejoinsel
+);
+
+CREATE OPERATOR > (
+    LEFTARG = email_fingerprint,
+    RIGHTARG = email_fingerprint,
+    PROCEDURE = email_fingerprint_gt,
+    COMMUTATOR = <,
+    NEGATOR = <=,
+    RESTRICT = scalargtsel,
+    JOIN = scalargtjoinsel
+);
+
+CREATE OPERATOR >= (
+    LEFTARG = email_fingerprint,
+    RIGHTARG = email_fingerprint,
+    PROCEDURE = email_fingerprint_ge,
+    COMMUTATOR = <=,
+    NEGATOR = <,
+    RESTRICT = scalargesel,
+    JOIN = scalargejoinsel
+);
+
+CREATE OPERATOR CLASS email_fingerprint_ops
+DEFAULT FOR TYPE email_fingerprint USING btree AS
+    OPERATOR    1   <,
+    OPERATOR    2   <=,
+    OPERATOR    3   =,
+    OPERATOR    4   >=,
+    OPERATOR    5   >,
+    FUNCTION    1   email_fingerprint_cmp(email_fingerprint, email_fingerprint),
+    FUNCTION    2   email_fingerprint_sortsupport(internal);
+
+CREATE OPERATOR CLASS email_fingerprint_hash_ops
+DEFAULT FOR TYPE email_fingerprint USING hash AS
+    OPERATOR    1   =,
+    FUNCTION    1   email_fingerprint_hash(email_fingerprint),
+    FUNCTION    2   email_fingerprint_hash_extended(email_fingerprint, int8);
+
+-- Batch validation and parsing
+CREATE FUNCTION email_addr_validate(text[])
+    RETURNS boolean[]
+AS 'MODULE_PATHNAME'
+LANGUAGE C IMMUTABLE STRICT PARALLEL SAFE;
+
+CREATE FUNCTION email_addr_validate_detail(
+    text[],
+    OUT ordinal integer,
+    OUT valid boolean,
+    OUT reason text)
+    RETURNS SETOF record
+AS 'MODULE_PATHNAME'
+LANGUAGE C IMMUTABLE STRICT PARALLEL SAFE;
+
+CREATE FUNCTION email_addr_parse_array(text[])
+    RETURNS email_addr[]
+AS 'MODULE_PATHNAME'
+LANGUAGE C IMMUTABLE STRICT PARALLEL SAFE;
+
+-- Top-N domains aggregate
+CREATE TYPE email_domain_count AS (
+    domain text,
+    count bigint
+);
+
+CREATE FUNCTION domain_histogram_transfn(internal, email_addr, integer)
+    RETURNS internal
+AS 'MODULE_PATHNAME'
+LANGUAGE C IMMUTABLE PARALLEL SAFE;
+
+CREATE FUNCTION domain_histogram_combinefn(internal, internal)
+    RETURNS internal
+AS 'MODULE_PATHNAME'
+LANGUAGE C IMMUTABLE PARALLEL SAFE;
+
+CREATE FUNCTION domain_histogram_serialize(internal)
+    RETURNS bytea
+AS 'MODULE_PATHNAME'
+LANGUAGE C IMMUTABLE STRICT PARALLEL SAFE;
+
+CREATE FUNCTION domain_histogram_deserialize(bytea, internal)
+    RETURNS internal
+AS 'MODULE_PATHNAME'
+LANGUAGE C IMMUTABLE STRICT PARALLEL SAFE;
+
+CREATE FUNCTION domain_histogram_finalfn(internal)
+    RETURNS email_domain_count[]
+AS 'MODULE_PATHNAME'
+LANGUAGE C IMMUTABLE PARALLEL SAFE;
+
+CREATE AGGREGATE domain_histogram(email_addr, integer) (
+    SFUNC = domain_histogram_transfn,
+    STYPE = internal,
+    FINALFUNC = domain_histogram_finalfn,
+    COMBINEFUNC = domain_histogram_combinefn,
+    SERIALFUNC = domain_histogram_serialize,
+    DESERIALFUNC = domain_histogram_deserialize,
+    PARALLEL = SAFE
+);
+
+-- HyperLogLog sketches for approximate distinct counts
+CREATE TYPE email_hll;
+
+CREATE FUNCTION email_hll_in(cstring)
+    RETURNS email_hll
+AS 'MODULE_PATHNAME'
+LANGUAGE C IMMUTABLE STRICT PARALLEL SAFE;
+
+CREATE FUNCTION email_hll_out(email_hll)
+    RETURNS cstring
+AS 'MODULE_PATHNAME'
+LANGUAGE C IMMUTABLE STRICT PARALLEL SAFE;
+
+CREATE FUNCTION email_hll_recv(internal)
+    RETURNS email_hll
+AS 'MODULE_PATHNAME'
+LANGUAGE C IMMUTABLE STRICT PARALLEL SAFE;
+
+CREATE FUNCTION email_hll_send(email_hll)
+    RETURNS bytea
+AS 'MODULE_PATHNAME'
+LANGUAGE C IMMUTABLE STRICT PARALLEL SAFE;
+
+CREATE TYPE email_hll (
+    INTERNALLENGTH = VARIABLE,
+    INPUT = email_hll_in,
+    OUTPUT = email_hll_out,
+    RECEIVE = email_hll_recv,
+    SEND = email_hll_send,
+    STORAGE = EXTENDED
+);
+
+CREATE FUNCTION email_hll_cardinality(email_hll)
+    RETURNS bigint
+AS 'MODULE_PATHNAME'
+LANGUAGE C IMMUTABLE STRICT PARALLEL SAFE;
+
+CREATE FUNCTION email_hll_union(email_hll, email_hll)
+    RETURNS email_hll
+AS 'MODULE_PATHNAME', 'email_hll_union2'
+LANGUAGE C IMMUTABLE STRICT PARALLEL SAFE;
+
+CREATE FUNCTION email_hll_transfn(internal, email_addr)
+    RETURNS internal
+AS 'MODULE_PATHNAME'
+LANGUAGE C IMMUTABLE PARALLEL SAFE;
+
+CREATE FUNCTION email_hll_transfn(internal, email_addr, integer)
+    RETURNS internal
+AS 'MODULE_PATHNAME'
+LANGUAGE C IMMUTABLE PARALLEL SAFE;
+
+-- Reads email_fingerprint_rules, hence only stable
+CREATE FUNCTION email_hll_rules_transfn(internal, email_addr, boolean)
+    RETURNS internal
+AS 'MODULE_PATHNAME'
+LANGUAGE C STABLE PARALLEL SAFE;
+
+CREATE FUNCTION email_hll_union_transfn(internal, email_hll)
+    RETURNS internal
+AS 'MODULE_PATHNAME'
+LANGUAGE C IMMUTABLE PARALLEL SAFE;
+
+CREATE FUNCTION email_hll_combinefn(internal, internal)
+    RETURNS internal
+AS 'MODULE_PATHNAME'
+LANGUAGE C IMMUTABLE PARALLEL SAFE;
+
+CREATE FUNCTION email_hll_serialize(internal)
+    RETURNS bytea
+AS 'MODULE_PATHNAME'
+LANGUAGE C IMMUTABLE STRICT PARALLEL SAFE;
+
+CREATE FUNCTION email_hll_deserialize(bytea, internal)
+    RETURNS internal
+AS 'MODULE_PATHNAME'
+LANGUAGE C IMMUTABLE STRICT PARALLEL SAFE;
+
+CREATE FUNCTION email_hll_finalfn(internal)
+    RETURNS email_hll
+AS 'MODULE_PATHNAME'
+LANGUAGE C IMMUTABLE PARALLEL SAFE;
+
+CREATE FUNCTION email_hll_count_finalfn(internal)
+    RETURNS bigint
+AS 'MODULE_PATHNAME'
+LANGUAGE C IMMUTABLE PARALLEL SAFE;
+
+CREATE AGGREGATE email_hll_agg(email_addr) (
+    SFUNC = email_hll_transfn,
+    STYPE = internal,
+    FINALFUNC = email_hll_finalfn,
+    COMBINEFUNC = email_hll_combinefn,
+    SERIALFUNC = email_hll_serialize,
+    DESERIALFUNC = email_hll_deserialize,
+    PARALLEL = SAFE
+);
+
+-- With the precision, log2 of the number of registers (4 to 18)
+CREATE AGGREGATE email_hll_agg(email_addr, integer) (
+    SFUNC = email_hll_transfn,
+    STYPE = internal,
+    FINALFUNC = email_hll_finalfn,
+    COMBINEFUNC = email_hll_combinefn,
+    SERIALFUNC = email_hll_serialize,
+    DESERIALFUNC = email_hll_deserialize,
+    PARALLEL = SAFE
+);
+
+-- With provider_rules, as email_addr_fingerprint(email_addr, boolean)
+CREATE AGGREGATE email_hll_agg(email_addr, boolean) (
+    SFUNC = email_hll_rules_transfn,
+    STYPE = internal,
+    FINALFUNC = email_hll_finalfn,
+    COMBINEFUNC = email_hll_combinefn,
+    SERIALFUNC = email_hll_serialize,
+    DESERIALFUNC = email_hll_deserialize,
+    PARALLEL = SAFE
+);
+
+CREATE AGGREGATE email_approx_count_distinct(email_addr) (
+    SFUNC = email_hll_transfn,
+    STYPE = internal,
+    FINALFUNC = email_hll_count_finalfn,
+    COMBINEFUNC = email_hll_combinefn,
+    SERIALFUNC = email_hll_serialize,
+    DESERIALFUNC = email_hll_deserialize,
+    PARALLEL = SAFE
+);
+
+CREATE AGGREGATE email_approx_count_distinct(email_addr, boolean) (
+    SFUNC = email_hll_rules_transfn,
+    STYPE = internal,
+    FINALFUNC = email_hll_count_finalfn,
+    COMBINEFUNC = email_hll_combinefn,
+    SERIALFUNC = email_hll_serialize,
+    DESERIALFUNC = email_hll_deserialize,
+    PARALLEL = SAFE
+);
+
+-- Union of stored sketches, e.g. daily ones
+CREATE AGGREGATE email_hll_union(email_hll) (
+    SFUNC = email_hll_union_transfn,
+    STYPE = internal,
+    FINALFUNC = email_hll_finalfn,
+    COMBINEFUNC = email_hll_combinefn,
+    SERIALFUNC = email_hll_serialize,
+    DESERIALFUNC = email_hll_deserialize,
+    PARALLEL = SAFE
+);
+
+-- Bloom filters for suppression-list checks
+CREATE TYPE email_bloom;
+
+CREATE FUNCTION email_bloom_in(cstring)
+    RETURNS email_bloom
+AS 'MODULE_PATHNAME'
+LANGUAGE C IMMUTABLE STRICT PARALLEL SAFE;
+
+CREATE FUNCTION email_bloom_out(email_bloom)
+    RETURNS cstring
+AS 'MODULE_PATHNAME'
+LANGUAGE C IMMUTABLE STRICT PARALLEL SAFE;
+
+CREATE FUNCTION email_bloom_recv(internal)
+    RETURNS email_bloom
+AS 'MODULE_PATHNAME'
+LANGUAGE C IMMUTABLE STRICT PARALLEL SAFE;
+
+CREATE FUNCTION email_bloom_send(email_bloom)
+    RETURNS bytea
+AS 'MODULE_PATHNAME'
+LANGUAGE C IMMUTABLE STRICT PARALLEL SAFE;
+
+-- Random bits do not compress: store out of line as they are
+CREATE TYPE email_bloom (
+    INTERNALLENGTH = VARIABLE,
+    INPUT = email_bloom_in,
+    OUTPUT = email_bloom_out,
+    RECEIVE = email_bloom_recv,
+    SEND = email_bloom_send,
+    ALIGNMENT = double,
+    STORAGE = EXTERNAL
+);
+
+CREATE FUNCTION email_bloom_contains(email_bloom, email_addr)
+    RETURNS boolean
+AS 'MODULE_PATHNAME'
+LANGUAGE C IMMUTABLE STRICT PARALLEL SAFE;
+
+CREATE FUNCTION email_bloom_contained(email_addr, email_bloom)
+    RETURNS boolean
+AS 'MODULE_PATHNAME'
+LANGUAGE C IMMUTABLE STRICT PARALLEL SAFE;
+
+CREATE OPERATOR @> (
+    LEFTARG = email_bloom,
+    RIGHTARG = email_addr,
+    PROCEDURE = email_bloom_contains,
+    COMMUTATOR = <@,
+    RESTRICT = contsel,
+    JOIN = contjoinsel
+);
+
+CREATE OPERATOR <@ (
+    LEFTARG = email_addr,
+    RIGHTARG = email_bloom,
+    PROCEDURE = email_bloom_contained,
+    COMMUTATOR = @>,
+    RESTRICT = contsel,
+    JOIN = contjoinsel
+);
+
+CREATE FUNCTION email_bloom_union(email_bloom, email_bloom)
+    RETURNS email_bloom
+AS 'MODULE_PATHNAME', 'email_bloom_union2'
+LANGUAGE C IMMUTABLE STRICT PARALLEL SAFE;
+
+CREATE FUNCTION email_bloom_transfn(internal, email_addr, bigint)
+    RETURNS internal
+AS 'MODULE_PATHNAME'
+LANGUAGE C IMMUTABLE PARALLEL SAFE;
+
+CREATE FUNCTION email_bloom_transfn(internal, email_addr, bigint, double precision)
+    RETURNS internal
+AS 'MODULE_PATHNAME'
+LANGUAGE C IMMUTABLE PARALLEL SAFE;
+
+CREATE FUNCTION email_bloom_union_transfn(internal, email_bloom)
+    RETURNS internal
+AS 'MODULE_PATHNAME'
+LANGUAGE C IMMUTABLE PARALLEL SAFE;
+
+CREATE FUNCTION email_bloom_combinefn(internal, internal)
+    RETURNS internal
+AS 'MODULE_PATHNAME'
+LANGUAGE C IMMUTABLE PARALLEL SAFE;
+
+CREATE FUNCTION email_bloom_serialize(internal)
+    RETURNS bytea
+AS 'MODULE_PATHNAME'
+LANGUAGE C IMMUTABLE STRICT PARALLEL SAFE;
+
+CREATE FUNCTION email_bloom_deserialize(bytea, internal)
+    RETURNS internal
+AS 'MODULE_PATHNAME'
+LANGUAGE C IMMUTABLE STRICT PARALLEL SAFE;
+
+CREATE FUNCTION email_bloom_finalfn(internal)
+    RETURNS email_bloom
+AS 'MODULE_PATHNAME'
+LANGUAGE C IMMUTABLE PARALLEL SAFE;
+
+-- Sized for the expected number of addresses, at a 1% false positive rate
+CREATE AGGREGATE email_bloom_agg(email_addr, bigint) (
+    SFUNC = email_bloom_transfn,
+    STYPE = internal,
+    FINALFUNC = email_bloom_finalfn,
+    COMBINEFUNC = email_bloom_combinefn,
+    SERIALFUNC = email_bloom_serialize,
+    DESERIALFUNC = email_bloom_deserialize,
+    PARALLEL = SAFE
+);
+
+-- With the false positive rate
+CREATE AGGREGATE email_bloom_agg(email_addr, bigint, double precision) (
+    SFUNC = email_bloom_transfn,
+    STYPE = internal,
+    FINALFUNC = email_bloom_finalfn,
+    COMBINEFUNC = email_bloom_combinefn,
+    SERIALFUNC = email_bloom_serialize,
+    DESERIALFUNC = email_bloom_deserialize,
+    PARALLEL = SAFE
+);
+
+CREATE AGGREGATE email_bloom_union(email_bloom) (
+    SFUNC = email_bloom_union_transfn,
+    STYPE = internal,
+    FINALFUNC = email_bloom_finalfn,
+    COMBINEFUNC = email_bloom_combinefn,
+    SERIALFUNC = email_bloom_serialize,
+    DESERIALFUNC = email_bloom_deserialize,
+    PARALLEL = SAFE
+);
+
+-- Suppression cache: needs pg_email_opt in shared_preload_libraries
+CREATE TABLE email_suppression_sources (
+    source regclass PRIMARY KEY,
+    email_column name NOT NULL
+);
+
+SELECT pg_catalog.pg_extension_config_dump('email_suppression_sources', '');
+
+GRANT SELECT ON email_suppression_sources TO PUBLIC;
+
+-- Answers from shared memory, reloading the sources after they change
+CREATE FUNCTION email_is_suppressed(email_addr)
+    RETURNS boolean
+AS 'MODULE_PATHNAME'
+LANGUAGE C STABLE STRICT PARALLEL RESTRICTED;
+
+CREATE FUNCTION email_suppression_invalidate()
+    RETURNS trigger
+AS 'MODULE_PATHNAME'
+LANGUAGE C;
+
+CREATE FUNCTION email_suppression_changed()
+    RETURNS void
+AS 'MODULE_PATHNAME'
+LANGUAGE C VOLATILE STRICT PARALLEL UNSAFE;
+
+CREATE FUNCTION email_suppression_register(source regclass, email_column name DEFAULT 'email')
+    RETURNS void
+AS $$
+DECLARE
+    kind "char";
+    rowsecurity boolean;
+BEGIN
+    -- The cache is shared by every role: no views, no row-level security
+    SELECT c.relkind, c.relrowsecurity INTO kind, rowsecurity
+    FROM pg_catalog.pg_class c WHERE c.oid = source;
+    IF kind NOT IN ('r', 'p') THEN
+        RAISE EXCEPTION '% is not a table', source;
+    END IF;
+    IF rowsecurity THEN
+        RAISE EXCEPTION '% has row-level security enabled', source;
+    END IF;
+
+    INSERT INTO @extschema@.email_suppression_sources VALUES (source, email_column);
+    EXECUTE format('CREATE TRIGGER email_suppression_invalidate '
+                   'AFTER INSERT OR UPDATE OR DELETE OR TRUNCATE ON %s '
+                   'FOR EACH STATEMENT EXECUTE FUNCTION @extschema@.email_suppression_invalidate()',
+                   source);
+    PERFORM @extschema@.email_suppression_changed();
+END
+$$ LANGUAGE plpgsql VOLATILE STRICT PARALLEL UNSAFE;
+
+CREATE FUNCTION email_suppression_unregister(source regclass)
+    RETURNS void
+AS $$
+BEGIN
+    DELETE FROM @extschema@.email_suppression_sources s WHERE s.source = email_suppression_unregister.source;
+    IF NOT FOUND THEN
+        RAISE EXCEPTION '% is not a suppression source', source;
+    END IF;
+    EXECUTE format('DROP TRIGGER IF EXISTS email_suppression_invalidate ON %s', source);
+    PERFORM @extschema@.email_suppression_changed();
+END
+$$ LANGUAGE plpgsql VOLATILE STRICT PARALLEL UNSAFE;
+
+-- Instrumentation: per-backend counters
+CREATE FUNCTION pg_email_opt_stats(
+    OUT operation text,
+    OUT calls bigint,
+    OUT bytes bigint,
+    OUT failures bigint,
+    OUT total_time double precision)
+    RETURNS SETOF record
+AS 'MODULE_PATHNAME'
+LANGUAGE C VOLATILE STRICT PARALLEL RESTRICTED;
+
+CREATE FUNCTION pg_email_opt_stats_reset()
+    RETURNS void
+AS 'MODULE_PATHNAME'
+LANGUAGE C VOLATILE STRICT PARALLEL RESTRICTED;
+-- Add helpful comments
+COMMENT ON FUNCTION email_addr_recv(internal, oid, integer) IS 'Convert external binary format to email_addr';
+COMMENT ON FUNCTION email_addr_send(email_addr) IS 'Convert email_addr to external binary format';
+COMMENT ON TABLE email_addr_domain_dict IS 'Dictionary of interned email domains';
+COMMENT ON FUNCTION email_addr_domain_dict_add(text) IS 'Add a domain to the interning dictionary, returning its new id';
+COMMENT ON FUNCTION email_addr_split(email_addr) IS 'Local part and domain, as entered and normalized';
+COMMENT ON FUNCTION email_addr_normalize_eq(email_addr, email_addr) IS 'Equality of normalized forms, planned as =';
+COMMENT ON OPERATOR <># (email_addr, email_addr) IS 'Domain-based inequality comparison';
+COMMENT ON OPERATOR =# (email_addr, text) IS 'Domain equals the given domain, or the domain of the given address';
+COMMENT ON OPERATOR =# (text, email_addr) IS 'Domain equals the given domain, or the domain of the given address';
+COMMENT ON OPERATOR <># (email_addr, text) IS 'Domain differs from the given domain, or the domain of the given address';
+COMMENT ON OPERATOR <># (text, email_addr) IS 'Domain differs from the given domain, or the domain of the given address';
+COMMENT ON OPERATOR <@# (email_addr, text) IS 'Domain is the given domain or one of its subdomains';
+COMMENT ON OPERATOR ^@ (email_addr, text) IS 'Canonical local part starts with the given prefix';
+COMMENT ON OPERATOR <^ (email_addr, email_addr) IS 'Local-part-first less than comparison';
+COMMENT ON OPERATOR <=^ (email_addr, email_addr) IS 'Local-part-first less than or equal comparison';
+COMMENT ON OPERATOR >=^ (email_addr, email_addr) IS 'Local-part-first greater than or equal comparison';
+COMMENT ON OPERATOR >^ (email_addr, email_addr) IS 'Local-part-first greater than comparison';
+COMMENT ON OPERATOR ?# (email_addr, text) IS 'Domain has the given label';
+COMMENT ON OPERATOR ?@ (email_addr, text) IS 'Local part has the given segment, split on dot, plus and hyphen';
+COMMENT ON OPERATOR ?+ (email_addr, text) IS 'Local part has the given plus-tag';
+COMMENT ON TYPE email_fingerprint IS '128-bit fingerprint of a normalized email address';
+COMMENT ON TABLE email_fingerprint_rules IS 'Per-domain local-part folding applied by email_addr_fingerprint(email_addr, true)';
+COMMENT ON FUNCTION email_addr_fingerprint(email_addr) IS 'Fingerprint of the normalized form of an email address';
+COMMENT ON FUNCTION email_addr_fingerprint(email_addr, boolean) IS 'Fingerprint of an email address, optionally applying provider rules';
+COMMENT ON FUNCTION email_addr_validate(text[]) IS 'Check which elements of a text array are valid email addresses';
+COMMENT ON FUNCTION email_addr_validate_detail(text[]) IS 'Show validity and the reason for rejection of each element of a text array';
+COMMENT ON FUNCTION email_addr_parse_array(text[]) IS 'Convert a text array to email_addr, mapping invalid elements to NULL';
+COMMENT ON AGGREGATE domain_histogram(email_addr, integer) IS 'Most frequent domains and their counts, most frequent first';
+COMMENT ON TYPE email_hll IS 'HyperLogLog sketch of email addresses';
+COMMENT ON AGGREGATE email_approx_count_distinct(email_addr) IS 'Approximate number of distinct email addresses';
+COMMENT ON AGGREGATE email_hll_union(email_hll) IS 'Union of HyperLogLog sketches';
+COMMENT ON TYPE email_bloom IS 'Bloom filter of email addresses';
+COMMENT ON OPERATOR @> (email_bloom, email_addr) IS 'Bloom filter may contain the email address';
+COMMENT ON AGGREGATE email_bloom_agg(email_addr, bigint, double precision) IS 'Bloom filter of email addresses, sized for the expected count and false positive rate';
+COMMENT ON TABLE email_suppression_sources IS 'Tables whose email_addr column is cached by the suppression cache';
+COMMENT ON FUNCTION email_is_suppressed(email_addr) IS 'Email address is in one of the suppression sources, from the shared cache';
+COMMENT ON FUNCTION email_suppression_register(regclass, name) IS 'Add a table to the suppression sources';
+COMMENT ON FUNCTION email_suppression_unregister(regclass) IS 'Remove a table from the suppression sources';
+COMMENT ON FUNCTION pg_email_opt_stats() IS 'Show email_addr instrumentation counters of the current backend';
+COMMENT ON FUNCTION pg_email_opt_stats_reset() IS 'Reset email_addr instrumentation counters of the current backend';
+
+-- email_addr_cmp sorts quoted local parts after unquoted ones, and
+-- email_hash hashes the canonical domain and then the canonical local
+-- part. Indexes built by 1.0 on either no longer find their rows, and
+-- tables range or hash partitioned through them route rows to other
+-- partitions.
+DO $$
+DECLARE
+    cmp pg_catalog.oid := '@extschema@.email_addr_cmp(@extschema@.email_addr, @extschema@.email_addr)'::pg_catalog.regprocedure;
+    hash pg_catalog.oid := '@extschema@.email_hash(@extschema@.email_addr)'::pg_catalog.regprocedure;
+    rel pg_catalog.regclass;
+BEGIN
+    FOR rel IN
+        SELECT i.indexrelid::pg_catalog.regclass
+        FROM pg_catalog.pg_index i
+        WHERE EXISTS (SELECT FROM pg_catalog.pg_opclass oc
+                      JOIN pg_catalog.pg_amproc ap ON ap.amprocfamily = oc.opcfamily
+                      WHERE oc.oid = ANY (i.indclass::pg_catalog.oid[])
+                        AND ap.amproc::pg_catalog.oid IN (cmp, hash))
+    LOOP
+        RAISE WARNING 'index % must be rebuilt', rel
+            USING HINT = 'Run REINDEX INDEX after the update.';
+    END LOOP;
+
+    FOR rel IN
+        SELECT pt.partrelid::pg_catalog.regclass
+        FROM pg_catalog.pg_partitioned_table pt
+        WHERE pt.partstrat IN ('r', 'h')
+          AND EXISTS (SELECT FROM pg_catalog.pg_opclass oc
+                      JOIN pg_catalog.pg_amproc ap ON ap.amprocfamily = oc.opcfamily
+                      WHERE oc.oid = ANY (pt.partclass::pg_catalog.oid[])
+                        AND ap.amproc::pg_catalog.oid IN (cmp, hash))
+    LOOP
+        RAISE WARNING 'partitioned table % must be reloaded', rel
+            USING HINT = 'Copy its rows out and back in after the update.';
+    END LOOP;
+END
+$$;
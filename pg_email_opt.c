@@ -5,147 +5,341 @@
 #include "postgres.h"
 
 #include "access/htup_details.h"
+#include "access/stratnum.h"
+#include "catalog/pg_am.h"
+#include "catalog/pg_type.h"
+#include "commands/defrem.h"
+#include "common/hashfn.h"
+#include "lib/hyperloglog.h"
+#include "libpq/pqformat.h"
+#include "nodes/makefuncs.h"
+#include "nodes/nodeFuncs.h"
+#include "nodes/supportnodes.h"
+#include "port/pg_bswap.h"
+#include "utils/array.h"
 #include "utils/builtins.h"
+#include "utils/lsyscache.h"
 #include "fmgr.h"
+#include "funcapi.h"
 #include "utils/palloc.h"
+#include "utils/sortsupport.h"
 
+#include "pg_email_opt.h"
 #include "myutils/local.h"
 #include "myutils/domain.h"
+#include "myutils/idn.h"
+#include "myutils/parse.h"
+#include "myutils/simd.h"
 
 #ifdef PG_MODULE_MAGIC
 PG_MODULE_MAGIC;
 #endif
 
+void _PG_init(void);
+
 /*
- * Structure for representing an email address in PostgreSQL.
- * Format: local-part@domain
- * This is designed to efficiently store and manipulate email addresses
- * while maintaining PostgreSQL's TOAST-able varlena format.
+ * Module load callback
  */
-typedef struct {
-    /* varlena header for storing total struct length */
-    char vl_len_[4];
-
-    /* offset to where domain starts in data array */
-    uint16 domain_offset;
-
-    /* lengths of local-part and domain */
-    uint16 local_len;
-    uint16 domain_len;
-
-    /* actual data storage: [local_part]\0[domain]\0
-     * both parts are null-terminated for easy string handling
-     */
-    char data[FLEXIBLE_ARRAY_MEMBER];
-} EMAIL_ADDR;
+void
+_PG_init(void) {
+    email_stats_init();
+    email_simd_init();
+    email_suppression_init();
+}
 
 /*
- * Macros for working with email_addr type
+ * Computes the canonical form of an email address.
+ * The canonical local part is written to canon_local and the canonical
+ * (lowercased) domain to canon_domain; both buffers must be as large as
+ * the corresponding input. Returns the EMAIL_FLAG_QUOTED_LOCAL bit.
  */
-#define PG_GETARG_EMAIL_ADDR_P(n)     ((EMAIL_ADDR *) PG_GETARG_POINTER(n))
-#define PG_GETARG_EMAIL_ADDR_PP(n)  ((EMAIL_ADDR *) PG_DETOAST_DATUM(PG_GETARG_DATUM(n)))
-#define PG_GETARG_EMAIL_ADDR_COPY(n) ((EMAIL_ADDR *) PG_DETOAST_DATUM_COPY(PG_GETARG_DATUM(n)))
+static uint8
+email_canonicalize(const char *local_part, const size_t local_len,
+                   const char *domain, const size_t domain_len,
+                   char *canon_local, size_t *canon_local_len,
+                   char *canon_domain) {
+    bool quoted;
 
-/* For returning email_addr values */
-#define PG_RETURN_EMAIL_ADDR(x)    PG_RETURN_POINTER(x)
+    *canon_local_len = canonicalize_local_part(local_part, local_len, canon_local, &quoted);
+
+    email_lower(canon_domain, domain, domain_len);
+
+    return quoted ? EMAIL_FLAG_QUOTED_LOCAL : 0;
+}
 
 /*
  * Creates a new EMAIL_ADDR structure from local-part and domain.
  *
  * Arguments:
- *     local_part - the part before @ in email
- *     domain - the part after @ in email
+ *     local_part, local_len - the part before @ in email
+ *     domain, domain_len - the part after @ in email
  *
  * Returns:
  *     Pointer to newly allocated EMAIL_ADDR structure
  *
  * Note: The caller must ensure input strings are valid.
+ * The canonical form is computed here, once per value.
  */
 EMAIL_ADDR *
-make_email_addr(const char *local_part, const char *domain) {
-    const Size local_len = strlen(local_part);
-    const Size domain_len = strlen(domain);
+make_email_addr(const char *local_part, const size_t local_len,
+                const char *domain, const size_t domain_len) {
+    return make_email_addr_idn(local_part, local_len, domain, domain_len, NULL, 0);
+}
 
+/*
+ * As make_email_addr; a non-NULL ascii_domain is the A-label form of a
+ * U-label domain and becomes its canonical domain
+ */
+EMAIL_ADDR *
+make_email_addr_idn(const char *local_part, const size_t local_len,
+                    const char *domain, const size_t domain_len,
+                    const char *ascii_domain, const size_t ascii_len) {
     /* Validate lengths */
-    if (local_len > 64)
+    if (local_len > EMAIL_MAX_LOCAL_LENGTH)
         ereport(ERROR,
             (errcode(ERRCODE_STRING_DATA_RIGHT_TRUNCATION),
                 errmsg("email local part too long"),
                 errdetail("Maximum length is 64 characters.")));
 
-    if (domain_len > 255)
+    if (domain_len > EMAIL_MAX_DOMAIN_LENGTH)
         ereport(ERROR,
             (errcode(ERRCODE_STRING_DATA_RIGHT_TRUNCATION),
                 errmsg("email domain too long"),
                 errdetail("Maximum length is 255 characters.")));
 
-    /* Calculate total size with proper alignment */
-    const Size total_size = VARHDRSZ +
-                            offsetof(EMAIL_ADDR, data) +
-                            local_len + 1 + /* local part + null terminator */
-                            domain_len + 1; /* domain + null terminator */
-
-    /* Allocate and zero memory */
-    EMAIL_ADDR *result = (EMAIL_ADDR *) palloc0(total_size);
+    /*
+     * Allocate for the worst case and write the canonical parts straight
+     * into the datum; a canonical part that turns out to be identical to
+     * the entered one is overwritten by the next or cut off.
+     */
+    EMAIL_ADDR *result = (EMAIL_ADDR *) palloc(offsetof(EMAIL_ADDR, data) +
+                                               2 * (local_len + domain_len) +
+                                               (ascii_domain ? 1 + ascii_len : 0));
+    uint8 flags = 0;
+    bool quoted;
+
+    /* [local][domain][canonical local][canonical domain] */
+    char *dest = result->data;
+    memcpy(dest, local_part, local_len);
+    dest += local_len;
+    memcpy(dest, domain, domain_len);
+    dest += domain_len;
+
+    const size_t canon_local_len = canonicalize_local_part(local_part, local_len, dest, &quoted);
+    if (quoted)
+        flags |= EMAIL_FLAG_QUOTED_LOCAL;
+    if (canon_local_len != local_len || memcmp(dest, local_part, local_len) != 0) {
+        flags |= EMAIL_FLAG_CANON_LOCAL;
+        dest += canon_local_len;
+    }
 
-    /* Set varlena header */
-    SET_VARSIZE(result, total_size);
+    if (ascii_domain != NULL) {
+        flags |= EMAIL_FLAG_CANON_DOMAIN | EMAIL_FLAG_IDN_DOMAIN;
+        *dest++ = (char) ascii_len;
+        memcpy(dest, ascii_domain, ascii_len);
+        dest += ascii_len;
+    } else if (email_lower(dest, domain, domain_len)) {
+        flags |= EMAIL_FLAG_CANON_DOMAIN;
+        dest += domain_len;
+    }
 
-    /* Set lengths */
+    SET_VARSIZE(result, dest - (char *) result);
+    result->version = EMAIL_ADDR_VERSION_1;
+    result->flags = flags;
     result->local_len = local_len;
     result->domain_len = domain_len;
-    result->domain_offset = local_len + 1; /* Position after local part's null terminator */
-
-    /* Copy local part */
-    memcpy(result->data, local_part, local_len);
-    result->data[local_len] = '\0';
-
-    /* Copy domain */
-    memcpy(result->data + result->domain_offset, domain, domain_len);
-    result->data[result->domain_offset + domain_len] = '\0';
 
     return result;
 }
 
 /*
- * Returns pointer to local-part of email address.
- * Result is null-terminated string.
+ * Decodes an email address into a view.
+ * Current datums are decoded in place; datums in the version 0 layout
+ * have their canonical form computed into the view's scratch buffer.
+ *
+ * The datum may have a short (1-byte) varlena header, as it does when
+ * read straight from a heap tuple, so its fields are read at byte level
+ * through VARDATA_ANY rather than through the struct.
  */
-const char *
-get_local_part(const EMAIL_ADDR *addr) {
+void
+email_addr_unpack(const EMAIL_ADDR *addr, EmailAddrView *view) {
     Assert(addr != NULL);
-    return addr->data;
+
+    const uint8 *hdr = (const uint8 *) VARDATA_ANY(addr);
+
+    if (EMAIL_ADDR_IS_V0(addr)) {
+        uint16 fields[3];
+        size_t canon_local_len;
+
+        /* domain_offset, local_len, domain_len; possibly unaligned */
+        memcpy(fields, hdr, sizeof(fields));
+
+        const char *data = (const char *) hdr + sizeof(fields);
+
+        view->local = data;
+        view->local_len = fields[1];
+        view->domain = data + fields[0];
+        view->domain_len = fields[2];
+
+        view->flags = email_canonicalize(view->local, view->local_len,
+                                         view->domain, view->domain_len,
+                                         view->buf, &canon_local_len,
+                                         view->buf + view->local_len);
+        view->canon_local = view->buf;
+        view->canon_local_len = canon_local_len;
+        view->canon_domain = view->buf + view->local_len;
+        view->canon_domain_len = view->domain_len;
+        view->domain_id = 0;
+        return;
+    }
+
+    const uint8 flags = hdr[EMAIL_ADDR_FLAGS_OFFSET];
+    const uint8 local_len = hdr[EMAIL_ADDR_LOCAL_LEN_OFFSET];
+    const uint8 domain_len = hdr[EMAIL_ADDR_DOMAIN_LEN_OFFSET];
+    const char *p = (const char *) hdr + EMAIL_ADDR_HDRSZ;
+
+    view->flags = flags;
+    view->local = p;
+    view->local_len = local_len;
+    p += local_len;
+    view->domain_len = domain_len;
+
+    if (flags & EMAIL_FLAG_INTERNED) {
+        /* Domain replaced by its dictionary id; it is canonical by construction */
+        uint32 id;
+
+        memcpy(&id, p, sizeof(uint32));
+        p += sizeof(uint32);
+        view->domain_id = id;
+        view->domain = email_domain_dict_lookup(id, view->domain_len);
+    } else {
+        view->domain_id = 0;
+        view->domain = p;
+        p += domain_len;
+    }
+
+    /* Canonical local part is the entered one, minus quotes if unquotable */
+    if (flags & EMAIL_FLAG_CANON_LOCAL) {
+        view->canon_local = p;
+        view->canon_local_len = (flags & EMAIL_FLAG_QUOTED_LOCAL) || view->local[0] != '"'
+                                    ? local_len
+                                    : local_len - 2;
+        p += view->canon_local_len;
+    } else {
+        view->canon_local = view->local;
+        view->canon_local_len = view->local_len;
+    }
+
+    if (flags & EMAIL_FLAG_IDN_DOMAIN) {
+        view->canon_domain = p + 1;
+        view->canon_domain_len = (uint8) p[0];
+        return;
+    }
+
+    if (flags & EMAIL_FLAG_CANON_DOMAIN)
+        view->canon_domain = p;
+    else
+        view->canon_domain = view->domain;
+    view->canon_domain_len = view->domain_len;
 }
 
 /*
- * Returns pointer to domain part of email address.
- * Result is null-terminated string.
+ * Compare two decoded email addresses.
+ * Domains are compared first, then local parts: unquoted local parts
+ * sort before those that must stay quoted. Since both parts are
+ * canonical, this is a plain byte comparison.
  */
-const char *
-get_domain(const EMAIL_ADDR *addr) {
-    Assert(addr != NULL);
-    return addr->data + addr->domain_offset;
+int
+email_addr_view_cmp(const EmailAddrView *view1, const EmailAddrView *view2) {
+    /* Interned domains with the same id are equal without looking at them */
+    if (view1->domain_id == 0 || view1->domain_id != view2->domain_id) {
+        const int cmp = bounded_memcmp(view1->canon_domain, view1->canon_domain_len,
+                                       view2->canon_domain, view2->canon_domain_len);
+        if (cmp != 0)
+            return cmp;
+    }
+
+    const bool quoted1 = (view1->flags & EMAIL_FLAG_QUOTED_LOCAL) != 0;
+    const bool quoted2 = (view2->flags & EMAIL_FLAG_QUOTED_LOCAL) != 0;
+    if (quoted1 != quoted2)
+        return quoted1 ? 1 : -1;
+
+    return bounded_memcmp(view1->canon_local, view1->canon_local_len,
+                          view2->canon_local, view2->canon_local_len);
 }
 
 /*
- * Returns newly allocated string containing complete email address
- * in "local-part@domain" format.
- * Caller is responsible for pfree'ing the result.
+ * Seeded 64-bit hash of the canonical form of a decoded email address,
+ * so that equal addresses produce the same hash.
+ * The canonical parts are already case folded, so they are hashed with
+ * the word-at-a-time hash_bytes_extended kernel as they are.
  */
-char *
-get_full_email(const EMAIL_ADDR *addr) {
-    Assert(addr != NULL);
+uint64
+email_addr_view_hash_extended(const EmailAddrView *view, const uint64 seed) {
+    /* Hash domain, then use it as the seed for the local part */
+    const uint64 hash = hash_bytes_extended((const unsigned char *) view->canon_domain,
+                                            view->canon_domain_len, seed);
+
+    return hash_bytes_extended((const unsigned char *) view->canon_local,
+                               view->canon_local_len, hash);
+}
+
+/*
+ * 32-bit hash of the canonical form of a decoded email address.
+ * This is the low half of the extended hash with seed 0, as the hash
+ * opclass requires of support functions 1 and 2.
+ */
+uint32
+email_addr_view_hash(const EmailAddrView *view) {
+    return (uint32) email_addr_view_hash_extended(view, 0);
+}
+
+/*
+ * Returns a copy of an email address with its domain replaced by a
+ * dictionary id. Addresses whose domain is not already in canonical
+ * (lowercase) form are returned unchanged, so that an interned domain
+ * always equals its canonical form, and so are those whose domain a
+ * read-only transaction cannot add.
+ */
+EMAIL_ADDR *
+email_addr_intern(const EMAIL_ADDR *addr) {
+    EmailAddrView view;
 
-    /* Allocate memory for: local-part + @ + domain + null terminator */
-    char *result = palloc(addr->local_len + 1 + addr->domain_len + 1);
+    email_addr_unpack(addr, &view);
 
-    /* Construct full address */
-    memcpy(result, addr->data, addr->local_len);
-    result[addr->local_len] = '@';
-    memcpy(result + addr->local_len + 1,
-           addr->data + addr->domain_offset,
-           addr->domain_len);
-    result[addr->local_len + 1 + addr->domain_len] = '\0';
+    if (view.domain_id != 0 || view.canon_domain_len != view.domain_len ||
+        (view.canon_domain != view.domain &&
+         memcmp(view.canon_domain, view.domain, view.domain_len) != 0))
+        return (EMAIL_ADDR *) addr;
+
+    const uint32 id = email_domain_dict_intern(view.domain, view.domain_len);
+    if (id == 0)
+        return (EMAIL_ADDR *) addr;
+
+    const bool canon_local_stored = view.canon_local != view.local;
+
+    Size total_size = offsetof(EMAIL_ADDR, data) + view.local_len + sizeof(uint32);
+    if (canon_local_stored)
+        total_size += view.canon_local_len;
+
+    EMAIL_ADDR *result = (EMAIL_ADDR *) palloc(total_size);
+    SET_VARSIZE(result, total_size);
+
+    result->version = EMAIL_ADDR_VERSION_1;
+    result->flags = (view.flags & EMAIL_FLAG_QUOTED_LOCAL) | EMAIL_FLAG_INTERNED;
+    if (canon_local_stored)
+        result->flags |= EMAIL_FLAG_CANON_LOCAL;
+    result->local_len = view.local_len;
+    result->domain_len = view.domain_len;
+
+    /* Copy parts: [local][domain id][canonical local] */
+    char *dest = result->data;
+    memcpy(dest, view.local, view.local_len);
+    dest += view.local_len;
+    memcpy(dest, &id, sizeof(uint32));
+    dest += sizeof(uint32);
+    if (canon_local_stored)
+        memcpy(dest, view.canon_local, view.canon_local_len);
 
     return result;
 }
@@ -156,23 +350,17 @@ get_full_email(const EMAIL_ADDR *addr) {
  */
 bool
 email_addr_equals(const EMAIL_ADDR *addr1, const EMAIL_ADDR *addr2) {
+    EmailAddrView view1;
+    EmailAddrView view2;
+
     /* Check for NULL inputs */
     if (!addr1 || !addr2)
         return false;
 
-    /* First compare domains (case-insensitive) */
-    int cmp = bounded_strcasecmp(get_domain(addr1), addr1->domain_len,
-                                 get_domain(addr2), addr2->domain_len);
-    if (cmp != 0)
-        return false;;
+    email_addr_unpack(addr1, &view1);
+    email_addr_unpack(addr2, &view2);
 
-    /* If domains are equal, compare local parts */
-    cmp = compare_local_parts(get_local_part(addr1), addr1->local_len,
-                              get_local_part(addr2), addr2->local_len);
-    if (cmp != 0)
-        return false;
-
-    return true;
+    return email_addr_view_cmp(&view1, &view2) == 0;
 }
 
 /*
@@ -181,71 +369,181 @@ email_addr_equals(const EMAIL_ADDR *addr1, const EMAIL_ADDR *addr2) {
  */
 uint32
 email_addr_hash(const EMAIL_ADDR *addr) {
+    EmailAddrView view;
+
     /* Handle NULL input */
     if (!addr)
         return 0;
 
-    /* Hash local part */
-    uint32 hash = hash_local_part(get_local_part(addr), addr->local_len);
-
-    /* Add @ separator to hash */
-    hash = (hash << 5) + hash + '@';
-
-    /* Hash domain (always case-insensitive) */
-    for (int i = 0; i < addr->domain_len; i++)
-        hash = (hash << 5) + hash +
-               pg_tolower(get_domain(addr)[i]);
-
-    return hash;
-}
-
-/*
- * Find the rightmost @ character that is not within quotes.
- * Returns NULL if no valid @ character is found.
- * Handles escaped quotes and validates quote structure.
- */
-static const char *
-find_valid_at(const char *input_text) {
-    const char *at_pos = NULL;
-    const char *p = input_text;
-    bool in_quotes = false;
-    bool escaped = false;
-
-    /* Scan the entire string */
-    while (*p != '\0') {
-        if (escaped) {
-            /* Previous character was backslash - this character is escaped */
-            escaped = false;
-        } else if (*p == '\\') {
-            /* Start of escape sequence */
-            escaped = true;
-        } else if (*p == '"') {
-            /* Toggle quote state */
-            in_quotes = !in_quotes;
-        } else if (*p == '@' && !in_quotes) {
-            /* Found an @ outside of quotes */
-            at_pos = p;
-        }
-        p++;
-    }
+    email_addr_unpack(addr, &view);
 
-    /* Check for unterminated quotes */
-    if (in_quotes) {
-        ereport(ERROR,
+    return email_addr_view_hash(&view);
+}
+
+/*
+ * Seeded 64-bit variant of email_addr_hash
+ */
+uint64
+email_addr_hash_extended(const EMAIL_ADDR *addr, const uint64 seed) {
+    EmailAddrView view;
+
+    /* Handle NULL input */
+    if (!addr)
+        return seed;
+
+    email_addr_unpack(addr, &view);
+
+    return email_addr_view_hash_extended(&view, seed);
+}
+
+/*
+ * Report why email_parse rejected an input string. With a soft error
+ * context the error is saved there and the function returns.
+ */
+static void
+report_parse_error(const char *input, const size_t len, const EmailParseResult *parse,
+                   Node *escontext) {
+    switch (parse->error) {
+        case EMAIL_PARSE_UNTERMINATED_QUOTES:
+            errsave(escontext,
+                (errcode(ERRCODE_INVALID_TEXT_REPRESENTATION),
+                    errmsg("unterminated quotes in email address: \"%.*s\"",
+                        (int) len, input)));
+            break;
+        case EMAIL_PARSE_TRAILING_BACKSLASH:
+            errsave(escontext,
                 (errcode(ERRCODE_INVALID_TEXT_REPRESENTATION),
-                    errmsg("unterminated quotes in email address: \"%s\"",
-                        input_text)));
+                    errmsg("invalid trailing backslash in email address: \"%.*s\"",
+                        (int) len, input)));
+            break;
+        case EMAIL_PARSE_MISSING_AT:
+            errsave(escontext,
+                (errcode(ERRCODE_INVALID_TEXT_REPRESENTATION),
+                    errmsg("invalid input syntax for type emailaddr: \"%.*s\"",
+                        (int) len, input)));
+            break;
+        case EMAIL_PARSE_INVALID_LOCAL:
+            errsave(escontext,
+                (errcode(ERRCODE_INVALID_TEXT_REPRESENTATION),
+                    errmsg("invalid local-part of email address: %s", parse->error_msg),
+                    errdetail("Local-part was: \"%.*s\"", (int) parse->local_len, parse->local),
+                    errhint("The local-part of an email address must follow RFC 5321/5322 rules")));
+            break;
+        case EMAIL_PARSE_INVALID_DOMAIN:
+            errsave(escontext,
+                (errcode(ERRCODE_INVALID_TEXT_REPRESENTATION),
+                    errmsg("invalid domain part of email address: %s", parse->error_msg),
+                    errdetail("Domain was: \"%.*s\"", (int) parse->domain_len, parse->domain),
+                    errhint("Domain must follow DNS naming rules or be a valid IP address literal")));
+            break;
+        case EMAIL_PARSE_DOMAIN_TOO_LONG:
+            errsave(escontext,
+                (errcode(ERRCODE_STRING_DATA_RIGHT_TRUNCATION),
+                    errmsg("email domain too long"),
+                    errdetail("Maximum length is 255 characters.")));
+            break;
+        case EMAIL_PARSE_OK:
+            break;
     }
+}
 
-    /* Check for trailing backslash */
-    if (escaped) {
-        ereport(ERROR,
-                (errcode(ERRCODE_INVALID_TEXT_REPRESENTATION),
-                    errmsg("invalid trailing backslash in email address: \"%s\"",
-                        input_text)));
+/*
+ * Builds the datum of a validated address, interned if typmod says so
+ */
+static EMAIL_ADDR *
+make_email_addr_parsed(const EmailParseResult *parse, const int32 typmod) {
+    EMAIL_ADDR *result;
+
+    if (parse->idn_domain) {
+        /* Converted once here, compared as ASCII from then on */
+        char ascii[EMAIL_MAX_DOMAIN_LENGTH];
+        size_t ascii_len;
+        char *error_msg;
+
+        if (!email_domain_to_ascii(parse->domain, parse->domain_len, ascii, &ascii_len, &error_msg))
+            elog(ERROR, "could not convert validated domain: %s", error_msg);
+        result = make_email_addr_idn(parse->local, parse->local_len, parse->domain,
+                                     parse->domain_len, ascii, ascii_len);
+    } else
+        result = make_email_addr(parse->local, parse->local_len, parse->domain, parse->domain_len);
+
+    if (typmod == EMAIL_TYPMOD_INTERNED)
+        result = email_addr_intern(result);
+
+    return result;
+}
+
+/*
+ * Builds an email address from its text form, shared by the input
+ * function, the casts and the batch functions. input need not be
+ * NUL-terminated. Returns NULL if the input is invalid and escontext is
+ * a soft error context; otherwise errors are thrown.
+ */
+EMAIL_ADDR *
+email_addr_from_string(const char *input, const size_t len, const int32 typmod,
+                       Node *escontext) {
+    instr_time start;
+
+    EMAIL_STATS_BEGIN(EMAIL_STATS_INPUT, start);
+
+    /* Split and validate in one go, then build the datum from the input */
+    EmailParseResult parse;
+    if (!email_parse_opt(input, len, EMAIL_PARSE_OPTIONS, &parse)) {
+        report_parse_error(input, len, &parse, escontext);
+        return NULL;
     }
 
-    return at_pos;
+    EMAIL_ADDR *result = make_email_addr_parsed(&parse, typmod);
+
+    if (email_trace)
+        elog(NOTICE, "email_addr_in: \"%.*s\" stored in %u bytes, flags 0x%02x",
+             (int) len, input, VARSIZE(result), result->flags);
+
+    EMAIL_STATS_END(EMAIL_STATS_INPUT, start, len);
+
+    return result;
+}
+
+/*
+ * Decodes the text form of an email address straight into a view, for
+ * comparing without building a datum. The canonical parts are computed
+ * into the view's scratch buffer. Invalid input raises the errors of
+ * email_addr_in.
+ */
+void
+email_addr_view_from_string(const char *input, const size_t len, EmailAddrView *view) {
+    EmailParseResult parse;
+    bool quoted;
+
+    if (!email_parse_opt(input, len, EMAIL_PARSE_OPTIONS, &parse)) {
+        report_parse_error(input, len, &parse, NULL);
+        pg_unreachable();
+    }
+
+    view->local = parse.local;
+    view->local_len = parse.local_len;
+    view->domain = parse.domain;
+    view->domain_len = parse.domain_len;
+
+    /* The parser limits local parts to EMAIL_MAX_LOCAL_LENGTH */
+    view->canon_local = view->buf;
+    view->canon_local_len = canonicalize_local_part(parse.local, parse.local_len, view->buf, &quoted);
+    view->canon_domain = view->buf + view->canon_local_len;
+    view->canon_domain_len = parse.domain_len;
+
+    if (parse.idn_domain) {
+        size_t ascii_len;
+        char *error_msg;
+
+        if (!email_domain_to_ascii(parse.domain, parse.domain_len, view->buf + view->canon_local_len,
+                                   &ascii_len, &error_msg))
+            elog(ERROR, "could not convert validated domain: %s", error_msg);
+        view->canon_domain_len = ascii_len;
+    } else
+        email_lower(view->buf + view->canon_local_len, parse.domain, parse.domain_len);
+
+    view->flags = quoted ? EMAIL_FLAG_QUOTED_LOCAL : 0;
+    view->domain_id = 0;
 }
 
 /*
@@ -255,29 +553,80 @@ PG_FUNCTION_INFO_V1(email_addr_in);
 
 Datum
 email_addr_in(PG_FUNCTION_ARGS) {
-    char *input_text = PG_GETARG_CSTRING(0);
+    const char *input_text = PG_GETARG_CSTRING(0);
+    const int32 typmod = PG_NARGS() > 2 ? PG_GETARG_INT32(2) : -1;
+
+    EMAIL_ADDR *result = email_addr_from_string(input_text, strlen(input_text), typmod,
+                                                fcinfo->context);
+    if (result == NULL)
+        PG_RETURN_NULL();
 
-    /* Find the @ character */
-    const char *at_pos = find_valid_at(input_text);
-    if (at_pos == NULL)
+    PG_RETURN_EMAIL_ADDR(result);
+}
+
+/*
+ * Type modifier input function: accepts email_addr(interned)
+ */
+PG_FUNCTION_INFO_V1(email_addr_typmod_in);
+
+Datum
+email_addr_typmod_in(PG_FUNCTION_ARGS) {
+    ArrayType *ta = PG_GETARG_ARRAYTYPE_P(0);
+    Datum *elems;
+    int n;
+
+    deconstruct_array_builtin(ta, CSTRINGOID, &elems, NULL, &n);
+
+    if (n != 1 || pg_strcasecmp(DatumGetCString(elems[0]), "interned") != 0)
         ereport(ERROR,
-            (errcode(ERRCODE_INVALID_TEXT_REPRESENTATION),
-                errmsg("invalid input syntax for type emailaddr: \"%s\"",
-                    input_text)));
+            (errcode(ERRCODE_INVALID_PARAMETER_VALUE),
+                errmsg("invalid type modifier for type email_addr"),
+                errhint("The only supported modifier is \"interned\".")));
+
+    PG_RETURN_INT32(EMAIL_TYPMOD_INTERNED);
+}
 
-    /* Split the address and create a new email addr */
-    char *local_part = pnstrdup(input_text, at_pos - input_text);
-    char *domain = pstrdup(at_pos + 1);
+/*
+ * Type modifier output function
+ */
+PG_FUNCTION_INFO_V1(email_addr_typmod_out);
 
-    check_local_part(local_part);
-    check_domain(domain);
+Datum
+email_addr_typmod_out(PG_FUNCTION_ARGS) {
+    const int32 typmod = PG_GETARG_INT32(0);
 
-    const EMAIL_ADDR *result = make_email_addr(local_part, domain);
+    PG_RETURN_CSTRING(pstrdup(typmod == EMAIL_TYPMOD_INTERNED ? "(interned)" : ""));
+}
 
-    pfree(local_part);
-    pfree(domain);
+/*
+ * Length coercion function: converts values stored into an
+ * email_addr(interned) column to the interned representation
+ */
+PG_FUNCTION_INFO_V1(email_addr_apply_typmod);
 
-    PG_RETURN_POINTER(result);
+Datum
+email_addr_apply_typmod(PG_FUNCTION_ARGS) {
+    EMAIL_ADDR *email = PG_GETARG_EMAIL_ADDR_PP(0);
+    const int32 typmod = PG_GETARG_INT32(1);
+
+    /*
+     * An interned datum can outlive the subtransaction that added its id,
+     * in a PL/pgSQL variable for one, and the id then is not in the
+     * dictionary. Unpacking resolves it, so such a datum fails here
+     * rather than in every later read of the row.
+     */
+    if (!EMAIL_ADDR_IS_V0(email) &&
+        (((const uint8 *) VARDATA_ANY(email))[EMAIL_ADDR_FLAGS_OFFSET] & EMAIL_FLAG_INTERNED)) {
+        EmailAddrView view;
+
+        email_addr_unpack(email, &view);
+        PG_RETURN_EMAIL_ADDR(email);
+    }
+
+    if (typmod == EMAIL_TYPMOD_INTERNED)
+        email = email_addr_intern(email);
+
+    PG_RETURN_EMAIL_ADDR(email);
 }
 
 /*
@@ -289,91 +638,301 @@ PG_FUNCTION_INFO_V1(email_addr_out);
 Datum
 email_addr_out(PG_FUNCTION_ARGS) {
     const EMAIL_ADDR *email = PG_GETARG_EMAIL_ADDR_PP(0);
+    EmailAddrView view;
+    instr_time start;
 
-    if (email == NULL)
-        elog(ERROR, "null email address");
-
-    /* Debug: Print structure details */
-    elog(NOTICE, "Structure details:");
-    elog(NOTICE, "  varlena size: %d", VARSIZE(email));
-    elog(NOTICE, "  domain_offset: %d", email->domain_offset);
-    elog(NOTICE, "  local_len: %d", email->local_len);
-    elog(NOTICE, "  domain_len: %d", email->domain_len);
-
-    /* Debug: Print raw data */
-    elog(NOTICE, "Raw data (hex):");
-    for (int i = 0; i < VARSIZE(email); i++) {
-        elog(NOTICE, "  byte[%d]: %02x", i, ((unsigned char *)email)[i]);
-    }
-
-    /* Get parts with bounds checking */
-    const char *local_part = get_local_part(email);
-    elog(NOTICE, "Local part pointer: %p", (void*)local_part);
-    elog(NOTICE, "Local part content: '%.*s'", email->local_len, local_part);
+    EMAIL_STATS_BEGIN(EMAIL_STATS_OUTPUT, start);
 
-    const char *domain = get_domain(email);
-    elog(NOTICE, "Domain pointer: %p", (void*)domain);
-    elog(NOTICE, "Domain content: '%.*s'", email->domain_len, domain);
+    email_addr_unpack(email, &view);
 
-    /* Calculate total length needed */
-    const int total_len = email->local_len + 1 + email->domain_len + 1;
-
-    /* Allocate and construct result */
+    const int total_len = view.local_len + 1 + view.domain_len + 1;
     char *result = palloc(total_len);
 
-    /* Copy with explicit lengths */
-    memcpy(result, local_part, email->local_len);
-    result[email->local_len] = '@';
-    memcpy(result + email->local_len + 1, domain, email->domain_len);
+    memcpy(result, view.local, view.local_len);
+    result[view.local_len] = '@';
+    memcpy(result + view.local_len + 1, view.domain, view.domain_len);
     result[total_len - 1] = '\0';
 
-    /* Debug: Print final result */
-    elog(NOTICE, "Final result: '%s'", result);
+    if (email_trace)
+        elog(NOTICE, "email_addr_out: version %d, flags 0x%02x, %u bytes, local_len %d, domain_len %d",
+             EMAIL_ADDR_IS_V0(email)
+                 ? 0
+                 : ((const uint8 *) VARDATA_ANY(email))[EMAIL_ADDR_VERSION_OFFSET],
+             view.flags, (uint32) VARSIZE_ANY(email),
+             view.local_len, view.domain_len);
+
+    EMAIL_STATS_END(EMAIL_STATS_OUTPUT, start, total_len - 1);
 
     PG_RETURN_CSTRING(result);
 }
 
+/*
+ * Binary input function.
+ * Wire format: [version byte][local length byte][local part]
+ *              [domain length byte][domain]
+ */
+PG_FUNCTION_INFO_V1(email_addr_recv);
+
+Datum
+email_addr_recv(PG_FUNCTION_ARGS) {
+    StringInfo buf = (StringInfo) PG_GETARG_POINTER(0);
+    const int32 typmod = PG_NARGS() > 2 ? PG_GETARG_INT32(2) : -1;
+    const int cursor = buf->cursor;
+    instr_time start;
+
+    EMAIL_STATS_BEGIN(EMAIL_STATS_RECEIVE, start);
+
+    const int version = pq_getmsgbyte(buf);
+    if (version != EMAIL_ADDR_WIRE_VERSION)
+        ereport(ERROR,
+            (errcode(ERRCODE_INVALID_BINARY_REPRESENTATION),
+                errmsg("unsupported email_addr binary format version %d", version)));
+
+    const int local_len = pq_getmsgbyte(buf);
+    const char *local_part = pq_getmsgbytes(buf, local_len);
+    const int domain_len = pq_getmsgbyte(buf);
+    const char *domain = pq_getmsgbytes(buf, domain_len);
+
+    /* Held to the rules of text input, whatever the sender checked */
+    EmailParseResult parse;
+    if (!email_parse_parts(local_part, local_len, domain, domain_len, EMAIL_PARSE_OPTIONS, &parse))
+        ereport(ERROR,
+            (errcode(ERRCODE_INVALID_BINARY_REPRESENTATION),
+                errmsg("invalid email address in external binary format"),
+                parse.error_msg ? errdetail("%s: %s", email_parse_error_string(parse.error),
+                                            parse.error_msg)
+                                : errdetail("%s", email_parse_error_string(parse.error))));
+
+    EMAIL_ADDR *result = make_email_addr_parsed(&parse, typmod);
+
+    EMAIL_STATS_END(EMAIL_STATS_RECEIVE, start, buf->cursor - cursor);
+
+    PG_RETURN_EMAIL_ADDR(result);
+}
+
+/*
+ * Binary output function, see email_addr_recv for the format
+ */
+PG_FUNCTION_INFO_V1(email_addr_send);
+
+Datum
+email_addr_send(PG_FUNCTION_ARGS) {
+    const EMAIL_ADDR *email = PG_GETARG_EMAIL_ADDR_PP(0);
+    EmailAddrView view;
+    StringInfoData buf;
+    instr_time start;
+
+    EMAIL_STATS_BEGIN(EMAIL_STATS_SEND, start);
+
+    email_addr_unpack(email, &view);
+
+    pq_begintypsend(&buf);
+    pq_sendbyte(&buf, EMAIL_ADDR_WIRE_VERSION);
+    pq_sendbyte(&buf, view.local_len);
+    pq_sendbytes(&buf, view.local, view.local_len);
+    pq_sendbyte(&buf, view.domain_len);
+    pq_sendbytes(&buf, view.domain, view.domain_len);
+
+    bytea *result = pq_endtypsend(&buf);
+
+    EMAIL_STATS_END(EMAIL_STATS_SEND, start, VARSIZE(result) - VARHDRSZ);
+
+    PG_RETURN_BYTEA_P(result);
+}
+
 /*
  * Compare two email addresses
  * Returns -1 if addr1 < addr2, 0 if equal, 1 if addr1 > addr2
  */
 PG_FUNCTION_INFO_V1(email_addr_cmp);
 
+/*
+ * Core comparison shared by email_addr_cmp and the sort support comparator.
+ * Domains are compared first, then local parts, both in canonical form.
+ */
+static int
+email_addr_cmp_internal(const EMAIL_ADDR *addr1, const EMAIL_ADDR *addr2) {
+    EmailAddrView view1;
+    EmailAddrView view2;
+
+    email_addr_unpack(addr1, &view1);
+    email_addr_unpack(addr2, &view2);
+
+    const int result = email_addr_view_cmp(&view1, &view2);
+
+    return result;
+}
+
 Datum
 email_addr_cmp(PG_FUNCTION_ARGS) {
-    const EMAIL_ADDR *addr1 = PG_GETARG_EMAIL_ADDR_PP(0);
-    const EMAIL_ADDR *addr2 = PG_GETARG_EMAIL_ADDR_PP(1);
-
-    /* Handle NULLs */
-    if (addr1 == NULL) {
-        if (addr2 == NULL)
-            PG_RETURN_INT32(0); /* NULL == NULL */
-        PG_RETURN_INT32(-1); /* NULL < non-NULL */
-    }
-    if (addr2 == NULL)
-        PG_RETURN_INT32(1); /* non-NULL > NULL */
+    EMAIL_ADDR *addr1 = PG_GETARG_EMAIL_ADDR_PP(0);
+    EMAIL_ADDR *addr2 = PG_GETARG_EMAIL_ADDR_PP(1);
 
-    /* First compare domains (case-insensitive) */
-    int cmp = bounded_strcasecmp(get_domain(addr1), addr1->domain_len,
-                                 get_domain(addr2), addr2->domain_len);
-    if (cmp != 0)
-        PG_RETURN_INT32(cmp);
+    const int cmp = email_addr_cmp_internal(addr1, addr2);
 
-    /* If domains are equal, compare local parts */
-    cmp = compare_local_parts(get_local_part(addr1), addr1->local_len,
-                              get_local_part(addr2), addr2->local_len);
+    PG_FREE_IF_COPY(addr1, 0);
+    PG_FREE_IF_COPY(addr2, 1);
 
     PG_RETURN_INT32(cmp);
 }
 
+/*
+ * State for abbreviated key conversion during sorts
+ */
+typedef struct {
+    /* number of non-null values seen */
+    int64 input_count;
+
+    /* true while we still estimate the cardinality of abbreviated keys */
+    bool estimating;
+
+    /* cardinality estimator for abbreviated keys */
+    hyperLogLogState abbr_card;
+} email_addr_sortsupport_state;
+
+/*
+ * Sort support comparator: compares two datums without going
+ * through the function manager
+ */
+static int
+email_addr_fast_cmp(Datum x, Datum y, SortSupport ssup) {
+    EMAIL_ADDR *addr1 = DatumGetEmailAddrP(x);
+    EMAIL_ADDR *addr2 = DatumGetEmailAddrP(y);
+
+    const int cmp = email_addr_cmp_internal(addr1, addr2);
+
+    /* Free detoasted copies, tuplesort may compare millions of pairs */
+    if ((Pointer) addr1 != DatumGetPointer(x))
+        pfree(addr1);
+    if ((Pointer) addr2 != DatumGetPointer(y))
+        pfree(addr2);
+
+    return cmp;
+}
+
+/*
+ * Convert an email address to an abbreviated key.
+ *
+ * The key holds the first bytes of
+ *     [canonical domain] 0x00 [class] [canonical local part]
+ * where class is 1 for unquoted and 2 for quoted local parts, zero padded
+ * and in big-endian order, so that an unsigned integer comparison gives
+ * the same result as email_addr_view_cmp. Canonical parts never contain
+ * a zero byte, so a shorter part sorts first, as in bounded_memcmp.
+ */
+static Datum
+email_addr_abbrev_convert(Datum original, SortSupport ssup) {
+    email_addr_sortsupport_state *state = ssup->ssup_extra;
+    EMAIL_ADDR *addr = DatumGetEmailAddrP(original);
+    EmailAddrView view;
+    Datum res = (Datum) 0;
+    char *key = (char *) &res;
+
+    email_addr_unpack(addr, &view);
+
+    Size key_len = Min(view.canon_domain_len, sizeof(Datum));
+    memcpy(key, view.canon_domain, key_len);
+    if (key_len + 2 <= sizeof(Datum)) {
+        /* Separator is already zero; add the class and the local part */
+        key[key_len + 1] = (view.flags & EMAIL_FLAG_QUOTED_LOCAL) ? 2 : 1;
+        key_len += 2;
+        memcpy(key + key_len, view.canon_local,
+               Min(view.canon_local_len, sizeof(Datum) - key_len));
+    }
+
+    state->input_count += 1;
+
+    /* Feed the key to the cardinality estimator */
+    if (state->estimating) {
+        uint32 tmp;
+
+#if SIZEOF_DATUM == 8
+        tmp = (uint32) res ^ (uint32) ((uint64) res >> 32);
+#else
+        tmp = (uint32) res;
+#endif
+        addHyperLogLog(&state->abbr_card, DatumGetUInt32(hash_uint32(tmp)));
+    }
+
+    if ((Pointer) addr != DatumGetPointer(original))
+        pfree(addr);
+
+    /* Byteswap on little-endian machines so that unsigned comparison works */
+    return DatumBigEndianToNative(res);
+}
+
+/*
+ * Decide whether abbreviation is still worth it, using the same
+ * heuristic as the built-in uuid and text sort support
+ */
+static bool
+email_addr_abbrev_abort(int memtupcount, SortSupport ssup) {
+    email_addr_sortsupport_state *state = ssup->ssup_extra;
+
+    if (memtupcount < 10000 || state->input_count < 10000 || !state->estimating)
+        return false;
+
+    const double abbr_card = estimateHyperLogLog(&state->abbr_card);
+
+    /* Enough distinct keys: stop estimating and keep abbreviating */
+    if (abbr_card > 100000.0) {
+        state->estimating = false;
+        return false;
+    }
+
+    /* Abort when fewer than one distinct key per 2000 inputs */
+    if (abbr_card < state->input_count / 2000.0 + 0.5)
+        return true;
+
+    return false;
+}
+
+/*
+ * B-tree sort support function for email_addr_ops
+ */
+PG_FUNCTION_INFO_V1(email_addr_sortsupport);
+
+Datum
+email_addr_sortsupport(PG_FUNCTION_ARGS) {
+    SortSupport ssup = (SortSupport) PG_GETARG_POINTER(0);
+
+    ssup->comparator = email_addr_fast_cmp;
+    ssup->ssup_extra = NULL;
+
+    if (ssup->abbreviate) {
+        const MemoryContext oldcontext = MemoryContextSwitchTo(ssup->ssup_cxt);
+
+        email_addr_sortsupport_state *state = palloc(sizeof(email_addr_sortsupport_state));
+        state->input_count = 0;
+        state->estimating = true;
+        initHyperLogLog(&state->abbr_card, 10);
+
+        ssup->ssup_extra = state;
+        ssup->comparator = ssup_datum_unsigned_cmp;
+        ssup->abbrev_converter = email_addr_abbrev_convert;
+        ssup->abbrev_abort = email_addr_abbrev_abort;
+        ssup->abbrev_full_comparator = email_addr_fast_cmp;
+
+        MemoryContextSwitchTo(oldcontext);
+    }
+
+    PG_RETURN_VOID();
+}
+
 
 PG_FUNCTION_INFO_V1(email_addr_lt);
 
 Datum
 email_addr_lt(PG_FUNCTION_ARGS) {
-    const int32 cmp = DatumGetInt32(DirectFunctionCall2(email_addr_cmp,
-                                                        PG_GETARG_DATUM(0),
-                                                        PG_GETARG_DATUM(1)));
+    EMAIL_ADDR *addr1 = PG_GETARG_EMAIL_ADDR_PP(0);
+    EMAIL_ADDR *addr2 = PG_GETARG_EMAIL_ADDR_PP(1);
+    int cmp;
+
+    EMAIL_STATS_COMPARISON(cmp, email_addr_cmp_internal(addr1, addr2));
+
+    PG_FREE_IF_COPY(addr1, 0);
+    PG_FREE_IF_COPY(addr2, 1);
+
     PG_RETURN_BOOL(cmp < 0);
 }
 
@@ -381,9 +940,15 @@ PG_FUNCTION_INFO_V1(email_addr_le);
 
 Datum
 email_addr_le(PG_FUNCTION_ARGS) {
-    const int32 cmp = DatumGetInt32(DirectFunctionCall2(email_addr_cmp,
-                                                        PG_GETARG_DATUM(0),
-                                                        PG_GETARG_DATUM(1)));
+    EMAIL_ADDR *addr1 = PG_GETARG_EMAIL_ADDR_PP(0);
+    EMAIL_ADDR *addr2 = PG_GETARG_EMAIL_ADDR_PP(1);
+    int cmp;
+
+    EMAIL_STATS_COMPARISON(cmp, email_addr_cmp_internal(addr1, addr2));
+
+    PG_FREE_IF_COPY(addr1, 0);
+    PG_FREE_IF_COPY(addr2, 1);
+
     PG_RETURN_BOOL(cmp <= 0);
 }
 
@@ -391,9 +956,15 @@ PG_FUNCTION_INFO_V1(email_addr_gt);
 
 Datum
 email_addr_gt(PG_FUNCTION_ARGS) {
-    const int32 cmp = DatumGetInt32(DirectFunctionCall2(email_addr_cmp,
-                                                        PG_GETARG_DATUM(0),
-                                                        PG_GETARG_DATUM(1)));
+    EMAIL_ADDR *addr1 = PG_GETARG_EMAIL_ADDR_PP(0);
+    EMAIL_ADDR *addr2 = PG_GETARG_EMAIL_ADDR_PP(1);
+    int cmp;
+
+    EMAIL_STATS_COMPARISON(cmp, email_addr_cmp_internal(addr1, addr2));
+
+    PG_FREE_IF_COPY(addr1, 0);
+    PG_FREE_IF_COPY(addr2, 1);
+
     PG_RETURN_BOOL(cmp > 0);
 }
 
@@ -401,9 +972,15 @@ PG_FUNCTION_INFO_V1(email_addr_ge);
 
 Datum
 email_addr_ge(PG_FUNCTION_ARGS) {
-    const int32 cmp = DatumGetInt32(DirectFunctionCall2(email_addr_cmp,
-                                                        PG_GETARG_DATUM(0),
-                                                        PG_GETARG_DATUM(1)));
+    EMAIL_ADDR *addr1 = PG_GETARG_EMAIL_ADDR_PP(0);
+    EMAIL_ADDR *addr2 = PG_GETARG_EMAIL_ADDR_PP(1);
+    int cmp;
+
+    EMAIL_STATS_COMPARISON(cmp, email_addr_cmp_internal(addr1, addr2));
+
+    PG_FREE_IF_COPY(addr1, 0);
+    PG_FREE_IF_COPY(addr2, 1);
+
     PG_RETURN_BOOL(cmp >= 0);
 }
 
@@ -411,9 +988,15 @@ PG_FUNCTION_INFO_V1(email_addr_eq);
 
 Datum
 email_addr_eq(PG_FUNCTION_ARGS) {
-    const int32 cmp = DatumGetInt32(DirectFunctionCall2(email_addr_cmp,
-                                                        PG_GETARG_DATUM(0),
-                                                        PG_GETARG_DATUM(1)));
+    EMAIL_ADDR *addr1 = PG_GETARG_EMAIL_ADDR_PP(0);
+    EMAIL_ADDR *addr2 = PG_GETARG_EMAIL_ADDR_PP(1);
+    int cmp;
+
+    EMAIL_STATS_COMPARISON(cmp, email_addr_cmp_internal(addr1, addr2));
+
+    PG_FREE_IF_COPY(addr1, 0);
+    PG_FREE_IF_COPY(addr2, 1);
+
     PG_RETURN_BOOL(cmp == 0);
 }
 
@@ -421,9 +1004,15 @@ PG_FUNCTION_INFO_V1(email_addr_ne);
 
 Datum
 email_addr_ne(PG_FUNCTION_ARGS) {
-    const int32 cmp = DatumGetInt32(DirectFunctionCall2(email_addr_cmp,
-                                                        PG_GETARG_DATUM(0),
-                                                        PG_GETARG_DATUM(1)));
+    EMAIL_ADDR *addr1 = PG_GETARG_EMAIL_ADDR_PP(0);
+    EMAIL_ADDR *addr2 = PG_GETARG_EMAIL_ADDR_PP(1);
+    int cmp;
+
+    EMAIL_STATS_COMPARISON(cmp, email_addr_cmp_internal(addr1, addr2));
+
+    PG_FREE_IF_COPY(addr1, 0);
+    PG_FREE_IF_COPY(addr2, 1);
+
     PG_RETURN_BOOL(cmp != 0);
 }
 
@@ -435,13 +1024,21 @@ PG_FUNCTION_INFO_V1(email_hash);
 Datum
 email_hash(PG_FUNCTION_ARGS) {
     const EMAIL_ADDR *email = PG_GETARG_EMAIL_ADDR_PP(0);
-    uint32 hash = email_addr_hash(email);
 
-    /* PostgreSQL hash indexes reserve 0 and 0xFFFFFFFF */
-    if (hash == 0 || hash == 0xFFFFFFFF)
-        hash = 0x12345678;
+    PG_RETURN_UINT32(email_addr_hash(email));
+}
+
+/*
+ * Seeded 64-bit hash function for hash partitioning and hash indexes
+ */
+PG_FUNCTION_INFO_V1(email_hash_extended);
 
-    PG_RETURN_UINT32(hash);
+Datum
+email_hash_extended(PG_FUNCTION_ARGS) {
+    const EMAIL_ADDR *email = PG_GETARG_EMAIL_ADDR_PP(0);
+    const uint64 seed = PG_GETARG_INT64(1);
+
+    PG_RETURN_UINT64(email_addr_hash_extended(email, seed));
 }
 
 /*
@@ -452,23 +1049,11 @@ PG_FUNCTION_INFO_V1(email_addr_get_local_part);
 Datum
 email_addr_get_local_part(PG_FUNCTION_ARGS) {
     const EMAIL_ADDR *email = PG_GETARG_EMAIL_ADDR_PP(0);
+    EmailAddrView view;
 
-    /* Handle NULL input */
-    if (email == NULL)
-        PG_RETURN_NULL();
-
-    /* Debug log */
-    elog(DEBUG1, "get_local_part: local_len=%d", email->local_len);
-
-    /* Allocate result text */
-    text *result = (text *) palloc(VARHDRSZ + email->local_len);
-    SET_VARSIZE(result, VARHDRSZ + email->local_len);
-
-    /* Copy data with explicit length */
-    const char *local_part = get_local_part(email);
-    memcpy(VARDATA(result), local_part, email->local_len);
+    email_addr_unpack(email, &view);
 
-    PG_RETURN_TEXT_P(result);
+    PG_RETURN_TEXT_P(cstring_to_text_with_len(view.local, view.local_len));
 }
 
 /*
@@ -479,23 +1064,27 @@ PG_FUNCTION_INFO_V1(email_addr_get_domain);
 Datum
 email_addr_get_domain(PG_FUNCTION_ARGS) {
     const EMAIL_ADDR *email = PG_GETARG_EMAIL_ADDR_PP(0);
+    EmailAddrView view;
 
-    /* Handle NULL input */
-    if (email == NULL)
-        PG_RETURN_NULL();
-
-    /* Debug log */
-    elog(DEBUG1, "get_domain: domain_len=%d", email->domain_len);
+    email_addr_unpack(email, &view);
 
-    /* Allocate result text */
-    text *result = (text *) palloc(VARHDRSZ + email->domain_len);
-    SET_VARSIZE(result, VARHDRSZ + email->domain_len);
-
-    /* Copy data with explicit length */
-    const char *domain = get_domain(email);
-    memcpy(VARDATA(result), domain, email->domain_len);
+    PG_RETURN_TEXT_P(cstring_to_text_with_len(view.domain, view.domain_len));
+}
 
-    PG_RETURN_TEXT_P(result);
+/*
+ * Local part as entered, minus quotes where they are not needed.
+ * Points into the view, so nothing is allocated.
+ */
+static void
+view_normalized_local_part(const EmailAddrView *view, const char **local, size_t *len) {
+    /* Whether it can be unquoted was decided at input time */
+    if (view->local[0] == '"' && !(view->flags & EMAIL_FLAG_QUOTED_LOCAL)) {
+        *local = view->local + 1;
+        *len = view->local_len - 2;
+    } else {
+        *local = view->local;
+        *len = view->local_len;
+    }
 }
 
 /*
@@ -506,31 +1095,14 @@ PG_FUNCTION_INFO_V1(email_addr_normalized_local_part);
 Datum
 email_addr_normalized_local_part(PG_FUNCTION_ARGS) {
     const EMAIL_ADDR *email = PG_GETARG_EMAIL_ADDR_PP(0);
-    text *result;
+    EmailAddrView view;
+    const char *local_part;
     size_t result_len;
 
-    /* Handle NULL input */
-    if (email == NULL)
-        PG_RETURN_NULL();
+    email_addr_unpack(email, &view);
+    view_normalized_local_part(&view, &local_part, &result_len);
 
-    const char *local_part = get_local_part(email);
-    const bool is_quoted = local_part[0] == '"' && local_part[email->local_len - 1] == '"';
-
-    /* If quoted and can be unquoted, return unquoted form */
-    if (is_quoted && quoted_content_valid_as_unquoted(local_part, email->local_len)) {
-        result_len = email->local_len - 2; /* remove quotes */
-        result = (text *) palloc(VARHDRSZ + result_len);
-        SET_VARSIZE(result, VARHDRSZ + result_len);
-        memcpy(VARDATA(result), local_part + 1, result_len);
-    } else {
-        /* Return as-is */
-        result_len = email->local_len;
-        result = (text *) palloc(VARHDRSZ + result_len);
-        SET_VARSIZE(result, VARHDRSZ + result_len);
-        memcpy(VARDATA(result), local_part, result_len);
-    }
-
-    PG_RETURN_TEXT_P(result);
+    PG_RETURN_TEXT_P(cstring_to_text_with_len(local_part, result_len));
 }
 
 /*
@@ -541,23 +1113,69 @@ PG_FUNCTION_INFO_V1(email_addr_normalized_domain);
 Datum
 email_addr_normalized_domain(PG_FUNCTION_ARGS) {
     const EMAIL_ADDR *email = PG_GETARG_EMAIL_ADDR_PP(0);
+    EmailAddrView view;
 
-    /* Handle NULL input */
-    if (email == NULL)
-        PG_RETURN_NULL();
+    email_addr_unpack(email, &view);
 
-    /* Allocate result text */
-    text *result = palloc(VARHDRSZ + email->domain_len);
-    SET_VARSIZE(result, VARHDRSZ + email->domain_len);
+    /* The canonical domain is already lowercase */
+    PG_RETURN_TEXT_P(cstring_to_text_with_len(view.canon_domain, view.canon_domain_len));
+}
 
-    /* Get normalized (lowercase) domain */
-    unsigned char *normalized = VARDATA(result);
-    const char *domain = get_domain(email);
+/*
+ * All four parts at once: local part and domain as entered, normalized
+ * local part and domain. The address is decoded once, and the texts are
+ * built on the stack: heap_form_tuple's copy into the row is the only one.
+ */
+PG_FUNCTION_INFO_V1(email_addr_split);
 
-    for (int i = 0; i < email->domain_len; i++)
-        normalized[i] = pg_tolower(domain[i]);
+Datum
+email_addr_split(PG_FUNCTION_ARGS) {
+    const EMAIL_ADDR *email = PG_GETARG_EMAIL_ADDR_PP(0);
+    TupleDesc tupdesc = fcinfo->flinfo->fn_extra;
+    EmailAddrView view;
+    const char *parts[4];
+    size_t lens[4];
+    Datum values[4];
+    bool nulls[4] = {false, false, false, false};
+
+    /* Part lengths are stored in a byte */
+    union {
+        int32 align;
+        char part[4][INTALIGN(VARHDRSZ + PG_UINT8_MAX)];
+    } buf;
+
+    /* The blessed result descriptor lives as long as the call site */
+    if (tupdesc == NULL) {
+        const MemoryContext old = MemoryContextSwitchTo(fcinfo->flinfo->fn_mcxt);
+
+        if (get_call_result_type(fcinfo, NULL, &tupdesc) != TYPEFUNC_COMPOSITE)
+            elog(ERROR, "return type must be a row type");
+        tupdesc = BlessTupleDesc(CreateTupleDescCopy(tupdesc));
+        fcinfo->flinfo->fn_extra = tupdesc;
+
+        MemoryContextSwitchTo(old);
+    }
 
-    PG_RETURN_TEXT_P(result);
+    email_addr_unpack(email, &view);
+
+    parts[0] = view.local;
+    lens[0] = view.local_len;
+    parts[1] = view.domain;
+    lens[1] = view.domain_len;
+    view_normalized_local_part(&view, &parts[2], &lens[2]);
+    parts[3] = view.canon_domain;
+    lens[3] = view.canon_domain_len;
+
+    for (int i = 0; i < 4; i++) {
+        text *part = (text *) buf.part[i];
+
+        Assert(lens[i] <= PG_UINT8_MAX);
+        SET_VARSIZE(part, VARHDRSZ + lens[i]);
+        memcpy(VARDATA(part), parts[i], lens[i]);
+        values[i] = PointerGetDatum(part);
+    }
+
+    PG_RETURN_DATUM(HeapTupleGetDatum(heap_form_tuple(tupdesc, values, nulls)));
 }
 
 /*
@@ -572,45 +1190,21 @@ PG_FUNCTION_INFO_V1(email_addr_normalize);
 Datum
 email_addr_normalize(PG_FUNCTION_ARGS) {
     const EMAIL_ADDR *email = PG_GETARG_EMAIL_ADDR_PP(0);
+    EmailAddrView view;
+    const char *local_part;
+    size_t local_len;
 
-    /* Handle NULL input */
-    if (email == NULL)
-        PG_RETURN_NULL();
-
-    /* Get normalized parts using existing functions */
-    text *norm_local = DatumGetTextPP(DirectFunctionCall1(email_addr_normalized_local_part,
-        PointerGetDatum(email)));
-    text *norm_domain = DatumGetTextPP(DirectFunctionCall1(email_addr_normalized_domain,
-        PointerGetDatum(email)));
-
-    /* Calculate total size needed */
-    const size_t local_len = VARSIZE_ANY_EXHDR(norm_local);
-    const size_t domain_len = VARSIZE_ANY_EXHDR(norm_domain);
-    const size_t total_size = VARHDRSZ +
-                              offsetof(EMAIL_ADDR, data) +
-                              local_len + 1 +
-                              domain_len + 1;
-
-    /* Allocate result */
-    EMAIL_ADDR *result = palloc0(total_size);
-    SET_VARSIZE(result, total_size);
-
-    /* Set lengths and offset */
-    result->local_len = local_len;
-    result->domain_len = domain_len;
-    result->domain_offset = local_len + 1;
+    email_addr_unpack(email, &view);
+    view_normalized_local_part(&view, &local_part, &local_len);
 
-    /* Copy data and add null terminators */
-    memcpy(result->data, VARDATA_ANY(norm_local), local_len);
-    result->data[local_len] = '\0';
-    memcpy(result->data + result->domain_offset, VARDATA_ANY(norm_domain), domain_len);
-    result->data[result->domain_offset + domain_len] = '\0';
+    /* Already normalized: hand back the (detoasted) argument */
+    if (local_part == view.local && view.canon_domain_len == view.domain_len &&
+        memcmp(view.canon_domain, view.domain, view.domain_len) == 0)
+        PG_RETURN_EMAIL_ADDR((EMAIL_ADDR *) email);
 
-    /* Free intermediate results */
-    pfree(norm_local);
-    pfree(norm_domain);
-
-    PG_RETURN_POINTER(result);
+    /* Build the result straight from the normalized parts */
+    PG_RETURN_POINTER(make_email_addr(local_part, local_len,
+                                      view.canon_domain, view.canon_domain_len));
 }
 
 /*
@@ -621,19 +1215,15 @@ PG_FUNCTION_INFO_V1(email_addr_normalize_text);
 Datum
 email_addr_normalize_text(PG_FUNCTION_ARGS) {
     const EMAIL_ADDR *email = PG_GETARG_EMAIL_ADDR_PP(0);
+    EmailAddrView view;
+    const char *local_part;
+    size_t local_len;
 
-    /* Handle NULL input */
-    if (email == NULL)
-        PG_RETURN_NULL();
-
-    /* Get normalized parts */
-    text *norm_local = DatumGetTextPP(DirectFunctionCall1(email_addr_normalized_local_part,
-        PointerGetDatum(email)));
-    text *norm_domain = DatumGetTextPP(DirectFunctionCall1(email_addr_normalized_domain,
-        PointerGetDatum(email)));
+    email_addr_unpack(email, &view);
+    view_normalized_local_part(&view, &local_part, &local_len);
 
     /* Calculate total length including @ */
-    const int total_len = VARSIZE_ANY_EXHDR(norm_local) + 1 + VARSIZE_ANY_EXHDR(norm_domain);
+    const size_t total_len = local_len + 1 + view.canon_domain_len;
 
     /* Allocate result text */
     text *result = palloc(VARHDRSZ + total_len);
@@ -641,22 +1231,24 @@ email_addr_normalize_text(PG_FUNCTION_ARGS) {
 
     /* Build result string */
     char *dest = VARDATA(result);
-    memcpy(dest,
-           VARDATA_ANY(norm_local),
-           VARSIZE_ANY_EXHDR(norm_local));
-    dest += VARSIZE_ANY_EXHDR(norm_local);
+    memcpy(dest, local_part, local_len);
+    dest += local_len;
     *dest++ = '@';
-    memcpy(dest,
-           VARDATA_ANY(norm_domain),
-           VARSIZE_ANY_EXHDR(norm_domain));
-
-    /* Free intermediate results */
-    pfree(norm_local);
-    pfree(norm_domain);
+    memcpy(dest, view.canon_domain, view.canon_domain_len);
 
     PG_RETURN_TEXT_P(result);
 }
 
+/*
+ * Normalized equality.
+ *
+ * The normalized form of an address differs from the entered one only
+ * in what its canonical form already folds (domain case, unneeded
+ * quotes), and its canonical form is that of the address itself. ==#
+ * is therefore exactly =, and is planned as = so that the operator
+ * classes of email_addr serve both.
+ */
+
 /*
  * Check if two email addresses are equal after normalization
  */
@@ -664,25 +1256,52 @@ PG_FUNCTION_INFO_V1(email_addr_normalize_eq);
 
 Datum
 email_addr_normalize_eq(PG_FUNCTION_ARGS) {
-    const EMAIL_ADDR *addr1 = PG_GETARG_EMAIL_ADDR_PP(0);
-    const EMAIL_ADDR *addr2 = PG_GETARG_EMAIL_ADDR_PP(1);
-    /* Handle NULLs */
-    if (addr1 == NULL || addr2 == NULL) {
-        PG_RETURN_NULL();
-    }
-    /* Normalize both addresses */
-    EMAIL_ADDR *norm1 = (EMAIL_ADDR *) DatumGetPointer(DirectFunctionCall1(email_addr_normalize,
-                                                                           PointerGetDatum(addr1)));
-    EMAIL_ADDR *norm2 = (EMAIL_ADDR *) DatumGetPointer(DirectFunctionCall1(email_addr_normalize,
-                                                                           PointerGetDatum(addr2)));
-    /* Compare normalized forms */
-    const bool result = email_addr_equals(norm1, norm2);
-    /* Free normalized addresses */
-    pfree(norm1);
-    pfree(norm2);
+    EMAIL_ADDR *addr1 = PG_GETARG_EMAIL_ADDR_PP(0);
+    EMAIL_ADDR *addr2 = PG_GETARG_EMAIL_ADDR_PP(1);
+
+    const bool result = email_addr_cmp_internal(addr1, addr2) == 0;
+
+    PG_FREE_IF_COPY(addr1, 0);
+    PG_FREE_IF_COPY(addr2, 1);
+
     PG_RETURN_BOOL(result);
 }
 
+/*
+ * Planner support for email_addr_normalize_eq: "a ==# b" becomes
+ * "a = b" with the equality of the default btree class
+ */
+PG_FUNCTION_INFO_V1(email_addr_normalize_eq_support);
+
+Datum
+email_addr_normalize_eq_support(PG_FUNCTION_ARGS) {
+    Node *rawreq = (Node *) PG_GETARG_POINTER(0);
+
+    if (!IsA(rawreq, SupportRequestSimplify))
+        PG_RETURN_POINTER(NULL);
+
+    const FuncExpr *expr = ((SupportRequestSimplify *) rawreq)->fcall;
+
+    if (list_length(expr->args) != 2 ||
+        !email_support_is_function(fcinfo, expr, "email_addr_normalize_eq"))
+        PG_RETURN_POINTER(NULL);
+
+    const Oid typid = exprType(linitial(expr->args));
+    const Oid opclass = GetDefaultOpClass(typid, BTREE_AM_OID);
+
+    if (!OidIsValid(opclass))
+        PG_RETURN_POINTER(NULL);
+
+    const Oid opno = get_opfamily_member(get_opclass_family(opclass), typid, typid,
+                                         BTEqualStrategyNumber);
+
+    if (!OidIsValid(opno))
+        PG_RETURN_POINTER(NULL);
+
+    PG_RETURN_POINTER(make_opclause(opno, BOOLOID, false, linitial(expr->args),
+                                    lsecond(expr->args), InvalidOid, InvalidOid));
+}
+
 /*
  * Cast email_addr to text
  */
@@ -691,12 +1310,15 @@ PG_FUNCTION_INFO_V1(email_addr_cast_to_text);
 Datum
 email_addr_cast_to_text(PG_FUNCTION_ARGS) {
     const EMAIL_ADDR *email = PG_GETARG_EMAIL_ADDR_PP(0);
+    EmailAddrView view;
 
     if (email == NULL)
         PG_RETURN_NULL();
 
+    email_addr_unpack(email, &view);
+
     /* Calculate total length: local_part + @ + domain */
-    const int total_len = email->local_len + 1 + email->domain_len;
+    const int total_len = view.local_len + 1 + view.domain_len;
 
     /* Allocate and initialize result */
     text *result = palloc(VARHDRSZ + total_len);
@@ -704,9 +1326,9 @@ email_addr_cast_to_text(PG_FUNCTION_ARGS) {
 
     /* Build the string */
     char *dest = VARDATA(result);
-    memcpy(dest, get_local_part(email), email->local_len);
-    dest[email->local_len] = '@';
-    memcpy(dest + email->local_len + 1, get_domain(email), email->domain_len);
+    memcpy(dest, view.local, view.local_len);
+    dest[view.local_len] = '@';
+    memcpy(dest + view.local_len + 1, view.domain, view.domain_len);
 
     PG_RETURN_TEXT_P(result);
 }
@@ -720,16 +1342,13 @@ Datum
 text_cast_to_email_addr(PG_FUNCTION_ARGS) {
     const text *txt = PG_GETARG_TEXT_PP(0);
 
-    if (txt == NULL)
+    /* Parse the text in place, no cstring copy needed */
+    EMAIL_ADDR *result = email_addr_from_string(VARDATA_ANY(txt), VARSIZE_ANY_EXHDR(txt), -1,
+                                                fcinfo->context);
+    if (result == NULL)
         PG_RETURN_NULL();
 
-    /* Convert text to cstring and call the input function */
-    char *str = text_to_cstring(txt);
-    const Datum result = DirectFunctionCall1(email_addr_in, CStringGetDatum(str));
-
-    pfree(str);
-
-    PG_RETURN_DATUM(result);
+    PG_RETURN_EMAIL_ADDR(result);
 }
 
 /*
@@ -797,20 +1416,38 @@ PG_FUNCTION_INFO_V1(name_cast_to_email_addr);
 Datum
 name_cast_to_email_addr(PG_FUNCTION_ARGS) {
     const Name name = PG_GETARG_NAME(0);
+    const char *str = NameStr(*name);
 
-    if (name == NULL)
+    EMAIL_ADDR *result = email_addr_from_string(str, strnlen(str, NAMEDATALEN), -1,
+                                                fcinfo->context);
+    if (result == NULL)
         PG_RETURN_NULL();
 
-    /* Convert name to text */
-    text *txt = cstring_to_text(NameStr(*name));
+    PG_RETURN_EMAIL_ADDR(result);
+}
 
-    /* Use text cast */
-    const Datum result = DirectFunctionCall1(text_cast_to_email_addr,
-                                             PointerGetDatum(txt));
+/*
+ * Core domain comparison: shorter canonical domains sort first, domains
+ * of equal length compare bytewise. Nothing is allocated.
+ */
+static int
+email_addr_domain_cmp_internal(const EMAIL_ADDR *addr1, const EMAIL_ADDR *addr2) {
+    EmailAddrView view1;
+    EmailAddrView view2;
+    int cmp;
 
-    pfree(txt);
+    email_addr_unpack(addr1, &view1);
+    email_addr_unpack(addr2, &view2);
+
+    /* Interned domains with the same id are equal */
+    if ((view1.flags & view2.flags & EMAIL_FLAG_INTERNED) && view1.domain_id == view2.domain_id)
+        cmp = 0;
+    else if (view1.canon_domain_len != view2.canon_domain_len)
+        cmp = view1.canon_domain_len < view2.canon_domain_len ? -1 : 1;
+    else
+        cmp = memcmp(view1.canon_domain, view2.canon_domain, view1.canon_domain_len);
 
-    PG_RETURN_DATUM(result);
+    return cmp;
 }
 
 /*
@@ -820,39 +1457,104 @@ PG_FUNCTION_INFO_V1(email_addr_domain_cmp);
 
 Datum
 email_addr_domain_cmp(PG_FUNCTION_ARGS) {
-    const EMAIL_ADDR *addr1 = PG_GETARG_EMAIL_ADDR_PP(0);
-    const EMAIL_ADDR *addr2 = PG_GETARG_EMAIL_ADDR_PP(1);
-    int cmp;
+    EMAIL_ADDR *addr1 = PG_GETARG_EMAIL_ADDR_PP(0);
+    EMAIL_ADDR *addr2 = PG_GETARG_EMAIL_ADDR_PP(1);
 
-    /* Handle NULLs */
-    if (addr1 == NULL) {
-        if (addr2 == NULL)
-            PG_RETURN_INT32(0); /* NULL == NULL */
-        PG_RETURN_INT32(-1); /* NULL < non-NULL */
-    }
-    if (addr2 == NULL)
-        PG_RETURN_INT32(1); /* non-NULL > NULL */
+    const int cmp = email_addr_domain_cmp_internal(addr1, addr2);
 
-    /* Get normalized (lowercase) domains */
-    text *domain1 = DatumGetTextPP(DirectFunctionCall1(email_addr_normalized_domain,
-        PG_GETARG_DATUM(0)));
-    text *domain2 = DatumGetTextPP(DirectFunctionCall1(email_addr_normalized_domain,
-        PG_GETARG_DATUM(1)));
-
-    /* Compare the domains */
-    if (VARSIZE_ANY_EXHDR(domain1) < VARSIZE_ANY_EXHDR(domain2))
-        cmp = -1;
-    else if (VARSIZE_ANY_EXHDR(domain1) > VARSIZE_ANY_EXHDR(domain2))
-        cmp = 1;
-    else {
-        cmp = memcmp(VARDATA_ANY(domain1), VARDATA_ANY(domain2),
-                     VARSIZE_ANY_EXHDR(domain1));
+    PG_FREE_IF_COPY(addr1, 0);
+    PG_FREE_IF_COPY(addr2, 1);
+
+    PG_RETURN_INT32(cmp);
+}
+
+/*
+ * Sort support comparator for email_addr_domain_ops
+ */
+static int
+email_addr_domain_fast_cmp(Datum x, Datum y, SortSupport ssup) {
+    EMAIL_ADDR *addr1 = DatumGetEmailAddrP(x);
+    EMAIL_ADDR *addr2 = DatumGetEmailAddrP(y);
+
+    const int cmp = email_addr_domain_cmp_internal(addr1, addr2);
+
+    if ((Pointer) addr1 != DatumGetPointer(x))
+        pfree(addr1);
+    if ((Pointer) addr2 != DatumGetPointer(y))
+        pfree(addr2);
+
+    return cmp;
+}
+
+/*
+ * Convert an email address to an abbreviated key for domain order.
+ *
+ * The key holds the canonical domain length in its first byte, followed
+ * by the first bytes of the canonical domain, zero padded and in
+ * big-endian order, matching email_addr_domain_cmp_internal.
+ */
+static Datum
+email_addr_domain_abbrev_convert(Datum original, SortSupport ssup) {
+    email_addr_sortsupport_state *state = ssup->ssup_extra;
+    EMAIL_ADDR *addr = DatumGetEmailAddrP(original);
+    EmailAddrView view;
+    Datum res = (Datum) 0;
+    char *key = (char *) &res;
+
+    email_addr_unpack(addr, &view);
+
+    key[0] = (uint8) view.canon_domain_len;
+    memcpy(key + 1, view.canon_domain, Min(view.canon_domain_len, sizeof(Datum) - 1));
+
+    state->input_count += 1;
+
+    if (state->estimating) {
+        uint32 tmp;
+
+#if SIZEOF_DATUM == 8
+        tmp = (uint32) res ^ (uint32) ((uint64) res >> 32);
+#else
+        tmp = (uint32) res;
+#endif
+        addHyperLogLog(&state->abbr_card, DatumGetUInt32(hash_uint32(tmp)));
     }
 
-    pfree(domain1);
-    pfree(domain2);
+    if ((Pointer) addr != DatumGetPointer(original))
+        pfree(addr);
 
-    PG_RETURN_INT32(cmp);
+    return DatumBigEndianToNative(res);
+}
+
+/*
+ * B-tree sort support function for email_addr_domain_ops
+ */
+PG_FUNCTION_INFO_V1(email_addr_domain_sortsupport);
+
+Datum
+email_addr_domain_sortsupport(PG_FUNCTION_ARGS) {
+    SortSupport ssup = (SortSupport) PG_GETARG_POINTER(0);
+
+    ssup->comparator = email_addr_domain_fast_cmp;
+    ssup->ssup_extra = NULL;
+
+    if (ssup->abbreviate) {
+        const MemoryContext oldcontext = MemoryContextSwitchTo(ssup->ssup_cxt);
+
+        email_addr_sortsupport_state *state = palloc(sizeof(email_addr_sortsupport_state));
+        state->input_count = 0;
+        state->estimating = true;
+        initHyperLogLog(&state->abbr_card, 10);
+
+        ssup->ssup_extra = state;
+        ssup->comparator = ssup_datum_unsigned_cmp;
+        ssup->abbrev_converter = email_addr_domain_abbrev_convert;
+        ssup->abbrev_abort = email_addr_abbrev_abort;
+        ssup->abbrev_full_comparator = email_addr_domain_fast_cmp;
+
+        MemoryContextSwitchTo(oldcontext);
+    }
+
+    PG_RETURN_VOID();
 }
 
 /*
@@ -862,9 +1564,15 @@ PG_FUNCTION_INFO_V1(email_addr_domain_eq);
 
 Datum
 email_addr_domain_eq(PG_FUNCTION_ARGS) {
-    const int32 cmp = DatumGetInt32(DirectFunctionCall2(email_addr_domain_cmp,
-                                                        PG_GETARG_DATUM(0),
-                                                        PG_GETARG_DATUM(1)));
+    EMAIL_ADDR *addr1 = PG_GETARG_EMAIL_ADDR_PP(0);
+    EMAIL_ADDR *addr2 = PG_GETARG_EMAIL_ADDR_PP(1);
+    int cmp;
+
+    EMAIL_STATS_COMPARISON(cmp, email_addr_domain_cmp_internal(addr1, addr2));
+
+    PG_FREE_IF_COPY(addr1, 0);
+    PG_FREE_IF_COPY(addr2, 1);
+
     PG_RETURN_BOOL(cmp == 0);
 }
 
@@ -875,9 +1583,15 @@ PG_FUNCTION_INFO_V1(email_addr_domain_ne);
 
 Datum
 email_addr_domain_ne(PG_FUNCTION_ARGS) {
-    const int32 cmp = DatumGetInt32(DirectFunctionCall2(email_addr_domain_cmp,
-                                                        PG_GETARG_DATUM(0),
-                                                        PG_GETARG_DATUM(1)));
+    EMAIL_ADDR *addr1 = PG_GETARG_EMAIL_ADDR_PP(0);
+    EMAIL_ADDR *addr2 = PG_GETARG_EMAIL_ADDR_PP(1);
+    int cmp;
+
+    EMAIL_STATS_COMPARISON(cmp, email_addr_domain_cmp_internal(addr1, addr2));
+
+    PG_FREE_IF_COPY(addr1, 0);
+    PG_FREE_IF_COPY(addr2, 1);
+
     PG_RETURN_BOOL(cmp != 0);
 }
 
@@ -888,9 +1602,15 @@ PG_FUNCTION_INFO_V1(email_addr_domain_lt);
 
 Datum
 email_addr_domain_lt(PG_FUNCTION_ARGS) {
-    const int32 cmp = DatumGetInt32(DirectFunctionCall2(email_addr_domain_cmp,
-                                                        PG_GETARG_DATUM(0),
-                                                        PG_GETARG_DATUM(1)));
+    EMAIL_ADDR *addr1 = PG_GETARG_EMAIL_ADDR_PP(0);
+    EMAIL_ADDR *addr2 = PG_GETARG_EMAIL_ADDR_PP(1);
+    int cmp;
+
+    EMAIL_STATS_COMPARISON(cmp, email_addr_domain_cmp_internal(addr1, addr2));
+
+    PG_FREE_IF_COPY(addr1, 0);
+    PG_FREE_IF_COPY(addr2, 1);
+
     PG_RETURN_BOOL(cmp < 0);
 }
 
@@ -901,9 +1621,15 @@ PG_FUNCTION_INFO_V1(email_addr_domain_le);
 
 Datum
 email_addr_domain_le(PG_FUNCTION_ARGS) {
-    const int32 cmp = DatumGetInt32(DirectFunctionCall2(email_addr_domain_cmp,
-                                                        PG_GETARG_DATUM(0),
-                                                        PG_GETARG_DATUM(1)));
+    EMAIL_ADDR *addr1 = PG_GETARG_EMAIL_ADDR_PP(0);
+    EMAIL_ADDR *addr2 = PG_GETARG_EMAIL_ADDR_PP(1);
+    int cmp;
+
+    EMAIL_STATS_COMPARISON(cmp, email_addr_domain_cmp_internal(addr1, addr2));
+
+    PG_FREE_IF_COPY(addr1, 0);
+    PG_FREE_IF_COPY(addr2, 1);
+
     PG_RETURN_BOOL(cmp <= 0);
 }
 
@@ -914,9 +1640,15 @@ PG_FUNCTION_INFO_V1(email_addr_domain_gt);
 
 Datum
 email_addr_domain_gt(PG_FUNCTION_ARGS) {
-    const int32 cmp = DatumGetInt32(DirectFunctionCall2(email_addr_domain_cmp,
-                                                        PG_GETARG_DATUM(0),
-                                                        PG_GETARG_DATUM(1)));
+    EMAIL_ADDR *addr1 = PG_GETARG_EMAIL_ADDR_PP(0);
+    EMAIL_ADDR *addr2 = PG_GETARG_EMAIL_ADDR_PP(1);
+    int cmp;
+
+    EMAIL_STATS_COMPARISON(cmp, email_addr_domain_cmp_internal(addr1, addr2));
+
+    PG_FREE_IF_COPY(addr1, 0);
+    PG_FREE_IF_COPY(addr2, 1);
+
     PG_RETURN_BOOL(cmp > 0);
 }
 
@@ -927,8 +1659,34 @@ PG_FUNCTION_INFO_V1(email_addr_domain_ge);
 
 Datum
 email_addr_domain_ge(PG_FUNCTION_ARGS) {
-    const int32 cmp = DatumGetInt32(DirectFunctionCall2(email_addr_domain_cmp,
-                                                        PG_GETARG_DATUM(0),
-                                                        PG_GETARG_DATUM(1)));
+    EMAIL_ADDR *addr1 = PG_GETARG_EMAIL_ADDR_PP(0);
+    EMAIL_ADDR *addr2 = PG_GETARG_EMAIL_ADDR_PP(1);
+    int cmp;
+
+    EMAIL_STATS_COMPARISON(cmp, email_addr_domain_cmp_internal(addr1, addr2));
+
+    PG_FREE_IF_COPY(addr1, 0);
+    PG_FREE_IF_COPY(addr2, 1);
+
     PG_RETURN_BOOL(cmp >= 0);
 }
+
+/*
+ * Hash of the canonical domain, so that addresses equal under =# hash
+ * alike
+ */
+PG_FUNCTION_INFO_V1(email_addr_domain_hash);
+
+Datum
+email_addr_domain_hash(PG_FUNCTION_ARGS) {
+    EMAIL_ADDR *addr = PG_GETARG_EMAIL_ADDR_PP(0);
+    EmailAddrView view;
+
+    email_addr_unpack(addr, &view);
+
+    const uint32 hash = hash_bytes((const unsigned char *) view.canon_domain, view.canon_domain_len);
+
+    PG_FREE_IF_COPY(addr, 0);
+
+    PG_RETURN_UINT32(hash);
+}
@@ -0,0 +1,368 @@
+//
+// Shared definitions for the email_addr type.
+//
+
+#ifndef PG_EMAIL_OPT_H
+#define PG_EMAIL_OPT_H
+
+#include "postgres.h"
+#include "fmgr.h"
+#include "nodes/primnodes.h"
+#include "portability/instr_time.h"
+
+/* RFC 5321 limits, enforced at input time */
+#define EMAIL_MAX_LOCAL_LENGTH 64
+#define EMAIL_MAX_DOMAIN_LENGTH 255
+
+/*
+ * Original (version 0) layout of an email address.
+ * Format: [local_part]\0[domain]\0
+ * Only read for datums written by earlier releases.
+ */
+typedef struct {
+    /* varlena header for storing total struct length */
+    char vl_len_[4];
+
+    /* offset to where domain starts in data array */
+    uint16 domain_offset;
+
+    /* lengths of local-part and domain */
+    uint16 local_len;
+    uint16 domain_len;
+
+    /* actual data storage: [local_part]\0[domain]\0 */
+    char data[FLEXIBLE_ARRAY_MEMBER];
+} EMAIL_ADDR_V0;
+
+/*
+ * Structure for representing an email address in PostgreSQL.
+ * Format: local-part@domain
+ *
+ * Besides the address as entered, the datum carries its canonical form,
+ * computed once at input time: the domain lowercased and the local part
+ * lowercased and unquoted where quoting is not needed. Comparisons and
+ * hashing only look at the canonical form, so they reduce to memcmp.
+ *
+ * Data layout: [local][domain][canonical local][canonical domain]
+ * The canonical parts are only stored when they differ from the
+ * entered ones (see the EMAIL_FLAG_CANON_* flags). No terminators.
+ *
+ * Interned datums (EMAIL_FLAG_INTERNED) store [local][domain id]
+ * [canonical local] instead; their domain is always canonical.
+ *
+ * Internationalized domains (EMAIL_FLAG_IDN_DOMAIN) are entered as
+ * U-labels; their canonical domain is the lowercase A-label form, whose
+ * length differs, so it is stored as [length byte][canonical domain].
+ */
+typedef struct {
+    /* varlena header for storing total struct length */
+    char vl_len_[4];
+
+    /* layout version, always EMAIL_ADDR_VERSION_1 */
+    uint8 version;
+
+    /* EMAIL_FLAG_* bits */
+    uint8 flags;
+
+    /* lengths of local-part and domain as entered */
+    uint8 local_len;
+    uint8 domain_len;
+
+    char data[FLEXIBLE_ARRAY_MEMBER];
+} EMAIL_ADDR;
+
+/*
+ * Version 0 datums start with domain_offset, which is local_len + 1 and
+ * so between 2 and 65: its first byte is below 0x80 in either byte order.
+ * Later versions start with a version byte that has the high bit set.
+ */
+#define EMAIL_ADDR_VERSION_1 0x81
+
+#define EMAIL_ADDR_IS_V0(addr) (((const uint8 *) VARDATA_ANY(addr))[0] < 0x80)
+
+/*
+ * Field offsets of the version 1 header within VARDATA_ANY(). Readers
+ * use these rather than the struct, since datums read in place from a
+ * tuple can have a 1-byte varlena header and are then unaligned.
+ * EMAIL_ADDR itself is only used to build new (4-byte header) datums.
+ */
+#define EMAIL_ADDR_VERSION_OFFSET    0
+#define EMAIL_ADDR_FLAGS_OFFSET      1
+#define EMAIL_ADDR_LOCAL_LEN_OFFSET  2
+#define EMAIL_ADDR_DOMAIN_LEN_OFFSET 3
+#define EMAIL_ADDR_HDRSZ             (offsetof(EMAIL_ADDR, data) - VARHDRSZ)
+
+/* Version of the binary send/receive format */
+#define EMAIL_ADDR_WIRE_VERSION 1
+
+/* Canonical local part keeps its quotes: sorts after all unquoted ones */
+#define EMAIL_FLAG_QUOTED_LOCAL     0x01
+/* Canonical local part differs from the entered one and is stored */
+#define EMAIL_FLAG_CANON_LOCAL      0x02
+/* Canonical domain differs from the entered one and is stored */
+#define EMAIL_FLAG_CANON_DOMAIN     0x04
+/* Domain replaced by a 4-byte id from email_addr_domain_dict */
+#define EMAIL_FLAG_INTERNED         0x08
+/* Canonical domain is the A-label form of a U-label domain, with its length */
+#define EMAIL_FLAG_IDN_DOMAIN       0x10
+
+/* Type modifier of email_addr(interned) columns */
+#define EMAIL_TYPMOD_INTERNED 1
+
+/*
+ * Decoded view of an email address, independent of the on-disk version.
+ * All pointers point into the datum, except for version 0 datums, whose
+ * canonical form is computed into buf.
+ */
+typedef struct {
+    /* parts as entered */
+    const char *local;
+    const char *domain;
+    uint16 local_len;
+    uint16 domain_len;
+
+    /* canonical parts used for comparison and hashing */
+    const char *canon_local;
+    const char *canon_domain;
+    uint16 canon_local_len;
+    uint16 canon_domain_len;
+
+    /* EMAIL_FLAG_* bits */
+    uint8 flags;
+
+    /* dictionary id of an interned domain, 0 if not interned */
+    uint32 domain_id;
+
+    /* scratch space for the canonical form of version 0 datums */
+    char buf[EMAIL_MAX_LOCAL_LENGTH + EMAIL_MAX_DOMAIN_LENGTH];
+} EmailAddrView;
+
+/*
+ * Macros for working with email_addr type
+ */
+#define PG_GETARG_EMAIL_ADDR_P(n)     ((EMAIL_ADDR *) PG_GETARG_POINTER(n))
+#define PG_GETARG_EMAIL_ADDR_PP(n)  ((EMAIL_ADDR *) PG_DETOAST_DATUM_PACKED(PG_GETARG_DATUM(n)))
+#define PG_GETARG_EMAIL_ADDR_COPY(n) ((EMAIL_ADDR *) PG_DETOAST_DATUM_COPY(PG_GETARG_DATUM(n)))
+#define DatumGetEmailAddrP(X)      ((EMAIL_ADDR *) PG_DETOAST_DATUM_PACKED(X))
+
+/* For returning email_addr values */
+#define PG_RETURN_EMAIL_ADDR(x)    PG_RETURN_POINTER(x)
+
+/*
+ * Creates a new EMAIL_ADDR from already validated parts
+ */
+EMAIL_ADDR *make_email_addr(const char *local_part, size_t local_len,
+                            const char *domain, size_t domain_len);
+
+/*
+ * make_email_addr for a U-label domain, given its A-label form
+ */
+EMAIL_ADDR *make_email_addr_idn(const char *local_part, size_t local_len,
+                                const char *domain, size_t domain_len,
+                                const char *ascii_domain, size_t ascii_len);
+
+/*
+ * Parses and validates the text form of an email address.
+ * Returns NULL on invalid input if escontext is a soft error context.
+ */
+EMAIL_ADDR *email_addr_from_string(const char *input, size_t len, int32 typmod,
+                                   Node *escontext);
+
+/*
+ * Decodes the text form of an email address into a view without
+ * allocating; invalid input raises an error
+ */
+void email_addr_view_from_string(const char *input, size_t len, EmailAddrView *view);
+
+/*
+ * Returns the interned form of an email address, or the address
+ * itself if its domain cannot be interned
+ */
+EMAIL_ADDR *email_addr_intern(const EMAIL_ADDR *addr);
+
+/*
+ * Decodes an email address of any on-disk version into a view
+ */
+void email_addr_unpack(const EMAIL_ADDR *addr, EmailAddrView *view);
+
+/*
+ * Compare two decoded email addresses by their canonical form
+ * Returns <0, 0 or >0
+ */
+int email_addr_view_cmp(const EmailAddrView *view1, const EmailAddrView *view2);
+
+/*
+ * Hash the canonical form of a decoded email address
+ */
+uint32 email_addr_view_hash(const EmailAddrView *view);
+uint64 email_addr_view_hash_extended(const EmailAddrView *view, uint64 seed);
+
+/*
+ * Hash an email address; variants of the above for undecoded datums
+ */
+uint32 email_addr_hash(const EMAIL_ADDR *addr);
+uint64 email_addr_hash_extended(const EMAIL_ADDR *addr, uint64 seed);
+
+/*
+ * Writes the canonical form of a domain given as a text operand to dest,
+ * which must hold EMAIL_MAX_DOMAIN_LENGTH bytes: lowercased, and in
+ * A-label form if it has U-labels. Returns false if no address can have
+ * it (email_domain_suffix.c).
+ */
+bool email_domain_operand_to_ascii(char *dest, const char *domain, size_t len, size_t *dest_len);
+
+/*
+ * email_domain_operand_to_ascii for a subdomain-match suffix. Returns
+ * false unless it is a plain domain name.
+ */
+bool email_domain_suffix_canonicalize(char *dest, const char *suffix, size_t len,
+                                      size_t *dest_len);
+
+/*
+ * Fixed-width fingerprint of the normalized form (email_fingerprint.c)
+ */
+#define EMAIL_FINGERPRINT_LEN 16
+
+typedef struct {
+    uint8 data[EMAIL_FINGERPRINT_LEN];
+} EmailFingerprint;
+
+#define PG_GETARG_EMAIL_FINGERPRINT_P(n) ((const EmailFingerprint *) PG_GETARG_POINTER(n))
+
+/*
+ * Computes the fingerprint of a decoded address; with provider_rules,
+ * the rules in email_fingerprint_rules for its domain are applied
+ */
+void email_addr_view_fingerprint(const EmailAddrView *view, bool provider_rules,
+                                 EmailFingerprint *result);
+
+/*
+ * Planner support (email_support.c)
+ */
+
+/*
+ * OID of an operator family of the extension, looked up in the schema of
+ * the calling support function. InvalidOid if there is none.
+ */
+Oid email_support_opfamily(FunctionCallInfo fcinfo, Oid amoid, const char *name);
+
+/*
+ * True if expr calls the function of the extension with this name and
+ * the types of its arguments
+ */
+bool email_support_is_function(FunctionCallInfo fcinfo, const FuncExpr *expr, const char *name);
+
+/*
+ * Builds "indexkey op 'local@domain'", an index condition against a
+ * constant bound
+ */
+Expr *email_make_bound_clause(Oid opno, Expr *indexkey, Oid typid,
+                              const char *local, size_t local_len,
+                              const char *domain, size_t domain_len);
+
+/*
+ * Domain dictionary (email_intern.c)
+ */
+
+/*
+ * Returns the domain for a dictionary id; the result stays valid for
+ * the rest of the transaction
+ */
+const char *email_domain_dict_lookup(uint32 id, uint16 len);
+
+/*
+ * Returns the dictionary id of a canonical domain, adding it if needed,
+ * or 0 if it is missing and the transaction is read-only
+ */
+uint32 email_domain_dict_intern(const char *domain, size_t len);
+
+/*
+ * Instrumentation (email_stats.c)
+ */
+
+/* Operations with their own counters */
+typedef enum {
+    EMAIL_STATS_INPUT,
+    EMAIL_STATS_OUTPUT,
+    EMAIL_STATS_RECEIVE,
+    EMAIL_STATS_SEND,
+    EMAIL_STATS_COMPARE,
+    EMAIL_STATS_NUM_KINDS
+} EmailStatsKind;
+
+/*
+ * Per-backend counters of one operation. bytes counts the text or wire
+ * size handled; time is only collected with pg_email_opt.track_timing.
+ */
+typedef struct {
+    int64 calls;
+    int64 bytes;
+    int64 failures;
+    instr_time time;
+} EmailStatsCounter;
+
+extern EmailStatsCounter email_stats[EMAIL_STATS_NUM_KINDS];
+
+/*
+ * Options of email_parse_opt for text input. Internationalized addresses
+ * are always accepted: input must read back whatever output wrote, and
+ * must not depend on settings to stay immutable.
+ */
+#define EMAIL_PARSE_OPTIONS EMAIL_PARSE_SMTPUTF8
+
+/* GUCs pg_email_opt.trace and pg_email_opt.track_timing */
+extern bool email_trace;
+extern bool email_track_timing;
+
+/*
+ * Brackets an instrumented operation. A call counts as failed until
+ * EMAIL_STATS_END is reached, so errors thrown anywhere in between are
+ * counted without a PG_TRY block. Time is only taken if it was started,
+ * whatever track_timing says by the end.
+ */
+#define EMAIL_STATS_BEGIN(kind, start) \
+    do { \
+        email_stats[kind].calls++; \
+        email_stats[kind].failures++; \
+        if (email_track_timing) \
+            INSTR_TIME_SET_CURRENT(start); \
+        else \
+            INSTR_TIME_SET_ZERO(start); \
+    } while (0)
+
+#define EMAIL_STATS_END(kind, start, nbytes) \
+    do { \
+        email_stats[kind].failures--; \
+        email_stats[kind].bytes += (nbytes); \
+        if (!INSTR_TIME_IS_ZERO(start)) { \
+            instr_time end_; \
+            INSTR_TIME_SET_CURRENT(end_); \
+            INSTR_TIME_ACCUM_DIFF(email_stats[kind].time, end_, start); \
+        } \
+    } while (0)
+
+/*
+ * Counts one call of a comparison operator, result = call. Only the SQL
+ * operators are instrumented: the btree, sort and hash support functions
+ * run once per tuple and stay as cheap as they can be.
+ */
+#define EMAIL_STATS_COMPARISON(result, call) \
+    do { \
+        instr_time start_; \
+        EMAIL_STATS_BEGIN(EMAIL_STATS_COMPARE, start_); \
+        (result) = (call); \
+        EMAIL_STATS_END(EMAIL_STATS_COMPARE, start_, 0); \
+    } while (0)
+
+/*
+ * Define the instrumentation GUCs, called from _PG_init
+ */
+void email_stats_init(void);
+
+/*
+ * Install the suppression cache shared memory hooks, called from _PG_init;
+ * does nothing unless loaded through shared_preload_libraries
+ */
+void email_suppression_init(void);
+
+#endif //PG_EMAIL_OPT_H
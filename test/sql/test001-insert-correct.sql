@@ -46,3 +46,20 @@ INSERT INTO email_test (email, description)
 VALUES ('Test.Email@Example.Com', 'Mixed case everything'),
        ('test.email@example.com', 'All lowercase'),
        ('POSTMASTER@EXAMPLE.COM', 'Special postmaster address');
+
+-- Binary format round trip (COPY ... FORMAT binary uses send/receive)
+SELECT email_addr_send('"John Doe"@Example.COM');
+
+CREATE TEMP TABLE email_binary_test (email email_addr);
+COPY email_test (email) TO '/tmp/pg_email_opt_binary.copy' WITH (FORMAT binary);
+COPY email_binary_test (email) FROM '/tmp/pg_email_opt_binary.copy' WITH (FORMAT binary);
+SELECT count(*) AS mismatches
+FROM email_test t
+         FULL JOIN email_binary_test b ON t.email::text = b.email::text
+WHERE t.email IS NULL OR b.email IS NULL;
+DROP TABLE email_binary_test;
+
+-- Stored values get a 1-byte header: 4-byte layout header plus the address, less '@'
+SELECT email::text, pg_column_size(email) AS stored_size
+FROM email_test
+WHERE email::text IN ('a@example.com', 'test.email@example.com');
@@ -48,10 +48,21 @@ FROM email_test
 WHERE email =# 'anyuser@EXAMPLE.COM'  -- Domain comparison is case-insensitive
 ORDER BY email;
 
+-- Domain equality with a bare domain in text form, either order
+SELECT email, description
+FROM email_test
+WHERE email =# 'Example.COM'::text
+ORDER BY email;
+
+-- A text operand with an @ stands for its domain (expect t, t, f)
+SELECT 'a@example.com'::email_addr =# 'anyone@EXAMPLE.com'::text AS address,
+       'example.com'::text =# 'a@example.com'::email_addr AS commuted,
+       'a@example.com'::email_addr <># 'example.com'::text AS negated;
+
 -- Test domain inequality (<># operator)
 SELECT email, description
 FROM email_test
-WHERE email <>## 'anyuser@example.com'
+WHERE email <># 'anyuser@example.com'
 ORDER BY email
 LIMIT 5;
 
@@ -92,6 +103,20 @@ FROM email_test
 WHERE email_addr_get_domain(email) <> email_addr_normalized_domain(email)::text
 ORDER BY normalized_domain;
 
+-- email_addr_split matches the four getters (expect 0)
+SELECT count(*) AS mismatches
+FROM email_test, email_addr_split(email) AS s
+WHERE s.local <> email_addr_get_local_part(email)
+   OR s.domain <> email_addr_get_domain(email)
+   OR s.norm_local <> email_addr_normalized_local_part(email)
+   OR s.norm_domain <> email_addr_normalized_domain(email);
+
+SELECT (email_addr_split('"John.Doe"@Example.COM')).*;
+
+-- Normalizing a normalized address gives it back (expect t, t)
+SELECT email_addr_normalize('john@example.com')::text = 'john@example.com',
+       email_addr_normalize('"John"@Example.com')::text = 'John@example.com';
+
 -- Group emails by top-level domain
 SELECT
     substring(email_addr_normalized_domain(email) from '[^.]+$') as tld,
@@ -136,6 +161,14 @@ WHERE email::text LIKE '"%@%'
   AND email =# 'user@example.com'
 ORDER BY email;
 
+-- Equality follows the canonical form stored at input time
+SELECT
+    '"John"@Example.COM'::email_addr = 'john@example.com' as unquotable_quoted_eq,
+    '"ABC"@example.com'::email_addr = '"abc"@example.com' as both_unquotable_eq,
+    '"a b"@example.com'::email_addr = '"A B"@example.com' as quoted_case_sensitive,
+    '"a b"@example.com'::email_addr > 'zzz@example.com' as quoted_sorts_last,
+    email_hash('"John"@Example.COM') = email_hash('john@example.com') as hash_eq;
+
 -- Test maximum length domains
 SELECT email, length(email_addr_get_domain(email)) as domain_length
 FROM email_test
@@ -190,3 +223,182 @@ EXPLAIN ANALYZE
 SELECT count(*)
 FROM email_test
 WHERE email ># 'user@example.com';
+
+-- ========= Test Group 9: Comparison with Text =========
+CREATE TEMP TABLE legacy_contacts AS
+SELECT email::text AS email_text
+FROM email_test;
+INSERT INTO legacy_contacts VALUES ('USER@Example.COM');
+
+-- Text operands compare by canonical form (expect t, t, t, f)
+SELECT 'User@Example.com'::email_addr = 'user@EXAMPLE.com'::text,
+       'user@example.com'::text = 'USER@example.com'::email_addr,
+       'a@example.com'::email_addr < 'b@example.com'::text,
+       'a@example.com'::email_addr <> 'A@Example.com'::text;
+
+-- Join on a text column without casting each row (hash join)
+EXPLAIN (COSTS OFF)
+SELECT count(*)
+FROM email_test e
+         JOIN legacy_contacts l ON e.email = l.email_text;
+
+SELECT count(*) AS matched
+FROM email_test e
+         JOIN legacy_contacts l ON e.email = l.email_text
+WHERE e.email = 'user@example.com';
+
+-- A constant text operand is turned into an email_addr constant
+EXPLAIN (COSTS OFF)
+SELECT email
+FROM email_test
+WHERE email = 'User@Example.com'::text;
+
+-- Invalid text operands raise the input error
+SELECT 'user@example.com'::email_addr = 'not an address'::text;
+
+DROP TABLE legacy_contacts;
+
+-- ========= Test Group 10: Normalized Identity =========
+-- ==# is planned as =, so its joins can be hashed or merged
+EXPLAIN (COSTS OFF)
+SELECT count(*)
+FROM email_test a
+         JOIN email_test b ON a.email ==# b.email;
+
+SET enable_hashjoin = off;
+EXPLAIN (COSTS OFF)
+SELECT count(*)
+FROM email_test a
+         JOIN email_test b ON a.email ==# b.email;
+RESET enable_hashjoin;
+
+-- Unique index on the normalized identity (expect a duplicate key error)
+CREATE TEMP TABLE normalized_contacts (email email_addr);
+CREATE UNIQUE INDEX normalized_contacts_idx ON normalized_contacts (email);
+INSERT INTO normalized_contacts VALUES ('"john"@Example.com');
+INSERT INTO normalized_contacts VALUES ('john@example.COM');
+
+-- Hash index lookup
+CREATE INDEX normalized_contacts_hash_idx ON normalized_contacts USING hash (email);
+SET enable_seqscan = off;
+EXPLAIN (COSTS OFF)
+SELECT email FROM normalized_contacts WHERE email ==# 'JOHN@example.com';
+SELECT email FROM normalized_contacts WHERE email ==# 'JOHN@example.com';
+RESET enable_seqscan;
+DROP TABLE normalized_contacts;
+
+-- ========= Test Group 11: Fingerprints =========
+-- Equal under ==#, so equal fingerprints (expect t, f)
+SELECT email_addr_fingerprint('"John"@Example.COM') = email_addr_fingerprint('john@example.com'),
+       email_addr_fingerprint('john@example.com') = email_addr_fingerprint('jane@example.com');
+
+-- Text form round trip (expect t) and a malformed value (expect an error)
+SELECT email_addr_fingerprint('john@example.com')::text::email_fingerprint =
+       email_addr_fingerprint('john@example.com');
+SELECT 'not a fingerprint'::email_fingerprint;
+
+-- Provider rules (expect f, t, f)
+INSERT INTO email_fingerprint_rules VALUES ('gmail.com', true, true);
+SELECT email_addr_fingerprint('J.Doe+news@gmail.com') = email_addr_fingerprint('jdoe@gmail.com'),
+       email_addr_fingerprint('J.Doe+news@gmail.com', true) = email_addr_fingerprint('jdoe@gmail.com', true),
+       email_addr_fingerprint('j.doe+news@example.com', true) = email_addr_fingerprint('jdoe@example.com', true);
+DELETE FROM email_fingerprint_rules WHERE domain = 'gmail.com';
+
+-- Dedup join on fingerprints can be hashed
+EXPLAIN (COSTS OFF)
+SELECT count(*)
+FROM email_test a
+         JOIN email_test b ON email_addr_fingerprint(a.email) = email_addr_fingerprint(b.email);
+
+-- ========= Test Group 12: Domain Histogram =========
+SELECT (unnest(domain_histogram(email, 3))).*
+FROM email_test;
+
+-- Same result from a parallel plan, combining the workers' states
+SET parallel_setup_cost = 0;
+SET parallel_tuple_cost = 0;
+SET min_parallel_table_scan_size = 0;
+SET max_parallel_workers_per_gather = 2;
+EXPLAIN (COSTS OFF)
+SELECT domain_histogram(email, 3)
+FROM email_test;
+SELECT (unnest(domain_histogram(email, 3))).*
+FROM email_test;
+RESET parallel_setup_cost;
+RESET parallel_tuple_cost;
+RESET min_parallel_table_scan_size;
+RESET max_parallel_workers_per_gather;
+
+-- Empty input gives NULL; topn must be positive (expect an error)
+SELECT domain_histogram(email, 3) IS NULL AS empty FROM email_test WHERE false;
+SELECT domain_histogram(email, 0) FROM email_test;
+
+-- ========= Test Group 13: Approximate Distinct Counts =========
+-- Small inputs are counted almost exactly (expect t)
+SELECT abs(email_approx_count_distinct(email) - count(DISTINCT email)) <= 0.02 * count(DISTINCT email) AS close
+FROM email_test;
+
+-- Case variants count once (expect 1)
+SELECT email_approx_count_distinct(e)
+FROM (VALUES ('john@example.com'::email_addr), ('"John"@EXAMPLE.com'), ('JOHN@example.com')) AS v(e);
+
+-- Provider rules fold dots and plus-tags (expect 2, 1)
+INSERT INTO email_fingerprint_rules VALUES ('gmail.com', true, true);
+SELECT email_approx_count_distinct(e), email_approx_count_distinct(e, true)
+FROM (VALUES ('j.doe@gmail.com'::email_addr), ('jdoe+news@gmail.com')) AS v(e);
+DELETE FROM email_fingerprint_rules WHERE domain = 'gmail.com';
+
+-- The union of the sketches of two halves is the sketch of the whole (expect t, t)
+CREATE TEMP TABLE audience_sketches AS
+SELECT id % 2 AS half, email_hll_agg(email) AS sketch
+FROM email_test
+GROUP BY id % 2;
+SELECT email_hll_cardinality(email_hll_union(sketch)) =
+       (SELECT email_approx_count_distinct(email) FROM email_test) AS union_matches,
+       email_hll_union(sketch)::text::email_hll::text = email_hll_union(sketch)::text AS text_round_trip
+FROM audience_sketches;
+DROP TABLE audience_sketches;
+
+-- Sketches of different precisions cannot be united (expect an error)
+SELECT email_hll_union(email_hll_agg(email, 10), email_hll_agg(email, 12))
+FROM email_test;
+
+-- Invalid text input is a soft error (expect f, f)
+SELECT pg_input_is_valid('\xzz', 'email_hll') AS bad_hex,
+       pg_input_is_valid('\x01', 'email_hll') AS short;
+
+-- ========= Test Group 14: Bloom Filters =========
+CREATE TEMP TABLE suppression_filters AS
+SELECT email_bloom_agg(email, 1000, 0.001) AS filter
+FROM email_test;
+
+-- No false negatives, case variants included (expect 0)
+SELECT count(*) AS missing
+FROM email_test, suppression_filters
+WHERE NOT filter @> email_addr_normalize(email);
+
+-- Few false positives for addresses not added (expect t)
+SELECT count(*) FILTER (WHERE filter @> ('nobody' || i || '@unlisted.example')::email_addr) < 10 AS few_false_positives
+FROM suppression_filters, generate_series(1, 1000) AS i;
+
+-- Merging filters (expect t) and filters of different sizes (expect an error)
+SELECT email_bloom_union(filter, filter)::text = filter::text AS idempotent FROM suppression_filters;
+SELECT email_bloom_union(filter, (SELECT email_bloom_agg(email, 10) FROM email_test)) FROM suppression_filters;
+
+-- The external form has its header in network byte order (expect \x010700000000000000000060)
+SELECT left(email_bloom_agg(email, 10)::text, 26) AS header FROM email_test;
+
+-- Filters read back through text and binary COPY (expect t, t)
+SELECT filter::text::email_bloom::text = filter::text AS text_round_trip FROM suppression_filters;
+CREATE TEMP TABLE suppression_filters_copy (filter email_bloom);
+COPY suppression_filters TO '/tmp/pg_email_opt_bloom.copy' WITH (FORMAT binary);
+COPY suppression_filters_copy FROM '/tmp/pg_email_opt_bloom.copy' WITH (FORMAT binary);
+SELECT c.filter::text = f.filter::text AS binary_round_trip
+FROM suppression_filters f, suppression_filters_copy c;
+DROP TABLE suppression_filters_copy;
+DROP TABLE suppression_filters;
+
+-- Invalid text input is a soft error (expect f, f, f)
+SELECT pg_input_is_valid('\xzz', 'email_bloom') AS bad_hex,
+       pg_input_is_valid('\x01', 'email_bloom') AS short,
+       pg_input_is_valid('\x010700000000000000000010ff', 'email_bloom') AS bad_size;
@@ -96,6 +96,314 @@ SELECT email, description
 FROM email_test
 ORDER BY email_addr_get_domain(email), email_addr_get_local_part(email);
 
+-- Large sort: exercises sort support and abbreviated keys
+CREATE TEMP TABLE email_sort_test AS
+SELECT ('user' || (i % 997) || '@' ||
+        (ARRAY['example.com', 'Example.org', 'mail.example.net', 'a.io'])[i % 4 + 1])::email_addr AS email
+FROM generate_series(1, 20000) AS i;
+
+EXPLAIN (ANALYZE, BUFFERS)
+SELECT email
+FROM email_sort_test
+ORDER BY email;
+
+-- Sorted output must agree with the comparison operators (expect 0)
+SELECT count(*) AS out_of_order
+FROM (SELECT email, lag(email) OVER (ORDER BY email) AS prev
+      FROM email_sort_test) AS s
+WHERE prev > email;
+
+-- Index build uses the same sort support; lookup through it (expect 5)
+CREATE INDEX idx_email_sort_test ON email_sort_test USING btree(email);
+SET enable_seqscan = off;
+SELECT count(*) AS found
+FROM email_sort_test
+WHERE email = 'user42@EXAMPLE.COM';
+RESET enable_seqscan;
+
+-- Domain order uses its own sort support (expect 0)
+SELECT count(*) AS out_of_order
+FROM (SELECT email, lag(email) OVER (ORDER BY email USING <#) AS prev
+      FROM email_sort_test) AS s
+WHERE prev ># email;
+
+-- Domain index lookup (expect 5000)
+CREATE INDEX idx_email_sort_test_domain ON email_sort_test USING btree(email email_addr_domain_ops);
+SET enable_seqscan = off;
+SELECT count(*) AS found
+FROM email_sort_test
+WHERE email =# 'anyone@EXAMPLE.ORG';
+
+-- A bare domain uses the same index (expect an index scan on
+-- idx_email_sort_test_domain, then 5000)
+EXPLAIN (COSTS OFF)
+SELECT count(*) FROM email_sort_test WHERE email =# 'EXAMPLE.ORG'::text;
+SELECT count(*) AS found
+FROM email_sort_test
+WHERE email =# 'EXAMPLE.ORG'::text;
+RESET enable_seqscan;
+DROP TABLE email_sort_test;
+
+-- ------------------------------------------------
+-- Test 4a: Subdomain Search (reverse-label order)
+-- ------------------------------------------------
+
+CREATE TEMP TABLE email_suffix_test AS
+SELECT ('user' || i || '@' ||
+        (ARRAY['example.com', 'Mail.Example.com', 'eu.mail.example.com', 'notexample.com',
+               'example.org', 'examplf.com', 'mail.notexample.com', 'exampl.com'])[i % 8 + 1])::email_addr AS email
+FROM generate_series(1, 8000) AS i;
+
+CREATE INDEX idx_email_suffix_test ON email_suffix_test USING btree(email email_addr_domain_rev_ops);
+ANALYZE email_suffix_test;
+
+-- Sequential scan result (expect 3000)
+SELECT count(*) AS under_example_com
+FROM email_suffix_test
+WHERE email <@# 'Example.COM';
+
+-- The same through an index range scan (expect 3000)
+SET enable_seqscan = off;
+EXPLAIN (COSTS OFF)
+SELECT count(*) FROM email_suffix_test WHERE email <@# 'example.com';
+SELECT count(*) AS under_example_com
+FROM email_suffix_test
+WHERE email <@# 'example.com';
+
+-- Deeper suffix (expect 2000) and a top-level domain (expect 7000)
+SELECT count(*) FROM email_suffix_test WHERE email <@# 'mail.example.com';
+SELECT count(*) FROM email_suffix_test WHERE email <@# 'com';
+RESET enable_seqscan;
+DROP TABLE email_suffix_test;
+
+-- ------------------------------------------------
+-- Test 4a.1: Local-part Prefix Search (local-first order)
+-- ------------------------------------------------
+
+CREATE TEMP TABLE email_local_test AS
+SELECT ((ARRAY['john', 'Joanna', 'jp', 'bob'])[i % 4 + 1] || i || '@' ||
+        (ARRAY['example.com', 'Example.ORG'])[i / 4 % 2 + 1])::email_addr AS email
+FROM generate_series(1, 4000) AS i;
+
+CREATE INDEX idx_email_local_test ON email_local_test USING btree(email email_addr_local_ops);
+ANALYZE email_local_test;
+
+-- Sequential scan result (expect 2000)
+SELECT count(*) AS starts_with_jo
+FROM email_local_test
+WHERE email ^@ 'jo';
+
+-- The same through an index range scan, case-insensitively (expect 2000)
+SET enable_seqscan = off;
+EXPLAIN (COSTS OFF)
+SELECT count(*) FROM email_local_test WHERE email ^@ 'JO';
+SELECT count(*) AS starts_with_jo
+FROM email_local_test
+WHERE email ^@ 'JO';
+
+-- Prefix plus a domain filter matches the sequential result
+EXPLAIN (COSTS OFF)
+SELECT email FROM email_local_test WHERE email ^@ 'john' AND email =# 'example.com'::text;
+SELECT count(*) = (SELECT count(*) FROM email_local_test
+                   WHERE email_addr_get_local_part(email) ILIKE 'john%'
+                     AND lower(email_addr_get_domain(email)) = 'example.com') AS same_as_seqscan
+FROM email_local_test
+WHERE email ^@ 'john' AND email =# 'example.com'::text;
+
+-- Autocomplete: first matches in local-part order
+SELECT email FROM email_local_test WHERE email ^@ 'john1' ORDER BY email USING <^ LIMIT 5;
+RESET enable_seqscan;
+
+-- The order is local part first (expect 0)
+SELECT count(*) AS out_of_order
+FROM (SELECT email, lag(email) OVER (ORDER BY email USING <^) AS prev
+      FROM email_local_test) AS s
+WHERE email_addr_get_local_part(prev) ILIKE 'j%' AND email_addr_get_local_part(email) ILIKE 'b%';
+DROP TABLE email_local_test;
+
+-- ------------------------------------------------
+-- Test 4b: Hash Partitioning (extended hash support)
+-- ------------------------------------------------
+
+CREATE TEMP TABLE email_part_test (email email_addr) PARTITION BY HASH (email);
+CREATE TEMP TABLE email_part_test_0 PARTITION OF email_part_test FOR VALUES WITH (MODULUS 2, REMAINDER 0);
+CREATE TEMP TABLE email_part_test_1 PARTITION OF email_part_test FOR VALUES WITH (MODULUS 2, REMAINDER 1);
+INSERT INTO email_part_test SELECT email FROM email_test;
+
+-- Equal addresses land in the same partition (expect 0)
+SELECT count(*) AS split_pairs
+FROM email_part_test a
+         JOIN email_part_test b ON a.email = b.email
+WHERE a.tableoid <> b.tableoid;
+
+-- Partition pruning on equality
+EXPLAIN (COSTS OFF)
+SELECT email FROM email_part_test WHERE email = 'Simple@EXAMPLE.com';
+DROP TABLE email_part_test;
+
+-- Low 32 bits of the extended hash with seed 0 match email_hash (expect true)
+SELECT bool_and((email_hash_extended(email, 0) & 4294967295) = (email_hash(email)::int8 & 4294967295))
+FROM email_test;
+
+-- ------------------------------------------------
+-- Test 4c: SP-GiST Radix Tree
+-- ------------------------------------------------
+
+CREATE TEMP TABLE email_spgist_test AS
+SELECT (CASE WHEN i % 2 = 0 THEN 'john' ELSE 'Mary' END || i || '@' ||
+        (ARRAY['example.com', 'Mail.Example.com', 'notexample.com', 'example.org'])[i % 4 + 1])::email_addr AS email
+FROM generate_series(1, 4000) AS i;
+
+CREATE INDEX idx_email_spgist_test ON email_spgist_test USING spgist(email email_addr_spgist_ops);
+ANALYZE email_spgist_test;
+
+SET enable_seqscan = off;
+
+-- Full address (expect 1)
+EXPLAIN (COSTS OFF)
+SELECT count(*) FROM email_spgist_test WHERE email = 'JOHN100@example.com';
+SELECT count(*) FROM email_spgist_test WHERE email = 'JOHN100@example.com';
+
+-- Domain (expect 1000)
+SELECT count(*) FROM email_spgist_test WHERE email =# 'anyone@mail.example.com';
+
+-- Subdomains (expect 2000)
+SELECT count(*) FROM email_spgist_test WHERE email <@# 'example.com';
+
+-- Local-part prefix, case-insensitive (expect 555)
+SELECT count(*) FROM email_spgist_test WHERE email ^@ 'John1';
+
+-- Same answers without the index
+RESET enable_seqscan;
+SET enable_indexscan = off;
+SET enable_bitmapscan = off;
+SELECT count(*) FROM email_spgist_test WHERE email = 'JOHN100@example.com';
+SELECT count(*) FROM email_spgist_test WHERE email =# 'anyone@mail.example.com';
+SELECT count(*) FROM email_spgist_test WHERE email <@# 'example.com';
+SELECT count(*) FROM email_spgist_test WHERE email ^@ 'John1';
+RESET enable_indexscan;
+RESET enable_bitmapscan;
+DROP TABLE email_spgist_test;
+
+-- ------------------------------------------------
+-- Test 4d: GIN Token Search
+-- ------------------------------------------------
+
+CREATE TEMP TABLE email_gin_test AS
+SELECT (CASE i % 5
+            WHEN 0 THEN 'Jane.Doe' || i || '+promo'
+            WHEN 1 THEN 'john-smith' || i || '+news.letter'
+            ELSE 'user' || i
+        END || '@' ||
+        (ARRAY['corp.example.com', 'mail.example.org', 'CORPORATE.example.net'])[i % 3 + 1])::email_addr AS email
+FROM generate_series(1, 3000) AS i;
+
+CREATE INDEX idx_email_gin_test ON email_gin_test USING gin(email email_addr_gin_ops);
+ANALYZE email_gin_test;
+
+SET enable_seqscan = off;
+EXPLAIN (COSTS OFF)
+SELECT count(*) FROM email_gin_test WHERE email ?# 'corp';
+
+-- Domain label, whole labels only (expect 1000)
+SELECT count(*) FROM email_gin_test WHERE email ?# 'CORP';
+
+-- Local-part segments (expect 600 each, and 0 for text spanning a separator)
+SELECT count(*) FROM email_gin_test WHERE email ?@ 'jane';
+SELECT count(*) FROM email_gin_test WHERE email ?@ 'news';
+SELECT count(*) FROM email_gin_test WHERE email ?@ 'jane.doe';
+
+-- Plus-tags (expect 600, 600 and 0)
+SELECT count(*) FROM email_gin_test WHERE email ?+ 'promo';
+SELECT count(*) FROM email_gin_test WHERE email ?+ 'news.letter';
+SELECT count(*) FROM email_gin_test WHERE email ?+ 'news';
+
+-- Same answers without the index
+RESET enable_seqscan;
+SET enable_bitmapscan = off;
+SELECT count(*) FROM email_gin_test WHERE email ?# 'CORP';
+SELECT count(*) FROM email_gin_test WHERE email ?@ 'news';
+SELECT count(*) FROM email_gin_test WHERE email ?+ 'news.letter';
+RESET enable_bitmapscan;
+DROP TABLE email_gin_test;
+
+-- ------------------------------------------------
+-- Test 4e: BRIN Minmax and Bloom
+-- ------------------------------------------------
+
+-- Rows arrive grouped by domain, as in an event table
+CREATE TEMP TABLE email_brin_test AS
+SELECT ('rcpt' || i || '@' || 'domain' || (i / 1000) || '.example.com')::email_addr AS email
+FROM generate_series(1, 20000) AS i;
+
+CREATE INDEX idx_email_brin_minmax ON email_brin_test USING brin(email email_addr_domain_minmax_ops)
+    WITH (pages_per_range = 4);
+CREATE INDEX idx_email_brin_bloom ON email_brin_test USING brin(email email_addr_bloom_ops)
+    WITH (pages_per_range = 4);
+ANALYZE email_brin_test;
+
+SET enable_seqscan = off;
+
+-- Domain lookup through the minmax index (expect 1000)
+EXPLAIN (COSTS OFF)
+SELECT count(*) FROM email_brin_test WHERE email =# 'x@domain7.example.com';
+SELECT count(*) FROM email_brin_test WHERE email =# 'x@domain7.example.com';
+
+-- Domain range (expect 3000)
+SELECT count(*) FROM email_brin_test
+WHERE email >=# 'x@domain3.example.com' AND email <=# 'x@domain5.example.com';
+
+-- Recipient lookup through the bloom index (expect 1)
+DROP INDEX idx_email_brin_minmax;
+EXPLAIN (COSTS OFF)
+SELECT count(*) FROM email_brin_test WHERE email = 'RCPT7777@Domain7.example.com';
+SELECT count(*) FROM email_brin_test WHERE email = 'RCPT7777@Domain7.example.com';
+
+RESET enable_seqscan;
+DROP TABLE email_brin_test;
+
+-- ------------------------------------------------
+-- Test 4f: Domain Statistics and Estimates
+-- ------------------------------------------------
+
+-- 80% of the rows share one domain, the rest are all different
+CREATE TEMP TABLE email_estimate_test AS
+SELECT ('u' || i || '@' ||
+        CASE WHEN i % 10 < 8 THEN 'gmail.com' ELSE 'd' || i || '.example.com' END)::email_addr AS email
+FROM generate_series(1, 10000) AS i;
+ANALYZE email_estimate_test;
+
+CREATE FUNCTION pg_temp.estimated_rows(query text) RETURNS float8 AS $$
+DECLARE
+    plan json;
+BEGIN
+    EXECUTE 'EXPLAIN (FORMAT JSON) ' || query INTO plan;
+    RETURN (plan -> 0 -> 'Plan' ->> 'Plan Rows')::float8;
+END
+$$ LANGUAGE plpgsql;
+
+-- Common domain, about 8000 rows (expect true)
+SELECT pg_temp.estimated_rows($$SELECT * FROM email_estimate_test WHERE email =# 'x@GMail.com'$$)
+           BETWEEN 7000 AND 9000 AS common_domain_ok;
+
+-- Rare domain, about 1 row (expect true)
+SELECT pg_temp.estimated_rows($$SELECT * FROM email_estimate_test WHERE email =# 'x@d9.example.com'$$)
+           < 10 AS rare_domain_ok;
+
+-- Everything but the common domain, about 2000 rows (expect true)
+SELECT pg_temp.estimated_rows($$SELECT * FROM email_estimate_test WHERE email <># 'x@gmail.com'$$)
+           BETWEEN 1500 AND 2500 AS other_domains_ok;
+
+-- Domains longer than gmail.com, all the rare ones (expect true)
+SELECT pg_temp.estimated_rows($$SELECT * FROM email_estimate_test WHERE email ># 'x@gmail.com'$$)
+           BETWEEN 1500 AND 2500 AS domain_range_ok;
+
+-- Self-join on domain, about 8000 * 8000 + 2000 rows (expect true)
+SELECT pg_temp.estimated_rows($$SELECT * FROM email_estimate_test a JOIN email_estimate_test b ON a.email =# b.email$$)
+           BETWEEN 50000000 AND 80000000 AS domain_join_ok;
+
+DROP TABLE email_estimate_test;
+
 -- ------------------------------------------------
 -- Test 5: Index Only Scans
 -- ------------------------------------------------
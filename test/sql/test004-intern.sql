@@ -0,0 +1,110 @@
+-- ================================================
+-- Domain Interning: email_addr(interned)
+-- ================================================
+
+DROP TABLE IF EXISTS email_intern_test;
+CREATE TABLE email_intern_test
+(
+    id    serial PRIMARY KEY,
+    email email_addr(interned)
+);
+
+\d email_intern_test
+
+-- Lowercase domains are interned, others are stored inline
+INSERT INTO email_intern_test (email)
+VALUES ('alice@example.com'),
+       ('bob@example.com'),
+       ('carol@gmail.com'),
+       ('Dave@Example.COM'),
+       ('"quoted user"@example.com');
+
+COPY email_intern_test (email) FROM STDIN;
+erin@gmail.com
+frank@example.org
+\.
+
+SELECT domain FROM email_addr_domain_dict ORDER BY domain;
+
+-- Values read back unchanged
+SELECT email, email_addr_get_domain(email) AS domain
+FROM email_intern_test
+ORDER BY id;
+
+-- Interned and inline values compare as usual
+SELECT a.email AS email1, b.email AS email2
+FROM email_intern_test a
+         JOIN email_test b ON a.email = b.email
+ORDER BY a.email;
+
+SELECT email
+FROM email_intern_test
+WHERE email =# 'anyone@EXAMPLE.com'
+ORDER BY email;
+
+-- Ordering is unchanged by interning
+SELECT email
+FROM email_intern_test
+ORDER BY email;
+
+-- Interned values are smaller than inline ones
+SELECT pg_column_size('alice@example.com'::email_addr) > pg_column_size(email) AS smaller
+FROM email_intern_test
+WHERE id = 1;
+
+-- Rolled back inserts do not leave dangling ids behind
+BEGIN;
+INSERT INTO email_intern_test (email) VALUES ('ghost@rolled-back.example');
+ROLLBACK;
+INSERT INTO email_intern_test (email) VALUES ('ghost@rolled-back.example');
+SELECT email FROM email_intern_test WHERE email =# 'x@rolled-back.example';
+
+-- A value interned in an aborted subtransaction is not stored: expect an
+-- error for its domain id, and no row
+DO $$
+DECLARE
+    v email_addr;
+BEGIN
+    BEGIN
+        v := 'ghost@aborted-sub.example'::email_addr(interned);
+        RAISE EXCEPTION 'abort';
+    EXCEPTION WHEN raise_exception THEN
+        NULL;
+    END;
+    INSERT INTO email_intern_test (email) VALUES (v);
+END
+$$;
+SELECT email FROM email_intern_test WHERE email =# 'x@aborted-sub.example';
+
+-- Read-only transactions intern known domains and keep new ones inline:
+-- expect t (interned), t (inline), and no row for readonly.example
+BEGIN READ ONLY;
+SELECT pg_column_size('zed@example.com'::email_addr(interned)) <
+       pg_column_size('zed@example.com'::email_addr) AS interned;
+SELECT pg_column_size('zed@readonly.example'::email_addr(interned)) =
+       pg_column_size('zed@readonly.example'::email_addr) AS inline;
+SELECT 'zed@readonly.example'::email_addr(interned) = 'zed@readonly.example'::email_addr;
+COMMIT;
+SELECT domain FROM email_addr_domain_dict WHERE domain = 'readonly.example';
+
+-- Only email_addr_domain_dict_add() writes the dictionary: expect
+-- permission denied, two check violations for domains that are not
+-- canonical, then an interned domain added for the role
+DROP ROLE IF EXISTS email_intern_user;
+CREATE ROLE email_intern_user;
+SET ROLE email_intern_user;
+INSERT INTO email_addr_domain_dict VALUES (1000000, 'remapped.example');
+SELECT email_addr_domain_dict_add(repeat('a', 300) || '.example');
+SELECT email_addr_domain_dict_add('Upper.Example');
+CREATE TEMP TABLE email_intern_role_test (email email_addr(interned));
+INSERT INTO email_intern_role_test VALUES ('henry@role.example');
+SELECT email FROM email_intern_role_test;
+DROP TABLE email_intern_role_test;
+RESET ROLE;
+DROP ROLE email_intern_user;
+SELECT domain FROM email_addr_domain_dict WHERE domain IN ('remapped.example', 'role.example');
+
+-- Invalid modifiers are rejected
+CREATE TEMP TABLE email_bad_typmod (email email_addr(compressed));
+
+DROP TABLE email_intern_test;
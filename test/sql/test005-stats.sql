@@ -0,0 +1,32 @@
+-- ================================================
+-- Instrumentation: pg_email_opt_stats()
+-- ================================================
+
+SELECT pg_email_opt_stats_reset();
+
+-- Counters start at zero
+SELECT operation, calls, bytes, failures FROM pg_email_opt_stats();
+
+-- Two valid inputs, one invalid, one output
+SELECT 'alice@example.com'::email_addr;
+SELECT 'bob@example.com'::email_addr < 'carol@example.com'::email_addr;
+SELECT 'invalid.email'::email_addr;
+
+-- expect input: 4 calls, 1 failure; output: 1 call, 17 bytes; compare: 1 call
+-- (the < operator; sorting below goes through email_addr_cmp and is not counted)
+SELECT operation, calls, bytes, failures FROM pg_email_opt_stats();
+
+-- Timing is only collected on request
+SET pg_email_opt.track_timing = on;
+SELECT count(*) FROM (SELECT ('user' || i || '@example.com')::email_addr AS e
+                      FROM generate_series(1, 1000) i ORDER BY e) s;
+SELECT operation, total_time > 0 AS timed FROM pg_email_opt_stats() WHERE operation = 'input';
+RESET pg_email_opt.track_timing;
+
+-- Trace emits one NOTICE per value
+SET pg_email_opt.trace = on;
+SELECT 'Dave@Example.COM'::email_addr;
+RESET pg_email_opt.trace;
+
+SELECT pg_email_opt_stats_reset();
+SELECT sum(calls) AS calls FROM pg_email_opt_stats();
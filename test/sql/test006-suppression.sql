@@ -0,0 +1,105 @@
+-- ================================================
+-- Suppression cache: email_is_suppressed()
+-- Needs shared_preload_libraries = 'pg_email_opt'; without it every
+-- lookup fails with "email suppression cache is not available"
+-- ================================================
+
+SHOW shared_preload_libraries;
+
+DROP TABLE IF EXISTS unsubscribed;
+DROP TABLE IF EXISTS bounced;
+CREATE TABLE unsubscribed (email email_addr NOT NULL);
+CREATE TABLE bounced (address email_addr);
+
+INSERT INTO unsubscribed VALUES ('alice@example.com'), ('Bob@Example.COM');
+INSERT INTO bounced VALUES ('carol@example.org'), (NULL);
+
+SELECT email_suppression_register('unsubscribed');
+SELECT email_suppression_register('bounced', 'address');
+SELECT * FROM email_suppression_sources ORDER BY source::text;
+
+-- expect t, t (normalized identity), t, f
+SELECT email_is_suppressed('alice@example.com');
+SELECT email_is_suppressed('bob@example.com');
+SELECT email_is_suppressed('carol@example.org');
+SELECT email_is_suppressed('dave@example.com');
+
+-- Committed changes reach the cache
+INSERT INTO unsubscribed VALUES ('dave@example.com');
+SELECT email_is_suppressed('dave@example.com');
+DELETE FROM unsubscribed WHERE email = 'alice@example.com';
+SELECT email_is_suppressed('alice@example.com');
+
+-- A transaction sees its own changes; aborted ones never reach the cache
+-- expect t, then f
+BEGIN;
+INSERT INTO unsubscribed VALUES ('erin@example.com');
+SELECT email_is_suppressed('erin@example.com');
+ROLLBACK;
+SELECT email_is_suppressed('erin@example.com');
+
+TRUNCATE bounced;
+SELECT email_is_suppressed('carol@example.org');
+
+-- Per-row use
+SELECT e, email_is_suppressed(e::email_addr)
+FROM (VALUES ('alice@example.com'), ('dave@example.com'), ('Bob@example.com')) v(e);
+
+-- Each database has its own sources and cache: expect f, t in the other
+-- database, then t, f back here
+\set main_db :DBNAME
+DROP DATABASE IF EXISTS pg_email_opt_suppression_other;
+CREATE DATABASE pg_email_opt_suppression_other;
+\c pg_email_opt_suppression_other
+CREATE EXTENSION pg_email_opt;
+CREATE TABLE unsubscribed (email email_addr NOT NULL);
+INSERT INTO unsubscribed VALUES ('zoe@example.com');
+SELECT email_suppression_register('unsubscribed');
+SELECT email_is_suppressed('dave@example.com');
+SELECT email_is_suppressed('zoe@example.com');
+\c :main_db
+SELECT email_is_suppressed('dave@example.com');
+SELECT email_is_suppressed('zoe@example.com');
+DROP DATABASE pg_email_opt_suppression_other;
+
+-- A loaded cache still needs SELECT on the sources; expect t, then
+-- permission denied for a source table; with column privileges, t
+SELECT email_is_suppressed('dave@example.com');
+DROP ROLE IF EXISTS suppression_prober;
+CREATE ROLE suppression_prober;
+SET ROLE suppression_prober;
+SELECT email_is_suppressed('dave@example.com');
+RESET ROLE;
+GRANT SELECT (email) ON unsubscribed TO suppression_prober;
+GRANT SELECT ON bounced TO suppression_prober;
+SET ROLE suppression_prober;
+SELECT email_is_suppressed('dave@example.com');
+RESET ROLE;
+REVOKE ALL ON unsubscribed FROM suppression_prober;
+REVOKE ALL ON bounced FROM suppression_prober;
+DROP ROLE suppression_prober;
+
+-- Sources are tables without row-level security: expect two errors
+CREATE VIEW unsubscribed_view AS SELECT email FROM unsubscribed;
+SELECT email_suppression_register('unsubscribed_view');
+DROP VIEW unsubscribed_view;
+CREATE TABLE hidden_emails (email email_addr);
+ALTER TABLE hidden_emails ENABLE ROW LEVEL SECURITY;
+SELECT email_suppression_register('hidden_emails');
+DROP TABLE hidden_emails;
+
+-- A source must have an email_addr column
+CREATE TABLE not_emails (email text);
+SELECT email_suppression_register('not_emails');
+SELECT email_is_suppressed('alice@example.com');
+SELECT email_suppression_unregister('not_emails');
+DROP TABLE not_emails;
+
+-- Unregistered sources leave the cache
+SELECT email_suppression_unregister('unsubscribed');
+SELECT email_is_suppressed('dave@example.com');
+SELECT email_suppression_unregister('unsubscribed');
+
+SELECT email_suppression_unregister('bounced');
+DROP TABLE unsubscribed;
+DROP TABLE bounced;
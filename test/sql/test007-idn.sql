@@ -0,0 +1,66 @@
+-- ================================================
+-- Internationalized addresses
+-- ================================================
+
+DROP TABLE IF EXISTS idn_test;
+CREATE TABLE idn_test (email email_addr);
+INSERT INTO idn_test VALUES
+    ('тест@example.com'),
+    ('test@测试.com'),
+    ('josé@Bücher.example'),
+    ('"José Díaz"@münchen.de'),
+    ('ascii@xn--mnchen-3ya.de');
+
+-- Entered forms are kept; the canonical domain is the A-label
+SELECT email, email_addr_get_domain(email), email_addr_normalized_domain(email)
+FROM idn_test
+ORDER BY email;
+
+-- A U-label equals its A-label spelling (expect t, t, f)
+SELECT 'josé@bücher.example'::email_addr = 'José@XN--BCHER-KVA.example' AS same_address,
+       'a@münchen.de'::email_addr =# 'b@xn--mnchen-3ya.de' AS same_domain,
+       'josé@bücher.example'::email_addr = 'jose@bücher.example' AS accents_differ;
+
+-- Equal values hash alike (expect t)
+SELECT email_hash('josé@bücher.example') = email_hash('josé@xn--bcher-kva.example');
+
+-- Domain index on the A-label bytes (expect 2)
+CREATE INDEX idx_idn_test_domain ON idn_test USING btree (email email_addr_domain_ops);
+SET enable_seqscan = off;
+SELECT count(*) FROM idn_test WHERE email =# 'x@MÜNCHEN.de';
+SELECT count(*) FROM idn_test WHERE email =# 'xn--mnchen-3ya.de'::text;
+SELECT count(*) FROM idn_test WHERE email =# 'münchen.de'::text;
+RESET enable_seqscan;
+
+-- Bare U-label operands match the A-label the address stores (expect t, t, t, t)
+SELECT 'a@münchen.de'::email_addr =# 'MÜNCHEN.de'::text AS bare_domain,
+       'josé@mail.bücher.example'::email_addr <@# 'bücher.example' AS subdomain,
+       'josé@mail.bücher.example'::email_addr ?# 'bücher' AS label,
+       'ascii@xn--mnchen-3ya.de'::email_addr <@# 'münchen.de' AS a_label_stored;
+
+-- The same through the GIN and SP-GiST indexes (expect 1, 2)
+CREATE INDEX idx_idn_test_gin ON idn_test USING gin (email email_addr_gin_ops);
+CREATE INDEX idx_idn_test_spgist ON idn_test USING spgist (email email_addr_spgist_ops);
+SET enable_seqscan = off;
+SELECT count(*) FROM idn_test WHERE email ?# 'bücher';
+SELECT count(*) FROM idn_test WHERE email <@# 'münchen.de';
+RESET enable_seqscan;
+
+-- Stored values round-trip through text (expect t)
+SELECT bool_and(email::text::email_addr = email) AS text_round_trip FROM idn_test;
+
+-- Still invalid: labels longer than 63 bytes once encoded, invalid
+-- characters around the non-ASCII ones
+SELECT ('a@' || repeat('ü', 40) || '.com')::email_addr;
+SELECT ('a@' || repeat('ü', 100) || '.com')::email_addr;
+SELECT ('a@ü' || repeat('a', 1500) || '.de')::email_addr;
+SELECT 'a@bü_cher.example'::email_addr;
+SELECT 'a..ü@example.com'::email_addr;
+
+-- Output reads back through COPY (expect 5)
+COPY idn_test TO '/tmp/pg_email_opt_idn.copy';
+TRUNCATE idn_test;
+COPY idn_test FROM '/tmp/pg_email_opt_idn.copy';
+SELECT count(*) FROM idn_test;
+
+DROP TABLE idn_test;
@@ -1,3 +1,10 @@
+# Captures the output of every script in sql/ into expect/. Run it against
+# a PostgreSQL 16 server with the extension installed, after any change in
+# behavior, and commit the regenerated files. Connect as a superuser with
+# pg_email_opt in shared_preload_libraries: test006 needs the preload, a
+# second database and a role of its own.
+cd "$(dirname "$0")" || exit 1
+
 psql \
       -v ON_ERROR_STOP=off \
       --pset pager=off \
@@ -28,6 +35,7 @@ psql \
   -P columns=200 \
   -P expanded=on \
   -f ./sql/test001-insert-wrong.sql \
+  > ./expect/test001-insert-wrong.out \
   2> ./expect/test001-insert-wrong.log
 
 psql \
@@ -52,6 +60,50 @@ psql \
       > ./expect/test003-index.out \
       2> ./expect/test003-index.log
 
+psql \
+      -v ON_ERROR_STOP=off \
+      --pset pager=off \
+      --set COLUMNS=200 \
+      -P format=aligned \
+      -P columns=200 \
+      -P expanded=on \
+      -f ./sql/test004-intern.sql \
+      > ./expect/test004-intern.out \
+      2> ./expect/test004-intern.log
+
+psql \
+      -v ON_ERROR_STOP=off \
+      --pset pager=off \
+      --set COLUMNS=200 \
+      -P format=aligned \
+      -P columns=200 \
+      -P expanded=on \
+      -f ./sql/test005-stats.sql \
+      > ./expect/test005-stats.out \
+      2> ./expect/test005-stats.log
+
+psql \
+      -v ON_ERROR_STOP=off \
+      --pset pager=off \
+      --set COLUMNS=200 \
+      -P format=aligned \
+      -P columns=200 \
+      -P expanded=on \
+      -f ./sql/test006-suppression.sql \
+      > ./expect/test006-suppression.out \
+      2> ./expect/test006-suppression.log
+
+psql \
+      -v ON_ERROR_STOP=off \
+      --pset pager=off \
+      --set COLUMNS=200 \
+      -P format=aligned \
+      -P columns=200 \
+      -P expanded=on \
+      -f ./sql/test007-idn.sql \
+      > ./expect/test007-idn.out \
+      2> ./expect/test007-idn.log
+
 psql \
       -v ON_ERROR_STOP=off \
       --pset pager=off \